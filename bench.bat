@@ -0,0 +1,13 @@
+@echo OFF
+
+set "cb_bat=%~dp0cb.bat"
+
+@REM Recursively iterate over all the "bench.c" files and call "cb.bat" on them
+@REM Benchmarks are not run by tests.bat, they only report timings.
+for /R "./tests/bench/" %%f in (bench.c) do (
+    if exist "%%f" (
+        echo "Starting benchmark for: %%f"
+        @REM Execute cb.bat on the current bench.c
+        call %cb_bat% --release --file "%%f" --output bench.exe || exit /B 1
+    )
+)
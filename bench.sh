@@ -0,0 +1,9 @@
+# Get absolute path of the cb.sh script
+cb_sh=$(realpath cb.sh)
+
+# Benchmarks are not run by tests.sh, they only report timings.
+shopt -s globstar
+for f in ./tests/bench/**/bench.c; do
+  echo "Starting benchmark for: $f" 
+  $cb_sh --release --file "$(realpath "$f")" --output ./bench.bin || { exit 1; }
+done
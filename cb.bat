@@ -19,6 +19,7 @@ set cb_output=cb.exe
 @REM inlude path to locate the "cb/cb.h" file
 set cb_include_dir=%~dp0
 set cb_pedantic=
+set cb_release=
 set cb_cxflags=
 @REM --------------------------------------------------------------------------------
 @REM Parse Arguments
@@ -33,6 +34,7 @@ if not "%1"=="" (
     @REM options                 
     if "%1"=="run"               set "cb_run=1"
     if "%1"=="--pedantic"        set "cb_pedantic=1"
+    if "%1"=="--release"         set "cb_release=1"
     if "%1"=="--file"            set "cb_file=%2" && SHIFT
     if "%1"=="--include-dir"     set "cb_include_dir=%2" && SHIFT
     if "%1"=="--tmp-dir"         set "cb_tmp_dir=%2"  && SHIFT
@@ -54,6 +56,7 @@ echo.
 echo    help                  Display help
 echo    msvc                  Using MSVC, the only option supported so far. [default]
 echo    run                   Run the builder once it's compiled [default]
+echo    --release             Compile the builder with optimizations.
 echo    --file    [filename]  Input c file to compile.
 echo    --output  [path]      The output full path of the generated executable
 echo    --tmp-dir [directory] Temporary directory for intermediate objects.
@@ -84,6 +87,7 @@ if not exist %cb_tmp_dir% echo "Could not create %cb_tmp_dir%" || goto error
 @REM Compile the builder
 @REM --------------------------------------------------------------------------------
 if "%cb_msvc%"=="1" if "%cb_pedantic%"=="1" set "cb_cxflags=/Wall /WX"
+if "%cb_msvc%"=="1" if "%cb_release%"=="1" set "cb_cxflags=%cb_cxflags% /O2"
 
 if "%cb_msvc%"=="1" (
     cl.exe %cb_cxflags% /EHsc /nologo /Zi /utf-8 /I %cb_include_dir% /Fo"%cb_tmp_dir%" /Fd"%cb_tmp_dir%"  %cb_filename% /link /OUT:"%cb_output%" /PDB:"%cb_tmp_dir%" /ILK:"%cb_tmp_dir%/%cb_basename%.ilk" || goto error
@@ -117,6 +121,7 @@ set "cb_help="
 set "cb_script="
 set "cb_cxflags="
 set "cb_pedantic="
+set "cb_release="
 
 cd %cb_starting_dir%
 Exit /B 0
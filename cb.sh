@@ -8,6 +8,7 @@ cb_run=1
 cb_file="$(realpath -- cb.c)"  # Source file name to compile
 cb_output="./cb.bin"           # Executable name
 cb_include_dir="$cb_root/"     # Include directory to locate the cb.h file
+cb_optimization="-O0"          # Optimization level, "--release" enables optimizations
 
 while (( "$#" )); do
     if [ "$1" == "clang" ];  then cb_clang=1; cb_compiler="${CC:-clang}"; unset cb_gcc; fi
@@ -15,6 +16,7 @@ while (( "$#" )); do
     if [ "$1" == "help" ];   then cb_help=1; fi
     if [ "$1" == "run" ];    then cb_run=1; fi
     if [ "$1" == "--pedantic" ]; then cb_pedantic=1; fi
+    if [ "$1" == "--release" ]; then cb_optimization="-O2"; fi
     if [ "$1" == "--file" ]; then cb_file=$2; shift; fi
     if [ "$1" == "--output" ]; then cb_output=$2; shift; fi 
     if [ "$1" == "--include-dir" ]; then cb_include_dir=$2; shift; fi
@@ -44,7 +46,7 @@ if [ -v cb_gcc ] && [ -v cb_pedantic ]; then cb_cxflags="-std=gnu89 -Wall -Wextr
 
 # Check if there is a value in cb_gcc.
 if [ -v cb_gcc ]; then
-   $cb_compiler $cb_cxflags -g -I $cb_include_dir -o "$cb_output" -O0 $cb_filename || { echo "'$cb_compiler' exited with $?"; exit 1; }
+   $cb_compiler $cb_cxflags -g -I $cb_include_dir -o "$cb_output" $cb_optimization $cb_filename || { echo "'$cb_compiler' exited with $?"; exit 1; }
 fi
 
 # Check if there is a value in cb_run.
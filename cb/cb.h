@@ -2,11 +2,11 @@
 #define CB_H
 
 #ifdef CB_VERSION
-#define CB_VERSION "0.0.10"
+#define CB_VERSION "0.0.11"
 #endif
 
 #ifdef CB_VERSION_NUM
-#define CB_VERSION_NUM 000010
+#define CB_VERSION_NUM 000011
 #endif
 
 #define CB_IMPLEMENTATION
@@ -16,6 +16,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h> /* va_start, va_end */
+#include <stdlib.h> /* getenv, atoi */
 
 /* Suppress some MSVC warnings. */
 #ifdef _MSC_VER
@@ -44,6 +45,19 @@
 	#include <errno.h>
 	#include <sys/sendfile.h> /* sendfile */
 	#include <sys/wait.h>     /* waitpid */
+	#include <time.h>         /* nanosleep */
+	#include <poll.h>         /* poll */
+	#include <signal.h>       /* sigaction */
+	/* posix_spawn avoids copying the page tables of the (potentially big) parent process.
+	   Define CB_NO_POSIX_SPAWN to always use fork. */
+	#ifndef CB_NO_POSIX_SPAWN
+	#include <spawn.h>        /* posix_spawnp */
+	#define CB_USE_POSIX_SPAWN
+	/* posix_spawn_file_actions_addchdir_np is required to start the process in another directory. */
+	#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+	#define CB_USE_POSIX_SPAWN_CHDIR
+	#endif
+	#endif
 	#include <dirent.h>       /* opendir */
 
 	#define CB_THREAD __thread
@@ -138,8 +152,11 @@ typedef struct cb_project_t cb_project_t;
 typedef struct cb_strv cb_strv;
 typedef struct cb_darr cb_darr;
 typedef struct cb_kv cb_kv;
+typedef struct cb_mmap_entry cb_mmap_entry;
+typedef struct cb_mmap cb_mmap;
 typedef struct cb_context cb_context;
 typedef struct cb_process_handle cb_process_handle;
+typedef struct cb_cmd cb_cmd;
 
 /* Returns the name of the result, which could be the path of a library or any other value depending on the toolchain. */
 typedef const char* (*cb_toolchain_bake_t)(cb_toolchain_t* tc, const char* project_name);
@@ -186,6 +203,17 @@ CB_API void cb_add_f(const char* key, const char* format, ...);
 /* Add multiple string values. The last value must be a null value. */
 CB_API void cb_add_many_vnull(const char* key, ...);
 
+/* Add multiple string values. */
+CB_API void cb_add_many(const char* key, const char* values[], cb_size count);
+
+/* Values added between cb_batch_begin and cb_batch_end are stored with their key all at once in cb_batch_end.
+   The batch applies to the project which is current in the outermost cb_batch_begin, values added to another project
+   within the batch are stored right away. Batches can be nested.
+   Properties of the batched project can't be read or removed within a batch, cb_set, cb_remove_all and cb_remove_one
+   must not be used on it before cb_batch_end. */
+CB_API void cb_batch_begin(void);
+CB_API void cb_batch_end(void);
+
 /* Add multiple values using var args macro. */
 #ifdef CB_C99_OR_LATER
 #define cb_add_many_v(key, ...) \
@@ -230,6 +258,76 @@ CB_API const char* cb_bake_project(const char* project_name);
 /* Same as cb_bake. Take an explicit toolchain instead of using the current one. */
 CB_API const char* cb_bake_project_with(const char* project_name, cb_toolchain_t toolchain);
 
+/* Bake a project and all the projects it links (see cb_LINK_PROJECTS), the linked projects being baked first.
+   With the gcc toolchain, projects are baked at the same time and share the number of jobs (see cb_set_jobs),
+   a project only waits for the projects it links before being linked itself.
+   Returns the same result as cb_bake_project. */
+CB_API const char* cb_bake_graph(const char* project_name);
+
+/* Same as cb_bake_graph. Take an explicit toolchain instead of using the current one. */
+CB_API const char* cb_bake_graph_with(const char* project_name, cb_toolchain_t toolchain);
+
+/* Same as cb_bake_graph for all the projects. Returns false if one of them could not be baked. */
+CB_API cb_bool cb_bake_all(void);
+
+/* Same as cb_bake_all. Take an explicit toolchain instead of using the current one. */
+CB_API cb_bool cb_bake_all_with(cb_toolchain_t toolchain);
+
+/* Write the compilation database (compile_commands.json) of all the projects, used by clangd, clang-tidy etc.
+   Each entry contains the arguments the gcc toolchain runs to compile a source file, including the arguments added by the plugins.
+   The file is written entry by entry and only replaced when its content changed.
+   Returns false if a linked project does not exist or if the file could not be written. */
+CB_API cb_bool cb_export_compile_commands(const char* path);
+
+/* Same as cb_export_compile_commands. Take an explicit toolchain instead of using the current one. */
+CB_API cb_bool cb_export_compile_commands_with(const char* path, cb_toolchain_t toolchain);
+
+/* Record the steps of the build in a file using the Chrome trace event format (chrome://tracing, https://ui.perfetto.dev).
+   Compilations, archives, links, file copies, plugin callbacks and the other processes are recorded with their project,
+   their file and, for processes, their process id and exit code. Processes running at the same time are shown on different rows.
+   Events are written as soon as they end. Returns false if the file could not be opened. */
+CB_API cb_bool cb_trace_begin(const char* path);
+
+/* Stop recording and close the file opened by cb_trace_begin. Called by cb_destroy. */
+CB_API void cb_trace_end(void);
+
+/* Statistics of cb itself, collected since cb_init or cb_stats_reset. Times are wall times in microseconds.
+   Steps of the same phase running at the same time (parallel compilations for instance) are counted once,
+   different phases can overlap. The properties and check phases are measured by the gcc toolchain. */
+typedef struct cb_stats cb_stats;
+struct cb_stats {
+	cb_u64 bake_time;       /* Time spent in cb_bake, cb_bake_project, cb_bake_graph and cb_bake_all. */
+	cb_u64 properties_time; /* Options and commands created from the properties of the projects. */
+	cb_u64 check_time;      /* Check of the source files and of the binaries to know what is up to date. */
+	cb_u64 compile_time;
+	cb_u64 link_time;       /* Static libraries included. */
+	cb_u64 copy_time;
+	cb_u64 plugin_time;     /* Time spent in the callbacks of the plugins, also part of the other phases. */
+	cb_u64 process_count;   /* Processes spawned by cb and by the plugins. */
+	cb_u64 bytes_hashed;    /* Content of the files hashed to check if they changed. */
+	cb_u64 files_stated;    /* Files whose size and modification time have been queried. */
+	cb_u64 cache_hits;      /* Files that did not need to be compiled according to the caches of the plugins. */
+	cb_u64 cache_misses;    /* Files looked up in the caches of the plugins and compiled. A file can be looked up in several caches. */
+	cb_u64 tmp_peak;        /* Highest number of bytes used by the tmp allocator. */
+};
+
+CB_API cb_stats cb_stats_get(void);
+
+CB_API void cb_stats_reset(void);
+
+/* Statistics on a single line, allocated with the tmp allocator. */
+CB_API const char* cb_stats_summary(void);
+
+/* Set the maximum number of source files compiled at the same time.
+   0 uses the number of logical processors.
+   A negative value restores the default value (CB_JOBS environment variable or 1).
+   The "jobs" property of a project takes precedence over this value. */
+CB_API void cb_set_jobs(int count);
+
+/* Change the current directory of the process. Returns false if the directory could not be changed.
+   The current directory and absolute paths are cached, use this function instead of chdir. */
+CB_API cb_bool cb_set_current_directory(const char* path);
+
 /* Run executable path. Path is double quoted before being run, in case path contains some space.
    Returns exit code. Returns -1 if command could not be executed.
 */
@@ -248,6 +346,38 @@ CB_API int cb_process_in_directory(const char* cmd, const char* directory);
    cb_process_stdout_string(handle) or cb_process_stderr_string(handle) are not accessible after cb_process_end(handle). */
 CB_API cb_process_handle* cb_process_to_string(const char* cmd, const char* starting_directory, cb_bool also_get_stderr);
 
+/* Start command without waiting for the process to end.
+   cb_process_poll, cb_process_wait or cb_process_wait_any are used to know when the process ends.
+   cb_process_end(handle) needs to be called to cleanup various resources.
+   If the process could not be started the handle is returned anyway and its exit code is -1. */
+CB_API cb_process_handle* cb_process_spawn(const char* cmd, const char* starting_directory);
+
+/* Same as cb_process_spawn but stdout (and stderr if 'also_get_stderr' is true) of the child process are copied to a buffer,
+   see cb_process_to_string. */
+CB_API cb_process_handle* cb_process_spawn_to_string(const char* cmd, const char* starting_directory, cb_bool also_get_stderr);
+
+/* Called for each line written by a child process. 'line' is not null-terminated and does not contain the end of line. */
+typedef void (*cb_process_line_callback)(void* user_data, const char* line, cb_size size, cb_bool is_stderr);
+
+/* Same as cb_process_spawn_to_string but each line is also given to 'callback' as soon as it's read,
+   so that the output can be displayed while the process is running.
+   The callback is called from cb_process_poll, cb_process_wait, cb_process_wait_any and cb_process_end. */
+CB_API cb_process_handle* cb_process_spawn_with_callback(const char* cmd, const char* starting_directory, cb_bool also_get_stderr, cb_process_line_callback callback, void* user_data);
+
+/* Returns true if the process has ended. Never blocks. */
+CB_API cb_bool cb_process_poll(cb_process_handle* handle);
+
+/* Wait for the process to end and returns its exit code. The handle still needs to be ended with cb_process_end. */
+CB_API int cb_process_wait(cb_process_handle* handle);
+
+/* Wait for one of the processes to end and returns its index.
+   Processes that have already ended are returned first, NULL handles are ignored.
+   Returns -1 if there is no process running.
+   POSIX: the first process started installs a SIGCHLD handler to be woken up as soon as a child process exits.
+   The previous handler is still called, the previous disposition is restored by cb_destroy.
+   While the handler is installed a SIGCHLD disposition set to SIG_IGN does not reap the children automatically. */
+CB_API int cb_process_wait_any(cb_process_handle* handles[], int count);
+
 /* Get c string content of stdout of the child process after cb_process_to_string has been called. */
 CB_API const char* cb_process_stdout_string(cb_process_handle* handle);
 
@@ -257,6 +387,59 @@ CB_API const char* cb_process_stderr_string(cb_process_handle* handle);
 /* Returns exit code of the process and clean up resources. */
 CB_API int cb_process_end(cb_process_handle* handle);
 
+/* Command stored as a list of arguments. The arguments are given as they are to the process,
+   the command line is never formatted and parsed again, so they don't need to be quoted. */
+CB_API cb_cmd* cb_cmd_create(void);
+CB_API void cb_cmd_destroy(cb_cmd* cmd);
+/* Remove all the arguments but keep the memory. */
+CB_API void cb_cmd_clear(cb_cmd* cmd);
+CB_API void cb_cmd_push(cb_cmd* cmd, const char* arg);
+CB_API void cb_cmd_push_f(cb_cmd* cmd, const char* fmt, ...);
+/* Split 'str' like a command line given to cb_process and push each argument. */
+CB_API void cb_cmd_push_command_line(cb_cmd* cmd, const char* str);
+/* Push all the arguments of 'other'. */
+CB_API void cb_cmd_append(cb_cmd* cmd, const cb_cmd* other);
+CB_API cb_size cb_cmd_count(const cb_cmd* cmd);
+CB_API const char* cb_cmd_at(const cb_cmd* cmd, cb_size index);
+/* Returns the command line with arguments quoted when needed. The string is allocated with the tmp allocator. */
+CB_API const char* cb_cmd_to_string(const cb_cmd* cmd);
+/* Same as cb_process_in_directory. */
+CB_API int cb_cmd_run(const cb_cmd* cmd, const char* starting_directory);
+/* Same as cb_process_spawn. 'cmd' must not be modified or destroyed before cb_process_end(handle). */
+CB_API cb_process_handle* cb_cmd_spawn(const cb_cmd* cmd, const char* starting_directory);
+/* Same as cb_process_spawn_to_string. 'cmd' must not be modified or destroyed before cb_process_end(handle). */
+CB_API cb_process_handle* cb_cmd_spawn_to_string(const cb_cmd* cmd, const char* starting_directory, cb_bool also_get_stderr);
+
+/* arena - blocks are chained and kept until the arena is destroyed */
+typedef struct cb_arena_block cb_arena_block;
+struct cb_arena_block {
+	char* memory;
+	cb_size size;
+	cb_size offset;
+	cb_size position; /* position of the first byte of the block, see cb_arena_save */
+	cb_arena_block* next;
+};
+
+typedef struct cb_arena cb_arena;
+struct cb_arena {
+	cb_arena_block* first_block;
+	cb_arena_block* current_block;
+	cb_size peak; /* highest position reached */
+};
+
+/* Blocks are allocated on first use, a zero-initialized cb_arena is ready to use. */
+CB_API void cb_arena_init(cb_arena* a);
+/* Release all the blocks. */
+CB_API void cb_arena_destroy(cb_arena* a);
+/* Allocation aligned on CB_ARENA_ALIGNMENT. Never returns NULL. */
+CB_API void* cb_arena_alloc(cb_arena* a, cb_size size);
+/* Release all allocations but keep the blocks. */
+CB_API void cb_arena_reset(cb_arena* a);
+/* Position of the next allocation. Positions always grow within an arena. */
+CB_API cb_size cb_arena_save(const cb_arena* a);
+/* Release all allocations made after the position was saved. */
+CB_API void cb_arena_restore(cb_arena* a, cb_size position);
+
 enum {
     cb_log_level_TRACE,
     cb_log_level_DEBUG,
@@ -278,20 +461,34 @@ struct cb_plugin
     /* To disable a plugin. */
     cb_bool disabled;
     
+    /* All the callbacks receive the project being baked, which is also the current project during the call.
+       Several projects can be baked at the same time (see cb_bake_graph), a plugin must keep its state per project:
+       the callbacks of a project are called between its bake_starting and its bake_finished, interleaved with
+       the callbacks of the other projects. */
+
     /* Called as soon as bake is called. */
-    void (*bake_starting)(cb_plugin* plugin);
+    void (*bake_starting)(cb_plugin* plugin, cb_project_t* project);
     /* Check if a file needs to be processed. */
-    cb_bool (*can_process_file)(cb_plugin* plugin, const char* file);
+    cb_bool (*can_process_file)(cb_plugin* plugin, cb_project_t* project, const char* file);
     /* Called after baking. Returns extra argument.
-       The argument will be added to the command line compiling the source files. */
-    const char* (*extra_argument)(cb_plugin* plugin);
+       The argument will be added to the command line compiling the source files.
+       Also called outside of a bake by cb_export_compile_commands, it must not depend on the state of the bake. */
+    const char* (*extra_argument)(cb_plugin* plugin, cb_project_t* project);
     
     /* 
        Called once a sourec file has been processed.
        NOTE: for Unix system "std_out" is actually equal to the dependency file .d generated by gcc.
        @TODO this is very convoluted. Make it simpler.
     */
-    void (*file_processed)(cb_plugin* plugin, const char* file, const char* std_out, const char* std_err);
+    void (*file_processed)(cb_plugin* plugin, cb_project_t* project, const char* file, const char* std_out, const char* std_err);
+
+    /* Called once the bake is done, whether it succeeded or not. */
+    void (*bake_finished)(cb_plugin* plugin, cb_project_t* project);
+
+    /* Called before any source file is processed, with the absolute path of the source files of the project
+       accepted by the previous plugins. Gives a chance to check all the files at once.
+       can_process_file is called for each of these files afterward, before the check_files of the next plugin. */
+    void (*check_files)(cb_plugin* plugin, cb_project_t* project, const char** files, cb_size count);
 };
 
 /* Initialize cb context with a array of plugins.  */
@@ -309,6 +506,8 @@ CB_API void cb_init_with_plugins(cb_plugin** plugins, int plugin_count);
 #define cb_FILES "files"
 /* Include directories. */
 #define cb_INCLUDE_DIRECTORIES "include_directories" 
+/* Maximum number of source files compiled at the same time. "0" uses the number of logical processors. */
+#define cb_JOBS "jobs"
 /* Other projects to link. */
 #define cb_LINK_PROJECTS "link_projects"
 /* Libraries to link with. */
@@ -457,14 +656,34 @@ struct cb_kv {
 	} u; /* value */
 };
 
-/* multimap */
-typedef cb_darrT(cb_kv) cb_mmap;
+/* all values of a key of the multimap */
+struct cb_mmap_entry {
+	cb_id hash;  /* hash of the key */
+	cb_strv key; /* key */
+	cb_darrT(cb_kv) values; /* values in insertion order */
+};
+
+/* multimap
+ * Each key owns a contiguous list of values so adding a value never moves the other ones.
+ * Keys are found with an open-addressing index.
+ */
+struct cb_mmap {
+	cb_darrT(cb_mmap_entry) entries; /* keys in order of first insertion, an entry is never removed */
+	cb_size* slots; /* entry index + 1, or 0 for an empty slot */
+	cb_size slot_capacity; /* power of two */
+	cb_size count; /* number of values of all keys */
+	cb_darrT(cb_kv) pending; /* values added within a batch, not yet stored with their key */
+	int batch_depth;
+};
 
 #define cb_rangeT(type) \
 struct {                \
 	type* begin;        \
 	type* end;          \
 	cb_size count;      \
+	/* Only used by cb_mmap_get_range_all to walk through the next entries. */ \
+	const cb_mmap* map; \
+	cb_size next_entry; \
 }
 
 typedef cb_rangeT(cb_kv) cb_kv_range;
@@ -481,6 +700,38 @@ struct cb_project_t {
 #define CB_MAX_PLUGIN 32
 #endif
 
+/* trace */
+
+/* Phases of cb_stats. */
+enum {
+	cb_phase_BAKE,
+	cb_phase_PROPERTIES,
+	cb_phase_CHECK,
+	cb_phase_COMPILE,
+	cb_phase_LINK,
+	cb_phase_COPY,
+	cb_phase_PLUGIN,
+	cb_phase_COUNT,
+	cb_phase_NONE = cb_phase_COUNT
+};
+
+/* Step of the build recorded by cb_trace_begin. */
+typedef struct cb_trace_event cb_trace_event;
+struct cb_trace_event {
+	const char* category;      /* "compile", "link", "plugin" etc. */
+	const char* project_name;  /* Optional, must outlive the event. */
+	const char* file;          /* Optional, must outlive the event. */
+	char name[128];            /* Truncated if too long. */
+	cb_u64 begin;              /* Time in microseconds, see cb_time_now. */
+	int lane;                  /* Row of the event in the trace viewer, 0 for the steps run by cb itself. */
+	int phase;                 /* Phase of the statistics, see cb_phase_from_category. */
+	cb_bool started;           /* Measured in the statistics, even if tracing is disabled. */
+	cb_bool recording;         /* Tracing was enabled when the event began. */
+	cb_bool is_process;        /* 'process_id' and 'exit_code' are recorded. */
+	unsigned long process_id;
+	int exit_code;
+};
+
 /* context, the root which hold everything */
 
 struct cb_context {
@@ -490,6 +741,30 @@ struct cb_context {
     
     cb_plugin* plugins[CB_MAX_PLUGIN];
     int plugin_count;
+
+	/* Value set by cb_set_jobs. Negative if not set. */
+	int jobs;
+	/* Slots left by the other projects when a project starts its bake, see cb_get_free_jobs.
+	   Negative outside of cb_gcc_bake_projects. */
+	int free_jobs;
+
+	/* Cached until cb_set_current_directory is called. */
+	cb_strv current_directory; /* without trailing separator, empty when not queried yet */
+	cb_mmap absolute_files; /* path -> absolute file path */
+	cb_mmap absolute_directories; /* path -> absolute directory path */
+	cb_arena path_arena; /* storage of the cached paths */
+
+	/* Set by cb_trace_begin, NULL when tracing is disabled. */
+	FILE* trace_file;
+	cb_u64 trace_start;               /* Time of cb_trace_begin in microseconds. */
+	cb_darrT(cb_bool) trace_lanes;    /* Lanes used by the running processes, the lane of index i is i + 1. */
+
+	cb_stats stats;
+	int phase_running[cb_phase_COUNT]; /* Number of events of each phase being run. */
+	cb_u64 phase_since[cb_phase_COUNT]; /* Time the first of them began. */
+
+	cb_project_t* batch_project; /* Project of the outermost cb_batch_begin, NULL outside of a batch. */
+	int batch_depth;
 };
 
 static cb_context default_ctx;
@@ -540,40 +815,196 @@ CB_INTERNAL void
 cb_log_trace(const char* fmt, ...) { va_list args; va_start(args, fmt); if (cb_log_level <= cb_log_level_TRACE) { cb_log_v(stdout, "[CB-TRACE] ", fmt, args); } va_end(args); }
 
 /*-----------------------------------------------------------------------*/
-/* temporary allocation */
+/* cb_arena - growable arena */
 /*-----------------------------------------------------------------------*/
 
-#ifndef CB_TMP_CAPACITY
-/* Arbitrary size. Must be big enough. Can be increased if needed. */
-#define CB_TMP_CAPACITY (4 * 1024 * 1024) 
+#ifndef CB_ARENA_MIN_BLOCK_SIZE
+#define CB_ARENA_MIN_BLOCK_SIZE (64 * 1024)
 #endif
 
-static CB_THREAD cb_size cb_tmp_size = 0;
-static CB_THREAD char cb_tmp_buffer[CB_TMP_CAPACITY] = { 0 };
-
-#ifndef CB_TMP_ALIGNMENT
-#define CB_TMP_ALIGNMENT 16
+/* Alignment of the memory of each block, must be a power of 2. */
+#ifndef CB_ARENA_ALIGNMENT
+#define CB_ARENA_ALIGNMENT 16
 #endif
 
+CB_INTERNAL cb_size
+cb_arena_align_up(cb_size n, cb_size align)
+{
+	return (n + (align - 1)) & ~(align - 1);
+}
+
+/* Allocate a block (arena_block + memory) in a single malloc */
+CB_INTERNAL cb_arena_block*
+cb_arena_create_block(cb_size size, cb_size position)
+{
+	cb_size header_size = cb_arena_align_up(sizeof(cb_arena_block), CB_ARENA_ALIGNMENT);
+	cb_arena_block* block = NULL;
+
+	size = size < CB_ARENA_MIN_BLOCK_SIZE ? CB_ARENA_MIN_BLOCK_SIZE : size;
+
+	block = (cb_arena_block*)CB_MALLOC(header_size + size);
+	if (!block)
+	{
+		CB_ASSERT(0 && "cb_arena_create_block failed");
+		exit(1);
+	}
+
+	block->memory = (char*)block + header_size; /* Memory is right after the struct */
+	block->size = size;
+	block->offset = 0;
+	block->position = position;
+	block->next = NULL;
+	return block;
+}
+
+CB_INTERNAL void
+cb_arena_free_blocks(cb_arena_block* block)
+{
+	cb_arena_block* next = NULL;
+	while (block)
+	{
+		next = block->next;
+		CB_FREE(block); /* Memory and metadata which were allocated together */
+		block = next;
+	}
+}
+
+CB_API void
+cb_arena_init(cb_arena* a)
+{
+	memset(a, 0, sizeof(cb_arena));
+}
+
+CB_API void
+cb_arena_destroy(cb_arena* a)
+{
+	cb_arena_free_blocks(a->first_block);
+	cb_arena_init(a);
+}
+
+CB_API void
+cb_arena_reset(cb_arena* a)
+{
+	a->current_block = a->first_block;
+	if (a->current_block)
+	{
+		a->current_block->offset = 0;
+	}
+}
+
 CB_INTERNAL void*
-cb_tmp_alloc(cb_size size)
+cb_arena_alloc_aligned(cb_arena* a, cb_size size, cb_size alignment)
 {
-    void* data = NULL;
+	cb_arena_block* block = a->current_block;
+	cb_arena_block* next = NULL;
+	cb_size offset = 0;
+
+	CB_ASSERT(alignment <= CB_ARENA_ALIGNMENT);
 
-    /* Align the current offset to the specified alignment (must be power of 2) */
-    size_t aligned_offset = (cb_tmp_size + (CB_TMP_ALIGNMENT - 1)) & ~((size_t)(CB_TMP_ALIGNMENT - 1));
+	/* Lazy allocation on first use. */
+	if (!block)
+	{
+		block = cb_arena_create_block(size, 0);
+		a->first_block = block;
+		a->current_block = block;
+	}
 
-    CB_ASSERT((aligned_offset + size <= CB_TMP_CAPACITY) &&
-              "Size of the temporary allocator is too small. Increase it if needed.");
+	offset = cb_arena_align_up(block->offset, alignment);
+	if (offset + size > block->size)
+	{
+		/* Blocks following the current one are free, reuse the next one if it's big enough. */
+		next = block->next;
+		if (next && next->size < size)
+		{
+			cb_arena_free_blocks(next);
+			next = NULL;
+		}
 
-    if (aligned_offset + size > CB_TMP_CAPACITY)
-    {
-        return NULL;
-    }
+		if (!next)
+		{
+			/* Double the size of the blocks to keep their number low. */
+			next = cb_arena_create_block(size > block->size * 2 ? size : block->size * 2, block->position + block->size);
+			block->next = next;
+		}
+
+		block = next;
+		offset = 0;
+		a->current_block = block;
+	}
+
+	block->offset = offset + size;
+	if (a->peak < block->position + block->offset)
+	{
+		a->peak = block->position + block->offset;
+	}
+	return block->memory + offset;
+}
+
+CB_API void*
+cb_arena_alloc(cb_arena* a, cb_size size)
+{
+	return cb_arena_alloc_aligned(a, size, CB_ARENA_ALIGNMENT);
+}
+
+CB_API cb_size
+cb_arena_save(const cb_arena* a)
+{
+	return a->current_block
+		? a->current_block->position + a->current_block->offset
+		: 0;
+}
+
+CB_API void
+cb_arena_restore(cb_arena* a, cb_size position)
+{
+	cb_arena_block* block = a->first_block;
+
+	CB_ASSERT(position <= cb_arena_save(a));
+
+	if (!block)
+	{
+		return;
+	}
+
+	while (position > block->position + block->size)
+	{
+		block = block->next;
+		CB_ASSERT(block);
+	}
+
+	block->offset = position - block->position;
+	a->current_block = block;
+}
+
+CB_INTERNAL cb_bool
+cb_arena_contains(const cb_arena* a, const void* ptr)
+{
+	const cb_arena_block* block = a->first_block;
+	for (; block; block = block->next)
+	{
+		if ((const char*)ptr >= block->memory && (const char*)ptr < block->memory + block->size)
+		{
+			return cb_true;
+		}
+	}
+	return cb_false;
+}
+
+/*-----------------------------------------------------------------------*/
+/* temporary allocation */
+/*-----------------------------------------------------------------------*/
+
+/* Grows on demand, the blocks are released by cb_destroy. */
+static CB_THREAD cb_arena cb_tmp_arena = { 0 };
+
+#ifndef CB_TMP_ALIGNMENT
+#define CB_TMP_ALIGNMENT 16
+#endif
 
-    data = &cb_tmp_buffer[aligned_offset];
-    cb_tmp_size = aligned_offset + size;
-    return data;
+CB_INTERNAL void*
+cb_tmp_alloc(cb_size size)
+{
+	return cb_arena_alloc_aligned(&cb_tmp_arena, size, CB_TMP_ALIGNMENT);
 }
 
 CB_INTERNAL void*
@@ -584,10 +1015,28 @@ cb_tmp_calloc(cb_size size)
 	return data;
 }
 
+CB_INTERNAL void cb_intern_clear(void);
+
 CB_INTERNAL void
 cb_tmp_reset(void)
 {
-	cb_tmp_size = 0;
+	cb_arena_reset(&cb_tmp_arena);
+	cb_intern_clear();
+}
+
+/* Release the memory of the tmp allocator of the current thread. */
+CB_INTERNAL void
+cb_tmp_destroy(void)
+{
+	cb_arena_destroy(&cb_tmp_arena);
+	cb_intern_clear();
+}
+
+/* Highest number of bytes used by the tmp allocator of the current thread, including the unused end of filled blocks. */
+CB_INTERNAL cb_size
+cb_tmp_peak_usage(void)
+{
+	return cb_tmp_arena.peak;
 }
 
 CB_INTERNAL cb_strv
@@ -669,21 +1118,29 @@ cb_tmp_str(const char* str)
 CB_INTERNAL cb_size
 cb_tmp_save(void)
 {
-	return cb_tmp_size;
+	return cb_arena_save(&cb_tmp_arena);
 }
 
+/* End of the last interned string in the tmp buffer. */
+static CB_THREAD cb_size cb_intern_tmp_end = 0;
+
 CB_INTERNAL void
 cb_tmp_restore(cb_size index)
 {
-	cb_tmp_size = index;
+	cb_arena_restore(&cb_tmp_arena, index);
+
+	/* Interned strings released by the restore must not be found anymore. */
+	if (index < cb_intern_tmp_end)
+	{
+		cb_intern_clear();
+	}
 }
 
 /* Check if pointer is contained in the tmp buffer */
 CB_INTERNAL cb_bool
 cb_tmp_contains(const void* ptr)
 {
-	return ptr >= (void*)cb_tmp_buffer
-		&& ptr < (void*)(cb_tmp_buffer + CB_TMP_CAPACITY);
+	return cb_arena_contains(&cb_tmp_arena, ptr);
 }
 
 /*-----------------------------------------------------------------------*/
@@ -900,8 +1357,9 @@ cb_lexicagraphical_cmp(const char* left, cb_size left_count, const char* right,
 CB_INTERNAL int cb_strv_compare(cb_strv sv, const char* data, cb_size size) { return cb_lexicagraphical_cmp(sv.data, sv.size, data, size); }
 CB_INTERNAL int cb_strv_compare_strv(cb_strv sv, cb_strv other) { return cb_strv_compare(sv, other.data, other.size); }
 CB_INTERNAL int cb_strv_compare_str(cb_strv sv, const char* str) { return cb_strv_compare(sv, str, strlen(str)); }
-CB_INTERNAL cb_bool cb_strv_equals(cb_strv sv, const char* data, cb_size size) { return cb_strv_compare(sv, data, size) == 0; }
-CB_INTERNAL cb_bool cb_strv_equals_strv(cb_strv sv, cb_strv other) { return cb_strv_compare_strv(sv, other) == 0; }
+/* Interned strings are equal when they share the same pointer. */
+CB_INTERNAL cb_bool cb_strv_equals(cb_strv sv, const char* data, cb_size size) { return sv.size == size && (sv.data == data || memcmp(sv.data, data, size) == 0); }
+CB_INTERNAL cb_bool cb_strv_equals_strv(cb_strv sv, cb_strv other) { return cb_strv_equals(sv, other.data, other.size); }
 CB_INTERNAL cb_bool cb_strv_equals_str(cb_strv sv, const char* other) { return cb_strv_compare_strv(sv, cb_strv_make_str(other)) == 0; }
 
 CB_INTERNAL cb_bool
@@ -980,6 +1438,17 @@ cb_bool cb_strv_contains_strv(cb_strv left, cb_strv right)
 
 CB_INTERNAL cb_bool cb_str_equals(const char* left, const char* right) { return cb_strv_equals_strv(cb_strv_make_str(left), cb_strv_make_str(right)); }
 
+/* Copy string using CB_MALLOC. Must be released with CB_FREE. */
+CB_INTERNAL char*
+cb_str_dup(const char* str)
+{
+	cb_size size = strlen(str);
+	char* data = (char*)CB_MALLOC(size + 1);
+	CB_ASSERT(data);
+	memcpy(data, str, size + 1);
+	return data;
+}
+
 /*-----------------------------------------------------------------------*/
 /* cb_dstr - dynamic string */
 /*-----------------------------------------------------------------------*/
@@ -1119,6 +1588,129 @@ cb_hash_strv(cb_strv sv)
 	return djb2_strv(sv.data, sv.size);
 }
 
+/*-----------------------------------------------------------------------*/
+/* cb_intern - interned strings */
+/*-----------------------------------------------------------------------*/
+
+/* Strings are stored once in the tmp buffer so equal strings share the same pointer. */
+
+typedef struct cb_intern_slot {
+	cb_id hash;
+	cb_strv sv; /* 'data' is NULL for an empty slot */
+} cb_intern_slot;
+
+static CB_THREAD cb_intern_slot* cb_intern_slots = NULL;
+static CB_THREAD cb_size cb_intern_slot_capacity = 0; /* power of two */
+static CB_THREAD cb_size cb_intern_count = 0;
+
+CB_INTERNAL void
+cb_intern_clear(void)
+{
+	if (cb_intern_slots)
+	{
+		CB_FREE(cb_intern_slots);
+	}
+	cb_intern_slots = NULL;
+	cb_intern_slot_capacity = 0;
+	cb_intern_count = 0;
+	cb_intern_tmp_end = 0;
+}
+
+/* Returns the slot of the string, or the empty slot where it can be added. */
+CB_INTERNAL cb_intern_slot*
+cb_intern_find(cb_strv sv, cb_id hash)
+{
+	cb_size mask = cb_intern_slot_capacity - 1;
+	cb_size i = hash & mask;
+	cb_intern_slot* slot = NULL;
+
+	while ((slot = &cb_intern_slots[i])->sv.data != NULL)
+	{
+		if (slot->hash == hash && cb_strv_equals_strv(slot->sv, sv))
+		{
+			break;
+		}
+		i = (i + 1) & mask;
+	}
+	return slot;
+}
+
+CB_INTERNAL void
+cb_intern_grow(void)
+{
+	cb_intern_slot* old_slots = cb_intern_slots;
+	cb_size old_capacity = cb_intern_slot_capacity;
+	cb_size i = 0;
+
+	cb_intern_slot_capacity = old_capacity ? old_capacity * 2 : 256;
+	cb_intern_slots = (cb_intern_slot*)CB_MALLOC(cb_intern_slot_capacity * sizeof(cb_intern_slot));
+	CB_ASSERT(cb_intern_slots);
+	memset(cb_intern_slots, 0, cb_intern_slot_capacity * sizeof(cb_intern_slot));
+
+	for (i = 0; i < old_capacity; ++i)
+	{
+		if (old_slots[i].sv.data)
+		{
+			*cb_intern_find(old_slots[i].sv, old_slots[i].hash) = old_slots[i];
+		}
+	}
+
+	if (old_slots)
+	{
+		CB_FREE(old_slots);
+	}
+}
+
+/* Returns the interned string equal to 'sv'.
+ * If the string is not interned yet, 'sv' is copied in the tmp buffer when 'copy' is true,
+ * otherwise 'sv' itself is interned and must already be in the tmp buffer.
+ */
+CB_INTERNAL cb_strv
+cb_intern_get(cb_strv sv, cb_bool copy)
+{
+	cb_id hash = cb_hash_strv(sv);
+	cb_intern_slot* slot = NULL;
+	char* data = NULL;
+
+	/* Keep the load factor under 50%. */
+	if ((cb_intern_count + 1) * 2 > cb_intern_slot_capacity)
+	{
+		cb_intern_grow();
+	}
+
+	slot = cb_intern_find(sv, hash);
+	if (slot->sv.data)
+	{
+		return slot->sv;
+	}
+
+	if (copy)
+	{
+		data = (char*)cb_tmp_alloc(sv.size + 1);
+		memcpy(data, sv.data, sv.size);
+		data[sv.size] = '\0';
+		sv.data = data;
+	}
+
+	CB_ASSERT(cb_tmp_contains(sv.data));
+
+	slot->hash = hash;
+	slot->sv = sv;
+	cb_intern_count += 1;
+	if (cb_intern_tmp_end < cb_tmp_save())
+	{
+		cb_intern_tmp_end = cb_tmp_save();
+	}
+	return sv;
+}
+
+/* Interned copy of the string, the string is only copied the first time. */
+CB_INTERNAL cb_strv
+cb_tmp_intern_str(const char* str)
+{
+	return cb_intern_get(cb_strv_make_str(str), cb_true);
+}
+
 /*-----------------------------------------------------------------------*/
 /* cb_kv */
 /*-----------------------------------------------------------------------*/
@@ -1173,92 +1765,238 @@ cb_kv_less(const cb_kv* left, const cb_kv* right)
 /* cb_mmap - a multimap */
 /*-----------------------------------------------------------------------*/
 
-CB_INTERNAL void cb_mmap_init(cb_mmap* m) { cb_darrT_init(m); }
-CB_INTERNAL void cb_mmap_destroy(cb_mmap* m) { cb_darrT_destroy(m); }
-
-CB_INTERNAL cb_size
-cb_mmap_lower_bound_predicate(const cb_mmap* m, const cb_kv* value)
+CB_INTERNAL void
+cb_mmap_init(cb_mmap* m)
 {
-	return cb_lower_bound_predicate(m->base.data, 0, m->base.size, value, sizeof(cb_kv), (cb_predicate_t)cb_kv_less);
+	memset(m, 0, sizeof(cb_mmap));
+	cb_darrT_init(&m->entries);
 }
 
 CB_INTERNAL void
-cb_mmap_insert(cb_mmap* m, cb_kv kv)
+cb_mmap_destroy(cb_mmap* m)
 {
-	cb_size index = cb_mmap_lower_bound_predicate(m, &kv);
+	cb_size i = 0;
+
+	for (; i < cb_darrT_size(&m->entries); ++i)
+	{
+		cb_darrT_destroy(&cb_darrT_ptr(&m->entries, i)->values);
+	}
+	cb_darrT_destroy(&m->entries);
+	cb_darrT_destroy(&m->pending);
+
+	if (m->slots)
+	{
+		CB_FREE(m->slots);
+	}
 
-	cb_darrT_insert(m, index, kv);
+	cb_mmap_init(m);
 }
 
+/* Number of values of all keys. */
 CB_INTERNAL cb_size
-cb_mmap_find(const cb_mmap* m, const cb_kv* kv)
+cb_mmap_size(const cb_mmap* m)
 {
-	cb_size index = cb_mmap_lower_bound_predicate(m, kv);
+	return m->count;
+}
+
+/* Returns the index of the entry or the number of entries if the key is not found.
+ * 'slot_index' receives the slot of the key, or the empty slot where the key can be added.
+ */
+CB_INTERNAL cb_size
+cb_mmap_find_entry(const cb_mmap* m, cb_id hash, cb_strv key, cb_size* slot_index)
+{
+	cb_size mask = m->slot_capacity - 1;
+	cb_size i = 0;
+	cb_size slot = 0;
+	const cb_mmap_entry* entry = NULL;
+
+	if (m->slot_capacity == 0)
+	{
+		return cb_darrT_size(&m->entries);
+	}
 
-	if (index == m->base.size || cb_kv_less(kv, cb_darrT_ptr(m, index)))
+	i = hash & mask;
+	while ((slot = m->slots[i]) != 0)
 	{
-		index = m->base.size; /* not found */
+		entry = cb_darrT_ptr(&m->entries, slot - 1);
+		if (entry->hash == hash && cb_strv_equals_strv(entry->key, key))
+		{
+			*slot_index = i;
+			return slot - 1;
+		}
+		i = (i + 1) & mask;
 	}
 
-	return index;
+	*slot_index = i;
+	return cb_darrT_size(&m->entries);
 }
 
-CB_INTERNAL cb_bool
-cb_mmap_try_get_first(const cb_mmap* m, cb_strv key, cb_kv* kv)
+CB_INTERNAL void
+cb_mmap_grow_slots(cb_mmap* m)
 {
-	cb_kv key_item = cb_kv_make_with_str(key, "");
-	cb_size index = cb_mmap_find(m, &key_item);
+	cb_size new_capacity = m->slot_capacity ? m->slot_capacity * 2 : 16;
+	cb_size i = 0;
+	cb_size slot_index = 0;
+	const cb_mmap_entry* entry = NULL;
 
-	if (index != m->darr.size) /* found */
+	if (m->slots)
 	{
-		*kv = cb_darrT_at(m, index);
-		return cb_true;
+		CB_FREE(m->slots);
 	}
 
-	return cb_false;
+	m->slots = (cb_size*)CB_MALLOC(new_capacity * sizeof(cb_size));
+	CB_ASSERT(m->slots);
+	memset(m->slots, 0, new_capacity * sizeof(cb_size));
+	m->slot_capacity = new_capacity;
+
+	for (i = 0; i < cb_darrT_size(&m->entries); ++i)
+	{
+		entry = cb_darrT_ptr(&m->entries, i);
+		cb_mmap_find_entry(m, entry->hash, entry->key, &slot_index);
+		m->slots[slot_index] = i + 1;
+	}
 }
 
-CB_INTERNAL cb_kv_range
-cb_mmap_get_range_all(const cb_mmap* m)
+CB_INTERNAL cb_mmap_entry*
+cb_mmap_get_entry(const cb_mmap* m, cb_strv key)
 {
-	cb_kv_range range;
-	range.begin = m->darr.data;
-	range.end = m->darr.data + m->darr.size;
-	range.count = m->darr.size;
-	return range;
+	cb_size slot_index = 0;
+	cb_size index = 0;
+
+	CB_ASSERT(cb_darrT_size(&m->pending) == 0 && "Properties can't be read or removed within a batch.");
+
+	index = cb_mmap_find_entry(m, cb_hash_strv(key), key, &slot_index);
+	return index != cb_darrT_size(&m->entries)
+		? cb_darrT_ptr(&m->entries, index)
+		: NULL;
 }
 
-CB_INTERNAL cb_kv_range
-cb_mmap_get_range(const cb_mmap* m, cb_strv key)
+/* Store values which all have the same key. */
+CB_INTERNAL void
+cb_mmap_push_values(cb_mmap* m, const cb_kv* values, cb_size count)
 {
-	cb_size starting_index;
-	cb_kv_range result = { 0, 0, 0 };
-
-	cb_kv key_item = cb_kv_make_with_str(key, "");
+	cb_size slot_index = 0;
+	cb_size index = 0;
+	cb_mmap_entry entry;
 
-	cb_size index = cb_mmap_find(m, &key_item);
+	CB_ASSERT(count > 0);
 
-	/* No item found */
-	if (index == m->darr.size)
+	/* Keep the load factor under 50%. */
+	if ((cb_darrT_size(&m->entries) + 1) * 2 > m->slot_capacity)
 	{
-		return result;
+		cb_mmap_grow_slots(m);
 	}
-	
-	starting_index = index;
 
-	/* An item has been found */
+	index = cb_mmap_find_entry(m, values[0].hash, values[0].key, &slot_index);
+	if (index == cb_darrT_size(&m->entries))
+	{
+		memset(&entry, 0, sizeof(cb_mmap_entry));
+		entry.hash = values[0].hash;
+		entry.key = values[0].key;
+		cb_darrT_init(&entry.values);
+		cb_darrT_push_back(&m->entries, entry);
+		m->slots[slot_index] = index + 1;
+	}
 
-	result.begin = cb_darrT_ptr(m, index);
+	cb_darr_push_back_many(&cb_darrT_ptr(&m->entries, index)->values.base, values, count, sizeof(cb_kv));
+	m->count += count;
+}
 
-	/* Check for other items */
-	do
+CB_INTERNAL void
+cb_mmap_insert(cb_mmap* m, cb_kv kv)
+{
+	if (m->batch_depth > 0)
+	{
+		cb_darrT_push_back(&m->pending, kv);
+		return;
+	}
+
+	cb_mmap_push_values(m, &kv, 1);
+}
+
+CB_INTERNAL void
+cb_mmap_batch_begin(cb_mmap* m)
+{
+	m->batch_depth += 1;
+}
+
+/* Store the pending values, consecutive values of the same key are stored at once. */
+CB_INTERNAL void
+cb_mmap_batch_end(cb_mmap* m)
+{
+	cb_size first = 0;
+	cb_size last = 0;
+	cb_size size = cb_darrT_size(&m->pending);
+	const cb_kv* values = m->pending.darr.data;
+
+	CB_ASSERT(m->batch_depth > 0);
+	m->batch_depth -= 1;
+	if (m->batch_depth > 0)
+	{
+		return;
+	}
+
+	while (first < size)
+	{
+		last = first + 1;
+		while (last < size
+			&& values[last].hash == values[first].hash
+			&& cb_strv_equals_strv(values[last].key, values[first].key))
+		{
+			last += 1;
+		}
+
+		cb_mmap_push_values(m, values + first, last - first);
+		first = last;
+	}
+
+	/* Keep the capacity for the next batch. */
+	m->pending.darr.size = 0;
+}
+
+/* Get the most recently added value of the key. */
+CB_INTERNAL cb_bool
+cb_mmap_try_get_first(const cb_mmap* m, cb_strv key, cb_kv* kv)
+{
+	cb_mmap_entry* entry = cb_mmap_get_entry(m, key);
+
+	if (entry && cb_darrT_size(&entry->values) > 0) /* found */
+	{
+		*kv = cb_darrT_at(&entry->values, cb_darrT_size(&entry->values) - 1);
+		return cb_true;
+	}
+
+	return cb_false;
+}
+
+CB_INTERNAL cb_kv_range
+cb_mmap_get_range_all(const cb_mmap* m)
+{
+	cb_kv_range range = { 0 };
+
+	CB_ASSERT(cb_darrT_size(&m->pending) == 0 && "Properties can't be read or removed within a batch.");
+
+	range.count = m->count;
+	range.map = m;
+	return range;
+}
+
+CB_INTERNAL cb_kv_range
+cb_mmap_get_range(const cb_mmap* m, cb_strv key)
+{
+	cb_kv_range result = { 0 };
+
+	cb_mmap_entry* entry = cb_mmap_get_entry(m, key);
+
+	/* No item found */
+	if (!entry)
 	{
-		index += 1;
-	} while (index < m->base.size
-		&& cb_kv_comp(cb_darrT_ptr(m, index), &key_item) == 0);
+		return result;
+	}
 
-	result.end = cb_darrT_ptr(m, index);
-	result.count = index - starting_index;
+	result.begin = entry->values.darr.data;
+	result.end = result.begin + cb_darrT_size(&entry->values);
+	result.count = cb_darrT_size(&entry->values);
 	return result;
 }
 
@@ -1268,18 +2006,31 @@ cb_mmap_get_range_str(const cb_mmap* m, const char* key)
 	return cb_mmap_get_range(m, cb_strv_make_str(key));
 }
 
+/* Values of a key are returned from the most recently added one. */
 CB_INTERNAL cb_bool
 cb_mmap_range_get_next(cb_kv_range* range, cb_kv* next)
 {
+	cb_mmap_entry* entry = NULL;
+
 	memset(next, 0, sizeof(cb_kv));
 
 	CB_ASSERT(range->begin <= range->end);
 
-	if (range->begin < range->end)
+	/* Move to the next key with values when iterating the whole map. */
+	while (range->begin == range->end
+		&& range->map
+		&& range->next_entry < cb_darrT_size(&range->map->entries))
 	{
-		*next = *range->begin;
+		entry = cb_darrT_ptr(&range->map->entries, range->next_entry);
+		range->begin = entry->values.darr.data;
+		range->end = range->begin + cb_darrT_size(&entry->values);
+		range->next_entry += 1;
+	}
 
-		range->begin += 1;
+	if (range->begin < range->end)
+	{
+		range->end -= 1;
+		*next = *range->end;
 		return cb_true;
 	}
 
@@ -1290,33 +2041,55 @@ cb_mmap_range_get_next(cb_kv_range* range, cb_kv* next)
 CB_INTERNAL cb_size
 cb_mmap_remove(cb_mmap* m, cb_kv kv)
 {
-	cb_kv_range range = cb_mmap_get_range(m, kv.key);
+	cb_mmap_entry* entry = NULL;
+	cb_size count_to_remove = 0;
 
-	cb_size count_to_remove = range.count;
+	CB_ASSERT(m->batch_depth == 0 && "Properties can't be removed within a batch.");
 
-	while (range.begin < range.end)
+	entry = cb_mmap_get_entry(m, kv.key);
+	if (!entry)
 	{
-		range.end -= 1;
-		/* Remove item from the tail. */
-		cb_darrT_remove(m, range.end - m->darr.data);
+		return 0;
 	}
-	
+
+	/* Keep the entry and the capacity of its values, the key is likely to be set again. */
+	count_to_remove = cb_darrT_size(&entry->values);
+	entry->values.darr.size = 0;
+	m->count -= count_to_remove;
+
 	return count_to_remove;
 }
 
+/* Remove the most recently added value of the key equal to the (strv) value of 'kv'. */
 CB_INTERNAL cb_bool
-cb_mmap_get_from_kv(cb_mmap* map, const cb_kv* item, cb_kv* result)
+cb_mmap_remove_one_strv(cb_mmap* m, cb_kv kv)
 {
-	cb_size index = cb_mmap_find(map, item);
-	if (index != map->base.size)
+	cb_mmap_entry* entry = NULL;
+	cb_size index = 0;
+
+	CB_ASSERT(m->batch_depth == 0 && "Properties can't be removed within a batch.");
+
+	entry = cb_mmap_get_entry(m, kv.key);
+	index = entry ? cb_darrT_size(&entry->values) : 0;
+	while (index > 0)
 	{
-		*result = cb_darrT_at(map, index);
-		return cb_true;
+		index -= 1;
+		if (cb_strv_equals_strv(cb_darrT_ptr(&entry->values, index)->u.strv, kv.u.strv))
+		{
+			cb_darrT_remove(&entry->values, index);
+			m->count -= 1;
+			return cb_true;
+		}
 	}
-
 	return cb_false;
 }
 
+CB_INTERNAL cb_bool
+cb_mmap_get_from_kv(cb_mmap* map, const cb_kv* item, cb_kv* result)
+{
+	return cb_mmap_try_get_first(map, item->key, result);
+}
+
 CB_INTERNAL void
 cb_mmap_insert_ptr(cb_mmap* map, cb_strv key, const void* value_ptr)
 {
@@ -1355,12 +2128,29 @@ cb_context_init(cb_context* ctx)
 	memset(ctx, 0, sizeof(cb_context));
 	cb_mmap_init(&ctx->projects);
 	ctx->current_project = NULL;
+	ctx->jobs = -1;
+	ctx->free_jobs = -1;
+	cb_mmap_init(&ctx->absolute_files);
+	cb_mmap_init(&ctx->absolute_directories);
+	cb_arena_init(&ctx->path_arena);
+}
+
+CB_INTERNAL void
+cb_context_clear_path_cache(cb_context* ctx)
+{
+	ctx->current_directory.data = NULL;
+	ctx->current_directory.size = 0;
+	cb_mmap_destroy(&ctx->absolute_files);
+	cb_mmap_destroy(&ctx->absolute_directories);
+	cb_arena_destroy(&ctx->path_arena);
 }
 
 CB_INTERNAL void
 cb_context_destroy(cb_context* ctx)
 {
 	cb_mmap_destroy(&ctx->projects);
+	cb_darrT_destroy(&ctx->trace_lanes);
+	cb_context_clear_path_cache(ctx);
 
     cb_context_init(ctx);
 }
@@ -1370,19 +2160,19 @@ CB_INTERNAL void cb_project_destroy(cb_project_t* project);
 CB_INTERNAL void
 cb_context_clear(cb_context* ctx)
 {
-	cb_size i = 0;
-	cb_size size = cb_darrT_size(&ctx->projects);
+	cb_kv_range range = cb_mmap_get_range_all(&ctx->projects);
 	cb_kv kv = { 0 };
 	cb_project_t* p = NULL;
 
-	for (; i < size; ++i)
+	while (cb_mmap_range_get_next(&range, &kv))
 	{
-		kv = cb_darrT_at(&ctx->projects, i);
 		p = (cb_project_t*)kv.u.ptr;
 		cb_project_destroy(p);
 	}
 	
-	ctx->projects.darr.size = 0;
+	CB_ASSERT(ctx->batch_depth == 0 && "Projects can't be cleared within a batch.");
+
+	cb_mmap_destroy(&ctx->projects);
 
 	ctx->current_project = NULL;
 }
@@ -1413,2403 +2203,4986 @@ cb_current_project_name(void)
 }
 
 /*-----------------------------------------------------------------------*/
-/* plugins */
+/* trace */
 /*-----------------------------------------------------------------------*/
 
-CB_API void 
-cb_init_with_plugins(cb_plugin* plugins[], int plugin_count)
-{
-    cb_context* ctx = NULL;
-    int i = 0;
-    
-    CB_ASSERT(plugin_count > 0);
-    CB_ASSERT(plugin_count <= CB_MAX_PLUGIN);
-     
-    cb_init();
+#ifdef _WIN32
+/* Defined with the other Windows helpers, used to open the trace file. */
+CB_INTERNAL wchar_t* cb_utf8_to_utf16(const char* str);
+#endif
 
-    ctx = cb_current_context();
-    
-    for(i = 0; i < plugin_count; i += 1)
-    {
-        ctx->plugins[i] = plugins[i];
-    }
-    
-    ctx->plugin_count = plugin_count;
+/* Monotonic time in microseconds. */
+CB_INTERNAL cb_u64
+cb_time_now(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (cb_u64)(counter.QuadPart / frequency.QuadPart) * 1000000
+		+ (cb_u64)((counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart);
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (cb_u64)now.tv_sec * 1000000 + (cb_u64)now.tv_nsec / 1000;
+#endif
 }
 
-CB_INTERNAL void
-cb_plugins_bake_starting()
+CB_INTERNAL unsigned long
+cb_current_process_id(void)
 {
-    int i;
-    cb_context* ctx = cb_current_context();
-    
-    for(i = 0; i < ctx->plugin_count; i += 1)
-    {
-        cb_plugin* plugin = ctx->plugins[i];
-        
-        CB_ASSERT(plugin);
-        if (!plugin->disabled
-            && plugin->bake_starting)
-        {
-            plugin->bake_starting(plugin);
-        }
-    }
+#ifdef _WIN32
+	return (unsigned long)GetCurrentProcessId();
+#else
+	return (unsigned long)getpid();
+#endif
 }
 
+/* Write a string with the JSON escape sequences. */
 CB_INTERNAL void
-cb_plugins_extra_argument(cb_dstr* cmd)
+cb_write_json_string(FILE* file, const char* str)
 {
-    cb_context* ctx = NULL;
-    int i = 0;
-    
-    ctx = cb_current_context();
-     
-    for(i = 0; i < ctx->plugin_count; i += 1)
-    {
-        cb_plugin* plugin = ctx->plugins[i];
-        
-        CB_ASSERT(plugin);
-        if (!plugin->disabled
-            && plugin->extra_argument)
-        {
-            const char* arg = plugin->extra_argument(plugin);
-            cb_dstr_append_f(cmd, "%s ", arg);
-        }
-    }
+	const char* cur = NULL;
+
+	fputc('"', file);
+	for (cur = str; *cur; cur += 1)
+	{
+		if (*cur == '"' || *cur == '\\')
+		{
+			fputc('\\', file);
+			fputc(*cur, file);
+		}
+		else if ((unsigned char)*cur < 0x20)
+		{
+			fprintf(file, "\\u%04x", (unsigned int)(unsigned char)*cur);
+		}
+		else
+		{
+			fputc(*cur, file);
+		}
+	}
+	fputc('"', file);
 }
 
+/* Some functions like cb_copy_file can be used before cb_init. */
 CB_INTERNAL cb_bool
-cb_plugins_can_process_file(const char* file)
+cb_trace_enabled(void)
 {
-    int i;
-    cb_context* ctx = cb_current_context();
-    
-    for(i = 0; i < ctx->plugin_count; i += 1)
-    {
-        cb_plugin* plugin = ctx->plugins[i];
-        
-        CB_ASSERT(plugin);
-        
-        if (!plugin->disabled
-            && plugin->can_process_file
-            && !plugin->can_process_file(plugin, file))
-        {
-            return cb_false;
-        }
-    }
-   
-   return cb_true;
+	return current_ctx != NULL && current_ctx->trace_file != NULL;
 }
 
-CB_INTERNAL void
-cb_plugins_file_processed(const char* file, const char* std_out, const char* std_err)
+CB_INTERNAL int
+cb_phase_from_category(const char* category)
 {
-    int i;
-    cb_context* ctx = cb_current_context();
-     
-    for(i = 0; i < ctx->plugin_count; i += 1)
-    {
-        cb_plugin* plugin = ctx->plugins[i];
-       
-        CB_ASSERT(plugin);
-        if (!plugin->disabled
-            && plugin->file_processed)
-        {
-            plugin->file_processed(plugin, file, std_out, std_err);
-        }
-    }
-}
+	static const char* categories[] = { "bake", "properties", "check", "compile", "link", "archive", "copy", "plugin" };
+	static const int phases[] = { cb_phase_BAKE, cb_phase_PROPERTIES, cb_phase_CHECK, cb_phase_COMPILE, cb_phase_LINK, cb_phase_LINK, cb_phase_COPY, cb_phase_PLUGIN };
+	int i = 0;
 
-/*-----------------------------------------------------------------------*/
-/* misc. */
-/*-----------------------------------------------------------------------*/
+	for (i = 0; category && i < (int)(sizeof(categories) / sizeof(categories[0])); i += 1)
+	{
+		if (strcmp(category, categories[i]) == 0)
+		{
+			return phases[i];
+		}
+	}
+	return cb_phase_NONE;
+}
 
-CB_INTERNAL cb_bool
-cb_try_find_project_by_name(cb_strv sv, cb_project_t** project)
+CB_INTERNAL cb_u64*
+cb_stats_phase_time(cb_stats* stats, int phase)
 {
-	void* default_value = NULL;
-	*project = (cb_project_t*)cb_mmap_get_ptr(&cb_current_context()->projects, sv, default_value);
-	return (cb_bool)(*project != NULL);
+	switch (phase)
+	{
+	case cb_phase_BAKE: return &stats->bake_time;
+	case cb_phase_PROPERTIES: return &stats->properties_time;
+	case cb_phase_CHECK: return &stats->check_time;
+	case cb_phase_COMPILE: return &stats->compile_time;
+	case cb_phase_LINK: return &stats->link_time;
+	case cb_phase_COPY: return &stats->copy_time;
+	case cb_phase_PLUGIN: return &stats->plugin_time;
+	default: return NULL;
+	}
 }
 
-CB_INTERNAL cb_project_t*
-cb_find_project_by_name(cb_strv sv)
+CB_INTERNAL void
+cb_stats_phase_begin(cb_context* ctx, int phase, cb_u64 now)
 {
-	cb_project_t* project = 0;
-	if (!cb_try_find_project_by_name(sv, &project))
+	if (phase == cb_phase_NONE)
 	{
-		cb_log_error("Project not found '%.*s'", sv.size, sv.data);
-		return NULL;
+		return;
 	}
 
-	return project;
+	if (ctx->phase_running[phase] == 0)
+	{
+		ctx->phase_since[phase] = now;
+	}
+	ctx->phase_running[phase] += 1;
 }
 
-CB_INTERNAL cb_project_t* cb_find_project_by_name_str(const char* name) { return cb_find_project_by_name(cb_strv_make_str(name)); }
-CB_INTERNAL cb_bool cb_try_find_project_by_name_str(const char* name, cb_project_t** project) { return cb_try_find_project_by_name(cb_strv_make_str(name), project); }
-
 CB_INTERNAL void
-cb_project_init(cb_project_t* project, cb_strv name)
+cb_stats_phase_end(cb_context* ctx, int phase, cb_u64 now)
 {
-	memset(project, 0, sizeof(cb_project_t));
+	if (phase == cb_phase_NONE)
+	{
+		return;
+	}
 
-	cb_mmap_init(&project->mmap);
-	project->name = name;
+	ctx->phase_running[phase] -= 1;
+	if (ctx->phase_running[phase] == 0)
+	{
+		*cb_stats_phase_time(&ctx->stats, phase) += now - ctx->phase_since[phase];
+	}
 }
 
+/* Copy 'prefix' followed by 'suffix' (optional) into the name of the event. */
 CB_INTERNAL void
-cb_project_destroy(cb_project_t* project)
+cb_trace_event_set_name(cb_trace_event* event, const char* prefix, const char* suffix)
 {
-	CB_ASSERT(project);
-	cb_mmap_destroy(&project->mmap);
+	cb_size size = 0;
+	const char* parts[2];
+	int i = 0;
+
+	parts[0] = prefix;
+	parts[1] = suffix;
+
+	for (i = 0; i < 2; i += 1)
+	{
+		while (parts[i] && *parts[i] && size < sizeof(event->name) - 1)
+		{
+			event->name[size] = *parts[i];
+			parts[i] += 1;
+			size += 1;
+		}
+	}
+	event->name[size] = '\0';
 }
 
-CB_INTERNAL cb_project_t*
-cb_create_project(const char* name)
+/* Start an event whose category, project, file and name (if tracing is enabled) have already been set.
+   The event is measured in the statistics even if tracing is disabled. */
+CB_INTERNAL void
+cb_trace_event_start(cb_trace_event* event, int lane)
 {
-	cb_strv name_sv = cb_strv_make_str(name);
+	cb_context* ctx = current_ctx;
 
-	cb_project_t* project = (cb_project_t*)CB_MALLOC(sizeof(cb_project_t));
-	CB_ASSERT(project);
-	if (!project) { return NULL; }
+	/* Some functions like cb_copy_file can be used before cb_init. */
+	if (!ctx)
+	{
+		return;
+	}
 
-	cb_project_init(project, cb_tmp_str_to_strv(name));
+	if (!event->project_name && ctx->current_project)
+	{
+		event->project_name = ctx->current_project->name.data;
+	}
+	event->lane = lane;
+	event->phase = cb_phase_from_category(event->category);
+	event->started = cb_true;
+	event->recording = ctx->trace_file != NULL;
+	event->begin = cb_time_now();
 
-	cb_mmap_insert_ptr(&cb_current_context()->projects, name_sv, project);
-	
-    return project;
+	cb_stats_phase_begin(ctx, event->phase, event->begin);
 }
 
-/* API */
-
-#ifdef _WIN32
-/* Any error would silently crash any application, this handler is just there to display a message and exit the application with a specific value */
-__declspec(noinline) static LONG WINAPI exit_on_exception_handler(EXCEPTION_POINTERS* ex_ptr)
+/* Begin a step run by cb itself. 'file' is optional and must outlive the event. */
+CB_INTERNAL void
+cb_trace_event_begin(cb_trace_event* event, const char* category, const char* name, const char* file)
 {
-	(void)ex_ptr;
-	int exit_code=1;
-	printf("[CB] Error: unexpected error. exited with code %d\n", exit_code);
-	exit(exit_code);
-}
-
-/* Convert utf-8 string to utf-16 string. String is allocated using the temp buffer */
-CB_INTERNAL wchar_t*
-cb_utf8_to_utf16(const char* str)
-{
-	/* Calculate len */
-	int length = MultiByteToWideChar(CP_UTF8, 0, str, -1, NULL, 0);
-	/* Allocate enough space */
-	wchar_t* data = (wchar_t*)cb_tmp_alloc(length * sizeof(wchar_t));
-	/* Write data */
-	MultiByteToWideChar(CP_UTF8, 0, str, -1, data, length);
-	/* Place null-terminated char to end the string */
-	data[length] = L'\0';
-	return data;
-}
-
-#endif
-
-/* #file utils */
-
-CB_INTERNAL cb_bool cb_is_directory_separator(char c) { return (c == '/' || c == '\\'); }
-
-#define CB_NPOS ((cb_size)-1)
-
-CB_INTERNAL cb_size
-cb_rfind(cb_strv s, char c)
-{
-	const char* begin = NULL;
-	const char* end = NULL;
-	if (s.size == 0) return CB_NPOS;
+	memset(event, 0, sizeof(cb_trace_event));
 
-	begin = s.data;
-	end = s.data + s.size - 1;
-	while (end >= begin && *end != c)
+	event->category = category;
+	event->file = file;
+	if (cb_trace_enabled())
 	{
-		end--;
+		cb_trace_event_set_name(event, name, NULL);
 	}
-	return end < begin ? CB_NPOS : (cb_size)(end - begin);
+	cb_trace_event_start(event, 0);
 }
 
-CB_INTERNAL cb_size
-cb_rfind2(cb_strv s, char c1, char c2)
+/* Same as cb_trace_event_begin for a plugin callback, named after the plugin and the callback. */
+CB_INTERNAL void
+cb_trace_plugin_begin(cb_trace_event* event, const cb_plugin* plugin, const char* callback, const char* file)
 {
-	const char* begin = NULL;
-	const char* end = NULL;
-	if (s.size == 0) return CB_NPOS;
-
-	begin = s.data;
-	end = s.data + s.size - 1;
-	while (end >= begin && *end != c1 && *end != c2)
+	cb_trace_event_begin(event, "plugin", plugin->name, file);
+	if (event->recording)
 	{
-		end--;
-	}
-	return end < begin ? CB_NPOS : (cb_size)(end - begin);
-}
-
-CB_INTERNAL cb_strv
-cb_path_filename(cb_strv path)
-{
-	cb_size pos = cb_rfind2(path, '/', '\\');
-	if (pos != CB_NPOS && pos > 0)
-    {
-		return cb_strv_make(path.data + pos + 1 /* plus one because we don't want the slash char */
-			, path.size - pos);
+		cb_trace_event_set_name(event, plugin->name, callback);
 	}
-	return path;
-}
-
-CB_INTERNAL cb_strv
-cb_path_filename_str(const char* str)
-{
-	return cb_path_filename(cb_strv_make_str(str));
 }
 
-CB_INTERNAL cb_strv
-cb_path_basename(cb_strv s)
+/* Processes running at the same time use different lanes. */
+CB_INTERNAL int
+cb_trace_acquire_lane(void)
 {
-	cb_strv filename = cb_path_filename(s);
+	cb_context* ctx = cb_current_context();
+	cb_size i = 0;
 
-	if (!cb_strv_equals_str(filename, ".")
-		&& !cb_strv_equals_str(filename, ".."))
-    {
-		cb_size pos = cb_rfind(filename, '.');
-		if (pos != CB_NPOS && pos > 0)
-        {
-			return cb_strv_make(filename.data, pos);
+	for (i = 0; i < cb_darrT_size(&ctx->trace_lanes); i += 1)
+	{
+		if (!cb_darrT_at(&ctx->trace_lanes, i))
+		{
+			cb_darrT_set(&ctx->trace_lanes, i, cb_true);
+			return (int)i + 1;
 		}
 	}
-	return filename;
-}
 
-CB_INTERNAL cb_strv
-cb_path_basename_str(const char* str)
-{
-	return cb_path_basename(cb_strv_make_str(str));
+	cb_darrT_push_back(&ctx->trace_lanes, cb_true);
+	return (int)cb_darrT_size(&ctx->trace_lanes);
 }
 
-CB_INTERNAL cb_strv
-cb_path_change_extension(cb_strv s, cb_strv ext)
+/* Write the event if it has been recorded. */
+CB_INTERNAL void
+cb_trace_event_end(cb_trace_event* event)
 {
-    cb_strv basename = cb_path_basename(s);
-    
-    size_t len = (basename.data - s.data) + basename.size;
-    cb_strv path_without_extension = cb_strv_make(s.data, len);
-    return cb_tmp_strv_printf(CB_STRV_FMT CB_STRV_FMT,
-        CB_STRV_ARG(path_without_extension), CB_STRV_ARG(ext));
-}
-
-
-/*  #file_iterator */
-
-#define CB_MAX_PATH 1024 /* this is an arbitrary limit */
+	cb_context* ctx = NULL;
+	FILE* file = NULL;
+	cb_u64 end = 0;
 
-#define cb_str_append_from(dst, src, index, max) cb_str_append_from_core(dst, src, index, max, __FILE__, __LINE__)
+	if (!event->started)
+	{
+		return;
+	}
+	event->started = cb_false;
+	ctx = cb_current_context();
+	file = ctx->trace_file;
+	end = cb_time_now();
 
-/* Returns the number of character writter. Null-terminating char is not counted. */
-CB_INTERNAL cb_size
-cb_str_append_from_core(char* dst, const char* src, cb_size index, cb_size max, const char* file, int line_number)
-{
-	const char* begin = src;
-	cb_size i = index;
+	cb_stats_phase_end(ctx, event->phase, end);
 
-	do
+	if (event->lane > 0 && (cb_size)event->lane <= cb_darrT_size(&ctx->trace_lanes))
 	{
-		if (i >= (max - 1))
-		{
-			cb_log_error("Could not copy. String \"%s\" is too long. (file: '%s' line: '%d' max buffer length of '%d').", begin, line_number, file, max);
-			CB_ASSERT(0);
-			break;
-		}
-		dst[i++] = *src++;
-	} while (*src != '\0');
-
-	dst[i] = '\0';
+		cb_darrT_set(&ctx->trace_lanes, event->lane - 1, cb_false);
+	}
 
-	return i - index;
-}
+	/* Tracing disabled when the event began, or stopped while the event was running. */
+	if (!event->recording || !file || event->begin < ctx->trace_start)
+	{
+		return;
+	}
 
-/* return 1 if separator has been added 0 otherwise */
-CB_INTERNAL cb_size
-cb_ensure_trailing_dir_separator(char* path, cb_size path_len)
-{
-	if (!path || path_len >= CB_MAX_PATH) return cb_false;
+	fputs(",\n{\"name\":", file);
+	cb_write_json_string(file, event->name);
+	fputs(",\"cat\":", file);
+	cb_write_json_string(file, event->category ? event->category : "process");
+	fprintf(file, ",\"ph\":\"X\",\"ts\":" CB_U64_FMT ",\"dur\":" CB_U64_FMT ",\"pid\":%lu,\"tid\":%d,\"args\":{",
+		(cb_u64)(event->begin - ctx->trace_start), (cb_u64)(end - event->begin), cb_current_process_id(), event->lane);
 
-	if (path_len)
+	fputs("\"project\":", file);
+	cb_write_json_string(file, event->project_name ? event->project_name : "");
+	if (event->file)
 	{
-		path += path_len;
-		if (path[-1] != '/' && path[-1] != '\\')
-		{
-			*path++ = CB_PREFERRED_DIR_SEPARATOR_CHAR;
-			*path = '\0';
-			return 1;
-		}
+		fputs(",\"file\":", file);
+		cb_write_json_string(file, event->file);
 	}
-	return 0;
-}
-
-CB_INTERNAL char*
-cb_path_combine(const char* left, const char* right)
-{
-	char* result = (char*)cb_tmp_calloc(CB_MAX_PATH);
-	cb_size n = 0;
-	n += cb_str_append_from(result, left, n, CB_MAX_PATH);
-	n += cb_ensure_trailing_dir_separator(result, strlen(result));
-	n += cb_str_append_from(result, right, n, CB_MAX_PATH);
-	return result;
+	if (event->is_process)
+	{
+		fprintf(file, ",\"pid\":%lu,\"exit_code\":%d", event->process_id, event->exit_code);
+	}
+	fputs("}}", file);
 }
 
-#ifdef WIN32
-
-CB_INTERNAL cb_bool
-cb_path__exists(const wchar_t* path)
+/* Write the name of a row of the trace viewer. */
+CB_INTERNAL void
+cb_trace_write_lane_name(FILE* file, int lane, const char* name)
 {
-	DWORD attr = GetFileAttributesW(path);
-	return attr != INVALID_FILE_ATTRIBUTES;
+	fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%d,\"args\":{\"name\":", cb_current_process_id(), lane);
+	cb_write_json_string(file, name);
+	fputs("}}", file);
 }
 
-CB_INTERNAL cb_bool
-cb_path_exists(const char* path)
+CB_API cb_bool
+cb_trace_begin(const char* path)
 {
-	return cb_path__exists(cb_utf8_to_utf16(path));
-}
+	cb_context* ctx = cb_current_context();
 
-CB_INTERNAL cb_bool
-cb__create_directory(const wchar_t* path)
-{
-	return CreateDirectoryW(path, NULL);
-}
+	cb_trace_end();
 
-CB_INTERNAL cb_bool
-cb_create_directory(const char* path)
-{
-	return cb__create_directory(cb_utf8_to_utf16(path));
-}
+#ifdef _WIN32
+	ctx->trace_file = _wfopen(cb_utf8_to_utf16(path), L"wb");
 #else
-
-CB_INTERNAL cb_bool cb_path_exists(const char* path) { return access(path, F_OK) == 0; }
-CB_INTERNAL cb_bool cb_path__exists(const char* path) { return cb_path_exists(path); }
-
-CB_INTERNAL cb_bool cb_create_directory(const char* path) { return mkdir(path, 0777) == 0; }
-CB_INTERNAL cb_bool cb__create_directory(const char* path) { return cb_create_directory(path); }
-
+	ctx->trace_file = fopen(path, "wb");
 #endif
-
-CB_INTERNAL cb_bool
-cb_path_is_absolute(cb_strv path)
-{
-	cb_size len = path.size;
-
-	if (len == 0) return cb_false;
-
-#ifdef _WIN32
-	/* Check drive C : */
-	cb_size i = 0;
-	if (isalpha(path.data[0]) && path.data[1] == ':')
+	if (!ctx->trace_file)
 	{
-		i = 2;
+		cb_log_error("Could not open trace file '%s'", path);
+		return cb_false;
 	}
 
-	return (path.data[i] == '/' || path.data[i] == '\\');
-#else
+	ctx->trace_start = cb_time_now();
 
-	return (path.data[0] == '/');
-#endif
-}
+	/* The first event does not need a separator, all the others start with one. */
+	fprintf(ctx->trace_file, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":0,\"args\":{\"name\":\"cb\"}}", cb_current_process_id());
+	cb_trace_write_lane_name(ctx->trace_file, 0, "cb");
 
-#ifdef _WIN32
-#define getcwd(buf, size) GetCurrentDirectoryA((DWORD)size, buf)
-#else
-#include <unistd.h> /* getcwd */
-#endif
+	return cb_true;
+}
 
-CB_INTERNAL char*
-cb_path_get_absolute_core(const char* path, cb_bool is_directory)
+CB_API void
+cb_trace_end(void)
 {
-	cb_size n = 0;
-	char* buffer = (char*)cb_tmp_calloc(FILENAME_MAX);
-	char* cursor = NULL;
+	cb_context* ctx = cb_current_context();
+	cb_size i = 0;
+	char name[32];
 
-	if (!cb_path_is_absolute(cb_strv_make_str(path)))
+	if (!ctx->trace_file)
 	{
-		/* skip ./ or .\ */
-		if (path[0] == '.' && (path[1] == '\\' || path[1] == '/'))
-			path += 2;
-
-		getcwd(buffer, FILENAME_MAX);
-		if (buffer == NULL)
-		{
-			cb_log_error("Could not get absolute path from '%s'", path);
-			return NULL;
-		}
-		
-		n = strlen(buffer);
-		n += cb_ensure_trailing_dir_separator(buffer, n);
+		return;
 	}
 
-	n += cb_str_append_from(buffer, path, n, CB_MAX_PATH);
-
-	/* Add trailing slash if it's a directory path */
-	if (is_directory)
+	for (i = 0; i < cb_darrT_size(&ctx->trace_lanes); i += 1)
 	{
-		cb_ensure_trailing_dir_separator(buffer, strlen(buffer));
+		sprintf(name, "processes %d", (int)i + 1);
+		cb_trace_write_lane_name(ctx->trace_file, (int)i + 1, name);
 	}
+	fputs("\n]\n", ctx->trace_file);
 
-	cursor = buffer + 2; /* start at 2 to dealing with volume name. */
-	/* Replace slash with the preferred one. */
-	while (*cursor != '\0')
+	if (fclose(ctx->trace_file) != 0)
 	{
-		if (*cursor == CB_DEFAULT_DIR_SEPARATOR_CHAR)
-		{
-			*cursor = CB_PREFERRED_DIR_SEPARATOR_CHAR;
-		}
-		cursor += 1;
+		cb_log_error("Could not write trace file.");
 	}
+	ctx->trace_file = NULL;
 
-	return buffer;
+	/* Lanes of the processes still running are kept. */
 }
 
-CB_INTERNAL char*
-cb_path_get_absolute_file(const char* path)
+CB_API cb_stats
+cb_stats_get(void)
 {
-	cb_bool is_directory = cb_false;
-	return cb_path_get_absolute_core(path, is_directory);
+	cb_stats stats = cb_current_context()->stats;
+	stats.tmp_peak = cb_tmp_peak_usage();
+	return stats;
 }
 
+CB_API void
+cb_stats_reset(void)
+{
+	cb_context* ctx = cb_current_context();
+	cb_u64 now = cb_time_now();
+	int i = 0;
 
-#if defined(_WIN32) || defined(_WIN64)
+	memset(&ctx->stats, 0, sizeof(cb_stats));
 
-CB_INTERNAL
-cb_strv cb_get_current_directory()
-{
-    cb_strv result = {0};
-    
-    DWORD buffer_size = GetCurrentDirectory(0, NULL);
-    cb_size string_size = buffer_size - 1;
-    if (buffer_size == 0)
-    {
-        return result;
-    }
-    
-    cb_size anchor = cb_tmp_save();
-    char* buffer = (char*)cb_tmp_calloc(buffer_size);
+	/* Phases being run are only measured from now on. */
+	for (i = 0; i < cb_phase_COUNT; i += 1)
+	{
+		ctx->phase_since[i] = now;
+	}
 
-    if (GetCurrentDirectory(buffer_size, buffer))
-    {
-        /* Adjust slashes of the path/ */
-        for(DWORD i = 0 ;  i < string_size - 1; i += 1)
-        {
-            if (buffer[i] == '/' || buffer[i] == '\\')
-            {
-                buffer[i] =CB_PREFERRED_DIR_SEPARATOR_CHAR;
-            }
-        }
+	cb_tmp_arena.peak = cb_tmp_save();
+}
 
-        CB_ASSERT(string_size == strlen(buffer));
-         
-        return cb_strv_make(buffer, string_size);
-    }
-   
-    cb_tmp_restore(anchor);
+CB_API const char*
+cb_stats_summary(void)
+{
+	cb_stats stats = cb_stats_get();
 
-    return result;
+	return cb_tmp_sprintf("bake %.1fms (properties %.1fms, check %.1fms, compile %.1fms, link %.1fms, copy %.1fms, plugins %.1fms), "
+		CB_U64_FMT " processes, " CB_U64_FMT " bytes hashed, " CB_U64_FMT " files stated, "
+		CB_U64_FMT " cache hits, " CB_U64_FMT " cache misses, tmp peak " CB_U64_FMT " bytes",
+		stats.bake_time / 1000.0, stats.properties_time / 1000.0, stats.check_time / 1000.0,
+		stats.compile_time / 1000.0, stats.link_time / 1000.0, stats.copy_time / 1000.0, stats.plugin_time / 1000.0,
+		stats.process_count, stats.bytes_hashed, stats.files_stated,
+		stats.cache_hits, stats.cache_misses, stats.tmp_peak);
 }
 
-#else
+/*-----------------------------------------------------------------------*/
+/* plugins */
+/*-----------------------------------------------------------------------*/
 
-CB_INTERNAL
-cb_strv cb_get_current_directory()
+CB_API void 
+cb_init_with_plugins(cb_plugin* plugins[], int plugin_count)
 {
-    /* Get current directory */
-    char* cwd = getcwd(NULL, 0);
-    cb_strv result = { 0 };
+    cb_context* ctx = NULL;
+    int i = 0;
+    
+    CB_ASSERT(plugin_count > 0);
+    CB_ASSERT(plugin_count <= CB_MAX_PLUGIN);
+     
+    cb_init();
 
-    if (cwd != NULL)
+    ctx = cb_current_context();
+    
+    for(i = 0; i < plugin_count; i += 1)
     {
-        result.data = cwd;
-        result.size = strlen(cwd);  
+        ctx->plugins[i] = plugins[i];
     }
     
-    return result;
+    ctx->plugin_count = plugin_count;
 }
 
-#endif
-
-CB_INTERNAL cb_strv cb_path_get_relative_path(cb_strv abs_path)
+CB_INTERNAL void
+cb_plugins_bake_starting(cb_project_t* project)
 {
-    cb_size n = 0;
-    cb_strv base_path = {0};
-    cb_strv result = {0};
+    int i;
+    cb_context* ctx = cb_current_context();
+    cb_trace_event event;
 
-    if (!cb_path_is_absolute(cb_strv_make_str(abs_path.data))) 
+    ctx->current_project = project;
+    
+    for(i = 0; i < ctx->plugin_count; i += 1)
     {
-        cb_log_error("the provided path '%s' is not absolute.", abs_path.data);
-        return result;
+        cb_plugin* plugin = ctx->plugins[i];
+        
+        CB_ASSERT(plugin);
+        if (!plugin->disabled
+            && plugin->bake_starting)
+        {
+            cb_trace_plugin_begin(&event, plugin, ".bake_starting", NULL);
+            plugin->bake_starting(plugin, project);
+            cb_trace_event_end(&event);
+        }
     }
+}
 
-    base_path = cb_get_current_directory();
+CB_INTERNAL void
+cb_plugins_bake_finished(cb_project_t* project)
+{
+    int i;
+    cb_context* ctx = cb_current_context();
+    cb_trace_event event;
 
-    if (cb_strv_starts_with(abs_path, base_path)) 
+    ctx->current_project = project;
+    
+    for(i = 0; i < ctx->plugin_count; i += 1)
     {
-       
-        n = base_path.size;
-        /* If absolute path ends with directory separator we skip it */
-        if (abs_path.data[n] == CB_PREFERRED_DIR_SEPARATOR_CHAR) 
+        cb_plugin* plugin = ctx->plugins[i];
+        
+        CB_ASSERT(plugin);
+        if (!plugin->disabled
+            && plugin->bake_finished)
         {
-            n += 1;  /* Skip the directory separator */
+            cb_trace_plugin_begin(&event, plugin, ".bake_finished", NULL);
+            plugin->bake_finished(plugin, project);
+            cb_trace_event_end(&event);
         }
+    }
+}
 
-        result.data = abs_path.data + n;
-        result.size = abs_path.size - n;
-    } 
-    else 
+CB_INTERNAL void
+cb_plugins_extra_argument(cb_project_t* project, cb_dstr* cmd)
+{
+    cb_context* ctx = NULL;
+    int i = 0;
+    cb_trace_event event;
+    
+    ctx = cb_current_context();
+    ctx->current_project = project;
+     
+    for(i = 0; i < ctx->plugin_count; i += 1)
     {
-        result.data = abs_path.data;
-        result.size = abs_path.size;
+        cb_plugin* plugin = ctx->plugins[i];
+        
+        CB_ASSERT(plugin);
+        if (!plugin->disabled
+            && plugin->extra_argument)
+        {
+            const char* arg = NULL;
+            cb_trace_plugin_begin(&event, plugin, ".extra_argument", NULL);
+            arg = plugin->extra_argument(plugin, project);
+            cb_trace_event_end(&event);
+            cb_dstr_append_f(cmd, "%s ", arg);
+        }
     }
-
-    return result;
 }
 
-/* Replace slash with dashes to avoid directory error if they do not exists */
-CB_INTERNAL cb_strv cb_path_to_obj_path(cb_strv path)
+CB_INTERNAL void
+cb_plugins_file_processed(cb_project_t* project, const char* file, const char* std_out, const char* std_err)
 {
-    cb_size i = 0;
-    cb_strv res = cb_tmp_strv_printf(CB_STRV_FMT, CB_STRV_ARG(path));
+    int i;
+    cb_context* ctx = cb_current_context();
+    cb_trace_event event;
 
-    for(i = 0 ; i < res.size; i +=1)
+    ctx->current_project = project;
+     
+    for(i = 0; i < ctx->plugin_count; i += 1)
     {
-        if (cb_is_directory_separator(res.data[i]))
+        cb_plugin* plugin = ctx->plugins[i];
+       
+        CB_ASSERT(plugin);
+        if (!plugin->disabled
+            && plugin->file_processed)
         {
-            res.data[i] = '-';
+            cb_trace_plugin_begin(&event, plugin, ".file_processed", file);
+            plugin->file_processed(plugin, project, file, std_out, std_err);
+            cb_trace_event_end(&event);
         }
     }
-    return res;
 }
 
-CB_INTERNAL char*
-cb_path_get_absolute_dir(const char* path)
+/*-----------------------------------------------------------------------*/
+/* misc. */
+/*-----------------------------------------------------------------------*/
+
+CB_INTERNAL cb_bool
+cb_try_find_project_by_name(cb_strv sv, cb_project_t** project)
 {
-	cb_bool is_directory = cb_true;
-	return cb_path_get_absolute_core(path, is_directory);
+	void* default_value = NULL;
+	*project = (cb_project_t*)cb_mmap_get_ptr(&cb_current_context()->projects, sv, default_value);
+	return (cb_bool)(*project != NULL);
 }
 
-/* create directories recursively */
-CB_INTERNAL void
-cb_create_directories_core(const char* path, cb_size size)
+CB_INTERNAL cb_project_t*
+cb_find_project_by_name(cb_strv sv)
 {
-#ifdef _WIN32
-	typedef wchar_t tchar;
-	wchar_t* str = NULL;
-#else
-	typedef char tchar;
-	char* str = NULL;
-#endif
-
-	if (path == NULL || size <= 0) {
-		cb_log_error("Could not create directory. Path is empty.");
-		return;
+	cb_project_t* project = 0;
+	if (!cb_try_find_project_by_name(sv, &project))
+	{
+		cb_log_error("Project not found '%.*s'", sv.size, sv.data);
+		return NULL;
 	}
 
-	if (size > CB_MAX_PATH) {
-		cb_log_error("Could not create directory. Path is too long '%s'.", path);
-		return;
-	}
+	return project;
+}
 
-#ifdef _WIN32
-	str = (wchar_t*)cb_utf8_to_utf16(path);
-#else
-	str = (char*)path;
-#endif
+CB_INTERNAL cb_project_t* cb_find_project_by_name_str(const char* name) { return cb_find_project_by_name(cb_strv_make_str(name)); }
+CB_INTERNAL cb_bool cb_try_find_project_by_name_str(const char* name, cb_project_t** project) { return cb_try_find_project_by_name(cb_strv_make_str(name), project); }
 
-	if (!cb_path__exists(str))
-	{
-		tchar* cur = str + 2; /* + 2 to avoid root on Windows (unix would require +1 for the original slash ) */
-		tchar* end = str + size;
-		while (cur < end)
-		{
-			/* go to next directory separator */
-			while (*cur && *cur != '\\' && *cur != '/')
-            {
-				cur += 1;
-            }
+CB_INTERNAL void
+cb_project_init(cb_project_t* project, cb_strv name)
+{
+	memset(project, 0, sizeof(cb_project_t));
 
-			if (*cur)
-			{
-				*cur = '\0'; /* terminate path at separator */
-				if (!cb_path__exists(str))
-				{
-					if (!cb__create_directory(str))
-					{
-						cb_log_error("Could not create directory.");
-						return;
-					}
-				}
-				*cur = CB_PREFERRED_DIR_SEPARATOR_CHAR; /* put the separator back */
-			}
-			cur += 1;
-		}
-	}
+	cb_mmap_init(&project->mmap);
+	project->name = name;
 }
 
 CB_INTERNAL void
-cb_create_directories(const char* path, cb_size size)
+cb_project_destroy(cb_project_t* project)
 {
-	cb_size index = cb_tmp_save();
-	cb_create_directories_core(path, size);
-	cb_tmp_restore(index);
+	CB_ASSERT(project);
+	cb_mmap_destroy(&project->mmap);
 }
 
-CB_INTERNAL cb_bool
-cb_copy_file(const char* src_path, const char* dest_path)
+CB_INTERNAL cb_project_t*
+cb_create_project(const char* name)
 {
-#ifdef _WIN32
-	/* create target directory if it does not exists */
-	cb_create_directories(dest_path, strlen(dest_path));
-	cb_log_debug("Copying '%s' to '%s'", src_path, dest_path);
-
-	wchar_t* src_path_w = cb_utf8_to_utf16(src_path);
-	wchar_t* dest_path_w = cb_utf8_to_utf16(dest_path);
-	DWORD attr = GetFileAttributesW(src_path_w);
+	cb_strv name_sv = cb_strv_make_str(name);
 
-	if (attr == INVALID_FILE_ATTRIBUTES) {
-		cb_log_error("Could not retrieve file attributes of file '%s' (%d).", src_path, GetLastError());
-		return cb_false;
-	}
+	cb_project_t* project = (cb_project_t*)CB_MALLOC(sizeof(cb_project_t));
+	CB_ASSERT(project);
+	if (!project) { return NULL; }
 
-	cb_bool is_directory = attr & FILE_ATTRIBUTE_DIRECTORY;
-	BOOL fail_if_exists = FALSE;
-	if (!is_directory && !CopyFileW(src_path_w, dest_path_w, fail_if_exists)) {
-		cb_log_error("Could not copy file '%s', %lu", src_path, GetLastError());
-		return cb_false;
-	}
-	return cb_true;
-#else
+	cb_project_init(project, cb_tmp_str_to_strv(name));
 
-	int src_fd = -1;
-	int dst_fd = -1;
-	struct stat src_stat;
-	off_t sendfile_off = 0;
-	cb_size send_result = 0;
-	cb_size total_bytes_copied = 0;
-	cb_size bytes_copied = 0;
-	cb_size bytes_left = 0;
+	cb_mmap_insert_ptr(&cb_current_context()->projects, name_sv, project);
+	
+    return project;
+}
 
-	/* create target directory if it does not exists */
-	cb_create_directories(dest_path, strlen(dest_path));
-	cb_log_debug("Copying '%s' to '%s'", src_path, dest_path);
+/* API */
 
-	src_fd = open(src_path, O_RDONLY);
-	if (src_fd < 0)
-	{
-		cb_log_error("cb_copy_file: could not open file '%s': %s", src_path, strerror(errno));
-		return cb_false;
-	}
-	
-    if (fstat(src_fd, &src_stat) < 0)
-	{
-        cb_log_error("Could not get fstat of file '%s': %s", src_path, strerror(errno));
-		close(src_fd);
-		return cb_false;
-    }
-	
-	dst_fd = open(dest_path, O_CREAT | O_TRUNC | O_WRONLY, src_stat.st_mode);
-
-	if (dst_fd < 0)
-	{
-        cb_log_error("cb_copy_file: could not open file '%s': %s", dest_path, strerror(errno));
-		close(src_fd);
-		return cb_false;
-	}
-	
-    total_bytes_copied = 0;
-    bytes_left = src_stat.st_size;
-    while (bytes_left > 0)
-    {
-		sendfile_off = total_bytes_copied;
-		send_result = (cb_size)sendfile(dst_fd, src_fd, &sendfile_off, bytes_left);
-		if(send_result <= 0)
-		{
-			break;
-		}
-		bytes_copied = send_result;
-		bytes_left -= bytes_copied;
-		total_bytes_copied += bytes_copied;
-    }
-  
-	close(src_fd);
-	close(dst_fd);
-	return bytes_left == 0;
-#endif
-}
-
-CB_INTERNAL cb_bool
-cb_try_copy_file_to_dir(const char* file, const char* directory)
+#ifdef _WIN32
+/* Any error would silently crash any application, this handler is just there to display a message and exit the application with a specific value */
+__declspec(noinline) static LONG WINAPI exit_on_exception_handler(EXCEPTION_POINTERS* ex_ptr)
 {
-	cb_bool result = 0;
-	cb_size tmp_index = cb_tmp_save();
-	cb_strv filename;
-	const char* destination_file = 0;
-
-	if (cb_path_exists(file))
-	{
-		filename = cb_path_filename_str(file);
-		destination_file = cb_tmp_sprintf("%s%.*s", directory, filename.size, filename.data);
-
-		result = cb_copy_file(file, destination_file);
-	}
-
-	cb_tmp_restore(tmp_index);
-	return result;
+	(void)ex_ptr;
+	int exit_code=1;
+	printf("[CB] Error: unexpected error. exited with code %d\n", exit_code);
+	exit(exit_code);
 }
 
-CB_INTERNAL cb_bool
-cb_copy_file_to_dir(const char* file, const char* directory)
+/* Convert utf-8 string to utf-16 string. String is allocated using the temp buffer */
+CB_INTERNAL wchar_t*
+cb_utf8_to_utf16(const char* str)
 {
-	if (!cb_try_copy_file_to_dir(file, directory))
-	{
-		cb_log_error("Could not copy file '%s' to directory %s", file, directory);
-		return cb_false;
-	}
-	return cb_true;
+	/* Calculate len */
+	int length = MultiByteToWideChar(CP_UTF8, 0, str, -1, NULL, 0);
+	/* Allocate enough space */
+	wchar_t* data = (wchar_t*)cb_tmp_alloc(length * sizeof(wchar_t));
+	/* Write data */
+	MultiByteToWideChar(CP_UTF8, 0, str, -1, data, length);
+	/* Place null-terminated char to end the string */
+	data[length] = L'\0';
+	return data;
 }
 
-
-CB_INTERNAL cb_bool
-cb_delete_file(const char* src_path)
-{
-	cb_bool result = 0;
-	cb_size tmp_index = cb_tmp_save();
-	cb_log_debug("Deleting file '%s'.", src_path);
-#ifdef _WIN32
-	result = DeleteFileW(cb_utf8_to_utf16(src_path));
-#else
-	result = remove(src_path) != -1;
 #endif
-	if (!result) {
-		cb_log_debug("Could not delete file '%s'.", src_path);
-	}
 
-	cb_tmp_restore(tmp_index);
+/* #file utils */
 
-	return result;
-}
+CB_INTERNAL cb_bool cb_is_directory_separator(char c) { return (c == '/' || c == '\\'); }
 
-CB_INTERNAL cb_bool
-cb_move_file(const char* src_path, const char* dest_path)
+#define CB_NPOS ((cb_size)-1)
+
+CB_INTERNAL cb_size
+cb_rfind(cb_strv s, char c)
 {
-	if (cb_copy_file(src_path, dest_path))
+	const char* begin = NULL;
+	const char* end = NULL;
+	if (s.size == 0) return CB_NPOS;
+
+	begin = s.data;
+	end = s.data + s.size - 1;
+	while (end >= begin && *end != c)
 	{
-		return cb_delete_file(src_path);
+		end--;
 	}
-
-	return cb_false;
+	return end < begin ? CB_NPOS : (cb_size)(end - begin);
 }
 
-CB_INTERNAL cb_bool
-cb_try_move_file_to_dir(const char* file, const char* directory)
+CB_INTERNAL cb_size
+cb_rfind2(cb_strv s, char c1, char c2)
 {
-	cb_bool result = cb_false;
-	cb_strv filename = { 0 };
-	const char* destination_file = NULL;
+	const char* begin = NULL;
+	const char* end = NULL;
+	if (s.size == 0) return CB_NPOS;
 
-	cb_size index = cb_tmp_save();
-	if (cb_path_exists(file))
+	begin = s.data;
+	end = s.data + s.size - 1;
+	while (end >= begin && *end != c1 && *end != c2)
 	{
-		filename = cb_path_filename_str(file);
-		destination_file = cb_tmp_sprintf("%s%.*s", directory, filename.size, filename.data);
-
-		result = cb_move_file(file, destination_file);
+		end--;
 	}
-	
-	cb_tmp_restore(index);
-
-	return result;
+	return end < begin ? CB_NPOS : (cb_size)(end - begin);
 }
 
-CB_INTERNAL cb_bool
-cb_move_file_to_dir(const char* file, const char* directory)
+CB_INTERNAL cb_strv
+cb_path_filename(cb_strv path)
 {
-	if (!cb_try_move_file_to_dir(file, directory))
-	{
-		cb_log_error("Could not move file '%s' to '%s'", file, directory);
-		return cb_false;
+	cb_size pos = cb_rfind2(path, '/', '\\');
+	if (pos != CB_NPOS && pos > 0)
+    {
+		return cb_strv_make(path.data + pos + 1 /* plus one because we don't want the slash char */
+			, path.size - pos);
 	}
-	return cb_true;
+	return path;
 }
 
-/*-----------------------------------------------------------------------*/
-/* forward declarations */
-/*-----------------------------------------------------------------------*/
-
-#ifdef _WIN32
-CB_INTERNAL const char* cb_toolchain_msvc_bake(cb_toolchain_t* tc, const char* project_name);
-#else
-CB_INTERNAL const char* cb_toolchain_gcc_bake(cb_toolchain_t* tc, const char* project_name);
-#endif
-
-/*-----------------------------------------------------------------------*/
-/* API */
-/*-----------------------------------------------------------------------*/
-
-CB_API void
-cb_init(void)
+CB_INTERNAL cb_strv
+cb_path_filename_str(const char* str)
 {
-	cb_context_init(&default_ctx);
-	current_ctx = &default_ctx;
-#ifdef _WIN32
-	cb_bool exit_on_exception = cb_true; /* @TODO make this configurable */
-	if (exit_on_exception)
-	{
-		SetUnhandledExceptionFilter(exit_on_exception_handler);
-	}
-#endif
+	return cb_path_filename(cb_strv_make_str(str));
 }
 
-CB_API void
-cb_destroy(void)
+CB_INTERNAL cb_strv
+cb_path_basename(cb_strv s)
 {
-	cb_context_destroy(cb_current_context());
-	cb_tmp_reset();
+	cb_strv filename = cb_path_filename(s);
+
+	if (!cb_strv_equals_str(filename, ".")
+		&& !cb_strv_equals_str(filename, ".."))
+    {
+		cb_size pos = cb_rfind(filename, '.');
+		if (pos != CB_NPOS && pos > 0)
+        {
+			return cb_strv_make(filename.data, pos);
+		}
+	}
+	return filename;
 }
 
-CB_API void
-cb_clear(void)
+CB_INTERNAL cb_strv
+cb_path_basename_str(const char* str)
 {
-	cb_context_clear(cb_current_context());
-	cb_tmp_reset();
+	return cb_path_basename(cb_strv_make_str(str));
 }
 
-CB_API cb_project_t*
-cb_project(const char* name)
+CB_INTERNAL cb_strv
+cb_path_change_extension(cb_strv s, cb_strv ext)
 {
-	cb_project_t* project;
-
-	if (!cb_try_find_project_by_name_str(name, &project))
-	{
-		project = cb_create_project(name);
-	}
-
-	cb_current_context()->current_project = project;
-	return project;
+    cb_strv basename = cb_path_basename(s);
+    
+    size_t len = (basename.data - s.data) + basename.size;
+    cb_strv path_without_extension = cb_strv_make(s.data, len);
+    return cb_tmp_strv_printf(CB_STRV_FMT CB_STRV_FMT,
+        CB_STRV_ARG(path_without_extension), CB_STRV_ARG(ext));
 }
 
-CB_API cb_project_t*
-cb_project_f(const char* format, ...)
-{
-	cb_project_t* p;
-	va_list args;
-	va_start(args, format);
 
-	p = cb_project(cb_tmp_vsprintf(format, args));
+/*  #file_iterator */
 
-	va_end(args);
+#define CB_MAX_PATH 1024 /* this is an arbitrary limit */
 
-	return p;
-}
+#define cb_str_append_from(dst, src, index, max) cb_str_append_from_core(dst, src, index, max, __FILE__, __LINE__)
 
-/* Set current toolchain. */
-CB_API void
-cb_toolchain_set(cb_toolchain_t tc)
+/* Returns the number of character writter. Null-terminating char is not counted. */
+CB_INTERNAL cb_size
+cb_str_append_from_core(char* dst, const char* src, cb_size index, cb_size max, const char* file, int line_number)
 {
-	cb_current_context()->current_toolchain = tc;
-}
+	const char* begin = src;
+	cb_size i = index;
 
-/* Get current toolchain. */
-CB_API cb_toolchain_t
-cb_toolchain_get()
+	do
+	{
+		if (i >= (max - 1))
+		{
+			cb_log_error("Could not copy. String \"%s\" is too long. (file: '%s' line: '%d' max buffer length of '%d').", begin, line_number, file, max);
+			CB_ASSERT(0);
+			break;
+		}
+		dst[i++] = *src++;
+	} while (*src != '\0');
+
+	dst[i] = '\0';
+
+	return i - index;
+}
+
+/* return 1 if separator has been added 0 otherwise */
+CB_INTERNAL cb_size
+cb_ensure_trailing_dir_separator(char* path, cb_size path_len)
 {
-	cb_toolchain_t tc = cb_current_context()->current_toolchain;
-	/* No toolchain: return the default C toolchain. */
-	if (!tc.name)
+	if (!path || path_len >= CB_MAX_PATH) return cb_false;
+
+	if (path_len)
 	{
-		return cb_toolchain_default_c();
+		path += path_len;
+		if (path[-1] != '/' && path[-1] != '\\')
+		{
+			*path++ = CB_PREFERRED_DIR_SEPARATOR_CHAR;
+			*path = '\0';
+			return 1;
+		}
 	}
-	return tc;
+	return 0;
 }
 
-#if _WIN32
+CB_INTERNAL char*
+cb_path_combine(const char* left, const char* right)
+{
+	char* result = (char*)cb_tmp_calloc(CB_MAX_PATH);
+	cb_size n = 0;
+	n += cb_str_append_from(result, left, n, CB_MAX_PATH);
+	n += cb_ensure_trailing_dir_separator(result, strlen(result));
+	n += cb_str_append_from(result, right, n, CB_MAX_PATH);
+	return result;
+}
 
-CB_INTERNAL cb_toolchain_t
-cb_toolchain_msvc(void)
+#ifdef WIN32
+
+CB_INTERNAL cb_bool
+cb_path__exists(const wchar_t* path)
 {
-	cb_toolchain_t tc;
-	tc.bake = cb_toolchain_msvc_bake;
-	tc.name = "msvc";
-	tc.program = "cl";
-	tc.family = "msvc";
-	tc.default_directory_base = ".build/msvc";
-	return tc;
+	DWORD attr = GetFileAttributesW(path);
+	return attr != INVALID_FILE_ATTRIBUTES;
 }
 
-#else
+CB_INTERNAL cb_bool
+cb_path_exists(const char* path)
+{
+	return cb_path__exists(cb_utf8_to_utf16(path));
+}
 
-CB_INTERNAL cb_toolchain_t
-cb_toolchain_gcc()
+CB_INTERNAL cb_bool
+cb__create_directory(const wchar_t* path)
 {
-	cb_toolchain_t tc;
-	tc.bake = cb_toolchain_gcc_bake;
-	tc.name = "gcc";
-	tc.program = "gcc";
-	tc.family = "gcc";
-	tc.default_directory_base = ".build/gcc";
-	return tc;
+	return CreateDirectoryW(path, NULL);
 }
 
-CB_INTERNAL cb_toolchain_t
-cb_toolchain_gpp()
+CB_INTERNAL cb_bool
+cb_create_directory(const char* path)
 {
-	cb_toolchain_t tc;
-	tc.bake = cb_toolchain_gcc_bake;
-	tc.name = "g++";
-	tc.program = "g++";
-	tc.family = "gcc";
-	tc.default_directory_base = ".build/g++";
-	return tc;
+	return cb__create_directory(cb_utf8_to_utf16(path));
 }
+#else
+
+CB_INTERNAL cb_bool cb_path_exists(const char* path) { return access(path, F_OK) == 0; }
+CB_INTERNAL cb_bool cb_path__exists(const char* path) { return cb_path_exists(path); }
+
+CB_INTERNAL cb_bool cb_create_directory(const char* path) { return mkdir(path, 0777) == 0; }
+CB_INTERNAL cb_bool cb__create_directory(const char* path) { return cb_create_directory(path); }
+
 #endif
 
-CB_API cb_toolchain_t
-cb_toolchain_default_c(void)
+CB_INTERNAL cb_bool
+cb_path_is_absolute(cb_strv path)
 {
+	cb_size len = path.size;
+
+	if (len == 0) return cb_false;
+
 #ifdef _WIN32
-	return cb_toolchain_msvc();
+	/* Check drive C : */
+	cb_size i = 0;
+	if (isalpha(path.data[0]) && path.data[1] == ':')
+	{
+		i = 2;
+	}
+
+	return (path.data[i] == '/' || path.data[i] == '\\');
 #else
-	return cb_toolchain_gcc();
+
+	return (path.data[0] == '/');
 #endif
 }
 
-CB_API cb_toolchain_t
-cb_toolchain_default_cpp(void)
-{
 #ifdef _WIN32
-	return cb_toolchain_msvc();
+#define getcwd(buf, size) GetCurrentDirectoryA((DWORD)size, buf)
 #else
-	return cb_toolchain_gpp();
+#include <unistd.h> /* getcwd */
 #endif
-}
 
-CB_API void
-cb_add_many_core(cb_strv key, cb_strv values[], cb_size count)
+#if defined(_WIN32) || defined(_WIN64)
+
+/* Current directory allocated in the arena, or an empty string on failure. */
+CB_INTERNAL cb_strv
+cb__query_current_directory(cb_arena* arena)
 {
-	cb_size i;
-	cb_strv value = { 0 };
-	/* Check that the ptr is contains in the tmp buffer */
-	CB_ASSERT(cb_tmp_contains(key.data));
+	cb_strv result = { 0 };
+	DWORD buffer_size = GetCurrentDirectoryA(0, NULL);
+	DWORD i = 0;
+	char* buffer = NULL;
 
-	for (i = 0; i < count; ++i)
+	if (buffer_size == 0)
 	{
-		value = values[i];
-		/* Check that the ptr is contains in the tmp buffer */
-		CB_ASSERT(cb_tmp_contains(value.data));
-		
-		cb_mmap_insert(
-			&cb_current_project()->mmap,
-			cb_kv_make_with_strv(key, value));
+		return result;
 	}
-}
-
-CB_INTERNAL void
-cb_add_many(const char* key, const char* values[], cb_size count)
-{
-	cb_size i;
-	cb_strv value = { 0 };
 
-	for (i = 0; i < count; ++i)
+	buffer = (char*)cb_arena_alloc(arena, buffer_size);
+	if (!GetCurrentDirectoryA(buffer_size, buffer))
 	{
-		value = cb_tmp_str_to_strv(values[i]);
-		cb_add_many_core(cb_tmp_str_to_strv(key), &value, 1);
+		return result;
 	}
-}
-
-CB_API void
-cb_add_many_vnull(const char* key, ...)
-{
-	cb_strv value;
-	va_list args;
-	const char* current = NULL;
-	va_start(args, key);
 
-	current = va_arg(args, const char*);
-	CB_ASSERT(current);
-	while (current)
+	/* Adjust slashes of the path. */
+	for (i = 0; buffer[i] != '\0'; i += 1)
 	{
-		value = cb_tmp_str_to_strv(current);
-		cb_add_many_core(cb_tmp_str_to_strv(key), &value, 1);
-		current = va_arg(args, const char*);
+		if (buffer[i] == '/' || buffer[i] == '\\')
+		{
+			buffer[i] = CB_PREFERRED_DIR_SEPARATOR_CHAR;
+		}
 	}
-	va_end(args);
-}
-
-CB_API void
-cb_add(const char* key, const char* value)
-{
-	cb_strv value_copy = cb_tmp_str_to_strv(value);
-	cb_add_many_core(cb_tmp_str_to_strv(key), &value_copy, 1);
-}
 
-CB_API void
-cb_add_f(const char* key, const char* format, ...)
-{
-	cb_strv value;
-	va_list args;
-	va_start(args, format);
-
-	value = cb_tmp_strv_vprintf(format, args);
-	cb_add_many_core(cb_tmp_str_to_strv(key), &value, 1);
-
-	va_end(args);
+	return cb_strv_make(buffer, i);
 }
 
-CB_API void
-cb_set(const char* key, const char* value)
-{
-	/* @OPT this can easily be optimized, but we don't care about that right now. */
-	cb_remove_all(key);
-	cb_add(key, value);
-}
+#else
 
-CB_API void
-cb_set_f(const char* key, const char* format, ...)
+/* Current directory allocated in the arena, or an empty string on failure. */
+CB_INTERNAL cb_strv
+cb__query_current_directory(cb_arena* arena)
 {
-	va_list args;
-	va_start(args, format);
+	cb_strv result = { 0 };
+	char* cwd = getcwd(NULL, 0);
 
-	cb_set(key, cb_tmp_vsprintf(format, args));
+	if (cwd != NULL)
+	{
+		result.size = strlen(cwd);
+		result.data = (char*)cb_arena_alloc(arena, result.size + 1);
+		memcpy(result.data, cwd, result.size + 1);
+		free(cwd); /* allocated by getcwd */
+	}
 
-	va_end(args);
+	return result;
 }
 
-CB_API cb_size
-cb_remove_all(const char* key)
-{
-	cb_kv kv = cb_kv_make_with_str(cb_strv_make_str(key), "");
-	cb_project_t* p = cb_current_project();
-	return cb_mmap_remove(&p->mmap, kv);
-}
+#endif
 
-CB_API cb_size
-cb_remove_all_f(const char* format, ...)
+/* Current directory without trailing separator, only queried once until cb_set_current_directory is called. */
+CB_INTERNAL cb_strv
+cb_get_current_directory(void)
 {
-	va_list args;
-	cb_size count = 0;
-	va_start(args, format);
+	cb_context* ctx = cb_current_context();
 
-	count = cb_remove_all(cb_tmp_vsprintf(format, args));
+	if (ctx->current_directory.size == 0)
+	{
+		ctx->current_directory = cb__query_current_directory(&ctx->path_arena);
+	}
 
-	va_end(args);
-	return count;
+	return ctx->current_directory;
 }
 
-CB_API cb_bool
-cb_contains(const char* key, const char* value)
+/* Returns the absolute path, the result is cached and must not be modified. */
+CB_INTERNAL const char*
+cb_path_get_absolute_core(const char* path, cb_bool is_directory)
 {
-	cb_project_t* p;
-	cb_kv_range range;
-	cb_kv kv = cb_kv_make_with_str(cb_strv_make_str(key), value);
-	p = cb_current_project();
-	range = cb_mmap_get_range(&p->mmap, kv.key);
+	cb_context* ctx = cb_current_context();
+	cb_mmap* cache = is_directory ? &ctx->absolute_directories : &ctx->absolute_files;
+	cb_strv path_sv = cb_strv_make_str(path);
+	cb_strv cwd = { 0 };
+	cb_kv kv;
+	cb_size n = 0;
+	cb_size tmp_index = 0;
+	char* buffer = NULL;
+	char* cursor = NULL;
 
-	while (range.begin < range.end)
+	if (cb_mmap_try_get_first(cache, path_sv, &kv))
 	{
-		if (cb_strv_equals_strv((*range.begin).u.strv, kv.u.strv))
-		{
-			return cb_true;
-		}
-		range.begin++;
+		return kv.u.strv.data;
 	}
-	return cb_false;
-}
 
-CB_API cb_bool
-cb_remove_one(const char* key, const char* value)
-{
-	cb_kv kv = cb_kv_make_with_str(cb_strv_make_str(key), value);
-	cb_project_t* p = cb_current_project();
-	cb_kv_range range = cb_mmap_get_range(&p->mmap, kv.key);
+	tmp_index = cb_tmp_save();
+	buffer = (char*)cb_tmp_calloc(FILENAME_MAX);
 
-	while (range.begin < range.end)
+	if (!cb_path_is_absolute(path_sv))
 	{
-		if (cb_strv_equals_strv((*range.begin).u.strv, kv.u.strv))
+		/* skip ./ or .\ */
+		if (path[0] == '.' && (path[1] == '\\' || path[1] == '/'))
+			path += 2;
+
+		cwd = cb_get_current_directory();
+		if (cwd.size == 0)
 		{
-			cb_size index = p->mmap.darr.data - range.begin;
-			cb_darrT_remove(&p->mmap, index);
-			return cb_true;
+			cb_log_error("Could not get absolute path from '%s'", path);
+			cb_tmp_restore(tmp_index);
+			return NULL;
 		}
-		range.begin++;
-	}
-	return cb_false;
-}
-
-CB_API cb_bool
-cb_remove_one_f(const char* key, const char* format, ...)
-{
-	va_list args;
-	cb_bool was_removed = cb_false;
-	va_start(args, format);
-
-	was_removed = cb_remove_one(key, cb_tmp_vsprintf(format, args));
 
-	va_end(args);
-	return was_removed;
-}
+		n = cb_str_append_from(buffer, cwd.data, n, CB_MAX_PATH);
+		n += cb_ensure_trailing_dir_separator(buffer, n);
+	}
 
-CB_API void
-cb_add_file(const char* file)
-{
-	cb_add(cb_FILES, file);
-}
+	n += cb_str_append_from(buffer, path, n, CB_MAX_PATH);
 
-/* Properties are just (strv) values from the map of a project. */
-CB_INTERNAL cb_bool
-try_get_property(const cb_project_t* project, const char* key, cb_kv* result)
-{
-	if (cb_mmap_try_get_first(&project->mmap, cb_strv_make_str(key), result))
+	/* Add trailing slash if it's a directory path */
+	if (is_directory)
 	{
-		return cb_true;
+		cb_ensure_trailing_dir_separator(buffer, strlen(buffer));
 	}
-	return cb_false;
-}
 
-CB_INTERNAL cb_bool
-try_get_property_strv(const cb_project_t* project, const char* key, cb_strv* result)
-{
-	cb_kv kv_result;
-	if (cb_mmap_try_get_first(&project->mmap, cb_strv_make_str(key), &kv_result))
+	cursor = buffer + 2; /* start at 2 to dealing with volume name. */
+	/* Replace slash with the preferred one. */
+	while (*cursor != '\0')
 	{
-		*result = kv_result.u.strv;
-		return cb_true;
+		if (*cursor == CB_DEFAULT_DIR_SEPARATOR_CHAR)
+		{
+			*cursor = CB_PREFERRED_DIR_SEPARATOR_CHAR;
+		}
+		cursor += 1;
 	}
-	return cb_false;
-}
-
-CB_INTERNAL cb_bool
-cb_property_equals(const cb_project_t* project, const char* key, const char* comparison_value)
-{
-	cb_strv result;
-	return try_get_property_strv(project, key, &result)
-		&& cb_strv_equals_str(result, comparison_value);
-}
-
-CB_API const char*
-cb_bake_project_with(const char* project_name, cb_toolchain_t toolchain)
-{
-	const char* result = toolchain.bake(&toolchain, project_name);
-	return result;
-}
-
-CB_API const char*
-cb_bake_project(const char* project_name)
-{
-	return cb_bake_project_with(project_name, cb_toolchain_get());
-}
 
-CB_API const char*
-cb_bake(void)
-{
-	cb_project_t* p = cb_current_project();
-	return cb_bake_project_with(p->name.data, cb_toolchain_get());
-}
+	/* Store the input path and the result in the cache. */
+	kv.key.size = path_sv.size;
+	kv.key.data = (char*)cb_arena_alloc(&ctx->path_arena, path_sv.size + 1);
+	memcpy(kv.key.data, path_sv.data, path_sv.size + 1);
+	kv = cb_kv_make_with_strv(kv.key, cb_strv_make_str(buffer));
+	kv.u.strv.data = (char*)cb_arena_alloc(&ctx->path_arena, kv.u.strv.size + 1);
+	memcpy(kv.u.strv.data, buffer, kv.u.strv.size + 1);
+	cb_mmap_insert(cache, kv);
 
-CB_API const char*
-cb_bake_with(cb_toolchain_t toolchain)
-{
-	cb_project_t* p = cb_current_project();
-	return cb_bake_project_with(p->name.data, toolchain);
+	cb_tmp_restore(tmp_index);
+	return kv.u.strv.data;
 }
 
 CB_INTERNAL const char*
-cb_get_output_directory(const cb_project_t* project, const cb_toolchain_t* tc)
+cb_path_get_absolute_file(const char* path)
 {
-	cb_strv out_dir;
-	if (try_get_property_strv(project, cb_OUTPUT_DIR, &out_dir))
-	{
-		return cb_path_get_absolute_dir(out_dir.data);
-	}
-	else
-	{
-		/* Get default output directory */
-		return cb_path_get_absolute_dir(cb_path_combine(tc->default_directory_base, project->name.data));
-	}
+	cb_bool is_directory = cb_false;
+	return cb_path_get_absolute_core(path, is_directory);
 }
 
-struct cb_process_handle {
-	const char* cmd;
-	const char* starting_directory;
-	cb_bool stdout_to_string; /* If stdout needs to be copied to a string. */
-	cb_bool stderr_to_string; /* If stderr needs to be copied to a string. */
-	cb_dstr stdout_string;    /* If stdout_to_string has been set to true. */
-	cb_dstr stderr_string;    /* If stderr_to_string has been set to true. */
-	int exit_code;
-};
-
-CB_INTERNAL cb_process_handle* cb_process_core(cb_process_handle* handle);
-
-CB_INTERNAL cb_process_handle*
-cb_create_process_handle(const char* cmd, const char* starting_directory)
+CB_INTERNAL cb_strv cb_path_get_relative_path(cb_strv abs_path)
 {
-	cb_process_handle* handle = (cb_process_handle*)cb_tmp_alloc(sizeof(cb_process_handle));
-	memset(handle, 0, sizeof(cb_process_handle));
+    cb_size n = 0;
+    cb_strv base_path = {0};
+    cb_strv result = {0};
 
-	handle->cmd = cmd;
-	handle->starting_directory = starting_directory;
-	handle->exit_code = -1;
+    if (!cb_path_is_absolute(cb_strv_make_str(abs_path.data))) 
+    {
+        cb_log_error("the provided path '%s' is not absolute.", abs_path.data);
+        return result;
+    }
 
-	cb_dstr_init(&handle->stdout_string);
-	cb_dstr_init(&handle->stderr_string);
+    base_path = cb_get_current_directory();
 
-	return handle;
-}
+    if (cb_strv_starts_with(abs_path, base_path)) 
+    {
+       
+        n = base_path.size;
+        /* If absolute path ends with directory separator we skip it */
+        if (abs_path.data[n] == CB_PREFERRED_DIR_SEPARATOR_CHAR) 
+        {
+            n += 1;  /* Skip the directory separator */
+        }
 
-CB_API int
-cb_process(const char* cmd)
-{
-	return cb_process_in_directory(cmd, NULL);
-}
+        result.data = abs_path.data + n;
+        result.size = abs_path.size - n;
+    } 
+    else 
+    {
+        result.data = abs_path.data;
+        result.size = abs_path.size;
+    }
 
-CB_API int
-cb_process_in_directory(const char* cmd, const char* starting_directory)
-{
-	cb_process_handle* handle = cb_create_process_handle(cmd, starting_directory);
-	handle = cb_process_core(handle);
-	return cb_process_end(handle);
+    return result;
 }
 
-CB_API cb_process_handle*
-cb_process_to_string(const char* cmd, const char* starting_directory, cb_bool also_get_stderr)
+/* Replace slash with dashes to avoid directory error if they do not exists */
+CB_INTERNAL cb_strv cb_path_to_obj_path(cb_strv path)
 {
-	cb_process_handle* handle = cb_create_process_handle(cmd, starting_directory);
-
-	handle->stdout_to_string = cb_true;
-	handle->stderr_to_string = also_get_stderr;
+    cb_size i = 0;
+    cb_strv res = cb_tmp_strv_printf(CB_STRV_FMT, CB_STRV_ARG(path));
 
-	return cb_process_core(handle);
+    for(i = 0 ; i < res.size; i +=1)
+    {
+        if (cb_is_directory_separator(res.data[i]))
+        {
+            res.data[i] = '-';
+        }
+    }
+    return res;
 }
 
-CB_API int
-cb_run(const char* executable_path)
+/* Path of the object file of a source file, 'extension' being ".o" or ".obj". The result is allocated with the tmp allocator.
+   Example: <output_dir>src-foo.c.o for <current_dir>/src/foo.c */
+CB_INTERNAL cb_strv
+cb_path_get_object_path(const char* output_dir, const char* abs_file, const char* extension)
 {
-	return cb_process_in_directory(cb_tmp_sprintf("\"%s\"", executable_path), NULL);
-}
+    cb_strv relative_path = cb_path_get_relative_path(cb_strv_make_str(abs_file));
+    cb_strv relative_path_fmt = cb_path_to_obj_path(relative_path);
 
-CB_API const char*
-cb_process_stdout_string(cb_process_handle* handle)
-{
-	return handle->stdout_string.data;
+    /* Combine output dir and relative path of the src file. */
+    return cb_tmp_strv_printf("%s" CB_STRV_FMT "%s", output_dir, CB_STRV_ARG(relative_path_fmt), extension);
 }
 
-CB_API const char*
-cb_process_stderr_string(cb_process_handle* handle)
+CB_INTERNAL const char*
+cb_path_get_absolute_dir(const char* path)
 {
-	return handle->stderr_string.data;
+	cb_bool is_directory = cb_true;
+	return cb_path_get_absolute_core(path, is_directory);
 }
 
-CB_API int
-cb_process_end(cb_process_handle* handle)
+CB_API cb_bool
+cb_set_current_directory(const char* path)
 {
-	cb_dstr_destroy(&handle->stdout_string);
-	cb_dstr_destroy(&handle->stderr_string);
-
-	return handle->exit_code;
-}
+#ifdef _WIN32
+	cb_bool changed = SetCurrentDirectoryW(cb_utf8_to_utf16(path)) != 0;
+#else
+	cb_bool changed = chdir(path) == 0;
+#endif
 
-#if _WIN32
+	if (!changed)
+	{
+		cb_log_error("Could not change current directory to '%s'", path);
+		return cb_false;
+	}
 
-/* #process */
+	/* Relative paths were resolved from the previous directory. */
+	cb_context_clear_path_cache(cb_current_context());
+	return cb_true;
+}
 
-CB_INTERNAL cb_process_handle*
-cb_process_core(cb_process_handle* handle)
+/* create directories recursively */
+CB_INTERNAL void
+cb_create_directories_core(const char* path, cb_size size)
 {
-	HANDLE process_stdout_write = NULL; /* Pipe (write) for stdout of the child process */
-	HANDLE process_stdout_read = NULL;  /* Pipe (read) for stdout of the child process */
-	HANDLE process_stderr_write = NULL; /* Pipe (write) for stderr of the child process */
-	HANDLE process_stderr_read = NULL;  /* Pipe (read) for stderr of the child process */
-	SECURITY_ATTRIBUTES saAttr;         /* To create the pipes. */
-
-	DWORD exit_code = (DWORD) -1;
-	BOOL child_running = 0;
-	DWORD byte_read_from_buffer = 0;
-	char process_output_buffer[256] = { 0 };
-	BOOL handles_inheritance = 0;
-
-	wchar_t* cmd_w = cb_utf8_to_utf16(handle->cmd);
-	wchar_t* starting_directory_w = NULL;
+#ifdef _WIN32
+	typedef wchar_t tchar;
+	wchar_t* str = NULL;
+#else
+	typedef char tchar;
+	char* str = NULL;
+#endif
 
-	cb_log_debug("Running process '%s'", handle->cmd);
-	if (handle->starting_directory && handle->starting_directory[0])
-	{
-		starting_directory_w = cb_utf8_to_utf16(handle->starting_directory);
-		cb_log_debug("Subprocess started in directory '%s'", handle->starting_directory);
+	if (path == NULL || size <= 0) {
+		cb_log_error("Could not create directory. Path is empty.");
+		return;
 	}
 
-	/* Ensure that everything is written into the outputs before creating a new process that will also write in those outputs */
-	fflush(stdout);
-	fflush(stderr);
+	if (size > CB_MAX_PATH) {
+		cb_log_error("Could not create directory. Path is too long '%s'.", path);
+		return;
+	}
 
-	STARTUPINFOW si;
-	PROCESS_INFORMATION pi;
+#ifdef _WIN32
+	str = (wchar_t*)cb_utf8_to_utf16(path);
+#else
+	str = (char*)path;
+#endif
 
-	ZeroMemory(&si, sizeof(si));
-	si.cb = sizeof(si);
+	if (!cb_path__exists(str))
+	{
+		tchar* cur = str + 2; /* + 2 to avoid root on Windows (unix would require +1 for the original slash ) */
+		tchar* end = str + size;
+		while (cur < end)
+		{
+			/* go to next directory separator */
+			while (*cur && *cur != '\\' && *cur != '/')
+            {
+				cur += 1;
+            }
+
+			if (*cur)
+			{
+				*cur = '\0'; /* terminate path at separator */
+				if (!cb_path__exists(str))
+				{
+					if (!cb__create_directory(str))
+					{
+						cb_log_error("Could not create directory.");
+						return;
+					}
+				}
+				*cur = CB_PREFERRED_DIR_SEPARATOR_CHAR; /* put the separator back */
+			}
+			cur += 1;
+		}
+	}
+}
+
+CB_INTERNAL void
+cb_create_directories(const char* path, cb_size size)
+{
+	cb_size index = cb_tmp_save();
+	cb_create_directories_core(path, size);
+	cb_tmp_restore(index);
+}
+
+CB_INTERNAL cb_bool
+cb_copy_file_core(const char* src_path, const char* dest_path)
+{
+#ifdef _WIN32
+	/* create target directory if it does not exists */
+	cb_create_directories(dest_path, strlen(dest_path));
+	cb_log_debug("Copying '%s' to '%s'", src_path, dest_path);
+
+	wchar_t* src_path_w = cb_utf8_to_utf16(src_path);
+	wchar_t* dest_path_w = cb_utf8_to_utf16(dest_path);
+	DWORD attr = GetFileAttributesW(src_path_w);
+
+	if (attr == INVALID_FILE_ATTRIBUTES) {
+		cb_log_error("Could not retrieve file attributes of file '%s' (%d).", src_path, GetLastError());
+		return cb_false;
+	}
+
+	cb_bool is_directory = attr & FILE_ATTRIBUTE_DIRECTORY;
+	BOOL fail_if_exists = FALSE;
+	if (!is_directory && !CopyFileW(src_path_w, dest_path_w, fail_if_exists)) {
+		cb_log_error("Could not copy file '%s', %lu", src_path, GetLastError());
+		return cb_false;
+	}
+	return cb_true;
+#else
+
+	int src_fd = -1;
+	int dst_fd = -1;
+	struct stat src_stat;
+	off_t sendfile_off = 0;
+	cb_size send_result = 0;
+	cb_size total_bytes_copied = 0;
+	cb_size bytes_copied = 0;
+	cb_size bytes_left = 0;
+
+	/* create target directory if it does not exists */
+	cb_create_directories(dest_path, strlen(dest_path));
+	cb_log_debug("Copying '%s' to '%s'", src_path, dest_path);
+
+	src_fd = open(src_path, O_RDONLY);
+	if (src_fd < 0)
+	{
+		cb_log_error("cb_copy_file: could not open file '%s': %s", src_path, strerror(errno));
+		return cb_false;
+	}
+	
+    if (fstat(src_fd, &src_stat) < 0)
+	{
+        cb_log_error("Could not get fstat of file '%s': %s", src_path, strerror(errno));
+		close(src_fd);
+		return cb_false;
+    }
+	
+	dst_fd = open(dest_path, O_CREAT | O_TRUNC | O_WRONLY, src_stat.st_mode);
+
+	if (dst_fd < 0)
+	{
+        cb_log_error("cb_copy_file: could not open file '%s': %s", dest_path, strerror(errno));
+		close(src_fd);
+		return cb_false;
+	}
+	
+    total_bytes_copied = 0;
+    bytes_left = src_stat.st_size;
+    while (bytes_left > 0)
+    {
+		sendfile_off = total_bytes_copied;
+		send_result = (cb_size)sendfile(dst_fd, src_fd, &sendfile_off, bytes_left);
+		if(send_result <= 0)
+		{
+			break;
+		}
+		bytes_copied = send_result;
+		bytes_left -= bytes_copied;
+		total_bytes_copied += bytes_copied;
+    }
+  
+	close(src_fd);
+	close(dst_fd);
+	return bytes_left == 0;
+#endif
+}
+
+CB_INTERNAL cb_bool
+cb_copy_file(const char* src_path, const char* dest_path)
+{
+	cb_trace_event event;
+	cb_bool result = cb_false;
+
+	/* The filename points to the end of the destination path so it's null-terminated. */
+	cb_trace_event_begin(&event, "copy", cb_path_filename_str(dest_path).data, src_path);
+	result = cb_copy_file_core(src_path, dest_path);
+	cb_trace_event_end(&event);
+
+	return result;
+}
+
+CB_INTERNAL cb_bool
+cb_try_copy_file_to_dir(const char* file, const char* directory)
+{
+	cb_bool result = 0;
+	cb_size tmp_index = cb_tmp_save();
+	cb_strv filename;
+	const char* destination_file = 0;
+
+	if (cb_path_exists(file))
+	{
+		filename = cb_path_filename_str(file);
+		destination_file = cb_tmp_sprintf("%s%.*s", directory, filename.size, filename.data);
+
+		result = cb_copy_file(file, destination_file);
+	}
+
+	cb_tmp_restore(tmp_index);
+	return result;
+}
+
+CB_INTERNAL cb_bool
+cb_copy_file_to_dir(const char* file, const char* directory)
+{
+	if (!cb_try_copy_file_to_dir(file, directory))
+	{
+		cb_log_error("Could not copy file '%s' to directory %s", file, directory);
+		return cb_false;
+	}
+	return cb_true;
+}
+
+
+CB_INTERNAL cb_bool
+cb_delete_file(const char* src_path)
+{
+	cb_bool result = 0;
+	cb_size tmp_index = cb_tmp_save();
+	cb_log_debug("Deleting file '%s'.", src_path);
+#ifdef _WIN32
+	result = DeleteFileW(cb_utf8_to_utf16(src_path));
+#else
+	result = remove(src_path) != -1;
+#endif
+	if (!result) {
+		cb_log_debug("Could not delete file '%s'.", src_path);
+	}
+
+	cb_tmp_restore(tmp_index);
+
+	return result;
+}
+
+CB_INTERNAL cb_bool
+cb_move_file(const char* src_path, const char* dest_path)
+{
+	if (cb_copy_file(src_path, dest_path))
+	{
+		return cb_delete_file(src_path);
+	}
+
+	return cb_false;
+}
+
+CB_INTERNAL cb_bool
+cb_try_move_file_to_dir(const char* file, const char* directory)
+{
+	cb_bool result = cb_false;
+	cb_strv filename = { 0 };
+	const char* destination_file = NULL;
+
+	cb_size index = cb_tmp_save();
+	if (cb_path_exists(file))
+	{
+		filename = cb_path_filename_str(file);
+		destination_file = cb_tmp_sprintf("%s%.*s", directory, filename.size, filename.data);
+
+		result = cb_move_file(file, destination_file);
+	}
+	
+	cb_tmp_restore(index);
+
+	return result;
+}
+
+CB_INTERNAL cb_bool
+cb_move_file_to_dir(const char* file, const char* directory)
+{
+	if (!cb_try_move_file_to_dir(file, directory))
+	{
+		cb_log_error("Could not move file '%s' to '%s'", file, directory);
+		return cb_false;
+	}
+	return cb_true;
+}
+
+/*-----------------------------------------------------------------------*/
+/* forward declarations */
+/*-----------------------------------------------------------------------*/
+
+#ifdef _WIN32
+CB_INTERNAL const char* cb_toolchain_msvc_bake(cb_toolchain_t* tc, const char* project_name);
+#else
+CB_INTERNAL const char* cb_toolchain_gcc_bake(cb_toolchain_t* tc, const char* project_name);
+CB_INTERNAL cb_bool cb_gcc_bake_projects(cb_toolchain_t* tc, cb_project_t* projects[], cb_size count, const char** last_artefact);
+CB_INTERNAL cb_bool cb_gcc_export_compile_commands(const cb_toolchain_t* tc, const char* path, cb_project_t* projects[], cb_size count);
+#endif
+
+/*-----------------------------------------------------------------------*/
+/* API */
+/*-----------------------------------------------------------------------*/
+
+CB_API void
+cb_init(void)
+{
+	cb_context_init(&default_ctx);
+	current_ctx = &default_ctx;
+#ifdef _WIN32
+	cb_bool exit_on_exception = cb_true; /* @TODO make this configurable */
+	if (exit_on_exception)
+	{
+		SetUnhandledExceptionFilter(exit_on_exception_handler);
+	}
+#endif
+}
+
+#ifndef _WIN32
+/* Restore the SIGCHLD disposition replaced by the first process started. */
+CB_INTERNAL void cb_sigchld_pipe_destroy(void);
+#endif
+
+CB_API void
+cb_destroy(void)
+{
+	cb_trace_end();
+	cb_context_destroy(cb_current_context());
+	cb_tmp_destroy();
+#ifndef _WIN32
+	cb_sigchld_pipe_destroy();
+#endif
+}
+
+CB_API void
+cb_clear(void)
+{
+	cb_context_clear(cb_current_context());
+	cb_tmp_reset();
+}
+
+CB_API cb_project_t*
+cb_project(const char* name)
+{
+	cb_project_t* project;
+
+	if (!cb_try_find_project_by_name_str(name, &project))
+	{
+		project = cb_create_project(name);
+	}
+
+	cb_current_context()->current_project = project;
+	return project;
+}
+
+CB_API cb_project_t*
+cb_project_f(const char* format, ...)
+{
+	cb_project_t* p;
+	va_list args;
+	va_start(args, format);
+
+	p = cb_project(cb_tmp_vsprintf(format, args));
+
+	va_end(args);
+
+	return p;
+}
+
+/* Set current toolchain. */
+CB_API void
+cb_toolchain_set(cb_toolchain_t tc)
+{
+	cb_current_context()->current_toolchain = tc;
+}
+
+/* Get current toolchain. */
+CB_API cb_toolchain_t
+cb_toolchain_get()
+{
+	cb_toolchain_t tc = cb_current_context()->current_toolchain;
+	/* No toolchain: return the default C toolchain. */
+	if (!tc.name)
+	{
+		return cb_toolchain_default_c();
+	}
+	return tc;
+}
+
+#if _WIN32
+
+CB_INTERNAL cb_toolchain_t
+cb_toolchain_msvc(void)
+{
+	cb_toolchain_t tc;
+	tc.bake = cb_toolchain_msvc_bake;
+	tc.name = "msvc";
+	tc.program = "cl";
+	tc.family = "msvc";
+	tc.default_directory_base = ".build/msvc";
+	return tc;
+}
+
+#else
+
+CB_INTERNAL cb_toolchain_t
+cb_toolchain_gcc()
+{
+	cb_toolchain_t tc;
+	tc.bake = cb_toolchain_gcc_bake;
+	tc.name = "gcc";
+	tc.program = "gcc";
+	tc.family = "gcc";
+	tc.default_directory_base = ".build/gcc";
+	return tc;
+}
+
+CB_INTERNAL cb_toolchain_t
+cb_toolchain_gpp()
+{
+	cb_toolchain_t tc;
+	tc.bake = cb_toolchain_gcc_bake;
+	tc.name = "g++";
+	tc.program = "g++";
+	tc.family = "gcc";
+	tc.default_directory_base = ".build/g++";
+	return tc;
+}
+#endif
+
+CB_API cb_toolchain_t
+cb_toolchain_default_c(void)
+{
+#ifdef _WIN32
+	return cb_toolchain_msvc();
+#else
+	return cb_toolchain_gcc();
+#endif
+}
+
+CB_API cb_toolchain_t
+cb_toolchain_default_cpp(void)
+{
+#ifdef _WIN32
+	return cb_toolchain_msvc();
+#else
+	return cb_toolchain_gpp();
+#endif
+}
+
+CB_API void
+cb_add_many_core(cb_strv key, cb_strv values[], cb_size count)
+{
+	cb_size i;
+	cb_kv kv;
+	cb_mmap* m = &cb_current_project()->mmap;
+	/* Check that the ptr is contains in the tmp buffer */
+	CB_ASSERT(cb_tmp_contains(key.data));
+
+	/* The key is hashed once for all values. */
+	cb_kv_init(&kv, key);
+
+	cb_mmap_batch_begin(m);
+	for (i = 0; i < count; ++i)
+	{
+		/* Check that the ptr is contains in the tmp buffer */
+		CB_ASSERT(cb_tmp_contains(values[i].data));
+
+		kv.u.strv = values[i];
+		cb_mmap_insert(m, kv);
+	}
+	cb_mmap_batch_end(m);
+}
+
+CB_API void
+cb_add_many(const char* key, const char* values[], cb_size count)
+{
+	cb_size i;
+	cb_strv value = { 0 };
+	cb_strv key_copy = cb_tmp_intern_str(key);
+
+	cb_batch_begin();
+	for (i = 0; i < count; ++i)
+	{
+		value = cb_tmp_intern_str(values[i]);
+		cb_add_many_core(key_copy, &value, 1);
+	}
+	cb_batch_end();
+}
+
+CB_API void
+cb_add_many_vnull(const char* key, ...)
+{
+	cb_strv value;
+	va_list args;
+	const char* current = NULL;
+	cb_strv key_copy = cb_tmp_intern_str(key);
+	va_start(args, key);
+
+	current = va_arg(args, const char*);
+	CB_ASSERT(current);
+	cb_batch_begin();
+	while (current)
+	{
+		value = cb_tmp_intern_str(current);
+		cb_add_many_core(key_copy, &value, 1);
+		current = va_arg(args, const char*);
+	}
+	cb_batch_end();
+	va_end(args);
+}
+
+CB_API void
+cb_batch_begin(void)
+{
+	cb_context* ctx = cb_current_context();
+
+	if (ctx->batch_depth == 0)
+	{
+		ctx->batch_project = cb_current_project();
+	}
+	ctx->batch_depth += 1;
+	cb_mmap_batch_begin(&ctx->batch_project->mmap);
+}
+
+CB_API void
+cb_batch_end(void)
+{
+	cb_context* ctx = cb_current_context();
+
+	CB_ASSERT(ctx->batch_depth > 0 && "cb_batch_end called without cb_batch_begin.");
+	/* The current project may have changed since cb_batch_begin. */
+	cb_mmap_batch_end(&ctx->batch_project->mmap);
+	ctx->batch_depth -= 1;
+	if (ctx->batch_depth == 0)
+	{
+		ctx->batch_project = NULL;
+	}
+}
+
+CB_API void
+cb_add(const char* key, const char* value)
+{
+	cb_strv value_copy = cb_tmp_intern_str(value);
+	cb_add_many_core(cb_tmp_intern_str(key), &value_copy, 1);
+}
+
+CB_API void
+cb_add_f(const char* key, const char* format, ...)
+{
+	cb_strv value;
+	cb_strv interned;
+	cb_size tmp_index = cb_tmp_save();
+	va_list args;
+	va_start(args, format);
+
+	value = cb_tmp_strv_vprintf(format, args);
+	interned = cb_intern_get(value, cb_false);
+	if (interned.data != value.data)
+	{
+		/* Already interned, release the formatted string. */
+		cb_tmp_restore(tmp_index);
+	}
+	cb_add_many_core(cb_tmp_intern_str(key), &interned, 1);
+
+	va_end(args);
+}
+
+CB_API void
+cb_set(const char* key, const char* value)
+{
+	/* @OPT this can easily be optimized, but we don't care about that right now. */
+	cb_remove_all(key);
+	cb_add(key, value);
+}
+
+CB_API void
+cb_set_f(const char* key, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+
+	cb_set(key, cb_tmp_vsprintf(format, args));
+
+	va_end(args);
+}
+
+CB_API cb_size
+cb_remove_all(const char* key)
+{
+	cb_kv kv = cb_kv_make_with_str(cb_strv_make_str(key), "");
+	cb_project_t* p = cb_current_project();
+	return cb_mmap_remove(&p->mmap, kv);
+}
+
+CB_API cb_size
+cb_remove_all_f(const char* format, ...)
+{
+	va_list args;
+	cb_size count = 0;
+	va_start(args, format);
+
+	count = cb_remove_all(cb_tmp_vsprintf(format, args));
+
+	va_end(args);
+	return count;
+}
+
+CB_API cb_bool
+cb_contains(const char* key, const char* value)
+{
+	cb_project_t* p;
+	cb_kv_range range;
+	cb_kv current;
+	cb_kv kv = cb_kv_make_with_str(cb_strv_make_str(key), value);
+	p = cb_current_project();
+	range = cb_mmap_get_range(&p->mmap, kv.key);
+
+	while (cb_mmap_range_get_next(&range, &current))
+	{
+		if (cb_strv_equals_strv(current.u.strv, kv.u.strv))
+		{
+			return cb_true;
+		}
+	}
+	return cb_false;
+}
+
+CB_API cb_bool
+cb_remove_one(const char* key, const char* value)
+{
+	cb_kv kv = cb_kv_make_with_str(cb_strv_make_str(key), value);
+	cb_project_t* p = cb_current_project();
+	return cb_mmap_remove_one_strv(&p->mmap, kv);
+}
+
+CB_API cb_bool
+cb_remove_one_f(const char* key, const char* format, ...)
+{
+	va_list args;
+	cb_bool was_removed = cb_false;
+	va_start(args, format);
+
+	was_removed = cb_remove_one(key, cb_tmp_vsprintf(format, args));
+
+	va_end(args);
+	return was_removed;
+}
+
+CB_API void
+cb_add_file(const char* file)
+{
+	cb_add(cb_FILES, file);
+}
+
+/* Properties are just (strv) values from the map of a project. */
+CB_INTERNAL cb_bool
+try_get_property(const cb_project_t* project, const char* key, cb_kv* result)
+{
+	if (cb_mmap_try_get_first(&project->mmap, cb_strv_make_str(key), result))
+	{
+		return cb_true;
+	}
+	return cb_false;
+}
+
+CB_INTERNAL cb_bool
+try_get_property_strv(const cb_project_t* project, const char* key, cb_strv* result)
+{
+	cb_kv kv_result;
+	if (cb_mmap_try_get_first(&project->mmap, cb_strv_make_str(key), &kv_result))
+	{
+		*result = kv_result.u.strv;
+		return cb_true;
+	}
+	return cb_false;
+}
+
+CB_INTERNAL cb_bool
+cb_property_equals(const cb_project_t* project, const char* key, const char* comparison_value)
+{
+	cb_strv result;
+	return try_get_property_strv(project, key, &result)
+		&& cb_strv_equals_str(result, comparison_value);
+}
+
+CB_API const char*
+cb_bake_project_with(const char* project_name, cb_toolchain_t toolchain)
+{
+	cb_trace_event event;
+	const char* result = NULL;
+
+	cb_trace_event_begin(&event, "bake", project_name, NULL);
+	result = toolchain.bake(&toolchain, project_name);
+	cb_trace_event_end(&event);
+
+	return result;
+}
+
+CB_API void
+cb_set_jobs(int count)
+{
+	cb_current_context()->jobs = count;
+}
+
+/* Let the plugins decide which source files of the project are compiled, before any of them is compiled.
+   The plugins are called one after the other: check_files with the absolute path of the files accepted
+   by the previous plugins, then can_process_file for each of these files.
+   Returns one value per file of the project, in the order of cb_FILES. The result is allocated with CB_MALLOC. */
+CB_INTERNAL cb_bool*
+cb_plugins_check_files(cb_project_t* project)
+{
+    int i;
+    cb_context* ctx = cb_current_context();
+    cb_darrT(char*) files;           /* Absolute path of all the files. */
+    cb_darrT(const char*) accepted;  /* Files accepted by the plugins called so far. */
+    cb_darrT(cb_size) indices;       /* Index of each accepted file in 'files'. */
+    cb_bool* can_process = NULL;
+    cb_kv_range range = { 0 };
+    cb_kv current = { 0 };
+    cb_size tmp_index = 0;
+    cb_size j = 0;
+    cb_size count = 0;
+    cb_trace_event event;
+
+    range = cb_mmap_get_range_str(&project->mmap, cb_FILES);
+    can_process = (cb_bool*)CB_MALLOC(sizeof(cb_bool) * (range.count + 1));
+    CB_ASSERT(can_process);
+    for (j = 0; j < range.count; j += 1)
+    {
+        can_process[j] = cb_true;
+    }
+
+    for(i = 0; i < ctx->plugin_count; i += 1)
+    {
+        CB_ASSERT(ctx->plugins[i]);
+        count += !ctx->plugins[i]->disabled && (ctx->plugins[i]->check_files || ctx->plugins[i]->can_process_file);
+    }
+
+    if (count == 0)
+    {
+        return can_process;
+    }
+
+    ctx->current_project = project;
+    cb_darrT_init(&files);
+    cb_darrT_init(&accepted);
+    cb_darrT_init(&indices);
+
+    while (cb_mmap_range_get_next(&range, &current))
+    {
+        tmp_index = cb_tmp_save();
+        cb_darrT_push_back(&files, cb_str_dup(cb_path_get_absolute_file(current.u.strv.data)));
+        cb_tmp_restore(tmp_index);
+
+        cb_darrT_push_back(&accepted, cb_darrT_at(&files, cb_darrT_size(&files) - 1));
+        cb_darrT_push_back(&indices, cb_darrT_size(&files) - 1);
+    }
+
+    for(i = 0; i < ctx->plugin_count; i += 1)
+    {
+        cb_plugin* plugin = ctx->plugins[i];
+
+        if (plugin->disabled)
+        {
+            continue;
+        }
+
+        if (plugin->check_files)
+        {
+            cb_trace_plugin_begin(&event, plugin, ".check_files", NULL);
+            plugin->check_files(plugin, project, accepted.darr.data, cb_darrT_size(&accepted));
+            cb_trace_event_end(&event);
+        }
+
+        if (plugin->can_process_file)
+        {
+            /* Only keep the files accepted by the plugin. */
+            count = 0;
+            for (j = 0; j < cb_darrT_size(&accepted); j += 1)
+            {
+                cb_trace_plugin_begin(&event, plugin, ".can_process_file", cb_darrT_at(&accepted, j));
+                if (plugin->can_process_file(plugin, project, cb_darrT_at(&accepted, j)))
+                {
+                    cb_darrT_set(&accepted, count, cb_darrT_at(&accepted, j));
+                    cb_darrT_set(&indices, count, cb_darrT_at(&indices, j));
+                    count += 1;
+                }
+                else
+                {
+                    can_process[cb_darrT_at(&indices, j)] = cb_false;
+                }
+                cb_trace_event_end(&event);
+            }
+            accepted.darr.size = count;
+            indices.darr.size = count;
+        }
+    }
+
+    for (j = 0; j < cb_darrT_size(&files); j += 1)
+    {
+        CB_FREE(cb_darrT_at(&files, j));
+    }
+    cb_darrT_destroy(&files);
+    cb_darrT_destroy(&accepted);
+    cb_darrT_destroy(&indices);
+
+    return can_process;
+}
+
+CB_INTERNAL int
+cb_get_processor_count(void)
+{
+	int count = 1;
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	count = (int)info.dwNumberOfProcessors;
+#else
+	count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return count > 0 ? count : 1;
+}
+
+/* Get the number of source files the project can compile at the same time.
+   Look for the "jobs" property, then the value set with cb_set_jobs, then the CB_JOBS environment variable. */
+CB_INTERNAL int
+cb_get_jobs(const cb_project_t* project)
+{
+	cb_strv value = { 0 };
+	const char* env = NULL;
+	int jobs = -1;
+
+	if (try_get_property_strv(project, cb_JOBS, &value))
+	{
+		jobs = atoi(value.data);
+	}
+	else if (cb_current_context()->jobs >= 0)
+	{
+		jobs = cb_current_context()->jobs;
+	}
+	else if ((env = getenv("CB_JOBS")) != NULL && env[0])
+	{
+		jobs = atoi(env);
+	}
+
+	if (jobs == 0)
+	{
+		jobs = cb_get_processor_count();
+	}
+
+	return jobs > 0 ? jobs : 1;
+}
+
+/* Get the number of processes a plugin can start at the same time while checking the files of the project.
+   When several projects are baked at the same time, the processes of the other projects are taken into account. */
+CB_INTERNAL int
+cb_get_free_jobs(const cb_project_t* project)
+{
+	int jobs = cb_get_jobs(project);
+	int free_jobs = cb_current_context()->free_jobs;
+
+	if (free_jobs >= 0 && free_jobs < jobs)
+	{
+		jobs = free_jobs;
+	}
+
+	/* At least one process, otherwise nothing can be checked. */
+	return jobs > 0 ? jobs : 1;
+}
+
+CB_API const char*
+cb_bake_project(const char* project_name)
+{
+	return cb_bake_project_with(project_name, cb_toolchain_get());
+}
+
+CB_API const char*
+cb_bake(void)
+{
+	cb_project_t* p = cb_current_project();
+	return cb_bake_project_with(p->name.data, cb_toolchain_get());
+}
+
+CB_API const char*
+cb_bake_with(cb_toolchain_t toolchain)
+{
+	cb_project_t* p = cb_current_project();
+	return cb_bake_project_with(p->name.data, toolchain);
+}
+
+/* Projects sorted so that linked projects come before the projects linking them. */
+typedef struct cb_project_list cb_project_list;
+struct cb_project_list {
+	cb_darrT(cb_project_t*) sorted;
+	cb_darrT(cb_project_t*) visiting; /* Projects whose linked projects are being added, to detect cycles. */
+};
+
+CB_INTERNAL cb_bool
+cb_project_array_contains(cb_project_t** projects, cb_size count, const cb_project_t* project)
+{
+	cb_size i = 0;
+	for (i = 0; i < count; i += 1)
+	{
+		if (projects[i] == project)
+		{
+			return cb_true;
+		}
+	}
+	return cb_false;
+}
+
+/* Add the linked projects of 'project' then 'project' itself. Returns false if a linked project does not exist or if projects link each other. */
+CB_INTERNAL cb_bool
+cb_project_list_add(cb_project_list* list, cb_project_t* project)
+{
+	cb_kv_range range = { 0 };
+	cb_kv current = { 0 };
+	cb_project_t* linked_project = NULL;
+
+	if (cb_project_array_contains(list->sorted.darr.data, cb_darrT_size(&list->sorted), project))
+	{
+		return cb_true;
+	}
+
+	if (cb_project_array_contains(list->visiting.darr.data, cb_darrT_size(&list->visiting), project))
+	{
+		cb_log_error("Project '%s' links itself through its linked projects.", project->name.data);
+		return cb_false;
+	}
+
+	cb_darrT_push_back(&list->visiting, project);
+
+	range = cb_mmap_get_range_str(&project->mmap, cb_LINK_PROJECTS);
+	while (cb_mmap_range_get_next(&range, &current))
+	{
+		if (!cb_try_find_project_by_name(current.u.strv, &linked_project))
+		{
+			cb_log_error("Project '" CB_STRV_FMT "' linked by '%s' does not exist.", CB_STRV_ARG(current.u.strv), project->name.data);
+			return cb_false;
+		}
+
+		if (!cb_project_list_add(list, linked_project))
+		{
+			return cb_false;
+		}
+	}
+
+	list->visiting.darr.size -= 1;
+	cb_darrT_push_back(&list->sorted, project);
+	return cb_true;
+}
+
+/* Bake the projects in order. Returns false if one of them could not be baked.
+   'last_artefact' is optional and receives the result of the last project. */
+CB_INTERNAL cb_bool
+cb_bake_sorted_projects(cb_toolchain_t* tc, cb_project_t* projects[], cb_size count, const char** last_artefact)
+{
+	cb_context* ctx = cb_current_context();
+	cb_project_t* current_project = ctx->current_project;
+	const char* artefact = NULL;
+	cb_size i = 0;
+
+#ifndef _WIN32
+	/* The gcc toolchain can bake several projects at the same time. */
+	if (tc->bake == cb_toolchain_gcc_bake)
+	{
+		return cb_gcc_bake_projects(tc, projects, count, last_artefact);
+	}
+#endif
+
+	for (i = 0; i < count; i += 1)
+	{
+		/* Plugins refer to the current project. */
+		ctx->current_project = projects[i];
+		artefact = tc->bake(tc, projects[i]->name.data);
+		if (!artefact)
+		{
+			break;
+		}
+	}
+
+	ctx->current_project = current_project;
+
+	if (last_artefact)
+	{
+		*last_artefact = artefact;
+	}
+
+	return i == count;
+}
+
+CB_API const char*
+cb_bake_graph_with(const char* project_name, cb_toolchain_t toolchain)
+{
+	cb_project_list list;
+	cb_project_t* project = NULL;
+	const char* artefact = NULL;
+
+	cb_trace_event event;
+
+	project = cb_find_project_by_name_str(project_name);
+	if (!project)
+	{
+		return NULL;
+	}
+
+	cb_trace_event_begin(&event, "bake", project_name, NULL);
+
+	cb_darrT_init(&list.sorted);
+	cb_darrT_init(&list.visiting);
+
+	if (cb_project_list_add(&list, project))
+	{
+		cb_bake_sorted_projects(&toolchain, list.sorted.darr.data, cb_darrT_size(&list.sorted), &artefact);
+	}
+
+	cb_darrT_destroy(&list.sorted);
+	cb_darrT_destroy(&list.visiting);
+
+	cb_trace_event_end(&event);
+
+	return artefact;
+}
+
+CB_API const char*
+cb_bake_graph(const char* project_name)
+{
+	return cb_bake_graph_with(project_name, cb_toolchain_get());
+}
+
+/* Add all the projects, each project after the projects it links. */
+CB_INTERNAL cb_bool
+cb_project_list_add_all(cb_project_list* list)
+{
+	cb_kv_range range = { 0 };
+	cb_kv current = { 0 };
+
+	range = cb_mmap_get_range_all(&cb_current_context()->projects);
+	while (cb_mmap_range_get_next(&range, &current))
+	{
+		if (!cb_project_list_add(list, (cb_project_t*)current.u.ptr))
+		{
+			return cb_false;
+		}
+	}
+	return cb_true;
+}
+
+CB_API cb_bool
+cb_bake_all_with(cb_toolchain_t toolchain)
+{
+	cb_project_list list;
+	cb_bool result = cb_true;
+	cb_trace_event event;
+
+	cb_trace_event_begin(&event, "bake", "all", NULL);
+
+	cb_darrT_init(&list.sorted);
+	cb_darrT_init(&list.visiting);
+
+	result = cb_project_list_add_all(&list);
+
+	if (result)
+	{
+		result = cb_bake_sorted_projects(&toolchain, list.sorted.darr.data, cb_darrT_size(&list.sorted), NULL);
+	}
+
+	cb_darrT_destroy(&list.sorted);
+	cb_darrT_destroy(&list.visiting);
+
+	cb_trace_event_end(&event);
+
+	return result;
+}
+
+CB_API cb_bool
+cb_bake_all(void)
+{
+	return cb_bake_all_with(cb_toolchain_get());
+}
+
+CB_API cb_bool
+cb_export_compile_commands_with(const char* path, cb_toolchain_t toolchain)
+{
+	cb_project_list list;
+	cb_bool result = cb_true;
+
+	cb_darrT_init(&list.sorted);
+	cb_darrT_init(&list.visiting);
+
+	result = cb_project_list_add_all(&list);
+
+#ifdef _WIN32
+	cb_log_error("Compile commands can only be exported with the gcc toolchain.");
+	result = cb_false;
+#else
+	if (result && toolchain.bake != cb_toolchain_gcc_bake)
+	{
+		cb_log_error("Compile commands can only be exported with the gcc toolchain.");
+		result = cb_false;
+	}
+
+	if (result)
+	{
+		result = cb_gcc_export_compile_commands(&toolchain, path, list.sorted.darr.data, cb_darrT_size(&list.sorted));
+	}
+#endif
+
+	cb_darrT_destroy(&list.sorted);
+	cb_darrT_destroy(&list.visiting);
+
+	return result;
+}
+
+CB_API cb_bool
+cb_export_compile_commands(const char* path)
+{
+	return cb_export_compile_commands_with(path, cb_toolchain_get());
+}
+
+#ifndef CB_RESPONSE_FILE_THRESHOLD
+/* Arguments longer than this are given through a response file. Windows limits command lines to 32767 characters. */
+#define CB_RESPONSE_FILE_THRESHOLD (8 * 1024)
+#endif
+
+/* Write the content to a file, the file is overwritten. */
+CB_INTERNAL cb_bool
+cb_write_file(const char* path, const char* data, cb_size size)
+{
+	FILE* file = NULL;
+	cb_bool written = cb_false;
+
+#ifdef _WIN32
+	file = _wfopen(cb_utf8_to_utf16(path), L"wb");
+#else
+	file = fopen(path, "wb");
+#endif
+	if (!file)
+	{
+		cb_log_error("Could not open file '%s'", path);
+		return cb_false;
+	}
+
+	written = fwrite(data, 1, size, file) == size;
+	written = (fclose(file) == 0) && written;
+	if (!written)
+	{
+		cb_log_error("Could not write file '%s'", path);
+	}
+	return written;
+}
+
+/* Returns true if the file exists and its content is exactly 'data'. */
+CB_INTERNAL cb_bool
+cb_file_content_equals(const char* path, const char* data, cb_size size)
+{
+	FILE* file = NULL;
+	char buffer[4096];
+	cb_size read_size = 0;
+	cb_size offset = 0;
+	cb_bool equals = cb_true;
+
+#ifdef _WIN32
+	file = _wfopen(cb_utf8_to_utf16(path), L"rb");
+#else
+	file = fopen(path, "rb");
+#endif
+	if (!file)
+	{
+		return cb_false;
+	}
+
+	while (equals && (read_size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		equals = offset + read_size <= size && memcmp(buffer, data + offset, read_size) == 0;
+		offset += read_size;
+	}
+
+	fclose(file);
+	return equals && offset == size;
+}
+
+/* Returns true if both files exist and have the same content. */
+CB_INTERNAL cb_bool
+cb_files_equal(const char* left_path, const char* right_path)
+{
+	FILE* left = NULL;
+	FILE* right = NULL;
+	char left_buffer[4096];
+	char right_buffer[4096];
+	cb_size left_size = 0;
+	cb_size right_size = 0;
+	cb_bool equals = cb_false;
+
+#ifdef _WIN32
+	left = _wfopen(cb_utf8_to_utf16(left_path), L"rb");
+	right = _wfopen(cb_utf8_to_utf16(right_path), L"rb");
+#else
+	left = fopen(left_path, "rb");
+	right = fopen(right_path, "rb");
+#endif
+	if (left && right)
+	{
+		do
+		{
+			left_size = fread(left_buffer, 1, sizeof(left_buffer), left);
+			right_size = fread(right_buffer, 1, sizeof(right_buffer), right);
+			equals = left_size == right_size && memcmp(left_buffer, right_buffer, left_size) == 0;
+		} while (equals && left_size > 0);
+	}
+
+	if (left)
+	{
+		fclose(left);
+	}
+	if (right)
+	{
+		fclose(right);
+	}
+	return equals;
+}
+
+/* Returns 'args' if it's short enough to be given to the command line.
+   Otherwise 'args' are written to <output_dir><name>.rsp and "@<response file>" is returned, gcc, ar, link.exe and lib.exe all support it.
+   Returns NULL if the response file could not be written. */
+CB_INTERNAL const char*
+cb_get_args_or_response_file(const cb_dstr* args, const char* output_dir, const char* name)
+{
+	const char* path = NULL;
+
+	if (args->size < CB_RESPONSE_FILE_THRESHOLD)
+	{
+		return args->data;
+	}
+
+	path = cb_tmp_sprintf("%s%s.rsp", output_dir, name);
+	cb_log_debug("Writing arguments to response file '%s'", path);
+	if (!cb_write_file(path, args->data, args->size))
+	{
+		return NULL;
+	}
+
+	return cb_tmp_sprintf("\"@%s\"", path);
+}
+
+CB_INTERNAL const char*
+cb_get_output_directory(const cb_project_t* project, const cb_toolchain_t* tc)
+{
+	cb_strv out_dir;
+	if (try_get_property_strv(project, cb_OUTPUT_DIR, &out_dir))
+	{
+		return cb_path_get_absolute_dir(out_dir.data);
+	}
+	else
+	{
+		/* Get default output directory */
+		return cb_path_get_absolute_dir(cb_path_combine(tc->default_directory_base, project->name.data));
+	}
+}
+
+struct cb_process_handle {
+	const char* cmd;
+	const cb_cmd* args;       /* Used instead of 'cmd' if not NULL. */
+	const char* starting_directory;
+	cb_bool stdout_to_string; /* If stdout needs to be copied to a string. */
+	cb_bool stderr_to_string; /* If stderr needs to be copied to a string. */
+	cb_dstr stdout_string;    /* If stdout_to_string has been set to true. */
+	cb_dstr stderr_string;    /* If stderr_to_string has been set to true. */
+	int exit_code;
+	cb_bool running;          /* The process has been started but has not been waited on yet. */
+	cb_process_line_callback line_callback; /* Optional, called for each line of stdout/stderr. */
+	void* line_callback_user_data;
+	cb_size stdout_line_start; /* Beginning of the line not yet given to the line callback. */
+	cb_size stderr_line_start; /* Beginning of the line not yet given to the line callback. */
+	cb_trace_event trace;     /* Recorded from the start to the end of the process, see cb_process_set_trace. */
+#ifdef _WIN32
+	HANDLE process;
+	HANDLE thread;
+	HANDLE stdout_read;       /* Pipe (read) for stdout of the child process */
+	HANDLE stderr_read;       /* Pipe (read) for stderr of the child process */
+#else
+	pid_t pid;
+	int stdout_fd;            /* Pipe (read) for stdout of the child process */
+	int stderr_fd;            /* Pipe (read) for stderr of the child process */
+#endif
+};
+
+/* Start the process without waiting for it. Returns false if the process could not be created. */
+CB_INTERNAL cb_bool cb_process_start(cb_process_handle* handle);
+/* Check if the process exited and retrieve its exit code. Block until then if 'block' is true.
+   Returns true if the process is not running anymore. */
+CB_INTERNAL cb_bool cb_process_reap(cb_process_handle* handle, cb_bool block);
+
+CB_INTERNAL cb_process_handle*
+cb_create_process_handle(const char* cmd, const char* starting_directory)
+{
+	/* Allocated with CB_MALLOC instead of the tmp allocator since the process can outlive a cb_tmp_restore. */
+	cb_process_handle* handle = (cb_process_handle*)CB_MALLOC(sizeof(cb_process_handle));
+	CB_ASSERT(handle);
+	memset(handle, 0, sizeof(cb_process_handle));
+
+	handle->cmd = cmd;
+	handle->starting_directory = starting_directory;
+	handle->exit_code = -1;
+#ifndef _WIN32
+	handle->stdout_fd = -1;
+	handle->stderr_fd = -1;
+#endif
+
+	cb_dstr_init(&handle->stdout_string);
+	cb_dstr_init(&handle->stderr_string);
+
+	return handle;
+}
+
+/* Size of the buffer used to read the outputs of the child processes. */
+#define CB_PROCESS_READ_BUFFER_SIZE (64 * 1024)
+
+/* Append what has been read from stdout or stderr and give the complete lines to the line callback. */
+CB_INTERNAL void
+cb_process_append_output(cb_process_handle* handle, cb_bool is_stderr, const char* data, cb_size size)
+{
+	cb_dstr* str = is_stderr ? &handle->stderr_string : &handle->stdout_string;
+	cb_size* line_start = is_stderr ? &handle->stderr_line_start : &handle->stdout_line_start;
+	cb_size i = str->size;
+	cb_size line_size = 0;
+
+	cb_dstr_append_from(str, str->size, data, size);
+
+	if (!handle->line_callback)
+	{
+		return;
+	}
+
+	for (; i < str->size; i += 1)
+	{
+		if (str->data[i] == '\n')
+		{
+			line_size = i - *line_start;
+			/* Remove \r of \r\n. */
+			if (line_size > 0 && str->data[i - 1] == '\r')
+			{
+				line_size -= 1;
+			}
+			handle->line_callback(handle->line_callback_user_data, str->data + *line_start, line_size, is_stderr);
+			*line_start = i + 1;
+		}
+	}
+}
+
+/* Give the last line to the line callback if it does not end with a new line. */
+CB_INTERNAL void
+cb_process_flush_output(cb_process_handle* handle)
+{
+	if (!handle->line_callback)
+	{
+		return;
+	}
+
+	if (handle->stdout_line_start < handle->stdout_string.size)
+	{
+		handle->line_callback(handle->line_callback_user_data, handle->stdout_string.data + handle->stdout_line_start, handle->stdout_string.size - handle->stdout_line_start, cb_false);
+		handle->stdout_line_start = handle->stdout_string.size;
+	}
+
+	if (handle->stderr_line_start < handle->stderr_string.size)
+	{
+		handle->line_callback(handle->line_callback_user_data, handle->stderr_string.data + handle->stderr_line_start, handle->stderr_string.size - handle->stderr_line_start, cb_true);
+		handle->stderr_line_start = handle->stderr_string.size;
+	}
+}
+
+/* Describe the process in the trace, must be called before the process is started.
+   'project' and 'file' are optional, 'file' must outlive the process. */
+CB_INTERNAL void
+cb_process_set_trace(cb_process_handle* handle, const char* category, const cb_project_t* project, const char* file)
+{
+	handle->trace.category = category;
+	handle->trace.project_name = project ? project->name.data : NULL;
+	handle->trace.file = file;
+}
+
+/* Called when the process is started. */
+CB_INTERNAL void
+cb_process_trace_begin(cb_process_handle* handle)
+{
+	cb_trace_event* event = &handle->trace;
+	const char* name = NULL;
+	int lane = 0;
+
+	if (!current_ctx)
+	{
+		return;
+	}
+
+	current_ctx->stats.process_count += 1;
+
+	if (cb_trace_enabled())
+	{
+		/* Named after the file if there is one, the command otherwise. */
+		if (event->file)
+		{
+			name = event->file + strlen(event->file);
+			while (name > event->file && !cb_is_directory_separator(name[-1]))
+			{
+				name -= 1;
+			}
+		}
+		else
+		{
+			name = handle->args ? cb_cmd_at(handle->args, 0) : handle->cmd;
+		}
+
+		cb_trace_event_set_name(event, name, NULL);
+		lane = cb_trace_acquire_lane();
+	}
+
+	event->is_process = cb_true;
+	cb_trace_event_start(event, lane);
+}
+
+CB_INTERNAL cb_process_handle*
+cb_process_core(cb_process_handle* handle)
+{
+	if (cb_process_start(handle))
+	{
+		cb_process_reap(handle, cb_true);
+	}
+	return handle;
+}
+
+CB_API int
+cb_process(const char* cmd)
+{
+	return cb_process_in_directory(cmd, NULL);
+}
+
+CB_API int
+cb_process_in_directory(const char* cmd, const char* starting_directory)
+{
+	cb_process_handle* handle = cb_create_process_handle(cmd, starting_directory);
+	handle = cb_process_core(handle);
+	return cb_process_end(handle);
+}
+
+/* Same as cb_process_in_directory but the process is described in the trace. */
+CB_INTERNAL int
+cb_process_in_directory_traced(const char* cmd, const char* starting_directory, const char* category, const cb_project_t* project, const char* file)
+{
+	cb_process_handle* handle = cb_create_process_handle(cmd, starting_directory);
+	cb_process_set_trace(handle, category, project, file);
+	handle = cb_process_core(handle);
+	return cb_process_end(handle);
+}
+
+CB_API cb_process_handle*
+cb_process_to_string(const char* cmd, const char* starting_directory, cb_bool also_get_stderr)
+{
+	cb_process_handle* handle = cb_create_process_handle(cmd, starting_directory);
+
+	handle->stdout_to_string = cb_true;
+	handle->stderr_to_string = also_get_stderr;
+
+	return cb_process_core(handle);
+}
+
+CB_API cb_process_handle*
+cb_process_spawn(const char* cmd, const char* starting_directory)
+{
+	cb_process_handle* handle = cb_create_process_handle(cmd, starting_directory);
+	cb_process_start(handle);
+	return handle;
+}
+
+CB_API cb_process_handle*
+cb_process_spawn_to_string(const char* cmd, const char* starting_directory, cb_bool also_get_stderr)
+{
+	cb_process_handle* handle = cb_create_process_handle(cmd, starting_directory);
+
+	handle->stdout_to_string = cb_true;
+	handle->stderr_to_string = also_get_stderr;
+
+	cb_process_start(handle);
+	return handle;
+}
+
+CB_API cb_process_handle*
+cb_process_spawn_with_callback(const char* cmd, const char* starting_directory, cb_bool also_get_stderr, cb_process_line_callback callback, void* user_data)
+{
+	cb_process_handle* handle = cb_create_process_handle(cmd, starting_directory);
+
+	handle->stdout_to_string = cb_true;
+	handle->stderr_to_string = also_get_stderr;
+	handle->line_callback = callback;
+	handle->line_callback_user_data = user_data;
+
+	cb_process_start(handle);
+	return handle;
+}
+
+CB_API cb_bool
+cb_process_poll(cb_process_handle* handle)
+{
+	return cb_process_reap(handle, cb_false);
+}
+
+CB_API int
+cb_process_wait(cb_process_handle* handle)
+{
+	cb_process_reap(handle, cb_true);
+	return handle->exit_code;
+}
+
+CB_API int
+cb_run(const char* executable_path)
+{
+	return cb_process_in_directory(cb_tmp_sprintf("\"%s\"", executable_path), NULL);
+}
+
+CB_API const char*
+cb_process_stdout_string(cb_process_handle* handle)
+{
+	return handle->stdout_string.data;
+}
+
+CB_API const char*
+cb_process_stderr_string(cb_process_handle* handle)
+{
+	return handle->stderr_string.data;
+}
+
+CB_API int
+cb_process_end(cb_process_handle* handle)
+{
+	int exit_code = -1;
+
+	/* Make sure the process is not left behind as a zombie. */
+	cb_process_reap(handle, cb_true);
+
+	exit_code = handle->exit_code;
+
+	handle->trace.exit_code = exit_code;
+	cb_trace_event_end(&handle->trace);
+
+	cb_dstr_destroy(&handle->stdout_string);
+	cb_dstr_destroy(&handle->stderr_string);
+	CB_FREE(handle);
+
+	return exit_code;
+}
+
+/* space or tab */
+CB_INTERNAL cb_bool cb_is_space(char c) { return c == ' ' || c == '\t'; }
+
+CB_INTERNAL cb_bool
+cb_is_end_of_quote(const char* str, char quote_type)
+{
+	return *str != '\0'
+		&& *str == quote_type
+		&& (str[1] == '\0' || cb_is_space(str[1]));
+
+}
+/* Parse arguments, space is a separator and everything between <space or begining of string><quote> and <quote><space or end of string>
+* Quotes can be double quotes or simple quotes.
+a b c   => 3 arguments a b c
+abc     => 1 argument "abc"
+a "b" c => 3 arguments a b c;
+a"b"c   => 1 argument a"b"c
+"a"b"c" => 1 argument a"b"c
+*/
+CB_INTERNAL const char*
+cb_get_next_arg(const char* str, cb_strv* sv)
+{
+	sv->data = (char*)str;
+	sv->size = 0;
+	if (str == NULL || *str == '\0')
+		return NULL;
+		
+	while (*str != '\0')
+	{
+		/* Skip spaces */
+		while (*str != '\0' && cb_is_space(*str))
+			str += 1;
+
+		/* Return early if end of string */
+		if (*str == '\0') 
+			return sv->size > 0 ? str: NULL;
+
+		/* Handle quotes */
+		if (*str == '\'' || *str == '\"')
+		{
+			const char* quote = str;
+			str += 1; /* skip quote */
+			
+			/* Return early if end of string */
+			if (*str == '\0')
+				return sv->size > 0 ? str : NULL;
+
+			/* Quote next the previous one so it's an empty content, we look for another item */
+			if (cb_is_end_of_quote(str, *quote))
+			{
+				str += 1; /* Skip quote */
+				continue;
+			}
+
+			sv->data = (char*)str; /* The next argument will begin right after the quote */
+			/* Skip everything until the next unescaped quote */
+			while (*str != '\0' && !cb_is_end_of_quote(str, *quote))
+				str += 1;
+
+			/* Either it's the end of the quoted string, either we reached the null terminating string */
+			sv->size = (str - quote) - 1;
+
+			/* Eat trailing quote so that next argument can start with space */
+			while (*str != '\0' && *str == *quote)
+				str += 1;
+
+			return str;
+		}
+		else /* is char */
+		{
+			const char* ch = str;
+			while (*str != '\0' && !cb_is_space(*str))
+				str += 1;
+
+			sv->data = (char*)ch; /* remove quote */
+			sv->size = str - ch;
+			return str;
+		}
+	}
+	return NULL;
+}
+
+/* #cmd */
+
+struct cb_cmd {
+	cb_dstr buffer;            /* Null-terminated arguments stored one after the other. */
+	cb_darrT(cb_size) offsets; /* Offset of each argument in the buffer. */
+};
+
+CB_API cb_cmd*
+cb_cmd_create(void)
+{
+	/* Allocated with CB_MALLOC instead of the tmp allocator since a command can outlive a cb_tmp_restore. */
+	cb_cmd* cmd = (cb_cmd*)CB_MALLOC(sizeof(cb_cmd));
+	CB_ASSERT(cmd);
+	cb_dstr_init(&cmd->buffer);
+	cb_darrT_init(&cmd->offsets);
+	return cmd;
+}
+
+CB_API void
+cb_cmd_destroy(cb_cmd* cmd)
+{
+	if (!cmd)
+	{
+		return;
+	}
+	cb_dstr_destroy(&cmd->buffer);
+	cb_darrT_destroy(&cmd->offsets);
+	CB_FREE(cmd);
+}
+
+CB_API void
+cb_cmd_clear(cb_cmd* cmd)
+{
+	cb_dstr_clear(&cmd->buffer);
+	cmd->offsets.darr.size = 0;
+}
+
+CB_INTERNAL void
+cb_cmd_push_strv(cb_cmd* cmd, cb_strv arg)
+{
+	/* Reserve the null-terminating char of the argument and the one of the buffer. */
+	cb_dstr__grow_if_needed(&cmd->buffer, cmd->buffer.size + arg.size + 1);
+	cb_darrT_push_back(&cmd->offsets, cmd->buffer.size);
+	cb_dstr_append_from(&cmd->buffer, cmd->buffer.size, arg.data, arg.size);
+	/* Keep the null-terminating char as part of the argument. */
+	cmd->buffer.size += 1;
+}
+
+CB_API void
+cb_cmd_push(cb_cmd* cmd, const char* arg)
+{
+	cb_cmd_push_strv(cmd, cb_strv_make_str(arg));
+}
+
+CB_API void
+cb_cmd_push_f(cb_cmd* cmd, const char* fmt, ...)
+{
+	va_list args;
+
+	cb_dstr__grow_if_needed(&cmd->buffer, cmd->buffer.size + 1);
+	cb_darrT_push_back(&cmd->offsets, cmd->buffer.size);
+
+	va_start(args, fmt);
+	cb_dstr_append_from_fv(&cmd->buffer, cmd->buffer.size, fmt, args);
+	va_end(args);
+
+	/* Make sure there is room for the next null-terminating char before including this one in the argument. */
+	cb_dstr__grow_if_needed(&cmd->buffer, cmd->buffer.size + 1);
+	cmd->buffer.size += 1;
+	cmd->buffer.data[cmd->buffer.size] = '\0';
+}
+
+CB_API void
+cb_cmd_push_command_line(cb_cmd* cmd, const char* str)
+{
+	cb_strv arg = { 0 };
+	while ((str = cb_get_next_arg(str, &arg)) != NULL)
+	{
+		cb_cmd_push_strv(cmd, arg);
+	}
+}
+
+CB_API void
+cb_cmd_append(cb_cmd* cmd, const cb_cmd* other)
+{
+	cb_size i = 0;
+	cb_size base = cmd->buffer.size;
+
+	if (other->buffer.size == 0)
+	{
+		return;
+	}
+
+	cb_dstr_append_from(&cmd->buffer, base, other->buffer.data, other->buffer.size);
+
+	for (i = 0; i < cb_darrT_size(&other->offsets); i += 1)
+	{
+		cb_darrT_push_back(&cmd->offsets, base + cb_darrT_at(&other->offsets, i));
+	}
+}
+
+CB_API cb_size
+cb_cmd_count(const cb_cmd* cmd)
+{
+	return cb_darrT_size(&cmd->offsets);
+}
+
+CB_API const char*
+cb_cmd_at(const cb_cmd* cmd, cb_size index)
+{
+	CB_ASSERT(index < cb_cmd_count(cmd));
+	return cmd->buffer.data + cb_darrT_at(&cmd->offsets, index);
+}
+
+/* Append 'arg' quoted the way CommandLineToArgvW expects it. Arguments without space or quote are kept as they are. */
+CB_INTERNAL void
+cb_cmd_append_quoted_arg(cb_dstr* str, const char* arg)
+{
+	cb_size backslash_count = 0;
+	cb_size i = 0;
+
+	if (arg[0] != '\0' && strpbrk(arg, " \t\"") == NULL)
+	{
+		cb_dstr_append_str(str, arg);
+		return;
+	}
+
+	cb_dstr_append_str(str, "\"");
+	for (; *arg != '\0'; arg += 1)
+	{
+		if (*arg == '\\')
+		{
+			backslash_count += 1;
+			continue;
+		}
+
+		/* Backslashes are only special when they precede a quote. */
+		if (*arg == '"')
+		{
+			backslash_count = backslash_count * 2 + 1;
+		}
+
+		for (i = 0; i < backslash_count; i += 1)
+		{
+			cb_dstr_append_str(str, "\\");
+		}
+		backslash_count = 0;
+
+		cb_dstr_append_from(str, str->size, arg, 1);
+	}
+
+	/* Backslashes before the closing quote. */
+	for (i = 0; i < backslash_count * 2; i += 1)
+	{
+		cb_dstr_append_str(str, "\\");
+	}
+	cb_dstr_append_str(str, "\"");
+}
+
+CB_API const char*
+cb_cmd_to_string(const cb_cmd* cmd)
+{
+	cb_dstr str;
+	const char* result = NULL;
+	cb_size i = 0;
+
+	cb_dstr_init(&str);
+
+	for (i = 0; i < cb_cmd_count(cmd); i += 1)
+	{
+		if (i > 0)
+		{
+			cb_dstr_append_str(&str, " ");
+		}
+		cb_cmd_append_quoted_arg(&str, cb_cmd_at(cmd, i));
+	}
+
+	result = cb_tmp_strv_to_str(cb_strv_make(str.data, str.size));
+	cb_dstr_destroy(&str);
+	return result;
+}
+
+CB_API cb_process_handle*
+cb_cmd_spawn(const cb_cmd* cmd, const char* starting_directory)
+{
+	cb_process_handle* handle = cb_create_process_handle(NULL, starting_directory);
+	handle->args = cmd;
+	cb_process_start(handle);
+	return handle;
+}
+
+CB_API cb_process_handle*
+cb_cmd_spawn_to_string(const cb_cmd* cmd, const char* starting_directory, cb_bool also_get_stderr)
+{
+	cb_process_handle* handle = cb_create_process_handle(NULL, starting_directory);
+	handle->args = cmd;
+	handle->stdout_to_string = cb_true;
+	handle->stderr_to_string = also_get_stderr;
+	cb_process_start(handle);
+	return handle;
+}
+
+CB_API int
+cb_cmd_run(const cb_cmd* cmd, const char* starting_directory)
+{
+	cb_process_handle* handle = cb_create_process_handle(NULL, starting_directory);
+	handle->args = cmd;
+	handle = cb_process_core(handle);
+	return cb_process_end(handle);
+}
+
+#if _WIN32
+
+/* #process */
+
+CB_INTERNAL void
+cb_process_read_pipe(cb_process_handle* handle, HANDLE pipe, cb_bool is_stderr)
+{
+	DWORD bytes_available = 0;
+	DWORD byte_read_from_buffer = 0;
+	static CB_THREAD char process_output_buffer[CB_PROCESS_READ_BUFFER_SIZE];
+
+	/* Only read what is available so that it never blocks. */
+	while (PeekNamedPipe(pipe, NULL, 0, NULL, &bytes_available, NULL)
+		&& bytes_available > 0)
+	{
+		if (!ReadFile(pipe, process_output_buffer, sizeof(process_output_buffer), &byte_read_from_buffer, NULL)
+			|| byte_read_from_buffer == 0)
+		{
+			break;
+		}
+		cb_process_append_output(handle, is_stderr, process_output_buffer, byte_read_from_buffer);
+	}
+}
+
+CB_INTERNAL cb_bool
+cb_process_start(cb_process_handle* handle)
+{
+	HANDLE process_stdout_write = NULL; /* Pipe (write) for stdout of the child process */
+	HANDLE process_stdout_read = NULL;  /* Pipe (read) for stdout of the child process */
+	HANDLE process_stderr_write = NULL; /* Pipe (write) for stderr of the child process */
+	HANDLE process_stderr_read = NULL;  /* Pipe (read) for stderr of the child process */
+	SECURITY_ATTRIBUTES saAttr;         /* To create the pipes. */
+
+	BOOL handles_inheritance = 0;
+
+	const char* cmd = handle->args ? cb_cmd_to_string(handle->args) : handle->cmd;
+	wchar_t* cmd_w = cb_utf8_to_utf16(cmd);
+	wchar_t* starting_directory_w = NULL;
+
+	cb_process_trace_begin(handle);
+	cb_log_debug("Running process '%s'", cmd);
+	if (handle->starting_directory && handle->starting_directory[0])
+	{
+		starting_directory_w = cb_utf8_to_utf16(handle->starting_directory);
+		cb_log_debug("Subprocess started in directory '%s'", handle->starting_directory);
+	}
+
+	/* Ensure that everything is written into the outputs before creating a new process that will also write in those outputs */
+	fflush(stdout);
+	fflush(stderr);
+
+	STARTUPINFOW si;
+	PROCESS_INFORMATION pi;
+
+	ZeroMemory(&si, sizeof(si));
+	si.cb = sizeof(si);
+
+	if (handle->stdout_to_string
+		|| handle->stderr_to_string)
+	{
+		handles_inheritance = TRUE;
+
+		si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+		si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+		si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+
+		si.dwFlags |= STARTF_USESTDHANDLES;
+			
+		saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
+		saAttr.bInheritHandle = TRUE;
+		saAttr.lpSecurityDescriptor = NULL;
+
+		if (handle->stdout_to_string)
+		{
+			/* Create a pipe for the child process's stdout. */
+			if (!CreatePipe(&process_stdout_read, &process_stdout_write, &saAttr, 0)
+				|| !SetHandleInformation(process_stdout_read, HANDLE_FLAG_INHERIT, 0))
+			{
+				cb_log_error("Could not create pipe for stdout.");
+				exit(1);
+			}
+
+			si.hStdOutput = process_stdout_write;
+		}
+
+		if (handle->stderr_to_string)
+		{
+			/* Create a pipe for the child process's stderr. */
+			if (!CreatePipe(&process_stderr_read, &process_stderr_write, &saAttr, 0)
+				|| !SetHandleInformation(process_stderr_read, HANDLE_FLAG_INHERIT, 0))
+			{
+				cb_log_error("Could not create pipe for stderr.");
+				exit(1);
+			}
+
+			si.hStdError = process_stderr_write;
+		}
+	}
+
+	ZeroMemory(&pi, sizeof(pi));
+
+	/* Start the child process.
+	*  NOTE: we use CreateProcessW because CreateProcessA (with /utf-8) cannot create path with unicode.
+	*/
+	if (!CreateProcessW(
+		NULL,                 /* No module name (use command line) */
+		cmd_w,                /* Command line */
+		NULL,                 /* Process handle not inheritable */
+		NULL,                 /* Thread handle not inheritable */ 
+		handles_inheritance,  /* Set handle inheritance */
+		0,                    /* No creation flags */
+		NULL,                 /* Use parent's environment block */
+		starting_directory_w, /* Use parent's starting directory */
+		&si,                  /* Pointer to STARTUPINFO structure */
+		&pi)                  /* Pointer to PROCESS_INFORMATION structure */
+		)
+	{
+		cb_log_debug("CreateProcessW failed: %d", GetLastError());
+		/* No need to close handles since the process creation failed */
+		return cb_false;
+	}
+
+	/* Close the write ends of the pipes since they will not be used in the parent process. */
+	if (handle->stdout_to_string)
+	{
+		CloseHandle(process_stdout_write);
+	}
+
+	if (handle->stderr_to_string)
+	{
+		CloseHandle(process_stderr_write);
+	}
+
+	handle->process = pi.hProcess;
+	handle->thread = pi.hThread;
+	handle->trace.process_id = (unsigned long)pi.dwProcessId;
+	handle->stdout_read = process_stdout_read;
+	handle->stderr_read = process_stderr_read;
+	handle->running = cb_true;
+
+	return cb_true;
+}
+
+CB_INTERNAL cb_bool
+cb_process_reap(cb_process_handle* handle, cb_bool block)
+{
+	DWORD exit_code = (DWORD)-1;
+	BOOL child_running = 0;
+	cb_bool has_pipes = handle->stdout_to_string || handle->stderr_to_string;
+
+	if (!handle->running)
+	{
+		return cb_true;
+	}
+
+	for (;;)
+	{
+		/* When outputs are captured we need to wake up regularly to empty the pipes, otherwise the child could be blocked. */
+		DWORD timeout = !block ? 0 : (has_pipes ? 10 : INFINITE);
+
+		child_running =
+			WaitForSingleObject(handle->process, timeout) == WAIT_TIMEOUT;
+
+		if (handle->stdout_to_string)
+		{
+			cb_process_read_pipe(handle, handle->stdout_read, cb_false);
+		}
+
+		if (handle->stderr_to_string)
+		{
+			cb_process_read_pipe(handle, handle->stderr_read, cb_true);
+		}
+
+		if (!child_running)
+		{
+			break;
+		}
+
+		if (!block)
+		{
+			return cb_false;
+		}
+	}
+
+	if (GetExitCodeProcess(handle->process, &exit_code))
+	{
+		if (exit_code != 0)
+		{
+			cb_log_debug("Command exited with exit code %lu", exit_code);
+		}
+	}
+	else
+	{
+		cb_log_error("Could not get process exit code: %lu", GetLastError());
+	}
+
+	cb_process_flush_output(handle);
+
+	if (handle->stdout_to_string)
+	{
+		CloseHandle(handle->stdout_read);
+	}
+
+	if (handle->stderr_to_string)
+	{
+		CloseHandle(handle->stderr_read);
+	}
+
+	/* Close process and thread handles. */
+	CloseHandle(handle->process);
+	CloseHandle(handle->thread);
+
+	handle->exit_code = exit_code;
+	handle->running = cb_false;
+	return cb_true;
+}
+
+CB_API int
+cb_process_wait_any(cb_process_handle* handles[], int count)
+{
+	HANDLE waitables[MAXIMUM_WAIT_OBJECTS];
+	DWORD waitable_count = 0;
+	cb_bool has_pipes = cb_false;
+	int i = 0;
+
+	for (;;)
+	{
+		waitable_count = 0;
+		has_pipes = cb_false;
+
+		for (i = 0; i < count; i += 1)
+		{
+			if (!handles[i])
+			{
+				continue;
+			}
+
+			if (cb_process_reap(handles[i], cb_false))
+			{
+				return i;
+			}
+
+			if (waitable_count < MAXIMUM_WAIT_OBJECTS)
+			{
+				waitables[waitable_count] = handles[i]->process;
+				waitable_count += 1;
+			}
+			has_pipes = has_pipes || handles[i]->stdout_to_string || handles[i]->stderr_to_string;
+		}
+
+		if (waitable_count == 0)
+		{
+			return -1;
+		}
+
+		/* Processes beyond MAXIMUM_WAIT_OBJECTS are only checked when waking up. */
+		WaitForMultipleObjects(waitable_count, waitables, FALSE, (has_pipes || (int)waitable_count < count) ? 10 : INFINITE);
+	}
+}
+
+#else
+
+#define CB_INVALID_PROCESS (-1)
+
+CB_INTERNAL pid_t
+cb_fork_process(char* args[], cb_process_handle* handle, int stdout_pfd[2], int stderr_pfd[2])
+{
+	pid_t pid = fork();
+
+	switch (pid)
+	{
+	case -1: /* Error */
+		cb_log_error("Could not fork child process: %s", strerror(errno));
+		return CB_INVALID_PROCESS;
+	case 0:  /* Child process */
+	{
+		if (handle->stdout_to_string)
+		{
+			dup2(stdout_pfd[1], STDOUT_FILENO);
+			/* Close both sides of the pipe in the child */
+			close(stdout_pfd[0]);
+			close(stdout_pfd[1]);
+		}
+		if (handle->stderr_to_string)
+		{
+			dup2(stderr_pfd[1], STDERR_FILENO);
+			/* Close both sides of the pipe in the child */
+			close(stderr_pfd[0]);
+			close(stderr_pfd[1]);
+		}
+
+		/* Change directory in the fork */
+		if (handle->starting_directory
+			&& handle->starting_directory[0]
+			&& chdir(handle->starting_directory) < 0) {
+			cb_log_error("Could not change directory to '%s': %s", handle->starting_directory, strerror(errno));
+			/* Never return from the child, it would continue to run the code of the parent. */
+			_exit(127);
+		}
+		execvp(args[0], args);
+		cb_log_error("Could not exec child process: %s", strerror(errno));
+		_exit(127);
+		break;
+	}
+	default:
+		/* Do nothing for parent process */
+		break;
+	}
+
+	return pid;
+}
+
+#ifdef CB_USE_POSIX_SPAWN
+
+extern char** environ;
+
+#if defined(CB_USE_POSIX_SPAWN_CHDIR) && !defined(__USE_GNU)
+/* Only declared by spawn.h when _GNU_SOURCE is defined before any include. */
+extern int posix_spawn_file_actions_addchdir_np(posix_spawn_file_actions_t* actions, const char* path);
+#endif
+
+CB_INTERNAL pid_t
+cb_posix_spawn_process(char* args[], cb_process_handle* handle, int stdout_pfd[2], int stderr_pfd[2])
+{
+	pid_t pid = CB_INVALID_PROCESS;
+	posix_spawn_file_actions_t actions;
+	int error = 0;
+
+	if ((error = posix_spawn_file_actions_init(&actions)) != 0)
+	{
+		cb_log_error("Could not initialize spawn actions: %s", strerror(error));
+		return CB_INVALID_PROCESS;
+	}
+
+	/* Same as what's done in the child process of cb_fork_process. */
+	if (handle->stdout_to_string)
+	{
+		posix_spawn_file_actions_adddup2(&actions, stdout_pfd[1], STDOUT_FILENO);
+		posix_spawn_file_actions_addclose(&actions, stdout_pfd[0]);
+		posix_spawn_file_actions_addclose(&actions, stdout_pfd[1]);
+	}
+	if (handle->stderr_to_string)
+	{
+		posix_spawn_file_actions_adddup2(&actions, stderr_pfd[1], STDERR_FILENO);
+		posix_spawn_file_actions_addclose(&actions, stderr_pfd[0]);
+		posix_spawn_file_actions_addclose(&actions, stderr_pfd[1]);
+	}
+#ifdef CB_USE_POSIX_SPAWN_CHDIR
+	if (handle->starting_directory && handle->starting_directory[0])
+	{
+		posix_spawn_file_actions_addchdir_np(&actions, handle->starting_directory);
+	}
+#endif
+
+	error = posix_spawnp(&pid, args[0], &actions, NULL, args, environ);
+	if (error != 0)
+	{
+		cb_log_error("Could not spawn child process: %s", strerror(error));
+		pid = CB_INVALID_PROCESS;
+	}
+
+	posix_spawn_file_actions_destroy(&actions);
+	return pid;
+}
+
+#endif
+
+/* Create the child process with posix_spawn when possible, fork otherwise. */
+CB_INTERNAL pid_t
+cb_spawn_process(char* args[], cb_process_handle* handle, int stdout_pfd[2], int stderr_pfd[2])
+{
+#ifdef CB_USE_POSIX_SPAWN
+#ifndef CB_USE_POSIX_SPAWN_CHDIR
+	/* Cannot change the directory of the child process with posix_spawn. */
+	if (!handle->starting_directory || !handle->starting_directory[0])
+#endif
+	{
+		return cb_posix_spawn_process(args, handle, stdout_pfd, stderr_pfd);
+	}
+#endif
+	return cb_fork_process(args, handle, stdout_pfd, stderr_pfd);
+}
+
+/* Read what is currently available in the pipe of stdout or stderr. The pipe is closed once the end of file is reached. */
+CB_INTERNAL void
+cb_process_read_pipe(cb_process_handle* handle, cb_bool is_stderr)
+{
+	int* fd = is_stderr ? &handle->stderr_fd : &handle->stdout_fd;
+	ssize_t bytes_read = 0; /* Byte read count when we retrieve the output of the child process. */
+	static CB_THREAD char buffer[CB_PROCESS_READ_BUFFER_SIZE]; /* Buffer to get the output of the child process. */
+
+	/* Read output of the child process from the read file description of the pipe.
+	   The pipe is non-blocking so this only reads what is currently available. */
+	while (*fd >= 0)
+	{
+		bytes_read = read(*fd, buffer, sizeof(buffer));
+
+		if (bytes_read > 0)
+		{
+			cb_process_append_output(handle, is_stderr, buffer, (cb_size)bytes_read);
+		}
+		else if (bytes_read == 0)
+		{
+			/* Close the read pipe since we read all the information from it. */
+			close(*fd);
+			*fd = -1;
+		}
+		else if (errno != EINTR)
+		{
+			/* Nothing to read for now. */
+			break;
+		}
+	}
+}
+
+CB_INTERNAL void
+cb_process_read_pipes(cb_process_handle* handle)
+{
+	cb_process_read_pipe(handle, cb_false);
+	cb_process_read_pipe(handle, cb_true);
+}
+
+/* Add the pipes still opened to the poll list. Returns the new number of items. */
+CB_INTERNAL int
+cb_process_add_pollfds(cb_process_handle* handle, struct pollfd* fds, int fd_count)
+{
+	if (handle->stdout_fd >= 0)
+	{
+		fds[fd_count].fd = handle->stdout_fd;
+		fds[fd_count].events = POLLIN;
+		fds[fd_count].revents = 0;
+		fd_count += 1;
+	}
+
+	if (handle->stderr_fd >= 0)
+	{
+		fds[fd_count].fd = handle->stderr_fd;
+		fds[fd_count].events = POLLIN;
+		fds[fd_count].revents = 0;
+		fd_count += 1;
+	}
+	return fd_count;
+}
+
+/* Time in milliseconds to wait for outputs before checking that the child process is still running.
+   The pipes could be kept opened by a process created by the child process. */
+#define CB_PROCESS_POLL_TIMEOUT_MS 100
+
+/* Self-pipe written by the SIGCHLD handler, its read end is polled with the outputs of the child processes
+   to wake up as soon as one of them exits. Created before the first child process, -1 if it could not be created. */
+static int cb_sigchld_pipe[2] = { -1, -1 };
+static struct sigaction cb_sigchld_previous_action;
+static cb_bool cb_sigchld_initialized = cb_false;
+
+CB_INTERNAL void
+cb_sigchld_handler(int signal_number, siginfo_t* info, void* context)
+{
+	int saved_errno = errno;
+	char c = 0;
+
+	/* The pipe is non-blocking, if it's full the poll will wake up anyway. */
+	if (write(cb_sigchld_pipe[1], &c, 1) < 0) { /* Nothing to do. */ }
+
+	/* Keep the handler installed by the user working. */
+	if (cb_sigchld_previous_action.sa_flags & SA_SIGINFO)
+	{
+		cb_sigchld_previous_action.sa_sigaction(signal_number, info, context);
+	}
+	else if (cb_sigchld_previous_action.sa_handler != SIG_DFL && cb_sigchld_previous_action.sa_handler != SIG_IGN)
+	{
+		cb_sigchld_previous_action.sa_handler(signal_number);
+	}
+
+	errno = saved_errno;
+}
+
+CB_INTERNAL void
+cb_sigchld_pipe_init(void)
+{
+	struct sigaction action;
+	int i = 0;
+
+	if (cb_sigchld_initialized)
+	{
+		return;
+	}
+	cb_sigchld_initialized = cb_true;
+
+	if (pipe(cb_sigchld_pipe) == -1)
+	{
+		cb_log_warning("Could not create the pipe notified when a child process exits: '%s'", strerror(errno));
+		cb_sigchld_pipe[0] = -1;
+		cb_sigchld_pipe[1] = -1;
+		return;
+	}
+
+	for (i = 0; i < 2; i += 1)
+	{
+		fcntl(cb_sigchld_pipe[i], F_SETFL, O_NONBLOCK);
+		fcntl(cb_sigchld_pipe[i], F_SETFD, FD_CLOEXEC);
+	}
+
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = cb_sigchld_handler;
+	action.sa_flags = SA_SIGINFO | SA_RESTART | SA_NOCLDSTOP;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGCHLD, &action, &cb_sigchld_previous_action) == -1)
+	{
+		cb_log_warning("Could not install the SIGCHLD handler: '%s'", strerror(errno));
+		close(cb_sigchld_pipe[0]);
+		close(cb_sigchld_pipe[1]);
+		cb_sigchld_pipe[0] = -1;
+		cb_sigchld_pipe[1] = -1;
+	}
+}
+
+CB_INTERNAL void
+cb_sigchld_pipe_destroy(void)
+{
+	if (cb_sigchld_pipe[0] >= 0)
+	{
+		sigaction(SIGCHLD, &cb_sigchld_previous_action, NULL);
+		close(cb_sigchld_pipe[0]);
+		close(cb_sigchld_pipe[1]);
+		cb_sigchld_pipe[0] = -1;
+		cb_sigchld_pipe[1] = -1;
+	}
+	cb_sigchld_initialized = cb_false;
+}
+
+/* Empty the self-pipe, called before checking the child processes. */
+CB_INTERNAL void
+cb_sigchld_pipe_drain(void)
+{
+	char buffer[64];
+
+	if (cb_sigchld_pipe[0] < 0)
+	{
+		return;
+	}
+
+	while (read(cb_sigchld_pipe[0], buffer, sizeof(buffer)) > 0)
+	{
+		/* Read until the pipe is empty. */
+	}
+}
+
+CB_INTERNAL cb_bool
+cb_process_start(cb_process_handle* handle)
+{
+	cb_darrT(const char*) args;
+	cb_strv arg; /* Current argument */
+	const char* cmd_cursor = handle->cmd; /* Current position in the string command */
+	cb_size i = 0;
+	pid_t pid = CB_INVALID_PROCESS;
+	cb_bool result = cb_false;
+
+	int stdout_pfd[2] = { -1, -1 };     /* Pipe file descriptor for stdout. */
+	int stderr_pfd[2] = { -1, -1 };     /* Pipe file descriptor for stderr. */
+
+	cb_darrT_init(&args);
+
+	/* The handler must exist before the child process, its exit could be missed otherwise. */
+	cb_sigchld_pipe_init();
+
+	cb_process_trace_begin(handle);
+	if (cb_log_level <= cb_log_level_DEBUG)
+	{
+		cb_log_debug("Running process '%s'", handle->args ? cb_cmd_to_string(handle->args) : handle->cmd);
+	}
+	if (handle->starting_directory && handle->starting_directory[0])
+	{
+		cb_log_debug("Subprocess started in directory '%s'", handle->starting_directory);
+	}
+
+	/* Ensure that everything is written into the outputs before creating a new process that will also write in those outputs */
+	fflush(stdout);
+	fflush(stderr);
+
+	if (handle->args)
+	{
+		/* Arguments are already split, no need to copy them. */
+		for (i = 0; i < cb_cmd_count(handle->args); i += 1)
+		{
+			cb_darrT_push_back(&args, cb_cmd_at(handle->args, i));
+		}
+	}
+	else
+	{
+		/* Split args from the command line and add it to the array. */
+		while ((cmd_cursor = cb_get_next_arg(cmd_cursor, &arg)) != NULL)
+		{
+			cb_darrT_push_back(&args, cb_tmp_strv_to_str(arg));
+		}
+	}
+
+	if (args.darr.size == 0)
+	{
+		cb_log_error("Could not run empty command.");
+		cb_set_and_goto(result, cb_false, cleanup);
+	}
+
+	/* Last value of the args should be a null value */
+	cb_darrT_push_back(&args, NULL);
+
+	if (handle->stdout_to_string)
+	{
+		if (pipe(stdout_pfd) == -1)
+		{
+			cb_log_error("Pipe creation failed for stdout_pfd.");
+			cb_set_and_goto(result, cb_false, cleanup);
+		}
+	}
+	if (handle->stderr_to_string)
+	{
+		if (pipe(stderr_pfd) == -1)
+		{
+			cb_log_error("Pipe creation failed for stderr_pfd.");
+			cb_set_and_goto(result, cb_false, cleanup);
+		}
+	}
+
+	pid = cb_spawn_process((char**)args.darr.data, handle, stdout_pfd, stderr_pfd);
+
+	if (pid == CB_INVALID_PROCESS)
+	{
+		cb_set_and_goto(result, cb_false, cleanup);
+	}
+
+	/* Close the write ends of the pipes since they will not be used in the parent process.
+	   Read ends are non-blocking so that they can be emptied while the child process is running. */
+	if (handle->stdout_to_string)
+	{
+		close(stdout_pfd[1]);
+		stdout_pfd[1] = -1;
+		fcntl(stdout_pfd[0], F_SETFL, O_NONBLOCK);
+	}
+	if (handle->stderr_to_string)
+	{
+		close(stderr_pfd[1]);
+		stderr_pfd[1] = -1;
+		fcntl(stderr_pfd[0], F_SETFL, O_NONBLOCK);
+	}
+
+	handle->pid = pid;
+	handle->trace.process_id = (unsigned long)pid;
+	handle->stdout_fd = stdout_pfd[0];
+	handle->stderr_fd = stderr_pfd[0];
+	handle->running = cb_true;
+	result = cb_true;
+
+cleanup:
+	if (!result)
+	{
+		if (stdout_pfd[0] != -1) close(stdout_pfd[0]);
+		if (stdout_pfd[1] != -1) close(stdout_pfd[1]);
+		if (stderr_pfd[0] != -1) close(stderr_pfd[0]);
+		if (stderr_pfd[1] != -1) close(stderr_pfd[1]);
+	}
+	cb_darrT_destroy(&args);
+	return result;
+}
+
+CB_INTERNAL cb_bool
+cb_process_reap(cb_process_handle* handle, cb_bool block)
+{
+	int wstatus = 0; /* pid wait status */
+	int exit_status = -1;
+	pid_t result = 0;
+	struct pollfd fds[2];
+	int fd_count = 0;
+
+	if (!handle->running)
+	{
+		return cb_true;
+	}
+
+	/* wait for process to be done */
+	for (;;) {
+		/* Empty the pipes first, a child process writing to a full pipe would never end. */
+		cb_process_read_pipes(handle);
+
+		fd_count = cb_process_add_pollfds(handle, fds, 0);
+
+		if (block && fd_count > 0) {
+			/* Sleep until there is something to read or until the pipes are closed. */
+			if (poll(fds, fd_count, CB_PROCESS_POLL_TIMEOUT_MS) != 0) {
+				continue;
+			}
+			result = waitpid(handle->pid, &wstatus, WNOHANG);
+		}
+		else {
+			result = waitpid(handle->pid, &wstatus, block ? 0 : WNOHANG);
+		}
+
+		/* Still running. */
+		if (result == 0) {
+			if (!block) {
+				return cb_false;
+			}
+			continue;
+		}
+
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			cb_log_error("Could not wait on command (pid %d): '%s'", handle->pid, strerror(errno));
+			exit_status = -1;
+			break;
+		}
+
+		/* Process exited regularly. */
+		if (WIFEXITED(wstatus)) {
+			exit_status = WEXITSTATUS(wstatus);
+			
+			if (exit_status != 0) {
+				cb_log_debug("Command exited with exit code '%d'", exit_status);
+			}
+
+			break; /* Exit loop. */
+		}
+
+		if (WIFSIGNALED(wstatus)) {
+			exit_status = -1; /* @TODO check which exit status must be set in case of process terminated by another process. */
+			cb_log_debug("Command process was terminated by '%s'", strsignal(WTERMSIG(wstatus)));
+
+			break; /* Exit loop. */
+		}
+
+		if (!block) {
+			return cb_false;
+		}
+	}
+
+	/* Read what remains and close the read pipes if they are still opened. */
+	cb_process_read_pipes(handle);
+
+	if (handle->stdout_fd >= 0)
+	{
+		close(handle->stdout_fd);
+		handle->stdout_fd = -1;
+	}
+
+	if (handle->stderr_fd >= 0)
+	{
+		close(handle->stderr_fd);
+		handle->stderr_fd = -1;
+	}
+
+	cb_process_flush_output(handle);
+
+	handle->exit_code = exit_status;
+	handle->running = cb_false;
+	return cb_true;
+}
+
+CB_API int
+cb_process_wait_any(cb_process_handle* handles[], int count)
+{
+	int i = 0;
+	int result = -1;
+	cb_bool has_running = cb_false;
+	struct pollfd* fds = NULL;
+	int fd_count = 0;
+
+	/* Outputs of the processes and the SIGCHLD self-pipe. */
+	fds = (struct pollfd*)CB_MALLOC((count * 2 + 1) * sizeof(struct pollfd));
+	CB_ASSERT(fds);
+
+	for (;;)
+	{
+		has_running = cb_false;
+		fd_count = 0;
 
-	if (handle->stdout_to_string
-		|| handle->stderr_to_string)
+		/* Exits notified from now on will wake up the poll below. */
+		cb_sigchld_pipe_drain();
+
+		for (i = 0; i < count; i += 1)
+		{
+			if (!handles[i])
+			{
+				continue;
+			}
+
+			if (cb_process_reap(handles[i], cb_false))
+			{
+				cb_set_and_goto(result, i, exit);
+			}
+			has_running = cb_true;
+
+			/* Outputs being copied to a string need to be emptied while the processes are running. */
+			fd_count = cb_process_add_pollfds(handles[i], fds, fd_count);
+		}
+
+		if (!has_running)
+		{
+			cb_set_and_goto(result, -1, exit);
+		}
+
+		/* Sleep until there is something to read or until a child process exits.
+		   Children created by the user also wake up the poll, the pipe is emptied so it does not spin on them.
+		   The processes are still checked from time to time in case the handler has been replaced or could not be installed. */
+		if (cb_sigchld_pipe[0] >= 0)
+		{
+			fds[fd_count].fd = cb_sigchld_pipe[0];
+			fds[fd_count].events = POLLIN;
+			fds[fd_count].revents = 0;
+			fd_count += 1;
+		}
+		poll(fds, fd_count, CB_PROCESS_POLL_TIMEOUT_MS);
+	}
+
+exit:
+	CB_FREE(fds);
+	return result;
+}
+
+#endif
+
+#ifdef _WIN32
+
+/* ================================================================ */
+/* toolchain MSVC */
+/* ================================================================ */
+
+/* #msvc #toolchain */
+
+CB_INTERNAL const char*
+cb_toolchain_msvc_bake(cb_toolchain_t* tc, const char* project_name)
+{
+    /* Will contains most of the defines, flags, innclude paths etc. */
+	cb_dstr str_options = { 0 };
+    /* Will contains most of the arguments to link the program. */
+    cb_dstr str_link = { 0 };
+    /* Will contains all the .obj generated. */
+	cb_dstr str_obj = { 0 };
+    
+    /* Output directory. Contains the directory path of the binary being created. */
+	const char* output_dir = NULL;       
+	
+	cb_kv_range range = { 0 };
+	cb_kv_range lflag_range = { 0 };
+	cb_kv current = { 0 };       /* Temporary kv to store results. */
+	cb_kv current_lflag = { 0 }; /* Temporary kv to linker flags. */
+
+	const char* artefact = NULL; /* Resulting artefact path */
+	const char* _ = "  ";        /* Space to separate command arguments. */
+	const char* tmp = "";
+	const char* error_msg = "";
+
+	cb_strv linked_project_name = { 0 };
+	cb_project_t* linked_project = NULL;
+	const char* linked_output_dir; /* to keep track of the .obj generated */
+	const char* path_prefix = NULL;
+	cb_project_t* project = NULL;
+    const char* std_out = NULL;
+    const char* std_err = NULL;
+    cb_context* ctx = cb_current_context();
+
+    const char* abs_file_str = NULL; /* @TODO comment this. */
+    
+    /* Absolute path of the source file being compiled. */
+    cb_strv abs_file = { 0 };
+
+    /* Absolute path of the object generated. */
+    cb_strv obj_abs_path = { 0 };
+    cb_strv options_content = { 0 };
+    cb_bool* can_process = NULL; /* Decision of the plugins for each file. */
+    cb_size file_index = 0;
+   
+	cb_size tmp_index = 0;
+
+	project = cb_find_project_by_name_str(project_name);
+
+	if (!project)
 	{
-		handles_inheritance = TRUE;
+		return NULL;
+	}
+
+	cb_log_trace("Start baking... %s", project_name);
+
+	cb_dstr_init(&str_options);
+    cb_dstr_init(&str_link);
+	cb_dstr_init(&str_obj);
+
+	/* Get and format output directory */
+	output_dir = cb_get_output_directory(project, tc);
+
+	/* Create output directory if it does not exist yet. */
+	cb_create_directories(output_dir, strlen(output_dir));
+
+    cb_plugins_bake_starting(project);
+            
+    cb_plugins_extra_argument(project, &str_options);
+	
+	/* Append compiler flags */
+	{
+		range = cb_mmap_get_range_str(&project->mmap, cb_CXFLAGS);
+		while (cb_mmap_range_get_next(&range, &current))
+		{
+			cb_dstr_append_f(&str_options,"%s ", current.u.strv.data);
+		}
+	}
+
+	/* Append include directories */
+	{
+		range = cb_mmap_get_range_str(&project->mmap, cb_INCLUDE_DIRECTORIES);
+		while (cb_mmap_range_get_next(&range, &current))
+		{
+			/* Absolute file is created using the tmp buffer allocator but we don't need it once it's inserted into the dynamic string */
+			tmp_index = cb_tmp_save();
+			cb_dstr_append_f(&str_options, "/I\"%s\" ", cb_path_get_absolute_dir(current.u.strv.data));
+			cb_tmp_restore(tmp_index);
+		}
+	}
+	
+	/* Append preprocessor definition */
+	{
+		range = cb_mmap_get_range_str(&project->mmap, cb_DEFINES);
+		while (cb_mmap_range_get_next(&range, &current))
+		{
+			cb_dstr_append_f(&str_options, "/D\"%s\" ", current.u.strv.data);
+		}
+	}
+
+	/* Let the plugins check all the files before compiling them. */
+	can_process = cb_plugins_check_files(project);
+
+	/* Compile source file and create the .obj at the appropriate place. */
+	{
+        options_content = cb_strv_make_str(str_options.data);
+        
+		range = cb_mmap_get_range_str(&project->mmap, cb_FILES);
+		for (file_index = 0; cb_mmap_range_get_next(&range, &current); file_index += 1)
+		{
+			/* Absolute file is created using the tmp buffer allocator but we don't need it once it's inserted into the dynamic string */
+			tmp_index = cb_tmp_save();
+
+			/* Fail compilation if a file does not exists. */
+            abs_file_str = cb_path_get_absolute_file(current.u.strv.data);
+
+			if (!cb_path_exists(abs_file_str))
+			{
+				cb_log_error("File does not exists: %s", abs_file_str);
+				cb_set_and_goto(artefact, NULL, exit);
+			}
+	
+            abs_file = cb_strv_make_str(abs_file_str);
+            obj_abs_path = cb_path_get_object_path(output_dir, abs_file_str, ".obj");
+            
+            if (can_process[file_index])
+            {
+                /* /utf-8: by default since it's retrocompatible with utf-8 */
+                /* /nologo: to avoid undesirable messages in the command line. */
+                /* /c: compile only since we run the linker after all source file have beenc ompiled. */
+                const char* full_compile_command = cb_tmp_sprintf(
+                    /* cl.exe program */
+                    "%s /utf-8 /nologo /c "
+                    /* Option string content */
+                    CB_STRV_FMT " "
+                    /* Absolute path of the existing source file. */
+                    "\"" CB_STRV_FMT "\" "
+                    /* Absolute path of the resulting .obj file. */
+                    "/Fo\"" CB_STRV_FMT "\" " ,
+                    tc->program,
+                    CB_STRV_ARG(options_content),
+                    CB_STRV_ARG(abs_file),
+                    CB_STRV_ARG(obj_abs_path)
+                );
+                
+                /* Execute cl.exe */
+                
+                /* When plugins are used we capture the standard outputs which might be processed by one of the plugin. */
+                if (ctx->plugin_count > 0)
+                {
+                    cb_bool also_stderr = cb_true;
+                    cb_process_handle* process_handle = cb_create_process_handle(full_compile_command, output_dir);
+
+                    process_handle->stdout_to_string = cb_true;
+                    process_handle->stderr_to_string = also_stderr;
+                    cb_process_set_trace(process_handle, "compile", project, abs_file_str);
+                    process_handle = cb_process_core(process_handle);
+
+                    if (process_handle == 0)
+                    {
+                        cb_set_and_goto(artefact, NULL, exit);
+                    }
+                    
+                    std_out = cb_process_stdout_string(process_handle);
+                    std_err = cb_process_stderr_string(process_handle);
+           
+                    /* Only mark the file as processed if the command line was correctly run */
+                    if (process_handle->exit_code == 0)
+                    {
+                        cb_plugins_file_processed(project, abs_file_str, std_out, std_err);
+                    }
+					else
+					{
+						if (std_out)
+						{
+							cb_log_error(std_out);
+						}
+						if (std_err)
+						{
+							cb_log_error(std_err);
+						}
+					}
+
+                    if (cb_process_end(process_handle) != 0)
+                    {
+                        cb_set_and_goto(artefact, NULL, exit);
+                    }
+                }
+                else
+                {
+                    if (cb_process_in_directory_traced(full_compile_command, output_dir, "compile", project, abs_file_str) != 0)
+                    {
+                        cb_set_and_goto(artefact, NULL, exit);
+                    }
+                }
+            }
+            
+            /* Sometimes a .c or .cpp file is empty which does not create any obj file.
+               Therefore we need prevent it to get into the obj list. */
+            if (cb_path_exists(obj_abs_path.data))
+			{
+                cb_dstr_append_f(&str_obj, "\"" CB_STRV_FMT "\" ", CB_STRV_ARG(obj_abs_path));
+            }
+
+            cb_tmp_restore(tmp_index);
+		}
+	}
+
+    /* Add linker flags */
+    {
+        lflag_range = cb_mmap_get_range_str(&project->mmap, cb_LFLAGS);
+        while (cb_mmap_range_get_next(&lflag_range, &current_lflag))
+        {
+            cb_dstr_append_strv(&str_link, current_lflag.u.strv);
+            cb_dstr_append_str(&str_link, _);
+        }
+    }
+            
+    /* Compute link string to append to the cl.exe command at a later stage */
+    {
+        /* For each linked project we add the link information to the cl.exe command */
+          
+        range = cb_mmap_get_range_str(&project->mmap, cb_LINK_PROJECTS);
+        if (range.count > 0)
+        {
+            /* Iterate all the linked projects */
+            while (cb_mmap_range_get_next(&range, &current))
+            {
+                linked_project_name = current.u.strv;
+
+                linked_project = cb_find_project_by_name(linked_project_name);
+                if (!project)
+                {
+                    cb_set_and_goto(artefact, NULL, exit);
+                }
+
+                linked_output_dir = cb_get_output_directory(linked_project, tc);
+
+                /* is shared or static library */
+                if (cb_property_equals(linked_project, cb_BINARY_TYPE, cb_SHARED_LIBRARY)
+                    || cb_property_equals(linked_project, cb_BINARY_TYPE, cb_STATIC_LIBRARY))
+                {
+                    /* /LIBPATH:"output/dir/" "mlib.lib" */
+                    cb_dstr_append_f(&str_link, "/LIBPATH:\"%s\" \"%.*s.lib\" ", linked_output_dir, linked_project_name.size, linked_project_name.data);
+                }
 
-		si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
-		si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
-		si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+                /* is shared library */
+                if (cb_property_equals(linked_project, cb_BINARY_TYPE, cb_SHARED_LIBRARY))
+                {
+                    path_prefix = cb_tmp_sprintf("%s%.*s", linked_output_dir, linked_project_name.size, linked_project_name.data);
+                    /* .dll */
+                    tmp = cb_tmp_sprintf("%s.dll", path_prefix);
+                    if (!cb_copy_file_to_dir(tmp, output_dir))
+                    {
+                        cb_set_and_goto(artefact, NULL, exit);
+                    }
 
-		si.dwFlags |= STARTF_USESTDHANDLES;
-			
-		saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
-		saAttr.bInheritHandle = TRUE;
-		saAttr.lpSecurityDescriptor = NULL;
+                    /* .exp */
+                    tmp = cb_tmp_sprintf("%s.exp", path_prefix);
+                    if (!cb_copy_file_to_dir(tmp, output_dir))
+                    {
+                        cb_log_warning("Missing .exp. Shared libraries usually need to have some symbol exported with '__declspec(dllexport)'");
+                        cb_set_and_goto(artefact, NULL, exit);
+                    }
 
-		if (handle->stdout_to_string)
-		{
-			/* Create a pipe for the child process's stdout. */
-			if (!CreatePipe(&process_stdout_read, &process_stdout_write, &saAttr, 0)
-				|| !SetHandleInformation(process_stdout_read, HANDLE_FLAG_INHERIT, 0))
-			{
-				cb_log_error("Could not create pipe for stdout.");
-				exit(1);
-			}
+                    /* .lib */
+                    tmp = cb_tmp_sprintf("%s.lib", path_prefix);
+                    if (!cb_copy_file_to_dir(tmp, output_dir))
+                    {
+                        cb_log_warning("Missing .lib file. Shared libraries must create a .lib file for other program to be linked with at compile time.");
+                        cb_set_and_goto(artefact, NULL, exit);
+                    }
 
-			si.hStdOutput = process_stdout_write;
-		}
+                    /* Copy .pdb if there is any. */
+                    tmp = cb_tmp_sprintf("%s.pdb", path_prefix);
+                    cb_try_copy_file_to_dir(tmp, output_dir);
+                }
+            }
+        }
+    }
 
-		if (handle->stderr_to_string)
+	/* Append libraries like gdi32.lib */
+	{
+		range = cb_mmap_get_range_str(&project->mmap, cb_LIBRARIES);
+		while (cb_mmap_range_get_next(&range, &current))
 		{
-			/* Create a pipe for the child process's stderr. */
-			if (!CreatePipe(&process_stderr_read, &process_stderr_write, &saAttr, 0)
-				|| !SetHandleInformation(process_stderr_read, HANDLE_FLAG_INHERIT, 0))
-			{
-				cb_log_error("Could not create pipe for stderr.");
-				exit(1);
-			}
-
-			si.hStdError = process_stderr_write;
+			cb_dstr_append_f(&str_link, "\"%s.lib\" ", current.u.strv.data);
 		}
 	}
+	
+    cb_strv link_content = cb_strv_make_str(str_link.data);
 
-	ZeroMemory(&pi, sizeof(pi));
-
-	/* Start the child process.
-	*  NOTE: we use CreateProcessW because CreateProcessA (with /utf-8) cannot create path with unicode.
-	*/
-	if (!CreateProcessW(
-		NULL,                 /* No module name (use command line) */
-		cmd_w,                /* Command line */
-		NULL,                 /* Process handle not inheritable */
-		NULL,                 /* Thread handle not inheritable */ 
-		handles_inheritance,  /* Set handle inheritance */
-		0,                    /* No creation flags */
-		NULL,                 /* Use parent's environment block */
-		starting_directory_w, /* Use parent's starting directory */
-		&si,                  /* Pointer to STARTUPINFO structure */
-		&pi)                  /* Pointer to PROCESS_INFORMATION structure */
-		)
+	/* Thousands of .obj could exceed the maximum length of a command line. */
+	const char* obj_args = cb_get_args_or_response_file(&str_obj, output_dir, project_name);
+	if (!obj_args)
 	{
-		cb_log_debug("CreateProcessW failed: %d", GetLastError());
-		/* No need to close handles since the process creation failed */
-		return handle;
+		cb_set_and_goto(artefact, NULL, exit);
 	}
 
-	/* Close the write ends of the pipes since they will not be used in the parent process. */
-	if (handle->stdout_to_string)
-    {
-		CloseHandle(process_stdout_write);
-    }
+    /* Format artifact (exe, static library or shared library) path. */
+    
+    /* Handle binary type. */
 
-	if (handle->stderr_to_string)
-    {
-		CloseHandle(process_stderr_write);
-    }
+	cb_bool is_exe = cb_property_equals(project, cb_BINARY_TYPE, cb_EXE);
+	cb_bool is_shared_library = cb_property_equals(project, cb_BINARY_TYPE, cb_SHARED_LIBRARY);
+	cb_bool is_static_library = cb_property_equals(project, cb_BINARY_TYPE, cb_STATIC_LIBRARY);
 
-    for (;;)
+	/* Execute lib.exe or link.exe */
+    if (is_exe)
     {
-        child_running =
-            WaitForSingleObject(pi.hProcess, 0) == WAIT_TIMEOUT;
-
-        if (handle->stdout_to_string)
-        {
-            /* Read output from the child process's pipe for stdout. Stop when there is no more data. */
-            while (ReadFile(process_stdout_read, process_output_buffer, sizeof(process_output_buffer), &byte_read_from_buffer, NULL)
-                && byte_read_from_buffer != 0)
-            {
-                cb_dstr_append_f(&handle->stdout_string, "%.*s", (int)byte_read_from_buffer, process_output_buffer);
-            }
-        }
+        /* Possible artefact name: my/path/my_program.exe */
+        artefact = cb_tmp_sprintf("%s%s%s", output_dir, project_name, ".exe");
         
-        if (handle->stderr_to_string)
-        {
-            while (ReadFile(process_stderr_read, process_output_buffer, sizeof(process_output_buffer), &byte_read_from_buffer, NULL)
-                && byte_read_from_buffer != 0)
-            {
-                cb_dstr_append_f(&handle->stderr_string, "%.*s", (int)byte_read_from_buffer, process_output_buffer);
-            }
-        }
+        /* link.exe /NOLOGO /OUT:"output/dir/my_program.exe" /LIBPATH:"output/dir/" a.obj b.obj c.obj ... */
+		tmp = cb_tmp_sprintf("link.exe /NOLOGO /OUT:\"%s\"  /LIBPATH:\"%s\" %s " CB_STRV_FMT, artefact, output_dir, obj_args, CB_STRV_ARG(link_content));
+
+		error_msg = "Could not execute command to build executable: %s";
+    }
+	else if (is_static_library)
+	{
+        /* Possible artefact name: my/path/my_lib.lib */
+        artefact = cb_tmp_sprintf("%s%s%s", output_dir, project_name, ".lib");
         
-        if (!child_running)
-        {
-            break;
-        }
+		/* lib.exe /NOLOGO /OUT:"output/dir/my_lib.lib" /LIBPATH:"output/dir/" a.obj b.obj c.obj ... */
+		tmp = cb_tmp_sprintf("lib.exe /NOLOGO /OUT:\"%s\"  /LIBPATH:\"%s\" %s ", artefact, output_dir, obj_args);
+
+		error_msg = "Could not execute command to build static library: %s";
+	}
+    else if (is_shared_library)
+    {
+        /* Possible artefact name: my/path/my_lib.dll */
+        artefact = cb_tmp_sprintf("%s%s%s", output_dir, project_name, ".dll");
         
-        Sleep(10);
-    }
-    
-    if (GetExitCodeProcess(pi.hProcess, &exit_code))
+        /* link.exe /NOLOGO /DLL /OUT:"output/dir/my_lib.dll" /LIBPATH:"output/dir/" a.obj b.obj c.obj ... */
+		tmp = cb_tmp_sprintf("link.exe /NOLOGO /DLL /OUT:\"%s\"  /LIBPATH:\"%s\" %s " CB_STRV_FMT, artefact, output_dir, obj_args, CB_STRV_ARG(link_content));
+		
+		error_msg = "Could not execute command to build shared library: %s";
+	}
+    else
     {
-        if (exit_code != 0)
-        {
-            cb_log_debug("Command exited with exit code %lu", exit_code);
-        }
+        cb_log_error("Unknown binary type");
+		cb_set_and_goto(artefact, NULL, exit);
     }
-    else
+    
+    if (cb_process_in_directory_traced(tmp, output_dir, is_static_library ? "archive" : "link", project, artefact) != 0)
     {
-        cb_log_error("Could not get process exit code: %lu", GetLastError());
+        cb_log_error(error_msg, project_name);
+        cb_set_and_goto(artefact, NULL, exit);
     }
 
-	if (handle->stdout_to_string)
-	{
-		CloseHandle(process_stdout_read);
-	}
-
-	if (handle->stderr_to_string)
-	{
-		CloseHandle(process_stderr_read);
-	}
+exit:
+	cb_plugins_bake_finished(project);
 
-	/* Close process and thread handles. */
-	CloseHandle(pi.hProcess);
-	CloseHandle(pi.hThread);
+	CB_FREE(can_process);
+	cb_dstr_destroy(&str_options);
+    cb_dstr_destroy(&str_link);
+	cb_dstr_destroy(&str_obj);
 
-	handle->exit_code = exit_code;
-	return handle;
+	return artefact;
 }
-#else
-
-/* space or tab */
-CB_INTERNAL cb_bool cb_is_space(char c) { return c == ' ' || c == '\t'; }
-
-CB_INTERNAL cb_bool
-cb_is_end_of_quote(const char* str, char quote_type)
-{
-	return *str != '\0'
-		&& *str == quote_type
-		&& (str[1] == '\0' || cb_is_space(str[1]));
 
-}
-/* Parse arguments, space is a separator and everything between <space or begining of string><quote> and <quote><space or end of string>
-* Quotes can be double quotes or simple quotes.
-a b c   => 3 arguments a b c
-abc     => 1 argument "abc"
-a "b" c => 3 arguments a b c;
-a"b"c   => 1 argument a"b"c
-"a"b"c" => 1 argument a"b"c
-*/
-CB_INTERNAL const char*
-cb_get_next_arg(const char* str, cb_strv* sv)
-{
-	sv->data = (char*)str;
-	sv->size = 0;
-	if (str == NULL || *str == '\0')
-		return NULL;
-		
-	while (*str != '\0')
-	{
-		/* Skip spaces */
-		while (*str != '\0' && cb_is_space(*str))
-			str += 1;
+#else
 
-		/* Return early if end of string */
-		if (*str == '\0') 
-			return sv->size > 0 ? str: NULL;
+/* ================================================================ */
+/* toolchain GCC */
+/* ================================================================ */
 
-		/* Handle quotes */
-		if (*str == '\'' || *str == '\"')
-		{
-			const char* quote = str;
-			str += 1; /* skip quote */
-			
-			/* Return early if end of string */
-			if (*str == '\0')
-				return sv->size > 0 ? str : NULL;
+/* #gcc #toolchain */
 
-			/* Quote next the previous one so it's an empty content, we look for another item */
-			if (cb_is_end_of_quote(str, *quote))
-			{
-				str += 1; /* Skip quote */
-				continue;
-			}
+/* Compilation of a single source file running in the background. */
+typedef struct cb_compile_job cb_compile_job;
+struct cb_compile_job {
+	cb_process_handle* handle;
+	cb_cmd* cmd;    /* Compile command, the handle refers to it. */
+	char* file;     /* Absolute path of the source file. */
+	char* obj_file; /* Absolute path of the .o file. */
+	char* dep_file; /* Absolute path of the .d file. */
+};
 
-			sv->data = (char*)str; /* The next argument will begin right after the quote */
-			/* Skip everything until the next unescaped quote */
-			while (*str != '\0' && !cb_is_end_of_quote(str, *quote))
-				str += 1;
+CB_INTERNAL void
+cb_compile_job_destroy(cb_compile_job* job)
+{
+	cb_cmd_destroy(job->cmd);
+	CB_FREE(job->file);
+	CB_FREE(job->obj_file);
+	CB_FREE(job->dep_file);
+	memset(job, 0, sizeof(cb_compile_job));
+}
 
-			/* Either it's the end of the quoted string, either we reached the null terminating string */
-			sv->size = (str - quote) - 1;
+/* Wait for the end of the compilation, notify the plugins and release the job resources.
+   Returns false if the compilation failed. */
+CB_INTERNAL cb_bool
+cb_compile_job_finish(cb_project_t* project, cb_compile_job* job)
+{
+	int exit_code = cb_process_end(job->handle);
 
-			/* Eat trailing quote so that next argument can start with space */
-			while (*str != '\0' && *str == *quote)
-				str += 1;
+	if (exit_code == 0)
+	{
+		cb_plugins_file_processed(project, job->file, job->dep_file, NULL);
+	}
 
-			return str;
-		}
-		else /* is char */
-		{
-			const char* ch = str;
-			while (*str != '\0' && !cb_is_space(*str))
-				str += 1;
+	cb_compile_job_destroy(job);
 
-			sv->data = (char*)ch; /* remove quote */
-			sv->size = str - ch;
-			return str;
-		}
-	}
-	return NULL;
+	return exit_code == 0;
 }
 
-#define CB_INVALID_PROCESS (-1)
+enum {
+	cb_bake_state_NONE,      /* Not started yet. */
+	cb_bake_state_COMPILING,
+	cb_bake_state_WAITING,   /* Compiled, waiting for the linked projects. */
+	cb_bake_state_LINKING,
+	cb_bake_state_DONE,
+	cb_bake_state_FAILED
+};
+
+/* Project baked by cb_gcc_bake_projects. */
+typedef struct cb_gcc_bake cb_gcc_bake;
+struct cb_gcc_bake {
+	cb_project_t* project;
+	int state;
+	int jobs;                       /* Maximum number of files of the project compiled at the same time. */
+	int running_count;              /* Number of processes of the project being run. */
+	const char* output_dir;         /* Directory of the binary being created. */
+	cb_cmd* compile_options;        /* Compiler, defines, flags, include paths etc. shared by all the compile commands. */
+	cb_darrT(cb_compile_job) compile_jobs; /* Files to compile, the command is created when the job is started. */
+	cb_size next_job;               /* Index of the next job to start. */
+	cb_bool compile_failed;
+	cb_darrT(char*) obj_paths;      /* .o files in the same order as the source files. */
+	char* link_command;             /* The link handle refers to it. NULL if the link is up to date. */
+	cb_process_handle* link_handle;
+	char* link_signature;           /* Written to 'link_signature_path' once the link succeeded. */
+	char* link_signature_path;
+	char* artefact;                 /* Full path of the binary. */
+	cb_bool ended;                  /* The plugins have been notified that the bake is done. */
+};
 
-CB_INTERNAL pid_t
-cb_fork_process(char* args[], cb_process_handle* handle, int stdout_pfd[2], int stderr_pfd[2])
+/* Push the compiler, the compiler flags, the include directories, the preprocessor definitions of the project
+   and the arguments of the plugins. Used by the bake and by the export of the compile commands. */
+CB_INTERNAL void
+cb_gcc_push_compile_options(cb_cmd* cmd, const cb_toolchain_t* tc, cb_project_t* project)
 {
-	pid_t pid = fork();
+	cb_kv_range range = { 0 };
+	cb_kv current = { 0 };
+	cb_size tmp_index = 0;
+	/* Will contains the extra arguments of the plugins. */
+	cb_dstr str_plugin_args;
 
-	switch (pid)
-	{
-	case -1: /* Error */
-		cb_log_error("Could not fork child process: %s", strerror(errno));
-		return CB_INVALID_PROCESS;
-	case 0:  /* Child process */
+	cb_cmd_push_command_line(cmd, tc->program);
+
+	/* Append compiler flags. A single value can contain several flags. */
+	range = cb_mmap_get_range_str(&project->mmap, cb_CXFLAGS);
+	while (cb_mmap_range_get_next(&range, &current))
 	{
-		if (handle->stdout_to_string)
-		{
-			dup2(stdout_pfd[1], STDOUT_FILENO);
-			/* Close both sides of the pipe in the child */
-			close(stdout_pfd[0]);
-			close(stdout_pfd[1]);
-		}
-		if (handle->stderr_to_string)
-		{
-			dup2(stderr_pfd[1], STDERR_FILENO);
-			/* Close both sides of the pipe in the child */
-			close(stderr_pfd[0]);
-			close(stderr_pfd[1]);
-		}
+		cb_cmd_push_command_line(cmd, current.u.strv.data);
+	}
 
-		/* Change directory in the fork */
-		if (handle->starting_directory
-			&& handle->starting_directory[0]
-			&& chdir(handle->starting_directory) < 0) {
-			cb_log_error("Could not change directory to '%s': %s", handle->starting_directory, strerror(errno));
-			return CB_INVALID_PROCESS;
-		}
-		if (execvp(args[0], args) == CB_INVALID_PROCESS) {
-			cb_log_error("Could not exec child process: %s", strerror(errno));
-			return CB_INVALID_PROCESS;
-		}
-		CB_ASSERT(0 && "unreachable");
-		break;
+	/* Append include directories */
+	range = cb_mmap_get_range_str(&project->mmap, cb_INCLUDE_DIRECTORIES);
+	while (cb_mmap_range_get_next(&range, &current))
+	{
+		tmp_index = cb_tmp_save();
+		cb_cmd_push(cmd, "-I");
+		cb_cmd_push(cmd, cb_path_get_absolute_dir(current.u.strv.data));
+		cb_tmp_restore(tmp_index);
 	}
-	default:
-		/* Do nothing for parent process */
-		break;
+
+	/* Append preprocessor definition */
+	range = cb_mmap_get_range_str(&project->mmap, cb_DEFINES);
+	while (cb_mmap_range_get_next(&range, &current))
+	{
+		cb_cmd_push_f(cmd, "-D" CB_STRV_FMT, CB_STRV_ARG(current.u.strv));
 	}
 
-	return pid;
+	/* Append extra flags depending on the plugin used */
+	cb_dstr_init(&str_plugin_args);
+	cb_plugins_extra_argument(project, &str_plugin_args);
+	cb_cmd_push_command_line(cmd, str_plugin_args.data);
+	cb_dstr_destroy(&str_plugin_args);
 }
 
-CB_INTERNAL cb_process_handle*
-cb_process_core(cb_process_handle* handle)
+/* Push the arguments specific to the compilation of a single file.
+   Example: -c <c source file> -o <o file> -MMD -MF <d file> */
+CB_INTERNAL void
+cb_gcc_push_compile_file(cb_cmd* cmd, const char* file, const char* obj_file, const char* dep_file)
 {
-	cb_darrT(const char*) args;
-	cb_strv arg; /* Current argument */
-	const char* cmd_cursor = handle->cmd; /* Current position in the string command */
-	pid_t pid = CB_INVALID_PROCESS;
-	int wstatus = 0; /* pid wait status */
-	int exit_status = -1;
+	cb_cmd_push(cmd, "-c");
+	cb_cmd_push(cmd, file);
+	cb_cmd_push(cmd, "-o");
+	cb_cmd_push(cmd, obj_file);
+	cb_cmd_push(cmd, "-MMD");
+	cb_cmd_push(cmd, "-MF");
+	cb_cmd_push(cmd, dep_file);
+}
 
-	ssize_t bytes_read = 0;   /* Byte read count when we retrieve the output of the child process. */
-	char buffer[256] = { 0 }; /* Buffer to get the output of the child process. */
-	int stdout_pfd[2] = { 0 };     /* Pipe file descriptor for stdout. */
-	int stderr_pfd[2] = { 0 };     /* Pipe file descriptor for stderr. */
+/* Prepare the compilation of all the files of the project. Returns false if the project can't be compiled. */
+CB_INTERNAL cb_bool
+cb_gcc_bake_start(cb_toolchain_t* tc, cb_gcc_bake* bake)
+{
+	cb_project_t* project = bake->project;
 
-	cb_darrT_init(&args);
+	cb_kv_range range = { 0 };
+	cb_kv current = { 0 };       /* Temporary kv to store results. */
+	cb_compile_job job = { 0 };
+	cb_bool* can_process = NULL; /* Decision of the plugins for each file. */
+	cb_size file_index = 0;
 
-	cb_log_debug("Running process '%s'", handle->cmd);
-	if (handle->starting_directory && handle->starting_directory[0])
-	{
-		cb_log_debug("Subprocess started in directory '%s'", handle->starting_directory);
-	}
+	const char* abs_file_str = NULL;
+	cb_strv obj_abs_path = { 0 };
+	cb_strv dep_abs_path = { 0 };
+	cb_size tmp_index = 0;  /* to save temporary allocation index */
+	cb_bool result = cb_true;
+	cb_trace_event event;
 
-	/* Ensure that everything is written into the outputs before creating a new process that will also write in those outputs */
-	fflush(stdout);
-	fflush(stderr);
+	cb_plugins_bake_starting(project);
 
-	/* Split args from the command line and add it to the array. */
-	while ((cmd_cursor = cb_get_next_arg(cmd_cursor, &arg)) != NULL)
-	{
-		cb_darrT_push_back(&args, cb_tmp_strv_to_str(arg));
-	}
+	cb_trace_event_begin(&event, "properties", "compile options", NULL);
 
-	/* Last value of the args should be a null value, only append if necessary */
-	if (args.darr.size > 0)
-	{
-		cb_darrT_push_back(&args, NULL);
-	}
+	bake->state = cb_bake_state_COMPILING;
+	bake->jobs = cb_get_jobs(project);
+	bake->compile_options = cb_cmd_create();
+	cb_darrT_init(&bake->compile_jobs);
+	cb_darrT_init(&bake->obj_paths);
 
-	if (handle->stdout_to_string)
+	/* Get and format output directory */
+	bake->output_dir = cb_get_output_directory(project, tc);
+
+	/* Create output directory if it does not exist yet. */
+	cb_create_directories(bake->output_dir, strlen(bake->output_dir));
+
+	cb_gcc_push_compile_options(bake->compile_options, tc, project);
+
+	cb_trace_event_end(&event);
+	cb_trace_event_begin(&event, "check", "source files", NULL);
+
+	/* Let the plugins check all the files before compiling them. */
+	can_process = cb_plugins_check_files(project);
+
+	/* List the .c files to compile. */
+	range = cb_mmap_get_range_str(&project->mmap, cb_FILES);
+	for (file_index = 0; cb_mmap_range_get_next(&range, &current); file_index += 1)
 	{
-		if (pipe(stdout_pfd) == -1)
+		/* Paths are created using the tmp buffer allocator but we don't need them once they are copied. */
+		tmp_index = cb_tmp_save();
+
+		/* Fail compilation if a file does not exists. */
+		abs_file_str = cb_path_get_absolute_file(current.u.strv.data);
+
+		if (!cb_path_exists(abs_file_str))
 		{
-			cb_log_error("Pipe creation failed for stdout_pfd.");
-			cb_set_and_goto(exit_status, -1, cleanup);
+			cb_log_error("File does not exists: %s", abs_file_str);
+			cb_tmp_restore(tmp_index);
+			cb_set_and_goto(result, cb_false, exit);
 		}
-	}
-	if (handle->stderr_to_string)
-	{
-		if (pipe(stderr_pfd) == -1)
+
+		obj_abs_path = cb_path_get_object_path(bake->output_dir, abs_file_str, ".o");
+
+		/* The .o file is added to the list once all the compilations are done. */
+		cb_darrT_push_back(&bake->obj_paths, cb_str_dup(obj_abs_path.data));
+
+		if (can_process[file_index])
 		{
-			cb_log_error("Pipe creation failed for stderr_pfd.");
-			cb_set_and_goto(exit_status, -1, cleanup);
+			/* Change extension to .d */
+			dep_abs_path = cb_path_change_extension(obj_abs_path, cb_strv_make_str(".d"));
+
+			memset(&job, 0, sizeof(cb_compile_job));
+			job.file = cb_str_dup(abs_file_str);
+			job.obj_file = cb_str_dup(obj_abs_path.data);
+			job.dep_file = cb_str_dup(dep_abs_path.data);
+			cb_darrT_push_back(&bake->compile_jobs, job);
 		}
+
+		cb_tmp_restore(tmp_index);
 	}
 
-	pid = cb_fork_process((char**)args.darr.data, handle, stdout_pfd, stderr_pfd);
+exit:
+	CB_FREE(can_process);
+	cb_trace_event_end(&event);
 
-	if (pid == CB_INVALID_PROCESS)
+	if (!result)
 	{
-		cb_set_and_goto(exit_status, -1, cleanup);
+		bake->state = cb_bake_state_FAILED;
 	}
+	return result;
+}
 
-	/* wait for process to be done */
-	for (;;) {
-		if (waitpid(pid, &wstatus, 0) < 0) {
-			cb_log_error("Could not wait on command (pid %d): '%s'", pid, strerror(errno));
-			cb_set_and_goto(exit_status, -1, cleanup);
-		}
-
-		/* Process exited regularly. */
-		if (WIFEXITED(wstatus)) {
-			exit_status = WEXITSTATUS(wstatus);
-			
-			if (exit_status != 0) {
-				cb_log_debug("Command exited with exit code '%d'", exit_status);
-			}
+/* Start the next compilation of the project. Returns NULL if the process could not be started. */
+CB_INTERNAL cb_compile_job*
+cb_gcc_bake_start_compile(cb_gcc_bake* bake)
+{
+	cb_compile_job* job = cb_darrT_ptr(&bake->compile_jobs, bake->next_job);
+	bake->next_job += 1;
 
-			break; /* Exit loop. */
-		}
+	/* Example: gcc <options> -c <c source file> -o <o file> -MMD -MF <d file> */
+	job->cmd = cb_cmd_create();
+	cb_cmd_append(job->cmd, bake->compile_options);
+	cb_gcc_push_compile_file(job->cmd, job->file, job->obj_file, job->dep_file);
 
-		if (WIFSIGNALED(wstatus)) {
-			exit_status = -1; /* @TODO check which exit status must be set in case of process terminated by another process. */
-			cb_log_debug("Command process was terminated by '%s'", strsignal(WTERMSIG(wstatus)));
+	job->handle = cb_create_process_handle(NULL, bake->output_dir);
+	job->handle->args = job->cmd;
+	cb_process_set_trace(job->handle, "compile", bake->project, job->file);
 
-			break; /* Exit loop. */
-		}
+	if (!cb_process_start(job->handle))
+	{
+		cb_compile_job_finish(bake->project, job);
+		bake->compile_failed = cb_true;
+		return NULL;
 	}
 
-	if (handle->stdout_to_string)
-	{
-		/* Close the write pipe since the child program has been exited. */
-		close(stdout_pfd[1]);
+	bake->running_count += 1;
+	return job;
+}
 
-		/* Read output of the child process from the read file description of the pipe. */
-		while ((bytes_read = read(stdout_pfd[0], buffer, sizeof(buffer))) > 0)
-		{
-			cb_dstr_append_f(&handle->stdout_string, "%.*s", (int)bytes_read, buffer);
-		}
-		/* Close the read pipe since we read all the information from it. */
-		close(stdout_pfd[0]);
-	}
+/* Returns true if all the linked projects that are part of the bake are linked.
+   Linked projects that are not part of the bake are expected to be already baked. */
+CB_INTERNAL cb_bool
+cb_gcc_bake_can_link(const cb_gcc_bake* bake, const cb_gcc_bake* bakes, cb_size count)
+{
+	cb_kv_range range = { 0 };
+	cb_kv current = { 0 };
+	cb_size i = 0;
 
-	if (handle->stderr_to_string)
+	range = cb_mmap_get_range_str(&bake->project->mmap, cb_LINK_PROJECTS);
+	while (cb_mmap_range_get_next(&range, &current))
 	{
-		/* Close the write pipe since the child program has been exited. */
-		close(stderr_pfd[1]);
-
-		/* Read output of the child process from the read file description of the pipe. */
-		while ((bytes_read = read(stderr_pfd[0], buffer, sizeof(buffer))) > 0)
+		for (i = 0; i < count; i += 1)
 		{
-			cb_dstr_append_f(&handle->stderr_string, "%.*s", (int)bytes_read, buffer);
+			if (cb_strv_equals_strv(bakes[i].project->name, current.u.strv)
+				&& bakes[i].state != cb_bake_state_DONE)
+			{
+				return cb_false;
+			}
 		}
-		/* Close the read pipe since we read all the information from it. */
-		close(stderr_pfd[0]);
 	}
-
-cleanup:
-	cb_darrT_destroy(&args);
-	handle->exit_code = exit_status;
-	return handle;
+	return cb_true;
 }
 
-#endif
+/* Append the size and the modification time of a file to the link signature. Returns false if the file does not exist. */
+CB_INTERNAL cb_bool
+cb_gcc_append_file_signature(cb_dstr* signature, const char* path)
+{
+	struct stat st;
+	long nanoseconds = 0;
 
-#ifdef _WIN32
+	cb_current_context()->stats.files_stated += 1;
+	if (stat(path, &st) != 0)
+	{
+		return cb_false;
+	}
 
-/* ================================================================ */
-/* toolchain MSVC */
-/* ================================================================ */
+#ifdef __APPLE__
+	nanoseconds = (long)st.st_mtimespec.tv_nsec;
+#else
+	nanoseconds = (long)st.st_mtim.tv_nsec;
+#endif
 
-/* #msvc #toolchain */
+	cb_dstr_append_f(signature, CB_U64_FMT " " CB_U64_FMT ".%09ld %s\n", (cb_u64)st.st_size, (cb_u64)st.st_mtime, nanoseconds, path);
+	return cb_true;
+}
 
-CB_INTERNAL const char*
-cb_toolchain_msvc_bake(cb_toolchain_t* tc, const char* project_name)
-{
-    /* Will contains most of the defines, flags, innclude paths etc. */
-	cb_dstr str_options = { 0 };
-    /* Will contains most of the arguments to link the program. */
-    cb_dstr str_link = { 0 };
-    /* Will contains all the .obj generated. */
+/* Create the command linking the .o files and copy the linked shared libraries next to the binary.
+   Nothing is done if the link signature (objects, libraries, flags and linked binaries) did not change since the last link,
+   'link_command' is NULL in that case. */
+CB_INTERNAL cb_bool
+cb_gcc_bake_prepare_link(cb_toolchain_t* tc, cb_gcc_bake* bake)
+{
+	cb_project_t* project = bake->project;
+	const char* project_name = project->name.data;
+	const char* output_dir = bake->output_dir;
+	/* Will contains most of the arguments to link the program. */
+	cb_dstr str_link = { 0 };
+	/* Will contains all the .obj generated.*/
 	cb_dstr str_obj = { 0 };
-    
-    /* Output directory. Contains the directory path of the binary being created. */
-	const char* output_dir = NULL;       
-	
+	/* Everything the result of the link depends on. */
+	cb_dstr signature = { 0 };
+	/* Shared libraries to copy next to the binary. */
+	cb_darrT(const char*) copied_libraries;
+
+	cb_bool is_exe = cb_false;
+	cb_bool is_static_library = cb_false;
+	cb_bool is_shared_library = cb_false;
+
 	cb_kv_range range = { 0 };
-	cb_kv_range lflag_range = { 0 };
 	cb_kv current = { 0 };       /* Temporary kv to store results. */
-	cb_kv current_lflag = { 0 }; /* Temporary kv to linker flags. */
-
-	const char* artefact = NULL; /* Resulting artefact path */
-	const char* _ = "  ";        /* Space to separate command arguments. */
-	const char* tmp = "";
-	const char* error_msg = "";
+	cb_kv_range lflag_range = { 0 };
+	cb_kv current_lflag = { 0 };
 
+	const char* linked_output_dir = NULL;
 	cb_strv linked_project_name = { 0 };
 	cb_project_t* linked_project = NULL;
-	const char* linked_output_dir; /* to keep track of the .obj generated */
-	const char* path_prefix = NULL;
-	cb_project_t* project = NULL;
-    const char* std_out = NULL;
-    const char* std_err = NULL;
-    cb_context* ctx = cb_current_context();
-
-    const char* abs_file_str = NULL; /* @TODO comment this. */
-    
-    /* Absolute path of the source file being compiled. */
-    cb_strv abs_file = { 0 };
+	const char* tmp = NULL; /* Temp string */
+	const char* _ = "  ";   /* Space to separate command arguments */
+	cb_size tmp_index = 0;  /* to save temporary allocation index */
+	const char* obj_args = NULL; /* .o files or response file containing them */
+	const char* artefact = NULL;
+	const char* signature_path = NULL;
+	cb_bool up_to_date = cb_false;
+	cb_bool result = cb_true;
+	cb_size i = 0;
+	cb_trace_event event;
 
-    /* Relative path of the source. */
-    cb_strv relative_path = { 0 };
-    cb_strv relative_path_fmt = { 0 } ;
-    /* Absolute path of the object generated. */
-    cb_strv obj_abs_path = { 0 };
-    cb_strv options_content = { 0 };
-    cb_bool can_process_file = cb_false;
-   
-	cb_size tmp_index = 0;
+	tmp_index = cb_tmp_save();
 
-	project = cb_find_project_by_name_str(project_name);
+	/* Projects are linked at any time, they are not the current project. */
+	cb_trace_event_begin(&event, "check", "link", NULL);
+	event.project_name = project_name;
 
-	if (!project)
-	{
-		return NULL;
-	}
+	cb_dstr_init(&str_link);
+	cb_dstr_init(&str_obj);
+	cb_dstr_init(&signature);
+	cb_darrT_init(&copied_libraries);
 
-	cb_log_trace("Start baking... %s", project_name);
+	/* Handle binary type */
 
-	cb_dstr_init(&str_options);
-    cb_dstr_init(&str_link);
-	cb_dstr_init(&str_obj);
+	is_exe = cb_property_equals(project, cb_BINARY_TYPE, cb_EXE);
+	is_shared_library = cb_property_equals(project, cb_BINARY_TYPE, cb_SHARED_LIBRARY);
+	is_static_library = cb_property_equals(project, cb_BINARY_TYPE, cb_STATIC_LIBRARY);
 
-	/* Get and format output directory */
-	output_dir = cb_get_output_directory(project, tc);
+	if (is_exe)
+	{
+		/* Possible artefact format: /my/path/my_program */
+		artefact = cb_tmp_sprintf("%s%s", output_dir, project_name);
+	}
+	else if (is_static_library)
+	{
+		/* Possible artefact format: /my/path/my_program.a */
+		artefact = cb_tmp_sprintf("%slib%s%s", output_dir, project_name, ".a");
+	}
+	else if (is_shared_library)
+	{
+		/* Possible artefact format: /my/path/my_program.so */
+		artefact = cb_tmp_sprintf("%slib%s%s", output_dir, project_name, ".so");
+	}
+	else
+	{
+		cb_log_error("Unknown binary type");
+		cb_set_and_goto(result, cb_false, exit);
+	}
 
-	/* Create output directory if it does not exist yet. */
-	cb_create_directories(output_dir, strlen(output_dir));
+	cb_dstr_append_f(&signature, "%s\n%s\n", tc->program, artefact);
 
-    cb_plugins_bake_starting();
-            
-    cb_plugins_extra_argument(&str_options);
-	
-	/* Append compiler flags */
+	/* Append .obj */
+	for (i = 0; i < cb_darrT_size(&bake->obj_paths); i += 1)
 	{
-		range = cb_mmap_get_range_str(&project->mmap, cb_CXFLAGS);
-		while (cb_mmap_range_get_next(&range, &current))
+		/* Sometimes a .c or .cpp file is empty which does not create any obj file.
+		   Therefore we need prevent it to get into the obj list. */
+		if (cb_gcc_append_file_signature(&signature, cb_darrT_at(&bake->obj_paths, i)))
 		{
-			cb_dstr_append_f(&str_options,"%s ", current.u.strv.data);
+			cb_dstr_append_f(&str_obj, "\"%s\" ", cb_darrT_at(&bake->obj_paths, i));
 		}
 	}
 
-	/* Append include directories */
+	/* Append libraries */
 	{
-		range = cb_mmap_get_range_str(&project->mmap, cb_INCLUDE_DIRECTORIES);
+		range = cb_mmap_get_range_str(&project->mmap, cb_LIBRARIES);
 		while (cb_mmap_range_get_next(&range, &current))
 		{
-			/* Absolute file is created using the tmp buffer allocator but we don't need it once it's inserted into the dynamic string */
-			tmp_index = cb_tmp_save();
-			cb_dstr_append_f(&str_options, "/I\"%s\" ", cb_path_get_absolute_dir(current.u.strv.data));
-			cb_tmp_restore(tmp_index);
+			cb_dstr_append_f(&str_link, "-l \"%s\" ", current.u.strv.data);
 		}
 	}
-	
-	/* Append preprocessor definition */
-	{
-		range = cb_mmap_get_range_str(&project->mmap, cb_DEFINES);
-		while (cb_mmap_range_get_next(&range, &current))
+
+	/* Add linker flags */
+	{
+		lflag_range = cb_mmap_get_range_str(&project->mmap, cb_LFLAGS);
+		while (cb_mmap_range_get_next(&lflag_range, &current_lflag))
 		{
-			cb_dstr_append_f(&str_options, "/D\"%s\" ", current.u.strv.data);
+			cb_dstr_append_strv(&str_link, current_lflag.u.strv);
+			cb_dstr_append_str(&str_link, _);
 		}
 	}
 
-	/* Compile source file and create the .obj at the appropriate place. */
+	/* For each linked project we add the link information to the gcc command */
+	range = cb_mmap_get_range_str(&project->mmap, cb_LINK_PROJECTS);
+	if (range.count > 0)
 	{
-        options_content = cb_strv_make_str(str_options.data);
-        
-		range = cb_mmap_get_range_str(&project->mmap, cb_FILES);
+		/* Give some parameters to the linker to look for the shared library next to the binary being built */
+		cb_dstr_append_str(&str_link, " -Wl,-rpath,$ORIGIN ");
+
 		while (cb_mmap_range_get_next(&range, &current))
 		{
-			/* Absolute file is created using the tmp buffer allocator but we don't need it once it's inserted into the dynamic string */
-			tmp_index = cb_tmp_save();
-
-			/* Fail compilation if a file does not exists. */
-            abs_file_str = cb_path_get_absolute_file(current.u.strv.data);
+			linked_project_name = current.u.strv;
 
-			if (!cb_path_exists(abs_file_str))
+			linked_project = cb_find_project_by_name(linked_project_name);
+			if (!linked_project)
 			{
-				cb_log_error("File does not exists: %s", abs_file_str);
-				cb_set_and_goto(artefact, NULL, exit);
+				cb_set_and_goto(result, cb_false, exit);
 			}
-	
-            can_process_file = cb_plugins_can_process_file(abs_file_str);
-
-            {
-                abs_file = cb_strv_make_str(abs_file_str);
 
-                relative_path = cb_path_get_relative_path(abs_file);
-                relative_path_fmt = cb_path_to_obj_path(relative_path);
+			linked_output_dir = cb_get_output_directory(linked_project, tc);
 
-                /* Combine output dir and relative path of the src file. */
-                obj_abs_path = cb_tmp_strv_printf("%s" CB_STRV_FMT ".obj", output_dir, CB_STRV_ARG(relative_path_fmt));
-            }
-            
-            if (can_process_file)
-            {
-                /* /utf-8: by default since it's retrocompatible with utf-8 */
-                /* /nologo: to avoid undesirable messages in the command line. */
-                /* /c: compile only since we run the linker after all source file have beenc ompiled. */
-                const char* full_compile_command = cb_tmp_sprintf(
-                    /* cl.exe program */
-                    "%s /utf-8 /nologo /c "
-                    /* Option string content */
-                    CB_STRV_FMT " "
-                    /* Absolute path of the existing source file. */
-                    "\"" CB_STRV_FMT "\" "
-                    /* Absolute path of the resulting .obj file. */
-                    "/Fo\"" CB_STRV_FMT "\" " ,
-                    tc->program,
-                    CB_STRV_ARG(options_content),
-                    CB_STRV_ARG(abs_file),
-                    CB_STRV_ARG(obj_abs_path)
-                );
-                
-                /* Execute cl.exe */
-                
-                /* When plugins are used we capture the standard outputs which might be processed by one of the plugin. */
-                if (ctx->plugin_count > 0)
-                {
-                    cb_bool also_stderr = cb_true;
-                    cb_process_handle* process_handle = cb_process_to_string(full_compile_command, output_dir, also_stderr);
+			/* Is static lib or shared lib */
+			if (cb_property_equals(linked_project, cb_BINARY_TYPE, cb_STATIC_LIBRARY))
+			{
+				/* -L "my/path/" -l "my_proj" */
+				cb_dstr_append_f(&str_link, "-L \"%s\" -l \"%.*s\" ", linked_output_dir, linked_project_name.size, linked_project_name.data);
 
-                    if (process_handle == 0)
-                    {
-                        cb_set_and_goto(artefact, NULL, exit);
-                    }
-                    
-                    std_out = cb_process_stdout_string(process_handle);
-                    std_err = cb_process_stderr_string(process_handle);
-           
-                    /* Only mark the file as processed if the command line was correctly run */
-                    if (process_handle->exit_code == 0)
-                    {
-                        cb_plugins_file_processed(abs_file_str, std_out, std_err);
-                    }
-					else
-					{
-						if (std_out)
-						{
-							cb_log_error(std_out);
-						}
-						if (std_err)
-						{
-							cb_log_error(std_err);
-						}
-					}
+				/* The library is relinked when the static library changes. */
+				tmp = cb_tmp_sprintf("%slib%.*s.a", linked_output_dir, linked_project_name.size, linked_project_name.data);
+				cb_gcc_append_file_signature(&signature, tmp);
+			}
 
-                    if (cb_process_end(process_handle) != 0)
-                    {
-                        cb_set_and_goto(artefact, NULL, exit);
-                    }
-                }
-                else
-                {
-                    if (cb_process_in_directory(full_compile_command, output_dir) != 0)
-                    {
-                        cb_set_and_goto(artefact, NULL, exit);
-                    }
-                }
-            }
-            
-            /* Sometimes a .c or .cpp file is empty which does not create any obj file.
-               Therefore we need prevent it to get into the obj list. */
-            if (cb_path_exists(obj_abs_path.data))
+			/* Is shared library */
+			if (cb_property_equals(linked_project, cb_BINARY_TYPE, cb_SHARED_LIBRARY))
 			{
-                cb_dstr_append_f(&str_obj, "\"" CB_STRV_FMT "\" ", CB_STRV_ARG(obj_abs_path));
-            }
+				cb_dstr_append_f(&str_link, "-L \"%s\" -l \"%.*s\" ", linked_output_dir, linked_project_name.size, linked_project_name.data);
 
-            cb_tmp_restore(tmp_index);
+				/* libmy_project.so */
+				tmp = cb_tmp_sprintf("%slib%.*s.so", linked_output_dir, linked_project_name.size, linked_project_name.data);
+				cb_gcc_append_file_signature(&signature, tmp);
+				cb_darrT_push_back(&copied_libraries, tmp);
+
+				/* The copy needs to exist as well. */
+				if (!cb_path_exists(cb_tmp_sprintf("%slib%.*s.so", output_dir, linked_project_name.size, linked_project_name.data)))
+				{
+					cb_dstr_append_str(&signature, "missing copy\n");
+				}
+			}
 		}
 	}
 
-    /* Add linker flags */
-    {
-        lflag_range = cb_mmap_get_range_str(&project->mmap, cb_LFLAGS);
-        while (cb_mmap_range_get_next(&lflag_range, &current_lflag))
-        {
-            cb_dstr_append_strv(&str_link, current_lflag.u.strv);
-            cb_dstr_append_str(&str_link, _);
-        }
-    }
-            
-    /* Compute link string to append to the cl.exe command at a later stage */
-    {
-        /* For each linked project we add the link information to the cl.exe command */
-          
-        range = cb_mmap_get_range_str(&project->mmap, cb_LINK_PROJECTS);
-        if (range.count > 0)
-        {
-            /* Iterate all the linked projects */
-            while (cb_mmap_range_get_next(&range, &current))
-            {
-                linked_project_name = current.u.strv;
-
-                linked_project = cb_find_project_by_name(linked_project_name);
-                if (!project)
-                {
-                    cb_set_and_goto(artefact, NULL, exit);
-                }
-
-                linked_output_dir = cb_get_output_directory(linked_project, tc);
-
-                /* is shared or static library */
-                if (cb_property_equals(linked_project, cb_BINARY_TYPE, cb_SHARED_LIBRARY)
-                    || cb_property_equals(linked_project, cb_BINARY_TYPE, cb_STATIC_LIBRARY))
-                {
-                    /* /LIBPATH:"output/dir/" "mlib.lib" */
-                    cb_dstr_append_f(&str_link, "/LIBPATH:\"%s\" \"%.*s.lib\" ", linked_output_dir, linked_project_name.size, linked_project_name.data);
-                }
+	cb_dstr_append_f(&signature, "%s\n", str_link.data);
 
-                /* is shared library */
-                if (cb_property_equals(linked_project, cb_BINARY_TYPE, cb_SHARED_LIBRARY))
-                {
-                    path_prefix = cb_tmp_sprintf("%s%.*s", linked_output_dir, linked_project_name.size, linked_project_name.data);
-                    /* .dll */
-                    tmp = cb_tmp_sprintf("%s.dll", path_prefix);
-                    if (!cb_copy_file_to_dir(tmp, output_dir))
-                    {
-                        cb_set_and_goto(artefact, NULL, exit);
-                    }
+	/* Skip the link if nothing changed since the last one. */
+	signature_path = cb_tmp_sprintf("%s%s.link", output_dir, project_name);
+	up_to_date = cb_path_exists(artefact) && cb_file_content_equals(signature_path, signature.data, signature.size);
 
-                    /* .exp */
-                    tmp = cb_tmp_sprintf("%s.exp", path_prefix);
-                    if (!cb_copy_file_to_dir(tmp, output_dir))
-                    {
-                        cb_log_warning("Missing .exp. Shared libraries usually need to have some symbol exported with '__declspec(dllexport)'");
-                        cb_set_and_goto(artefact, NULL, exit);
-                    }
+	bake->artefact = cb_str_dup(artefact);
 
-                    /* .lib */
-                    tmp = cb_tmp_sprintf("%s.lib", path_prefix);
-                    if (!cb_copy_file_to_dir(tmp, output_dir))
-                    {
-                        cb_log_warning("Missing .lib file. Shared libraries must create a .lib file for other program to be linked with at compile time.");
-                        cb_set_and_goto(artefact, NULL, exit);
-                    }
+	if (up_to_date)
+	{
+		cb_log_debug("Link of '%s' skipped, nothing changed.", project_name);
+		cb_set_and_goto(result, cb_true, exit);
+	}
 
-                    /* Copy .pdb if there is any. */
-                    tmp = cb_tmp_sprintf("%s.pdb", path_prefix);
-                    cb_try_copy_file_to_dir(tmp, output_dir);
-                }
-            }
-        }
-    }
+	/* The signature is written once the link succeeded. */
+	remove(signature_path);
+	bake->link_signature_path = cb_str_dup(signature_path);
+	bake->link_signature = cb_str_dup(signature.data);
 
-	/* Append libraries like gdi32.lib */
+	for (i = 0; i < cb_darrT_size(&copied_libraries); i += 1)
 	{
-		range = cb_mmap_get_range_str(&project->mmap, cb_LIBRARIES);
-		while (cb_mmap_range_get_next(&range, &current))
+		if (!cb_copy_file_to_dir(cb_darrT_at(&copied_libraries, i), output_dir))
 		{
-			cb_dstr_append_f(&str_link, "\"%s.lib\" ", current.u.strv.data);
+			cb_set_and_goto(result, cb_false, exit);
 		}
 	}
-	
-    cb_strv link_content = cb_strv_make_str(str_link.data);
-
-    /* Format artifact (exe, static library or shared library) path. */
-    
-    /* Handle binary type. */
-
-	cb_bool is_exe = cb_property_equals(project, cb_BINARY_TYPE, cb_EXE);
-	cb_bool is_shared_library = cb_property_equals(project, cb_BINARY_TYPE, cb_SHARED_LIBRARY);
-	cb_bool is_static_library = cb_property_equals(project, cb_BINARY_TYPE, cb_STATIC_LIBRARY);
 
-	/* Execute lib.exe or link.exe */
-    if (is_exe)
-    {
-        /* Possible artefact name: my/path/my_program.exe */
-        artefact = cb_tmp_sprintf("%s%s%s", output_dir, project_name, ".exe");
-        
-        /* link.exe /NOLOGO /OUT:"output/dir/my_program.exe" /LIBPATH:"output/dir/" a.obj b.obj c.obj ... */
-		tmp = cb_tmp_sprintf("link.exe /NOLOGO /OUT:\"%s\"  /LIBPATH:\"%s\" %s " CB_STRV_FMT, artefact, output_dir, str_obj.data, CB_STRV_ARG(link_content));
+	/* Thousands of .o could exceed the maximum length of a command line. */
+	obj_args = cb_get_args_or_response_file(&str_obj, output_dir, project_name);
+	if (!obj_args)
+	{
+		cb_set_and_goto(result, cb_false, exit);
+	}
 
-		error_msg = "Could not execute command to build executable: %s";
-    }
+	/* Execute ar or gcc for linking */
+	if (is_exe)
+	{
+		/* gcc /my/path/mylib.o /my/path/myotherlib.o -o /my/path/my_program -L/my/path/libs -lother -lm */
+		tmp = cb_tmp_sprintf("%s %s -o \"%s\" %s", tc->program, obj_args, artefact, str_link.data);
+	}
 	else if (is_static_library)
 	{
-        /* Possible artefact name: my/path/my_lib.lib */
-        artefact = cb_tmp_sprintf("%s%s%s", output_dir, project_name, ".lib");
-        
-		/* lib.exe /NOLOGO /OUT:"output/dir/my_lib.lib" /LIBPATH:"output/dir/" a.obj b.obj c.obj ... */
-		tmp = cb_tmp_sprintf("lib.exe /NOLOGO /OUT:\"%s\"  /LIBPATH:\"%s\" %s ", artefact, output_dir, str_obj.data);
-
-		error_msg = "Could not execute command to build static library: %s";
+		/* Create libXXX.a in the output directory */
+		/* Example: ar -crs libMyLib.a MyObjectAo MyObjectB.o */
+		tmp = cb_tmp_sprintf("ar -crs \"%s\" %s ", artefact, obj_args);
 	}
-    else if (is_shared_library)
-    {
-        /* Possible artefact name: my/path/my_lib.dll */
-        artefact = cb_tmp_sprintf("%s%s%s", output_dir, project_name, ".dll");
-        
-        /* link.exe /NOLOGO /DLL /OUT:"output/dir/my_lib.dll" /LIBPATH:"output/dir/" a.obj b.obj c.obj ... */
-		tmp = cb_tmp_sprintf("link.exe /NOLOGO /DLL /OUT:\"%s\"  /LIBPATH:\"%s\" %s " CB_STRV_FMT, artefact, output_dir, str_obj.data, CB_STRV_ARG(link_content));
-		
-		error_msg = "Could not execute command to build shared library: %s";
+	else
+	{
+		/* gcc -shared /my/path/mylib.o /my/path/myotherlib.o  -o /my/path/libmylibrary.so -L/my/path/libs -lother -lm */
+		tmp = cb_tmp_sprintf("%s -shared %s -o \"%s\" %s", tc->program, obj_args, artefact, str_link.data);
 	}
-    else
-    {
-        cb_log_error("Unknown binary type");
-		cb_set_and_goto(artefact, NULL, exit);
-    }
-    
-    if (cb_process_in_directory(tmp, output_dir) != 0)
-    {
-        cb_log_error(error_msg, project_name);
-        cb_set_and_goto(artefact, NULL, exit);
-    }
+
+	bake->link_command = cb_str_dup(tmp);
 
 exit:
-	cb_dstr_destroy(&str_options);
-    cb_dstr_destroy(&str_link);
+	cb_dstr_destroy(&str_link);
 	cb_dstr_destroy(&str_obj);
+	cb_dstr_destroy(&signature);
+	cb_darrT_destroy(&copied_libraries);
 
-	return artefact;
-}
-
-#else
-
-/* ================================================================ */
-/* toolchain GCC */
-/* ================================================================ */
+	cb_trace_event_end(&event);
+	cb_tmp_restore(tmp_index);
 
-/* #gcc #toolchain */
+	return result;
+}
 
-CB_API const char*
-cb_toolchain_gcc_bake(cb_toolchain_t* tc, const char* project_name)
-{
-    /* Will contains most of the defines, flags, innclude paths etc. */
-	cb_dstr str_options = { 0 };
-    /* Will contains most of the arguments to link the program. */
-    cb_dstr str_link = { 0 };
-    /* Will contains all the .obj generated.*/
-	cb_dstr str_obj = { 0 };
-    
-    /* Output directory. Contains the directory path of the binary being created. */
-	const char* output_dir = NULL;        
+/* Notify the plugins that the project is done. */
+CB_INTERNAL void
+cb_gcc_bake_end(cb_gcc_bake* bake)
+{
+	CB_ASSERT(bake->running_count == 0);
 
-	cb_bool is_exe = cb_false;
-	cb_bool is_static_library = cb_false;
-	cb_bool is_shared_library = cb_false;
+	if (bake->state != cb_bake_state_DONE)
+	{
+		bake->state = cb_bake_state_FAILED;
+	}
 
-	cb_kv_range range = { 0 };
-	cb_kv current = { 0 };       /* Temporary kv to store results. */
-	cb_kv_range lflag_range = { 0 };
-	cb_kv current_lflag = { 0 };
-	 
-    const char* abs_file_str = NULL;
-    cb_strv abs_file = { 0 };
-    cb_strv relative_path = { 0 };
-    cb_strv relative_path_fmt = { 0 };
-    cb_strv obj_abs_path = { 0 };
-    cb_strv dep_abs_path = { 0 };
-    cb_strv options_content = { 0 };
-    const char* full_compile_command = NULL;
-    cb_bool can_process_file = cb_false;
+	bake->ended = cb_true;
+	cb_plugins_bake_finished(bake->project);
+}
 
-	const char* linked_output_dir = NULL;
-	cb_strv linked_project_name = { 0 };
-	cb_project_t* linked_project = NULL;
-	const char* tmp = NULL; /* Temp string */
-	const char* _ = "  ";   /* Space to separate command arguments */
-	cb_size tmp_index = 0;  /* to save temporary allocation index */
-    
-    /* Full path of the artifact returned from this function */
-	const char* artefact = NULL;
-	const char* error_msg = "";
+CB_INTERNAL void
+cb_gcc_bake_destroy(cb_gcc_bake* bake)
+{
+	cb_size i = 0;
 
-	cb_project_t* project = NULL;
-    
-    cb_plugins_bake_starting();
-    
-	project = cb_find_project_by_name_str(project_name);
-	
-	if (!project)
+	cb_cmd_destroy(bake->compile_options);
+
+	/* Jobs that have been finished are already released. */
+	for (i = 0; i < cb_darrT_size(&bake->compile_jobs); i += 1)
 	{
-		return NULL;
+		cb_compile_job_destroy(cb_darrT_ptr(&bake->compile_jobs, i));
 	}
+	cb_darrT_destroy(&bake->compile_jobs);
 
-	/* gcc command */
-	
-	cb_dstr_init(&str_options);
-    cb_dstr_init(&str_link);
-	cb_dstr_init(&str_obj);
+	for (i = 0; i < cb_darrT_size(&bake->obj_paths); i += 1)
+	{
+		CB_FREE(cb_darrT_at(&bake->obj_paths, i));
+	}
+	cb_darrT_destroy(&bake->obj_paths);
 
-	/* Get and format output directory */
-	output_dir = cb_get_output_directory(project, tc);
+	CB_FREE(bake->link_command);
+	CB_FREE(bake->link_signature);
+	CB_FREE(bake->link_signature_path);
+	CB_FREE(bake->artefact);
+}
 
-	/* Create output directory if it does not exist yet. */
-	cb_create_directories(output_dir, strlen(output_dir));
+/* Get the index of a free slot. There must be one. */
+CB_INTERNAL int
+cb_gcc_bake_free_slot(cb_process_handle* handles[], int slot_count)
+{
+	int slot = 0;
+	for (slot = 0; slot < slot_count && handles[slot] != NULL; slot += 1)
+	{
+	}
+	CB_ASSERT(slot < slot_count);
+	return slot;
+}
 
-    /* Append extra flags depending on the plugin used */
-    cb_plugins_extra_argument(&str_options);
-   
-	/* Append compiler flags */
+/* Bake projects which are sorted so that linked projects come first.
+   The files of all the projects are compiled at the same time, up to the highest number of jobs of the projects,
+   each project using at most its own number of jobs. A project is linked as soon as its files are compiled
+   and the projects it links are linked. The callbacks of the plugins are given the project they are called for. */
+CB_INTERNAL cb_bool
+cb_gcc_bake_projects(cb_toolchain_t* tc, cb_project_t* projects[], cb_size count, const char** last_artefact)
+{
+	cb_context* ctx = cb_current_context();
+	cb_project_t* current_project = ctx->current_project;
+
+	cb_gcc_bake* bakes = NULL;
+	cb_gcc_bake* bake = NULL;
+	cb_compile_job* job = NULL;
+	int previous_state = 0;
+
+	int slot_count = 1;                 /* Maximum number of processes running at the same time. */
+	int running_count = 0;              /* Number of processes running. */
+	int slot = 0;
+	cb_process_handle** handles = NULL; /* Handles of the running processes, NULL for free slots. */
+	cb_gcc_bake** slot_bakes = NULL;    /* Project of each running process. */
+	cb_compile_job** slot_jobs = NULL;  /* Compilation of each running process, NULL for a link. */
+
+	cb_bool failed = cb_false;          /* Nothing new is started once something failed. */
+	cb_bool progress = cb_false;        /* Something changed since the last process ended. */
+	cb_bool result = cb_true;
+	cb_size i = 0;
+
+	if (last_artefact)
 	{
-		range = cb_mmap_get_range_str(&project->mmap, cb_CXFLAGS);
-		while (cb_mmap_range_get_next(&range, &current))
-		{
-			cb_dstr_append_f(&str_options, CB_STRV_FMT " ", CB_STRV_ARG(current.u.strv));
-		}
+		*last_artefact = NULL;
 	}
 
-	/* Append include directories */
+	if (count == 0)
 	{
-		range = cb_mmap_get_range_str(&project->mmap, cb_INCLUDE_DIRECTORIES);
-		while (cb_mmap_range_get_next(&range, &current))
-		{
-			tmp_index = cb_tmp_save();
-			cb_dstr_append_f(&str_options, "-I \"%s\" ", cb_path_get_absolute_dir(current.u.strv.data));
-			cb_tmp_restore(tmp_index);
-		}
+		return cb_true;
 	}
 
-	/* Append preprocessor definition */
+	bakes = (cb_gcc_bake*)CB_MALLOC(count * sizeof(cb_gcc_bake));
+	CB_ASSERT(bakes);
+	memset(bakes, 0, count * sizeof(cb_gcc_bake));
+
+	for (i = 0; i < count; i += 1)
 	{
-		range = cb_mmap_get_range_str(&project->mmap, cb_DEFINES);
-		while (cb_mmap_range_get_next(&range, &current))
+		bakes[i].project = projects[i];
+		bakes[i].state = cb_bake_state_NONE;
+		if (cb_get_jobs(projects[i]) > slot_count)
 		{
-			cb_dstr_append_f(&str_options, "-D%.*s ", current.u.strv);
+			slot_count = cb_get_jobs(projects[i]);
 		}
 	}
 
-	/* Append .c files and .obj */
+	handles = (cb_process_handle**)CB_MALLOC(slot_count * sizeof(cb_process_handle*));
+	slot_bakes = (cb_gcc_bake**)CB_MALLOC(slot_count * sizeof(cb_gcc_bake*));
+	slot_jobs = (cb_compile_job**)CB_MALLOC(slot_count * sizeof(cb_compile_job*));
+	CB_ASSERT(handles && slot_bakes && slot_jobs);
+	memset(handles, 0, slot_count * sizeof(cb_process_handle*));
+
+	for (;;)
 	{
-       options_content = cb_strv_make_str(str_options.data);
-           
-		range = cb_mmap_get_range_str(&project->mmap, cb_FILES);
-		while (cb_mmap_range_get_next(&range, &current))
+		progress = cb_false;
+
+		/* Start what can be started, linked projects first. */
+		for (i = 0; i < count; i += 1)
 		{
-            /* Absolute file is created using the tmp buffer allocator but we don't need it once it's inserted into the dynamic string */
-			tmp_index = cb_tmp_save();
+			bake = &bakes[i];
+			previous_state = bake->state;
 
-			/* Fail compilation if a file does not exists. */
-			abs_file_str = cb_path_get_absolute_file(current.u.strv.data);
+			if (bake->state == cb_bake_state_NONE
+				&& !failed)
+			{
+				/* The plugins can use the slots that are not used by the other projects. */
+				ctx->free_jobs = slot_count - running_count;
+				cb_gcc_bake_start(tc, bake);
+				ctx->free_jobs = -1;
+			}
 
-			if (!cb_path_exists(abs_file_str))
+			/* Compile the files of the project while there are free slots. */
+			while (bake->state == cb_bake_state_COMPILING
+				&& !failed
+				&& !bake->compile_failed
+				&& bake->next_job < cb_darrT_size(&bake->compile_jobs)
+				&& bake->running_count < bake->jobs
+				&& running_count < slot_count)
 			{
-				cb_log_error("File does not exists: %s", abs_file_str);
-				cb_set_and_goto(artefact, NULL, exit);
+				job = cb_gcc_bake_start_compile(bake);
+				if (job)
+				{
+					slot = cb_gcc_bake_free_slot(handles, slot_count);
+					handles[slot] = job->handle;
+					slot_bakes[slot] = bake;
+					slot_jobs[slot] = job;
+					running_count += 1;
+				}
 			}
 
-            can_process_file = cb_plugins_can_process_file(abs_file_str);
-            
-            {
-                abs_file = cb_strv_make_str(abs_file_str);
+			/* All the compilations of the project are done. */
+			if (bake->state == cb_bake_state_COMPILING
+				&& bake->running_count == 0
+				&& (bake->compile_failed || bake->next_job == cb_darrT_size(&bake->compile_jobs)))
+			{
+				bake->state = bake->compile_failed ? cb_bake_state_FAILED : cb_bake_state_WAITING;
+			}
 
-                relative_path = cb_path_get_relative_path(abs_file);
-                relative_path_fmt = cb_path_to_obj_path(relative_path);
+			/* Link the project once the projects it links are done. */
+			if (bake->state == cb_bake_state_WAITING
+				&& !failed
+				&& running_count < slot_count
+				&& cb_gcc_bake_can_link(bake, bakes, count))
+			{
+				if (!cb_gcc_bake_prepare_link(tc, bake))
+				{
+					bake->state = cb_bake_state_FAILED;
+				}
+				else if (!bake->link_command)
+				{
+					bake->state = cb_bake_state_DONE;
+				}
+				else
+				{
+					/* Example: gcc <o files> -o <binary> <link options> */
+					bake->link_handle = cb_create_process_handle(bake->link_command, bake->output_dir);
+					cb_process_set_trace(bake->link_handle,
+						cb_property_equals(bake->project, cb_BINARY_TYPE, cb_STATIC_LIBRARY) ? "archive" : "link",
+						bake->project, bake->artefact);
+					cb_process_start(bake->link_handle);
+					bake->state = cb_bake_state_LINKING;
+					bake->running_count += 1;
+
+					slot = cb_gcc_bake_free_slot(handles, slot_count);
+					handles[slot] = bake->link_handle;
+					slot_bakes[slot] = bake;
+					slot_jobs[slot] = NULL;
+					running_count += 1;
+				}
+			}
 
-                /* Combine output dir and relative path of the src file. */
-                obj_abs_path = cb_tmp_strv_printf("%s" CB_STRV_FMT ".o", output_dir, CB_STRV_ARG(relative_path_fmt));
-            }
-            
-            if (can_process_file)
-            {
-                /* Change extension to .d */
-                dep_abs_path = cb_path_change_extension(obj_abs_path, cb_strv_make_str(".d"));
-               
-                full_compile_command = cb_tmp_sprintf(
-                    "%s "
-                    /* Option string content */
-                    CB_STRV_FMT " -c "
-                    /* Absolute path of the existing source file. */
-                    "\"" CB_STRV_FMT "\" "
-                    /* Absolute path of the resulting .o file. */
-                    "-o \"" CB_STRV_FMT "\" " 
-                    "-MMD -MF \"" CB_STRV_FMT "\" ",
-                    tc->program,
-                    CB_STRV_ARG(options_content),
-                    CB_STRV_ARG(abs_file),
-                    CB_STRV_ARG(obj_abs_path),
-                    CB_STRV_ARG(dep_abs_path)
-                );
-                
-                /* Execute gcc */
-                /* Example: gcc <includes> -c  <c source files> */
-                
-                /* Return if exist with non zero. */
-                if (cb_process_in_directory(full_compile_command, output_dir) != 0)
-                {
-                    cb_set_and_goto(artefact, NULL, exit);
-                }
-                
-                cb_plugins_file_processed(abs_file_str, dep_abs_path.data, NULL);
-            }
-            
-            /* Sometimes a .c or .cpp file is empty which does not create any obj file.
-               Therefore we need prevent it to get into the obj list. */
-            if (cb_path_exists(obj_abs_path.data))
+			/* The project is done, notify the plugins. */
+			if ((bake->state == cb_bake_state_DONE || bake->state == cb_bake_state_FAILED)
+				&& bake->running_count == 0
+				&& !bake->ended)
 			{
-                cb_dstr_append_f(&str_obj, "\"" CB_STRV_FMT "\" ", CB_STRV_ARG(obj_abs_path));
-            }
-            
-            cb_tmp_restore(tmp_index);
+				failed = failed || bake->state == cb_bake_state_FAILED;
+				cb_gcc_bake_end(bake);
+				progress = cb_true;
+			}
+
+			progress = progress || previous_state != bake->state;
+		}
+
+		if (running_count == 0)
+		{
+			if (progress)
+			{
+				continue;
+			}
+			break;
+		}
+
+		/* Wait for a process to end. */
+		slot = cb_process_wait_any(handles, slot_count);
+		CB_ASSERT(slot >= 0);
+
+		bake = slot_bakes[slot];
+		job = slot_jobs[slot];
+		handles[slot] = NULL;
+		running_count -= 1;
+		bake->running_count -= 1;
+
+		if (job)
+		{
+			/* Do not start new compilations once one of them failed. */
+			if (!cb_compile_job_finish(bake->project, job))
+			{
+				bake->compile_failed = cb_true;
+				failed = cb_true;
+			}
+		}
+		else
+		{
+			if (cb_process_end(bake->link_handle) != 0)
+			{
+				cb_log_error("Could not link project: %s", bake->project->name.data);
+				bake->state = cb_bake_state_FAILED;
+			}
+			else
+			{
+				bake->state = cb_bake_state_DONE;
+				cb_write_file(bake->link_signature_path, bake->link_signature, strlen(bake->link_signature));
+			}
+			bake->link_handle = NULL;
 		}
 	}
 
-	/* Append libraries */
+	for (i = 0; i < count; i += 1)
 	{
-		range = cb_mmap_get_range_str(&project->mmap, cb_LIBRARIES);
-		while (cb_mmap_range_get_next(&range, &current))
+		bake = &bakes[i];
+
+		/* Projects that have been started but could not be done. */
+		if (bake->state != cb_bake_state_NONE && !bake->ended)
 		{
-			cb_dstr_append_f(&str_link, "-l \"%s\" ", current.u.strv.data);
+			cb_gcc_bake_end(bake);
 		}
+
+		result = result && bake->state == cb_bake_state_DONE;
 	}
 
-    /* Add linker flags */
-    {
-        lflag_range = cb_mmap_get_range_str(&project->mmap, cb_LFLAGS);
-        while (cb_mmap_range_get_next(&lflag_range, &current_lflag))
-        {
-            cb_dstr_append_strv(&str_link, current_lflag.u.strv);
-            cb_dstr_append_str(&str_link, _);
-        }
-    }
-        
-	/* For each linked project we add the link information to the gcc command */
-	range = cb_mmap_get_range_str(&project->mmap, cb_LINK_PROJECTS);
-	if (range.count > 0)
+	if (last_artefact && bakes[count - 1].state == cb_bake_state_DONE)
 	{
-		/* Give some parameters to the linker to look for the shared library next to the binary being built */
-		cb_dstr_append_str(&str_link, " -Wl,-rpath,$ORIGIN ");
+		*last_artefact = cb_tmp_sprintf("%s", bakes[count - 1].artefact);
+	}
 
-		while (cb_mmap_range_get_next(&range, &current))
-		{
-			linked_project_name = current.u.strv;
+	for (i = 0; i < count; i += 1)
+	{
+		cb_gcc_bake_destroy(&bakes[i]);
+	}
 
-			linked_project = cb_find_project_by_name(linked_project_name);
-			if (!project)
-			{
-				cb_set_and_goto(artefact, NULL, exit);
-			}
+	CB_FREE(bakes);
+	CB_FREE(handles);
+	CB_FREE(slot_bakes);
+	CB_FREE(slot_jobs);
 
-			linked_output_dir = cb_get_output_directory(linked_project, tc);
+	ctx->current_project = current_project;
 
-			/* Is static lib or shared lib */
-			if (cb_property_equals(linked_project, cb_BINARY_TYPE, cb_STATIC_LIBRARY)
-				|| cb_property_equals(linked_project, cb_BINARY_TYPE, cb_SHARED_LIBRARY))
-			{
-				/* -L "my/path/" -l "my_proj" */ 
-				cb_dstr_append_f(&str_link, "-L \"%s\" -l \"%.*s\" ", linked_output_dir, linked_project_name.size, linked_project_name.data);
-			}
+	return result;
+}
 
-			/* Is shared library */
-			if (cb_property_equals(linked_project, cb_BINARY_TYPE, cb_SHARED_LIBRARY))
-			{
-				/* libmy_project.so */
-				tmp = cb_tmp_sprintf("%slib%.*s.so", linked_output_dir, linked_project_name.size, linked_project_name.data);
+CB_API const char*
+cb_toolchain_gcc_bake(cb_toolchain_t* tc, const char* project_name)
+{
+	cb_project_t* project = NULL;
+	const char* artefact = NULL;
+
+	project = cb_find_project_by_name_str(project_name);
+	if (!project)
+	{
+		return NULL;
+	}
+
+	/* Linked projects are expected to be already baked. */
+	cb_gcc_bake_projects(tc, &project, 1, &artefact);
+
+	return artefact;
+}
+
+/* Write one entry per source file of the projects, the entries are written in the order of the projects. */
+CB_INTERNAL cb_bool
+cb_gcc_export_compile_commands(const cb_toolchain_t* tc, const char* path, cb_project_t* projects[], cb_size count)
+{
+	FILE* file = NULL;
+	cb_cmd* options = cb_cmd_create();
+	cb_cmd* cmd = cb_cmd_create();
+	cb_project_t* current_project = cb_current_context()->current_project;
+	const char* tmp_path = NULL;
+	const char* output_dir = NULL;
+	const char* abs_file = NULL;
+	cb_strv obj_abs_path = { 0 };
+	cb_strv dep_abs_path = { 0 };
+	cb_kv_range range = { 0 };
+	cb_kv current = { 0 };
+	cb_size tmp_index = cb_tmp_save();
+	cb_size file_tmp_index = 0;
+	cb_size i = 0;
+	cb_size j = 0;
+	cb_bool first = cb_true;
+	cb_bool result = cb_true;
+
+	/* The database is written next to the previous one, which is only replaced if the content changed. */
+	tmp_path = cb_tmp_sprintf("%s.tmp", path);
+	file = fopen(tmp_path, "wb");
+	if (!file)
+	{
+		cb_log_error("Could not open file '%s'", tmp_path);
+		cb_set_and_goto(result, cb_false, exit);
+	}
 
-				if (!cb_copy_file_to_dir(tmp, output_dir))
+	fputs("[", file);
+	for (i = 0; i < count; i += 1)
+	{
+		cb_cmd_clear(options);
+		cb_gcc_push_compile_options(options, tc, projects[i]);
+		output_dir = cb_get_output_directory(projects[i], tc);
+
+		range = cb_mmap_get_range_str(&projects[i]->mmap, cb_FILES);
+		while (cb_mmap_range_get_next(&range, &current))
+		{
+			file_tmp_index = cb_tmp_save();
+
+			/* Same arguments as cb_gcc_bake_start_compile. */
+			abs_file = cb_path_get_absolute_file(current.u.strv.data);
+			obj_abs_path = cb_path_get_object_path(output_dir, abs_file, ".o");
+			dep_abs_path = cb_path_change_extension(obj_abs_path, cb_strv_make_str(".d"));
+
+			cb_cmd_clear(cmd);
+			cb_cmd_append(cmd, options);
+			cb_gcc_push_compile_file(cmd, abs_file, obj_abs_path.data, dep_abs_path.data);
+
+			fputs(first ? "\n  {\n    \"directory\": " : ",\n  {\n    \"directory\": ", file);
+			cb_write_json_string(file, output_dir);
+			fputs(",\n    \"file\": ", file);
+			cb_write_json_string(file, abs_file);
+			fputs(",\n    \"output\": ", file);
+			cb_write_json_string(file, obj_abs_path.data);
+			fputs(",\n    \"arguments\": [", file);
+			for (j = 0; j < cb_cmd_count(cmd); j += 1)
+			{
+				if (j > 0)
 				{
-					cb_set_and_goto(artefact, NULL, exit);
+					fputs(", ", file);
 				}
+				cb_write_json_string(file, cb_cmd_at(cmd, j));
 			}
+			fputs("]\n  }", file);
+			first = cb_false;
+
+			cb_tmp_restore(file_tmp_index);
 		}
 	}
+	fputs("\n]\n", file);
 
-    /* Handle binary type */
-    
-	is_exe = cb_property_equals(project, cb_BINARY_TYPE, cb_EXE);
-	is_shared_library = cb_property_equals(project, cb_BINARY_TYPE, cb_SHARED_LIBRARY);
-	is_static_library = cb_property_equals(project, cb_BINARY_TYPE, cb_STATIC_LIBRARY);
-
-    /* Execute ar or gcc for linking */
-    if (is_exe)
-    {
-        /* Possible artefact format: /my/path/my_program */
-        artefact = cb_tmp_sprintf("%s%s", output_dir, project_name);
-        
-        /* gcc /my/path/mylib.o /my/path/myotherlib.o -o /my/path/my_program -L/my/path/libs -lother -lm */
-        tmp = cb_tmp_sprintf("%s %s -o \"%s\" %s", tc->program, str_obj.data, artefact, str_link.data);
-
-		error_msg = "Could not execute command to build executable: %s";
-    }
-	else if (is_static_library)
+	result = !ferror(file);
+	result = (fclose(file) == 0) && result;
+	if (!result)
 	{
-        /* Possible artefact format: /my/path/my_program.a */
-        artefact = cb_tmp_sprintf("%slib%s%s", output_dir, project_name, ".a");
-        
-        /* Create libXXX.a in the output directory */
-        /* Example: ar -crs libMyLib.a MyObjectAo MyObjectB.o */
-        tmp = cb_tmp_sprintf("ar -crs \"%s\" %s ", artefact, str_obj.data);
-
-		error_msg = "Could not execute command to build static library: %s";
+		cb_log_error("Could not write file '%s'", tmp_path);
+		cb_delete_file(tmp_path);
+		goto exit;
 	}
-    else if (is_shared_library)
-    {
-        /* Possible artefact format: /my/path/my_program.so */
-        artefact = cb_tmp_sprintf("%slib%s%s", output_dir, project_name, ".so");
-        
-        /* gcc -shared /my/path/mylib.o /my/path/myotherlib.o  -o /my/path/libmylibrary.so -L/my/path/libs -lother -lm */
-        tmp = cb_tmp_sprintf("%s -shared %s -o \"%s\" %s", tc->program, str_obj.data, artefact, str_link.data);
 
-		error_msg = "Could not execute command to build shared library: %s";
-    }
-    else
-    {
-        cb_log_error("Unknown binary type");
-		cb_set_and_goto(artefact, NULL, exit);
-    }
+	if (cb_files_equal(tmp_path, path))
+	{
+		cb_log_debug("Compile commands are up to date: %s", path);
+		cb_delete_file(tmp_path);
+	}
+	else if (rename(tmp_path, path) != 0)
+	{
+		cb_log_error("Could not replace file '%s': %s", path, strerror(errno));
+		cb_delete_file(tmp_path);
+		result = cb_false;
+	}
 
-    if (cb_process_in_directory(tmp, output_dir) != 0)
-    {
-		cb_log_error(error_msg, project_name);
-        cb_set_and_goto(artefact, NULL, exit);
-    }
- 
 exit:
-	cb_dstr_destroy(&str_options);
-    cb_dstr_destroy(&str_link);
-	cb_dstr_destroy(&str_obj);
+	/* The plugins changed the current project. */
+	cb_current_context()->current_project = current_project;
 
-	return artefact;
+	cb_cmd_destroy(cmd);
+	cb_cmd_destroy(options);
+	cb_tmp_restore(tmp_index);
+	return result;
 }
 
 #endif /* #else of _WIN32 */
 
 #endif /* CB_IMPL  */
 
-#endif /* CB_IMPLEMENTATION */
\ No newline at end of file
+#endif /* CB_IMPLEMENTATION */
\ No newline at end of file
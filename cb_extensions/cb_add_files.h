@@ -146,12 +146,15 @@ cb_add_files(const char* directory, const char* pattern)
 	cb_file_it it;
 	cb_file_it_init(&it, directory);
 
+	/* Files are stored all at once at the end of the batch. */
+	cb_batch_begin();
 	while (cb_file_it_get_next_glob(&it, pattern))
 	{
 		const char* filepath = cb_file_it_current_file(&it);
 
 		cb_add(cb_FILES, filepath);
 	}
+	cb_batch_end();
 }
 
 CB_API void
@@ -160,12 +163,15 @@ cb_add_files_recursive(const char* directory, const char* pattern)
 	cb_file_it it;
 	cb_file_it_init_recursive(&it, directory);
 
+	/* Files are stored all at once at the end of the batch. */
+	cb_batch_begin();
 	while (cb_file_it_get_next_glob(&it, pattern))
 	{
 		const char* filepath = cb_file_it_current_file(&it);
 
 		cb_add(cb_FILES, filepath);
 	}
+	cb_batch_end();
 }
 
 #endif /* CB_ADD_FILES_IMPL */
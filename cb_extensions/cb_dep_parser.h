@@ -41,11 +41,17 @@ struct cb_dep_parser {
     /* Buffer containing the dependency path if found. */
     char* dep_buffer;   
     size_t dep_buffer_size;
+    
+    /* The read_buffer contains the whole file. */
+    cb_bool in_memory;
 };
 
 /* Initialize parser and skip target */
 CB_API void cb_gcc_dep_parser_init(cb_dep_parser* p, char* read_buffer, size_t read_buffer_size, char* dep_buffer, size_t dep_buffer_size);
 
+/* Initialize parser with the whole content of a file (see cb_file_view), 'file' must be NULL in the other functions. */
+CB_API void cb_gcc_dep_parser_init_from_memory(cb_dep_parser* p, const char* content, size_t content_size, char* dep_buffer, size_t dep_buffer_size);
+
 /* Reset the parser with the file and skip target. */
 CB_API void cb_gcc_dep_parser_reset(cb_dep_parser* p, FILE* file);
 
@@ -84,6 +90,18 @@ CB_API void cb_gcc_dep_parser_init(cb_dep_parser* p, char* read_buffer, size_t r
     p->dep_buffer = dep_buffer;
 }
 
+CB_API void cb_gcc_dep_parser_init_from_memory(cb_dep_parser* p, const char* content, size_t content_size, char* dep_buffer, size_t dep_buffer_size)
+{
+    memset(p, 0, sizeof(cb_dep_parser));
+    /* The content is never written. */
+    p->read_buffer_size = content_size;
+    p->read_buffer = (char*)content;
+    p->in_memory = cb_true;
+    
+    p->dep_buffer_size = dep_buffer_size;
+    p->dep_buffer = dep_buffer;
+}
+
 CB_API void cb_gcc_dep_parser_reset(cb_dep_parser* p, FILE* file)
 {
     /* Current char */
@@ -94,7 +112,14 @@ CB_API void cb_gcc_dep_parser_reset(cb_dep_parser* p, FILE* file)
     p->pos = 0;
     p->end = 0;
 
-    memset(p->read_buffer, 0, p->read_buffer_size);
+    if (p->in_memory)
+    {
+        p->end = p->read_buffer_size;
+    }
+    else
+    {
+        memset(p->read_buffer, 0, p->read_buffer_size);
+    }
     memset(p->dep_buffer, 0, p->dep_buffer_size);
 
     /* Skip target (skip everything until the next ':') */
@@ -335,6 +360,11 @@ CB_INTERNAL int cb_gcc_dep_get_next_char(cb_dep_parser *p, FILE* file)
     /* If current pos reach the end, we refill the buffer */
     if (p->pos >= p->end)
     {
+        if (p->in_memory)
+        {
+            return EOF;
+        }
+        
         n = fread(p->read_buffer, 1, p->read_buffer_size, file);
 
         if (n == 0)
@@ -243,7 +243,7 @@ CB_API cb_bool cb_file_info_matches(const char *path, int flags, cb_file_info *f
         }
     }
 
-    if (flags & cb_file_info_MODIFICATION_TIME)
+    if (flags & cb_file_info_HASH)
     {
         cb_u64 hash = 0;
         if (!cb_hash_64_file(hFile, &hash))
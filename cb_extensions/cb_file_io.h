@@ -14,6 +14,49 @@ CB_API FILE* cb_file_open_write(const char* path);
 /* Write the content of a string view to a new file */
 CB_API cb_bool cb_file_write_strv(const char* filepath, cb_strv sv);
 
+/* Replace the file 'path' by the file 'new_path'. 'new_path' does not exist anymore after this call.
+   Used to write a file atomically: write to a temporary file, then replace the destination. */
+CB_API cb_bool cb_file_replace(const char* new_path, const char* path);
+
+/* Read-only view of a whole file mapped in memory. */
+typedef struct cb_file_mapping cb_file_mapping;
+struct cb_file_mapping {
+    const char* data;
+    cb_size size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+/* Map a file in memory. Returns false if the file could not be opened or mapped.
+   An empty file is a valid mapping with a NULL data. */
+CB_API cb_bool cb_file_map_readonly(const char* path, cb_file_mapping* mapping);
+
+/* Release the file mapping. Can be called on a zeroed mapping. */
+CB_API void cb_file_unmap(cb_file_mapping* mapping);
+
+/* Files smaller than this are read with a single read call, larger files are mapped in memory. */
+#ifndef CB_FILE_VIEW_MAP_THRESHOLD
+#define CB_FILE_VIEW_MAP_THRESHOLD (256 * 1024)
+#endif
+
+/* Read-only view of the whole content of a file, meant to be read sequentially.
+   'data' is null-terminated only if the file has been read (size smaller than CB_FILE_VIEW_MAP_THRESHOLD). */
+typedef struct cb_file_view cb_file_view;
+struct cb_file_view {
+    const char* data;
+    cb_size size;
+    cb_file_mapping mapping; /* Used for large files. */
+    char* buffer;            /* Used for small files. */
+};
+
+/* Returns false if the file could not be opened or read. An empty file is a valid view with a NULL data. */
+CB_API cb_bool cb_file_view_open(const char* path, cb_file_view* view);
+
+/* Release the view. Can be called on a zeroed view. */
+CB_API void cb_file_view_close(cb_file_view* view);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -25,6 +68,10 @@ CB_API cb_bool cb_file_write_strv(const char* filepath, cb_strv sv);
 #ifndef CB_FILE_IO_IMPL
 #define CB_FILE_IO_IMPL
 
+#ifndef _WIN32
+#include <sys/mman.h> /* mmap, madvise */
+#endif
+
 CB_INTERNAL FILE*
 cb_file_open(const char* path, const char* mode)
 {
@@ -95,6 +142,280 @@ cb_file_write_strv(const char* filepath, cb_strv sv)
     return cb_true;
 }
 
+CB_API cb_bool
+cb_file_replace(const char* new_path, const char* path)
+{
+#ifdef _WIN32
+    if (!MoveFileExA(new_path, path, MOVEFILE_REPLACE_EXISTING))
+#else
+    if (rename(new_path, path) != 0)
+#endif
+    {
+        cb_log_error("cb_file_replace: could not replace '%s' with '%s'", path, new_path);
+        return cb_false;
+    }
+    return cb_true;
+}
+
+#ifdef _WIN32
+
+CB_API cb_bool
+cb_file_map_readonly(const char* path, cb_file_mapping* mapping)
+{
+    LARGE_INTEGER size;
+
+    memset(mapping, 0, sizeof(cb_file_mapping));
+
+    mapping->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapping->file == INVALID_HANDLE_VALUE)
+    {
+        mapping->file = NULL;
+        return cb_false;
+    }
+
+    if (!GetFileSizeEx(mapping->file, &size))
+    {
+        cb_file_unmap(mapping);
+        return cb_false;
+    }
+
+    mapping->size = (cb_size)size.QuadPart;
+
+    /* Files of size 0 cannot be mapped. */
+    if (mapping->size == 0)
+    {
+        return cb_true;
+    }
+
+    mapping->mapping = CreateFileMappingA(mapping->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping->mapping)
+    {
+        cb_file_unmap(mapping);
+        return cb_false;
+    }
+
+    mapping->data = (const char*)MapViewOfFile(mapping->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!mapping->data)
+    {
+        cb_file_unmap(mapping);
+        return cb_false;
+    }
+
+    return cb_true;
+}
+
+CB_API void
+cb_file_unmap(cb_file_mapping* mapping)
+{
+    if (mapping->data)
+    {
+        UnmapViewOfFile(mapping->data);
+    }
+    if (mapping->mapping)
+    {
+        CloseHandle(mapping->mapping);
+    }
+    if (mapping->file)
+    {
+        CloseHandle(mapping->file);
+    }
+    memset(mapping, 0, sizeof(cb_file_mapping));
+}
+
+CB_API cb_bool
+cb_file_view_open(const char* path, cb_file_view* view)
+{
+    HANDLE file = INVALID_HANDLE_VALUE;
+    LARGE_INTEGER size;
+    DWORD bytes_read = 0;
+
+    memset(view, 0, sizeof(cb_file_view));
+
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return cb_false;
+    }
+
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return cb_false;
+    }
+
+    view->size = (cb_size)size.QuadPart;
+
+    if (view->size >= CB_FILE_VIEW_MAP_THRESHOLD)
+    {
+        CloseHandle(file);
+
+        if (!cb_file_map_readonly(path, &view->mapping))
+        {
+            return cb_false;
+        }
+        view->data = view->mapping.data;
+        view->size = view->mapping.size;
+        return cb_true;
+    }
+
+    if (view->size > 0)
+    {
+        view->buffer = (char*)CB_MALLOC(view->size + 1);
+        CB_ASSERT(view->buffer);
+
+        if (!ReadFile(file, view->buffer, (DWORD)view->size, &bytes_read, NULL) || bytes_read != view->size)
+        {
+            CloseHandle(file);
+            cb_file_view_close(view);
+            return cb_false;
+        }
+        view->buffer[view->size] = '\0';
+        view->data = view->buffer;
+    }
+
+    CloseHandle(file);
+    return cb_true;
+}
+
+#else
+
+CB_API cb_bool
+cb_file_map_readonly(const char* path, cb_file_mapping* mapping)
+{
+    struct stat st;
+    void* data = NULL;
+    int fd = open(path, O_RDONLY);
+
+    memset(mapping, 0, sizeof(cb_file_mapping));
+
+    if (fd < 0)
+    {
+        return cb_false;
+    }
+
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return cb_false;
+    }
+
+    mapping->size = (cb_size)st.st_size;
+
+    /* Files of size 0 cannot be mapped. */
+    if (mapping->size > 0)
+    {
+        data = mmap(NULL, mapping->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            mapping->size = 0;
+            return cb_false;
+        }
+        mapping->data = (const char*)data;
+    }
+
+    /* The mapping stays valid after the file descriptor is closed. */
+    close(fd);
+    return cb_true;
+}
+
+CB_API void
+cb_file_unmap(cb_file_mapping* mapping)
+{
+    if (mapping->data)
+    {
+        munmap((void*)mapping->data, mapping->size);
+    }
+    memset(mapping, 0, sizeof(cb_file_mapping));
+}
+
+CB_API cb_bool
+cb_file_view_open(const char* path, cb_file_view* view)
+{
+    struct stat st;
+    void* data = NULL;
+    cb_size offset = 0;
+    ssize_t count = 0;
+    int fd = open(path, O_RDONLY);
+
+    memset(view, 0, sizeof(cb_file_view));
+
+    if (fd < 0)
+    {
+        return cb_false;
+    }
+
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return cb_false;
+    }
+
+    view->size = (cb_size)st.st_size;
+
+    if (view->size >= CB_FILE_VIEW_MAP_THRESHOLD)
+    {
+        data = mmap(NULL, view->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (data == MAP_FAILED)
+        {
+            view->size = 0;
+            return cb_false;
+        }
+#ifdef MADV_SEQUENTIAL
+        /* Read ahead aggressively and drop the pages once they are read. */
+        madvise(data, view->size, MADV_SEQUENTIAL);
+#endif
+        view->mapping.data = (const char*)data;
+        view->mapping.size = view->size;
+        view->data = view->mapping.data;
+        return cb_true;
+    }
+
+    /* Small files are read without the copy of the stdio buffer. */
+    if (view->size > 0)
+    {
+        view->buffer = (char*)CB_MALLOC(view->size + 1);
+        CB_ASSERT(view->buffer);
+
+        while (offset < view->size)
+        {
+            count = pread(fd, view->buffer + offset, view->size - offset, (off_t)offset);
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            /* Error or file truncated while being read. */
+            if (count <= 0)
+            {
+                close(fd);
+                cb_file_view_close(view);
+                return cb_false;
+            }
+            offset += (cb_size)count;
+        }
+        view->buffer[view->size] = '\0';
+        view->data = view->buffer;
+    }
+
+    close(fd);
+    return cb_true;
+}
+
+#endif
+
+CB_API void
+cb_file_view_close(cb_file_view* view)
+{
+    cb_file_unmap(&view->mapping);
+    if (view->buffer)
+    {
+        CB_FREE(view->buffer);
+    }
+    memset(view, 0, sizeof(cb_file_view));
+}
+
 #endif /* CB_FILE_IO_IMPL */
 
 #endif /* CB_IMPLEMENTATION */
\ No newline at end of file
@@ -18,6 +18,50 @@ CB_API cb_bool cb_hash_64_file(HANDLE hFile, cb_u64* hash);
 
 CB_API cb_bool cb_hash_64_from_filename(const char* filename, cb_u64* hash);
 
+/* Identify the algorithm used to produce a stored hash. */
+typedef enum cb_hash_algorithm
+{
+    cb_hash_algorithm_NONE = 0,
+    cb_hash_algorithm_FNV1A_64 = 1, /* cb_hash_64 functions */
+    cb_hash_algorithm_WIDE_128 = 2  /* cb_hash_128 functions */
+} cb_hash_algorithm;
+
+/* 128-bit hash value. */
+typedef struct cb_hash_128_t cb_hash_128_t;
+struct cb_hash_128_t
+{
+    cb_u64 low;
+    cb_u64 high;
+};
+
+/* Data is processed by blocks of 16 stripes of 64 bytes. */
+#define CB_HASH_128_BLOCK_SIZE 1024
+
+/* Streaming state of the 128-bit hash. */
+typedef struct cb_hash_128_state cb_hash_128_state;
+struct cb_hash_128_state
+{
+    cb_u64 acc[8];
+    unsigned char buffer[CB_HASH_128_BLOCK_SIZE];
+    cb_size buffer_size;
+    cb_u64 total_size;
+};
+
+/* Wide hash in the style of XXH3, the result does not depend on the implementation (scalar, SSE2 or AVX2) selected at runtime.
+   NOTE: the result is not the same as XXH3. */
+CB_API cb_hash_128_t cb_hash_128(const void* data, cb_size size);
+CB_API void cb_hash_128_init(cb_hash_128_state* state);
+CB_API void cb_hash_128_update(cb_hash_128_state* state, const void* data, cb_size size);
+CB_API cb_hash_128_t cb_hash_128_final(cb_hash_128_state* state);
+CB_API cb_bool cb_hash_128_equals(cb_hash_128_t left, cb_hash_128_t right);
+
+CB_API cb_bool cb_hash_128_from_filename(const char* filename, cb_hash_128_t* hash);
+
+/* Name of the implementation used by the 128-bit hash: "avx2", "sse2" or "scalar". */
+CB_API const char* cb_hash_128_implementation(void);
+/* Select an implementation by name, returns false if it's not supported by the current CPU. Mostly used for testing. */
+CB_API cb_bool cb_hash_128_set_implementation(const char* name);
+
 #ifdef __cplusplus
 }
 #endif
@@ -148,39 +192,484 @@ CB_API cb_bool cb_hash_64_file(HANDLE hFile, cb_u64* hash)
 CB_API cb_bool cb_hash_64_from_filename(const char* filename, cb_u64* hash)
 {
     cb_fnv1a_64 state = {0};
-    size_t count = 0;
-    cb_u32 buffer_size = 16 * 4096;
-    char* buffer = NULL;
-      
-	FILE* file = cb_file_open_readonly(filename);
-	if (!file)
-	{
-		cb_log_error("cb_hash_64_from_filename: could not open file '%s'\n", filename);
-		return 0;
-	}
-    
+    cb_size offset = 0;
+    cb_size count = 0;
+    cb_file_view view;
+
+    if (!cb_file_view_open(filename, &view))
+    {
+        cb_log_error("cb_hash_64_from_filename: could not open file '%s'\n", filename);
+        return cb_false;
+    }
+
     state = cb_fnv1a_64_make();
-    
-    buffer = cb_tmp_alloc(buffer_size);
- 
-    while ((count = fread(buffer, 1, buffer_size, file)) != 0)
+
+    /* cb_fnv1a_64_update takes an int size. */
+    for (offset = 0; offset < view.size; offset += count)
     {
-        state = cb_fnv1a_64_update(state, buffer, (int)count);
+        count = view.size - offset < 0x40000000 ? view.size - offset : 0x40000000;
+        state = cb_fnv1a_64_update(state, (char*)view.data + offset, (int)count);
     }
 
     *hash = state;
-    
-    if (!feof(file))
+
+    cb_file_view_close(&view);
+
+    return cb_true;
+}
+
+/*-----------------------------------------------------------------------*/
+/* 128-bit hash */
+/*-----------------------------------------------------------------------*/
+
+/* Each stripe is accumulated in 8 lanes of 64 bits, lanes are independent
+   which makes the scalar, SSE2 and AVX2 implementations produce the same result. */
+
+#if !defined(CB_HASH_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define CB_HASH_SSE2
+    #endif
+    #if defined(_MSC_VER) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || defined(__clang__)
+        #define CB_HASH_AVX2
+    #endif
+#endif
+
+#if defined(CB_HASH_SSE2) || defined(CB_HASH_AVX2)
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+    #include <immintrin.h>
+#endif
+
+#if defined(CB_HASH_AVX2) && defined(__GNUC__)
+    #define CB_HASH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define CB_HASH_TARGET_AVX2
+#endif
+
+#define CB_HASH_STRIPE_SIZE 64
+#define CB_HASH_STRIPES_PER_BLOCK 16
+#define CB_HASH_SECRET_SIZE 192
+
+#define CB_HASH_PRIME32_1 0x9E3779B1U
+#define CB_HASH_PRIME32_2 0x85EBCA77U
+#define CB_HASH_PRIME32_3 0xC2B2AE3DU
+#define CB_HASH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define CB_HASH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define CB_HASH_PRIME64_3 0x165667B19E3779F9ULL
+#define CB_HASH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define CB_HASH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+/* Pseudo-random bytes (splitmix64) mixed with the data. */
+static const unsigned char cb_hash_secret[CB_HASH_SECRET_SIZE] = {
+    0xf4, 0x65, 0xb9, 0xa1, 0x6a, 0x9e, 0x78, 0x6e, 0x4f, 0x45, 0x09, 0x80, 0x18, 0x5d, 0xc4, 0x06,
+    0xec, 0x81, 0x4c, 0x72, 0xa8, 0xb8, 0x8b, 0xf8, 0x9b, 0x74, 0xa8, 0x51, 0x6a, 0x89, 0x39, 0x1b,
+    0xea, 0xa2, 0x7e, 0x74, 0x0c, 0x9f, 0xcb, 0x53, 0xe1, 0x32, 0x45, 0x1f, 0xbe, 0x9a, 0x82, 0x2c,
+    0x3c, 0xab, 0x16, 0xc9, 0x3a, 0x13, 0x84, 0xc5, 0xc3, 0x8a, 0xc9, 0x41, 0x90, 0x78, 0xe5, 0x3e,
+    0xa6, 0xb0, 0x8c, 0x36, 0x8c, 0x48, 0xb8, 0xf3, 0x09, 0x3d, 0xb1, 0x3c, 0xdd, 0xec, 0x7e, 0x65,
+    0xf6, 0xde, 0x5b, 0x05, 0xe0, 0x26, 0xd3, 0xc2, 0x7b, 0xdb, 0xbb, 0xe0, 0x3f, 0xa0, 0x21, 0x86,
+    0x2f, 0xa9, 0x3a, 0x98, 0x55, 0x75, 0x1f, 0x8e, 0x19, 0x4d, 0xcc, 0x00, 0x16, 0x0f, 0x4e, 0xb5,
+    0xab, 0x80, 0x1d, 0x97, 0x97, 0x3f, 0xbb, 0x84, 0x55, 0x12, 0x52, 0x75, 0x5c, 0x82, 0x29, 0x7d,
+    0x86, 0x7f, 0x7f, 0x2b, 0x10, 0x17, 0xcf, 0xc3, 0x64, 0x4f, 0x91, 0x83, 0xa0, 0xe9, 0x66, 0x34,
+    0xac, 0x85, 0x44, 0x5a, 0x2b, 0x8d, 0x1a, 0xd8, 0xd7, 0x9e, 0x0b, 0x10, 0x2b, 0x60, 0x01, 0xdb,
+    0x0d, 0xf1, 0x25, 0x18, 0x92, 0x8a, 0x03, 0xa9, 0x6a, 0x2f, 0xca, 0x0d, 0xd9, 0xf1, 0xf5, 0xed,
+    0x4c, 0x63, 0xd2, 0x7b, 0xd6, 0x6a, 0x49, 0x54, 0x69, 0x72, 0x40, 0xf5, 0xd4, 0x01, 0x7c, 0xdd
+};
+
+typedef void (*cb_hash_accumulate_fn)(cb_u64* acc, const unsigned char* data, cb_size stripe_count, const unsigned char* secret);
+typedef void (*cb_hash_scramble_fn)(cb_u64* acc, const unsigned char* secret);
+
+typedef struct cb_hash_128_impl cb_hash_128_impl;
+struct cb_hash_128_impl
+{
+    const char* name;
+    cb_hash_accumulate_fn accumulate;
+    cb_hash_scramble_fn scramble;
+};
+
+/* Little-endian read, compilers turn this into a single load. */
+CB_INTERNAL cb_u64 cb_hash_read_64(const unsigned char* p)
+{
+    return (cb_u64)p[0] | ((cb_u64)p[1] << 8) | ((cb_u64)p[2] << 16) | ((cb_u64)p[3] << 24)
+        | ((cb_u64)p[4] << 32) | ((cb_u64)p[5] << 40) | ((cb_u64)p[6] << 48) | ((cb_u64)p[7] << 56);
+}
+
+CB_INTERNAL void cb_hash_accumulate_scalar(cb_u64* acc, const unsigned char* data, cb_size stripe_count, const unsigned char* secret)
+{
+    cb_size n = 0;
+    int i = 0;
+    cb_u64 value = 0;
+    cb_u64 keyed = 0;
+
+    for (n = 0; n < stripe_count; n += 1)
     {
-        fclose(file);
-        return  cb_false;
+        for (i = 0; i < 8; i += 1)
+        {
+            value = cb_hash_read_64(data + n * CB_HASH_STRIPE_SIZE + i * 8);
+            keyed = value ^ cb_hash_read_64(secret + n * 8 + i * 8);
+            acc[i ^ 1] += value;
+            acc[i] += (keyed & 0xFFFFFFFFU) * (keyed >> 32);
+        }
     }
-    
-    fclose(file);
-    
+}
+
+CB_INTERNAL void cb_hash_scramble_scalar(cb_u64* acc, const unsigned char* secret)
+{
+    int i = 0;
+    cb_u64 value = 0;
+
+    for (i = 0; i < 8; i += 1)
+    {
+        value = acc[i];
+        value ^= value >> 47;
+        value ^= cb_hash_read_64(secret + i * 8);
+        acc[i] = value * CB_HASH_PRIME32_1;
+    }
+}
+
+#ifdef CB_HASH_SSE2
+
+CB_INTERNAL void cb_hash_accumulate_sse2(cb_u64* acc, const unsigned char* data, cb_size stripe_count, const unsigned char* secret)
+{
+    __m128i acc_v[4];
+    __m128i value, keyed, product;
+    cb_size n = 0;
+    int i = 0;
+
+    for (i = 0; i < 4; i += 1)
+    {
+        acc_v[i] = _mm_loadu_si128((const __m128i*)acc + i);
+    }
+
+    for (n = 0; n < stripe_count; n += 1)
+    {
+        for (i = 0; i < 4; i += 1)
+        {
+            value = _mm_loadu_si128((const __m128i*)(data + n * CB_HASH_STRIPE_SIZE) + i);
+            keyed = _mm_xor_si128(value, _mm_loadu_si128((const __m128i*)(secret + n * 8) + i));
+            /* Low 32 bits multiplied by high 32 bits of each lane. */
+            product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+            /* Swap the two lanes to add the data to the neighbour lane. */
+            value = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+            acc_v[i] = _mm_add_epi64(acc_v[i], _mm_add_epi64(product, value));
+        }
+    }
+
+    for (i = 0; i < 4; i += 1)
+    {
+        _mm_storeu_si128((__m128i*)acc + i, acc_v[i]);
+    }
+}
+
+CB_INTERNAL void cb_hash_scramble_sse2(cb_u64* acc, const unsigned char* secret)
+{
+    const __m128i prime = _mm_set1_epi32((int)CB_HASH_PRIME32_1);
+    __m128i value, low, high;
+    int i = 0;
+
+    for (i = 0; i < 4; i += 1)
+    {
+        value = _mm_loadu_si128((const __m128i*)acc + i);
+        value = _mm_xor_si128(value, _mm_srli_epi64(value, 47));
+        value = _mm_xor_si128(value, _mm_loadu_si128((const __m128i*)secret + i));
+        /* 64-bit by 32-bit multiplication. */
+        low = _mm_mul_epu32(value, prime);
+        high = _mm_mul_epu32(_mm_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        _mm_storeu_si128((__m128i*)acc + i, _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+    }
+}
+
+#endif /* CB_HASH_SSE2 */
+
+#ifdef CB_HASH_AVX2
+
+CB_HASH_TARGET_AVX2
+CB_INTERNAL void cb_hash_accumulate_avx2(cb_u64* acc, const unsigned char* data, cb_size stripe_count, const unsigned char* secret)
+{
+    __m256i acc_v[2];
+    __m256i value, keyed, product;
+    cb_size n = 0;
+    int i = 0;
+
+    for (i = 0; i < 2; i += 1)
+    {
+        acc_v[i] = _mm256_loadu_si256((const __m256i*)acc + i);
+    }
+
+    for (n = 0; n < stripe_count; n += 1)
+    {
+        for (i = 0; i < 2; i += 1)
+        {
+            value = _mm256_loadu_si256((const __m256i*)(data + n * CB_HASH_STRIPE_SIZE) + i);
+            keyed = _mm256_xor_si256(value, _mm256_loadu_si256((const __m256i*)(secret + n * 8) + i));
+            product = _mm256_mul_epu32(keyed, _mm256_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+            value = _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+            acc_v[i] = _mm256_add_epi64(acc_v[i], _mm256_add_epi64(product, value));
+        }
+    }
+
+    for (i = 0; i < 2; i += 1)
+    {
+        _mm256_storeu_si256((__m256i*)acc + i, acc_v[i]);
+    }
+}
+
+CB_HASH_TARGET_AVX2
+CB_INTERNAL void cb_hash_scramble_avx2(cb_u64* acc, const unsigned char* secret)
+{
+    const __m256i prime = _mm256_set1_epi32((int)CB_HASH_PRIME32_1);
+    __m256i value, low, high;
+    int i = 0;
+
+    for (i = 0; i < 2; i += 1)
+    {
+        value = _mm256_loadu_si256((const __m256i*)acc + i);
+        value = _mm256_xor_si256(value, _mm256_srli_epi64(value, 47));
+        value = _mm256_xor_si256(value, _mm256_loadu_si256((const __m256i*)secret + i));
+        low = _mm256_mul_epu32(value, prime);
+        high = _mm256_mul_epu32(_mm256_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        _mm256_storeu_si256((__m256i*)acc + i, _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+    }
+}
+
+CB_INTERNAL cb_bool cb_hash_cpu_has_avx2(void)
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7)
+    {
+        return cb_false;
+    }
+
+    /* AVX and OSXSAVE, then check that the OS saves the YMM registers. */
+    __cpuid(regs, 1);
+    if ((regs[2] & (1 << 27)) == 0 || (regs[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+    {
+        return cb_false;
+    }
+
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif /* CB_HASH_AVX2 */
+
+static const cb_hash_128_impl cb_hash_128_impls[] = {
+#ifdef CB_HASH_AVX2
+    { "avx2", cb_hash_accumulate_avx2, cb_hash_scramble_avx2 },
+#endif
+#ifdef CB_HASH_SSE2
+    { "sse2", cb_hash_accumulate_sse2, cb_hash_scramble_sse2 },
+#endif
+    { "scalar", cb_hash_accumulate_scalar, cb_hash_scramble_scalar }
+};
+
+#define CB_HASH_128_IMPL_COUNT (sizeof(cb_hash_128_impls) / sizeof(cb_hash_128_impls[0]))
+
+/* Selected the first time a hash is computed. */
+static const cb_hash_128_impl* cb_hash_128_current_impl = NULL;
+
+CB_INTERNAL cb_bool cb_hash_128_impl_supported(const cb_hash_128_impl* impl)
+{
+#ifdef CB_HASH_AVX2
+    if (impl->accumulate == cb_hash_accumulate_avx2)
+    {
+        return cb_hash_cpu_has_avx2();
+    }
+#endif
+    (void)impl;
+    return cb_true;
+}
+
+CB_INTERNAL const cb_hash_128_impl* cb_hash_128_get_impl(void)
+{
+    cb_size i = 0;
+
+    if (!cb_hash_128_current_impl)
+    {
+        /* Implementations are sorted from the fastest to the slowest. */
+        for (i = 0; i < CB_HASH_128_IMPL_COUNT; i += 1)
+        {
+            if (cb_hash_128_impl_supported(&cb_hash_128_impls[i]))
+            {
+                cb_hash_128_current_impl = &cb_hash_128_impls[i];
+                break;
+            }
+        }
+    }
+    return cb_hash_128_current_impl;
+}
+
+CB_INTERNAL void cb_hash_128_process_block(const cb_hash_128_impl* impl, cb_u64* acc, const unsigned char* block)
+{
+    impl->accumulate(acc, block, CB_HASH_STRIPES_PER_BLOCK, cb_hash_secret);
+    impl->scramble(acc, cb_hash_secret + CB_HASH_SECRET_SIZE - CB_HASH_STRIPE_SIZE);
+}
+
+/* Upper and lower parts of the 128-bit product folded in 64 bits. */
+CB_INTERNAL cb_u64 cb_hash_mul_128_fold_64(cb_u64 left, cb_u64 right)
+{
+    cb_u64 lo_lo = (left & 0xFFFFFFFFU) * (right & 0xFFFFFFFFU);
+    cb_u64 hi_lo = (left >> 32) * (right & 0xFFFFFFFFU);
+    cb_u64 lo_hi = (left & 0xFFFFFFFFU) * (right >> 32);
+    cb_u64 hi_hi = (left >> 32) * (right >> 32);
+    cb_u64 cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFU) + lo_hi;
+    cb_u64 upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    cb_u64 lower = (cross << 32) | (lo_lo & 0xFFFFFFFFU);
+    return lower ^ upper;
+}
+
+CB_INTERNAL cb_u64 cb_hash_avalanche(cb_u64 value)
+{
+    value ^= value >> 37;
+    value *= 0x165667919E3779F9ULL;
+    value ^= value >> 32;
+    return value;
+}
+
+CB_INTERNAL cb_u64 cb_hash_merge_acc(const cb_u64* acc, const unsigned char* secret, cb_u64 start)
+{
+    int i = 0;
+    for (i = 0; i < 4; i += 1)
+    {
+        start += cb_hash_mul_128_fold_64(acc[2 * i] ^ cb_hash_read_64(secret + 16 * i),
+            acc[2 * i + 1] ^ cb_hash_read_64(secret + 16 * i + 8));
+    }
+    return cb_hash_avalanche(start);
+}
+
+CB_API void cb_hash_128_init(cb_hash_128_state* state)
+{
+    state->acc[0] = CB_HASH_PRIME32_3;
+    state->acc[1] = CB_HASH_PRIME64_1;
+    state->acc[2] = CB_HASH_PRIME64_2;
+    state->acc[3] = CB_HASH_PRIME64_3;
+    state->acc[4] = CB_HASH_PRIME64_4;
+    state->acc[5] = CB_HASH_PRIME32_2;
+    state->acc[6] = CB_HASH_PRIME64_5;
+    state->acc[7] = CB_HASH_PRIME32_1;
+    state->buffer_size = 0;
+    state->total_size = 0;
+}
+
+CB_API void cb_hash_128_update(cb_hash_128_state* state, const void* data, cb_size size)
+{
+    const cb_hash_128_impl* impl = cb_hash_128_get_impl();
+    const unsigned char* bytes = (const unsigned char*)data;
+    cb_size count = 0;
+
+    state->total_size += size;
+
+    /* Complete the pending block first. */
+    if (state->buffer_size > 0)
+    {
+        count = CB_HASH_128_BLOCK_SIZE - state->buffer_size;
+        count = size < count ? size : count;
+
+        memcpy(state->buffer + state->buffer_size, bytes, count);
+        state->buffer_size += count;
+        bytes += count;
+        size -= count;
+
+        if (state->buffer_size < CB_HASH_128_BLOCK_SIZE)
+        {
+            return;
+        }
+
+        cb_hash_128_process_block(impl, state->acc, state->buffer);
+        state->buffer_size = 0;
+    }
+
+    /* Full blocks are processed without copy. */
+    while (size >= CB_HASH_128_BLOCK_SIZE)
+    {
+        cb_hash_128_process_block(impl, state->acc, bytes);
+        bytes += CB_HASH_128_BLOCK_SIZE;
+        size -= CB_HASH_128_BLOCK_SIZE;
+    }
+
+    if (size > 0)
+    {
+        memcpy(state->buffer, bytes, size);
+        state->buffer_size = size;
+    }
+}
+
+CB_API cb_hash_128_t cb_hash_128_final(cb_hash_128_state* state)
+{
+    const cb_hash_128_impl* impl = cb_hash_128_get_impl();
+    cb_size stripe_count = state->buffer_size / CB_HASH_STRIPE_SIZE;
+    cb_size remaining = state->buffer_size % CB_HASH_STRIPE_SIZE;
+    cb_hash_128_t result;
+
+    impl->accumulate(state->acc, state->buffer, stripe_count, cb_hash_secret);
+
+    /* The last partial stripe is padded with zeros, the total size is part of the result. */
+    if (remaining > 0)
+    {
+        memset(state->buffer + state->buffer_size, 0, CB_HASH_STRIPE_SIZE - remaining);
+        impl->accumulate(state->acc, state->buffer + stripe_count * CB_HASH_STRIPE_SIZE, 1, cb_hash_secret + stripe_count * 8);
+    }
+
+    result.low = cb_hash_merge_acc(state->acc, cb_hash_secret + 11, state->total_size * CB_HASH_PRIME64_1);
+    result.high = cb_hash_merge_acc(state->acc, cb_hash_secret + CB_HASH_SECRET_SIZE - CB_HASH_STRIPE_SIZE - 11, ~(state->total_size * CB_HASH_PRIME64_2));
+    return result;
+}
+
+CB_API cb_hash_128_t cb_hash_128(const void* data, cb_size size)
+{
+    cb_hash_128_state state;
+    cb_hash_128_init(&state);
+    cb_hash_128_update(&state, data, size);
+    return cb_hash_128_final(&state);
+}
+
+CB_API cb_bool cb_hash_128_equals(cb_hash_128_t left, cb_hash_128_t right)
+{
+    return left.low == right.low && left.high == right.high;
+}
+
+CB_API cb_bool cb_hash_128_from_filename(const char* filename, cb_hash_128_t* hash)
+{
+    cb_file_view view;
+
+    if (!cb_file_view_open(filename, &view))
+    {
+        cb_log_error("cb_hash_128_from_filename: could not open file '%s'\n", filename);
+        return cb_false;
+    }
+
+    *hash = cb_hash_128(view.data, view.size);
+
+    cb_file_view_close(&view);
+
     return cb_true;
 }
 
+CB_API const char* cb_hash_128_implementation(void)
+{
+    return cb_hash_128_get_impl()->name;
+}
+
+CB_API cb_bool cb_hash_128_set_implementation(const char* name)
+{
+    cb_size i = 0;
+    for (i = 0; i < CB_HASH_128_IMPL_COUNT; i += 1)
+    {
+        if (strcmp(cb_hash_128_impls[i].name, name) == 0 && cb_hash_128_impl_supported(&cb_hash_128_impls[i]))
+        {
+            cb_hash_128_current_impl = &cb_hash_128_impls[i];
+            return cb_true;
+        }
+    }
+    return cb_false;
+}
+
 #endif /* CB_HASH_IMPL */
 
 #endif /* CB_IMPLEMENTATION */
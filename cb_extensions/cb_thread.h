@@ -0,0 +1,185 @@
+#ifndef CB_THREAD_H
+#define CB_THREAD_H
+
+/*
+    Minimal thread API used to run work on several threads.
+    On Unix, link with -pthread (not needed with glibc 2.34 or later).
+*/
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*cb_thread_fn)(void* user_data);
+
+typedef struct cb_thread cb_thread;
+struct cb_thread {
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    cb_thread_fn fn;
+    void* user_data;
+};
+
+/* Start a thread calling fn(user_data). The cb_thread must stay valid until cb_thread_join is called. */
+CB_API cb_bool cb_thread_start(cb_thread* thread, cb_thread_fn fn, void* user_data);
+
+/* Wait for the thread to finish. */
+CB_API void cb_thread_join(cb_thread* thread);
+
+typedef void (*cb_parallel_for_fn)(void* user_data, cb_size index);
+
+/* Call fn(user_data, index) for each index in [0, count) using up to 'thread_count' threads, the calling thread is one of them.
+   Indices are distributed in a round-robin fashion. Returns once all the calls are done. */
+CB_API void cb_parallel_for(cb_size count, int thread_count, cb_parallel_for_fn fn, void* user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CB_THREAD_H */
+
+#ifdef CB_IMPLEMENTATION
+
+#ifndef CB_THREAD_IMPL
+#define CB_THREAD_IMPL
+
+#ifdef _WIN32
+
+CB_INTERNAL DWORD WINAPI cb_thread_entry(LPVOID parameter)
+{
+    cb_thread* thread = (cb_thread*)parameter;
+    thread->fn(thread->user_data);
+    /* The tmp allocator is thread-local, release its memory before the thread exits. */
+    cb_tmp_destroy();
+    return 0;
+}
+
+CB_API cb_bool cb_thread_start(cb_thread* thread, cb_thread_fn fn, void* user_data)
+{
+    thread->fn = fn;
+    thread->user_data = user_data;
+    thread->handle = CreateThread(NULL, 0, cb_thread_entry, thread, 0, NULL);
+    return thread->handle != NULL;
+}
+
+CB_API void cb_thread_join(cb_thread* thread)
+{
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    thread->handle = NULL;
+}
+
+#else
+
+CB_INTERNAL void* cb_thread_entry(void* parameter)
+{
+    cb_thread* thread = (cb_thread*)parameter;
+    thread->fn(thread->user_data);
+    /* The tmp allocator is thread-local, release its memory before the thread exits. */
+    cb_tmp_destroy();
+    return NULL;
+}
+
+CB_API cb_bool cb_thread_start(cb_thread* thread, cb_thread_fn fn, void* user_data)
+{
+    thread->fn = fn;
+    thread->user_data = user_data;
+    return pthread_create(&thread->handle, NULL, cb_thread_entry, thread) == 0;
+}
+
+CB_API void cb_thread_join(cb_thread* thread)
+{
+    pthread_join(thread->handle, NULL);
+}
+
+#endif
+
+typedef struct cb_parallel_for_worker cb_parallel_for_worker;
+struct cb_parallel_for_worker {
+    cb_thread thread;
+    cb_parallel_for_fn fn;
+    void* user_data;
+    cb_size first;
+    cb_size count;
+    cb_size stride;
+    cb_bool started;
+};
+
+CB_INTERNAL void cb_parallel_for_run(void* user_data)
+{
+    cb_parallel_for_worker* worker = (cb_parallel_for_worker*)user_data;
+    cb_size i = 0;
+
+    for (i = worker->first; i < worker->count; i += worker->stride)
+    {
+        worker->fn(worker->user_data, i);
+    }
+}
+
+CB_API void cb_parallel_for(cb_size count, int thread_count, cb_parallel_for_fn fn, void* user_data)
+{
+    cb_parallel_for_worker* workers = NULL;
+    cb_size worker_count = thread_count > 1 ? (cb_size)thread_count : 1;
+    cb_size i = 0;
+
+    if (worker_count > count)
+    {
+        worker_count = count;
+    }
+
+    if (worker_count <= 1)
+    {
+        for (i = 0; i < count; i += 1)
+        {
+            fn(user_data, i);
+        }
+        return;
+    }
+
+    workers = (cb_parallel_for_worker*)CB_MALLOC(worker_count * sizeof(cb_parallel_for_worker));
+    CB_ASSERT(workers);
+    memset(workers, 0, worker_count * sizeof(cb_parallel_for_worker));
+
+    for (i = 0; i < worker_count; i += 1)
+    {
+        workers[i].fn = fn;
+        workers[i].user_data = user_data;
+        workers[i].first = i;
+        workers[i].count = count;
+        workers[i].stride = worker_count;
+    }
+
+    /* The calling thread is the first worker. */
+    for (i = 1; i < worker_count; i += 1)
+    {
+        workers[i].started = cb_thread_start(&workers[i].thread, cb_parallel_for_run, &workers[i]);
+    }
+
+    cb_parallel_for_run(&workers[0]);
+
+    for (i = 1; i < worker_count; i += 1)
+    {
+        if (workers[i].started)
+        {
+            cb_thread_join(&workers[i].thread);
+        }
+        else
+        {
+            /* The thread could not be created, do its work here. */
+            cb_parallel_for_run(&workers[i]);
+        }
+    }
+
+    CB_FREE(workers);
+}
+
+#endif /* CB_THREAD_IMPL */
+
+#endif /* CB_IMPLEMENTATION */
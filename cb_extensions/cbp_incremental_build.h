@@ -7,6 +7,19 @@ This plugin depends on:
   cb_file_io.h
   cb_file_info.h
   cb_file_it.h
+  cb_thread.h
+
+The dependencies of each compiled file are stored in a single binary file per project: <output_dir>/cbp_ib_cache/<project name>.db
+Projects sharing the same output directory have their own database, along with the flags used to compile their units.
+It is mapped in memory at the beginning of the bake and written again (atomically) at the end of the bake.
+
+Layout of the database, all the integers are stored with the native endianness:
+
+  cbp_ib_db_header
+  cbp_ib_db_unit[unit_count]     - Compiled files sorted by path.
+  cbp_ib_db_record[record_count] - Dependencies of the units, the records of a unit are contiguous.
+  cbp_ib_db_path[path_count]     - Location of the paths in the string table.
+  char[strings_size]             - Null-terminated paths, each path is stored once.
 
 */
 
@@ -18,41 +31,185 @@ This plugin depends on:
 #include "cb_file_io.h"
 #include "cb_file_info.h"
 #include "cb_file_it.h"
-
-#ifndef CB_SSCANF
-#ifdef _WIN32
-#define CB_SSCANF sscanf_s
-#else
-#define CB_SSCANF sscanf
-#endif
-#endif
+#include "cb_thread.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define CBP_IB_DB_MAGIC "CBPIBDB"
+#define CBP_IB_DB_VERSION 2
+
+/* Files are checked on the current thread if there are not enough of them to keep several threads busy. */
+#ifndef CBP_IB_MIN_FILES_PER_THREAD
+#define CBP_IB_MIN_FILES_PER_THREAD 32
+#endif
+
+/* Status of each unit of the loaded database. */
+#define CBP_IB_UNIT_UNCHECKED 0
+#define CBP_IB_UNIT_UP_TO_DATE 1 /* The records are written again at the end of the bake. */
+#define CBP_IB_UNIT_OUTDATED 2
+
+typedef struct cbp_ib_db_header cbp_ib_db_header;
+struct cbp_ib_db_header
+{
+    char magic[8]; /* CBP_IB_DB_MAGIC */
+    cb_u32 version;
+    cb_u32 unit_count;
+    cb_u32 record_count;
+    cb_u32 path_count;
+    cb_u64 strings_size;
+    /* Length and hash of the flags used to compile the units. */
+    cb_u64 flags_len;
+    cb_u64 flags_hash;
+    cb_u64 reserved[2];
+};
+
+/* File that has been compiled. */
+typedef struct cbp_ib_db_unit cbp_ib_db_unit;
+struct cbp_ib_db_unit
+{
+    cb_u32 path_index;
+    cb_u32 first_record;
+    cb_u32 record_count;
+    cb_u32 reserved;
+};
+
+/* State of a dependency when the unit was compiled. */
+typedef struct cbp_ib_db_record cbp_ib_db_record;
+struct cbp_ib_db_record
+{
+    cb_u32 path_index;
+    cb_u32 hash_algorithm; /* cb_hash_algorithm used to compute the hash */
+    cb_u64 size;
+    cb_u64 last_modification;
+    cb_hash_128_t hash;
+};
+
+typedef struct cbp_ib_db_path cbp_ib_db_path;
+struct cbp_ib_db_path
+{
+    cb_u32 offset; /* Offset in the string table */
+    cb_u32 length; /* Length without the null-terminating char */
+};
+
+/* Read-only access to the tables of a database, either loaded from a file or being built. */
+typedef struct cbp_ib_db_view cbp_ib_db_view;
+struct cbp_ib_db_view
+{
+    const cbp_ib_db_unit* units;
+    cb_u32 unit_count;
+    const cbp_ib_db_record* records;
+    const cbp_ib_db_path* paths;
+    const char* strings;
+};
+
+/* Set of paths, each path is stored once and identified by its index. */
+typedef struct cbp_ib_path_table cbp_ib_path_table;
+struct cbp_ib_path_table
+{
+    cb_dstr strings;
+    cb_darrT(cbp_ib_db_path) paths;
+    /* Open addressing table containing path index + 1, 0 for empty slots. */
+    cb_u32* slots;
+    cb_u32 slot_capacity;
+};
+
+/* Tables of a database being built. */
+typedef struct cbp_ib_db_builder cbp_ib_db_builder;
+struct cbp_ib_db_builder
+{
+    cbp_ib_path_table paths;
+    cb_darrT(cbp_ib_db_unit) units;
+    cb_darrT(cbp_ib_db_record) records;
+    /* Index + 1 of the unit of each path, 0 if the path is not a unit. */
+    cb_darrT(cb_u32) path_units;
+};
+
+/* State of a file on disk, queried at most once per bake. */
+typedef struct cbp_ib_file_state cbp_ib_file_state;
+struct cbp_ib_file_state
+{
+    cb_bool verified; /* Size and modification time have been queried during this bake. */
+    cb_bool hashed;   /* Content has been hashed during this bake. */
+    cb_bool exists;
+    cb_u64 size;
+    cb_u64 last_modification;
+    cb_hash_128_t hash;
+};
+
+/* How the dependencies of a compiled file are checked. */
+typedef enum cbp_ib_check_policy
+{
+    /* Size and modification time must match, content is never read. */
+    cbp_ib_check_METADATA,
+    /* Size and modification time must match, or the content must match if only the modification time changed.
+       A file that has been touched without being modified is not compiled again. */
+    cbp_ib_check_TIERED,
+    /* Size and content must match, content is always read. */
+    cbp_ib_check_HASH
+} cbp_ib_check_policy;
+
 typedef struct cbp_incremental_build cbp_incremental_build;
-struct cbp_incremental_build
+
+/* State of the bake of one project, several projects can be baked at the same time. */
+typedef struct cbp_ib_bake cbp_ib_bake;
+struct cbp_ib_bake
 {
-    /* Plugin base, must stay at the top */
-    cb_plugin plugin;
-    
-    /* Current toolchain */
+    cbp_incremental_build* ib;
+
+    /* Toolchain and project being baked */
     cb_toolchain_t toolchain;
-    /* Current project */
     cb_project_t* project;
     
     /* When compiler flags or preprocessor defines are changed we need to do a full rebuild */
     cb_bool needs_full_rebuild;
+
+    /* Length and hash of the current flags. */
+    cb_u64 flags_len;
+    cb_u64 flags_hash;
+
+    /* Database loaded at the beginning of the bake. */
+    cb_file_mapping db_mapping;
+    const cbp_ib_db_header* db_header; /* NULL if there is no valid database. */
+    cbp_ib_db_view db;
+    /* CBP_IB_UNIT_XXX status of each unit of the loaded database. */
+    cb_u8* db_unit_status;
+
+    /* Units compiled during the bake. */
+    cbp_ib_db_builder compiled;
+
+    /* State of the files queried during the bake, indexed by path. */
+    cbp_ib_path_table file_state_paths;
+    cb_darrT(cbp_ib_file_state) file_states;
+};
+
+struct cbp_incremental_build
+{
+    /* Plugin base, must stay at the top */
+    cb_plugin plugin;
+
+    /* cbp_ib_check_TIERED by default. */
+    cbp_ib_check_policy check_policy;
+
+    /* Number of threads used to check the files before compiling them, 0 to use the number of jobs of the project. */
+    int check_threads;
     
-    /* Some statistics. Reset each run. */
+    /* Some statistics of all the projects being baked. Reset each run. */
     int stat_ignored;
     int stat_compilable;
+    int stat_file_state_hits;   /* Files checked without querying the file system. */
+    int stat_file_state_misses; /* Files queried from the file system. */
+    int stat_file_hashes;       /* Files whose content has been hashed. */
+
+    /* Projects being baked. */
+    cb_darrT(cbp_ib_bake*) bakes;
 };
 
 CB_API void cbp_incremental_build_init(cbp_incremental_build* plugin);
 
-/* Was created for the testing purpose to ensure that the tests run without cache. */
+/* Was created for the testing purpose to ensure that the tests run without cache.
+   Deletes the database of the current project. */
 CB_API void cbp_incremental_build_delete_cache(cbp_incremental_build* plugin);
 
 #ifdef __cplusplus
@@ -72,23 +229,50 @@ struct cb_tmp_strv_handle {
     cb_size anchor;
 };
 
-CB_INTERNAL void cbp_ib_bake_starting(cb_plugin* plugin);
-CB_INTERNAL const char* cbp_ib_extra_argument(cb_plugin* plugin);
-CB_INTERNAL cb_bool cbp_ib_can_process_file(cb_plugin* plugin, const char* file);
-CB_INTERNAL void cbp_ib_file_processed(cb_plugin* plugin, const char* file, const char* std_out, const char* std_err);
+CB_INTERNAL void cbp_ib_bake_starting(cb_plugin* plugin, cb_project_t* project);
+CB_INTERNAL const char* cbp_ib_extra_argument(cb_plugin* plugin, cb_project_t* project);
+CB_INTERNAL cb_bool cbp_ib_can_process_file(cb_plugin* plugin, cb_project_t* project, const char* file);
+CB_INTERNAL void cbp_ib_check_files(cb_plugin* plugin, cb_project_t* project, const char** files, cb_size count);
+CB_INTERNAL void cbp_ib_file_processed(cb_plugin* plugin, cb_project_t* project, const char* file, const char* std_out, const char* std_err);
+CB_INTERNAL void cbp_ib_bake_finished(cb_plugin* plugin, cb_project_t* project);
 
-/* Write a formated file info line into the dep store file. */
-CB_INTERNAL void cbp_ib_dep_store_write_info(FILE* dep_store_file, const char* file_to_record);
-/* Read a formated file info line from the dep store file. 
-   Example of line:
-     my/path/file.c;0123;0123;0123\r\n
-*/
-CB_INTERNAL cb_bool cbp_ib_dep_store_read_info(FILE* dep_store_file, char* buffer, int buffer_size, cb_file_info* file_info);
+/* Returns the bake of a project, the bake must have been started. */
+CB_INTERNAL cbp_ib_bake* cbp_ib_get_bake(cbp_incremental_build* ib, const cb_project_t* project);
 
-CB_INTERNAL cb_bool cbp_ib_check_full_rebuild_needed(cbp_incremental_build* ib);
+/* Record the current state of a dependency of the unit being recorded. */
+CB_INTERNAL void cbp_ib_record_dependency(cbp_ib_bake* bake, const char* file_to_record);
+
+CB_INTERNAL cb_bool cbp_ib_check_full_rebuild_needed(cbp_ib_bake* bake);
 
 CB_INTERNAL cb_tmp_strv_handle cbp_ib_format_dep_folder(const cb_toolchain_t* toolchain, const cb_project_t* project);
-CB_INTERNAL cb_tmp_strv_handle cbp_ib_format_dep_store_filepath(cbp_incremental_build* ib, const char* filepath);
+/* Path of the database of the project. */
+CB_INTERNAL cb_tmp_strv_handle cbp_ib_format_db_path(const cb_toolchain_t* toolchain, const cb_project_t* project);
+
+CB_INTERNAL void cbp_ib_db_load(cbp_ib_bake* bake);
+CB_INTERNAL void cbp_ib_db_release(cbp_ib_bake* bake);
+CB_INTERNAL cb_bool cbp_ib_db_write(cbp_ib_bake* bake);
+
+CB_INTERNAL void cbp_ib_path_table_init(cbp_ib_path_table* t);
+CB_INTERNAL void cbp_ib_path_table_destroy(cbp_ib_path_table* t);
+/* Returns the index of the path, add it if it does not exist yet. */
+CB_INTERNAL cb_u32 cbp_ib_path_table_intern(cbp_ib_path_table* t, const char* path, cb_size path_length);
+/* Returns the index of the path or -1 if the path is not found. */
+CB_INTERNAL int cbp_ib_path_table_find(const cbp_ib_path_table* t, const char* path, cb_size path_length, cb_u32* slot_index);
+
+/* Get the state of a file, the file system is only queried the first time.
+   The content is hashed only if 'with_hash' is true. */
+CB_INTERNAL const cbp_ib_file_state* cbp_ib_get_file_state(cbp_ib_bake* bake, const char* path, cb_size path_length, cb_bool with_hash);
+/* Returns the index of the state of a file, the state is added (but not queried) if it does not exist yet. */
+CB_INTERNAL cb_u32 cbp_ib_file_state_index(cbp_ib_bake* bake, const char* path, cb_size path_length);
+/* Query the file system for a state, doesn't update the statistics so it can be called from several threads for different states. */
+CB_INTERNAL void cbp_ib_query_file_state(cbp_ib_bake* bake, cb_u32 index, cb_bool with_hash);
+
+CB_INTERNAL void cbp_ib_db_builder_init(cbp_ib_db_builder* b);
+CB_INTERNAL void cbp_ib_db_builder_destroy(cbp_ib_db_builder* b);
+CB_INTERNAL cbp_ib_db_view cbp_ib_db_builder_view(const cbp_ib_db_builder* b);
+CB_INTERNAL void cbp_ib_db_builder_begin_unit(cbp_ib_db_builder* b, const char* path, cb_size path_length);
+CB_INTERNAL void cbp_ib_db_builder_add_record(cbp_ib_db_builder* b, const char* path, cb_size path_length, const cbp_ib_db_record* record);
+CB_INTERNAL void cbp_ib_db_builder_copy_unit(cbp_ib_db_builder* b, const cbp_ib_db_view* view, cb_u32 unit_index);
 
 /*-----------------------------------------------------------------------*/
 /* API implementation */
@@ -98,11 +282,14 @@ CB_API void cbp_incremental_build_init(cbp_incremental_build* ib)
 {
     memset(ib, 0, sizeof(cbp_incremental_build));
     ib->plugin.name = "cbp_incremental_build";
+    ib->check_policy = cbp_ib_check_TIERED;
 
     ib->plugin.bake_starting = cbp_ib_bake_starting;
     ib->plugin.can_process_file = cbp_ib_can_process_file;
     ib->plugin.extra_argument = cbp_ib_extra_argument;
     ib->plugin.file_processed = cbp_ib_file_processed;
+    ib->plugin.bake_finished = cbp_ib_bake_finished;
+    ib->plugin.check_files = cbp_ib_check_files;
 }
 
 CB_API void cbp_incremental_build_delete_cache(cbp_incremental_build* ib)
@@ -110,43 +297,70 @@ CB_API void cbp_incremental_build_delete_cache(cbp_incremental_build* ib)
     cb_toolchain_t toolchain = { 0 };
     cb_project_t* project = NULL;
     cb_tmp_strv_handle handle = { 0 };
-    cb_file_it it = { 0 };
-    CB_UNUSED(ib);
+
+    /* The database could not be deleted while it's mapped. */
+    CB_ASSERT(cb_darrT_size(&ib->bakes) == 0 && "The cache can't be deleted during a bake.");
      
     toolchain = cb_toolchain_get();
     project = cb_current_project();
     
-    handle = cbp_ib_format_dep_folder(&toolchain, project);
+    handle = cbp_ib_format_db_path(&toolchain, project);
 
-    /* Remove all files from the dep directory */
-    cb_file_it_init_recursive(&it, handle.strv.data);
-
-    while(cb_file_it_get_next(&it))
+    /* Only remove the database of the project, other projects can share the same output directory. */
+    if (cb_path_exists(handle.strv.data))
     {
-        const char* file = cb_file_it_current_file(&it);
-        cb_bool deleted = cb_delete_file(file);
+        cb_bool deleted = cb_delete_file(handle.strv.data);
         CB_ASSERT(deleted);
     }
-    
-    cb_file_it_destroy(&it);
 
     cb_tmp_restore(handle.anchor);
 }
 
-CB_INTERNAL void cbp_ib_bake_starting(cb_plugin* plugin)
+CB_INTERNAL cbp_ib_bake* cbp_ib_get_bake(cbp_incremental_build* ib, const cb_project_t* project)
+{
+    cb_size i = 0;
+
+    for (i = 0; i < cb_darrT_size(&ib->bakes); i += 1)
+    {
+        if (cb_darrT_at(&ib->bakes, i)->project == project)
+        {
+            return cb_darrT_at(&ib->bakes, i);
+        }
+    }
+
+    CB_ASSERT(0 && "The bake of the project has not been started.");
+    return NULL;
+}
+
+CB_INTERNAL void cbp_ib_bake_starting(cb_plugin* plugin, cb_project_t* project)
 {
     cbp_incremental_build* ib = (cbp_incremental_build*)plugin;
-    ib->stat_ignored = 0;
-    ib->stat_compilable = 0;
+    cbp_ib_bake* bake = NULL;
+
+    /* Statistics are shared by the projects baked at the same time. */
+    if (cb_darrT_size(&ib->bakes) == 0)
+    {
+        ib->stat_ignored = 0;
+        ib->stat_compilable = 0;
+        ib->stat_file_state_hits = 0;
+        ib->stat_file_state_misses = 0;
+        ib->stat_file_hashes = 0;
+    }
+
+    bake = (cbp_ib_bake*)CB_MALLOC(sizeof(cbp_ib_bake));
+    CB_ASSERT(bake);
+    memset(bake, 0, sizeof(cbp_ib_bake));
+    cb_darrT_push_back(&ib->bakes, bake);
     
     /* Reference current toolchain and project. */
-    ib->toolchain = cb_toolchain_get();
-    ib->project = cb_current_project();
+    bake->ib = ib;
+    bake->toolchain = cb_toolchain_get();
+    bake->project = project;
 
     /* Ensure that the cache folder exists. */
     {
         /* Format directory in tmp allocator. */
-        cb_tmp_strv_handle dir_handle = cbp_ib_format_dep_folder(&ib->toolchain, ib->project);
+        cb_tmp_strv_handle dir_handle = cbp_ib_format_dep_folder(&bake->toolchain, bake->project);
 
         /* Created directories */
         cb_create_directories(dir_handle.strv.data, dir_handle.strv.size);
@@ -154,19 +368,53 @@ CB_INTERNAL void cbp_ib_bake_starting(cb_plugin* plugin)
         /* Release tmp memory */
         cb_tmp_restore(dir_handle.anchor);
     } 
+
+    cbp_ib_db_builder_init(&bake->compiled);
+    cbp_ib_path_table_init(&bake->file_state_paths);
+    cb_darrT_init(&bake->file_states);
+    cbp_ib_db_load(bake);
     
-    ib->needs_full_rebuild = cbp_ib_check_full_rebuild_needed(ib);
+    bake->needs_full_rebuild = cbp_ib_check_full_rebuild_needed(bake);
 }
 
-CB_INTERNAL const char* cbp_ib_extra_argument(cb_plugin* plugin)
+CB_INTERNAL void cbp_ib_bake_finished(cb_plugin* plugin, cb_project_t* project)
 {
     cbp_incremental_build* ib = (cbp_incremental_build*)plugin;
+    cbp_ib_bake* bake = cbp_ib_get_bake(ib, project);
+    cb_size i = 0;
+
+    cbp_ib_db_write(bake);
+    cbp_ib_db_release(bake);
+
+    for (i = 0; i < cb_darrT_size(&ib->bakes); i += 1)
+    {
+        if (cb_darrT_at(&ib->bakes, i) == bake)
+        {
+            cb_darrT_remove(&ib->bakes, i);
+            break;
+        }
+    }
+    CB_FREE(bake);
+
+    if (cb_darrT_size(&ib->bakes) == 0)
+    {
+        cb_darrT_destroy(&ib->bakes);
+    }
+}
+
+/* Also called by cb_export_compile_commands, the bake of the project may not be started. */
+CB_INTERNAL const char* cbp_ib_extra_argument(cb_plugin* plugin, cb_project_t* project)
+{
+    cb_toolchain_t toolchain = cb_toolchain_get();
+
+    (void)plugin;
+    (void)project;
 
-    if (cb_str_equals(ib->toolchain.family, "msvc"))
+    if (cb_str_equals(toolchain.family, "msvc"))
     {
         return "/showIncludes ";
     }
-    else if (cb_str_equals(ib->toolchain.family, "gcc"))
+    else if (cb_str_equals(toolchain.family, "gcc"))
     {
         return " -MMD ";
     }
@@ -177,77 +425,381 @@ CB_INTERNAL const char* cbp_ib_extra_argument(cb_plugin* plugin)
     return "";
 }
 
-CB_INTERNAL cb_bool cbp_ib_can_process_file(cb_plugin* plugin, const char* file)
+/* Returns the index of the unit or -1 if the unit is not found. Units are sorted by path. */
+CB_INTERNAL int cbp_ib_db_find_unit(const cbp_ib_db_view* view, const char* path)
 {
-    cbp_incremental_build* ib = (cbp_incremental_build*)plugin;
+    int low = 0;
+    int high = (int)view->unit_count - 1;
+    int middle = 0;
+    int cmp = 0;
 
-    cb_bool file_need_to_be_compiled = cb_true;
- 
-    cb_tmp_strv_handle handle = {0};
-    
-    int file_info_flags = 0;
- 
-    const char* dep_store_filepath = NULL;
-    
-    if (!ib->needs_full_rebuild)
+    while (low <= high)
     {
-        file_need_to_be_compiled = cb_false;
-        
-        handle = cbp_ib_format_dep_store_filepath(ib, file);
-        dep_store_filepath = handle.strv.data;
-        
-        /* If the dep_file does not exists, the original file needs to be processed. */
-        if (!cb_path_exists(dep_store_filepath))
+        middle = low + (high - low) / 2;
+        cmp = strcmp(path, view->strings + view->paths[view->units[middle].path_index].offset);
+
+        if (cmp == 0)
+        {
+            return middle;
+        }
+        else if (cmp < 0)
         {
-            file_need_to_be_compiled = cb_true;
+            high = middle - 1;
         }
         else
         {
-            /* Open dep_store_file */
-            FILE* dep_store_file = cb_file_open_readonly(dep_store_filepath);
-            if (dep_store_file)
+            low = middle + 1;
+        }
+    }
+    return -1;
+}
+
+/* Hashes computed with another algorithm never match. */
+CB_INTERNAL cb_bool cbp_ib_hash_matches(const cbp_ib_file_state* state, const cbp_ib_db_record* record)
+{
+    return record->hash_algorithm == cb_hash_algorithm_WIDE_128
+        && cb_hash_128_equals(state->hash, record->hash);
+}
+
+/* True if the content of the file is needed to compare it with the record. */
+CB_INTERNAL cb_bool cbp_ib_needs_hash(const cbp_incremental_build* ib, const cbp_ib_file_state* state, const cbp_ib_db_record* record)
+{
+    switch (ib->check_policy)
+    {
+    case cbp_ib_check_TIERED:
+        /* Only read the content when the modification time has changed. */
+        return state->exists
+            && state->size == record->size
+            && state->last_modification != record->last_modification;
+    case cbp_ib_check_HASH:
+        return cb_true;
+    default:
+        return cb_false;
+    }
+}
+
+/* Compare a queried state with a record. The state must be hashed if cbp_ib_needs_hash returns true. */
+CB_INTERNAL cb_bool cbp_ib_state_matches(const cbp_incremental_build* ib, const cbp_ib_file_state* state, const cbp_ib_db_record* record)
+{
+    /* Don't check volume id and file id because we don't record them
+       (because we don't need them since we are using the full path)
+    */
+    if (!state->exists || state->size != record->size)
+    {
+        return cb_false;
+    }
+
+    switch (ib->check_policy)
+    {
+    case cbp_ib_check_METADATA:
+        return state->last_modification == record->last_modification;
+    case cbp_ib_check_TIERED:
+        return state->last_modification == record->last_modification
+            || cbp_ib_hash_matches(state, record);
+    case cbp_ib_check_HASH:
+        return cbp_ib_hash_matches(state, record);
+    default:
+        CB_ASSERT(0 && "Unhandled check policy for cbp_incremental_build");
+    }
+    return cb_false;
+}
+
+/* Check if the dependency is the same as when the unit was compiled. */
+CB_INTERNAL cb_bool cbp_ib_record_matches(cbp_ib_bake* bake, const cbp_ib_db_view* view, const cbp_ib_db_record* record)
+{
+    const cbp_ib_db_path* path = &view->paths[record->path_index];
+    const char* path_str = view->strings + path->offset;
+    const cbp_ib_file_state* state = cbp_ib_get_file_state(bake, path_str, path->length, bake->ib->check_policy == cbp_ib_check_HASH);
+
+    if (!state->hashed && cbp_ib_needs_hash(bake->ib, state, record))
+    {
+        state = cbp_ib_get_file_state(bake, path_str, path->length, cb_true);
+    }
+
+    return cbp_ib_state_matches(bake->ib, state, record);
+}
+
+CB_INTERNAL cb_u32 cbp_ib_file_state_index(cbp_ib_bake* bake, const char* path, cb_size path_length)
+{
+    cb_u32 index = cbp_ib_path_table_intern(&bake->file_state_paths, path, path_length);
+    cbp_ib_file_state new_state;
+
+    if (index == cb_darrT_size(&bake->file_states))
+    {
+        memset(&new_state, 0, sizeof(new_state));
+        cb_darrT_push_back(&bake->file_states, new_state);
+    }
+
+    return index;
+}
+
+CB_INTERNAL void cbp_ib_query_file_state(cbp_ib_bake* bake, cb_u32 index, cb_bool with_hash)
+{
+    cbp_ib_file_state* state = cb_darrT_ptr(&bake->file_states, index);
+    const char* path = bake->file_state_paths.strings.data + bake->file_state_paths.paths.darr.data[index].offset;
+    cb_file_info file_info = { 0 };
+    int flags = cb_file_info_SIZE | cb_file_info_MODIFICATION_TIME;
+
+    if (!state->verified)
+    {
+        state->exists = cb_file_info_query(path, flags, &file_info);
+        state->size = file_info.size;
+        state->last_modification = file_info.last_modification;
+        state->verified = cb_true;
+    }
+
+    if (with_hash && state->exists && !state->hashed)
+    {
+        state->exists = cb_hash_128_from_filename(path, &state->hash);
+        state->hashed = cb_true;
+    }
+}
+
+CB_INTERNAL const cbp_ib_file_state* cbp_ib_get_file_state(cbp_ib_bake* bake, const char* path, cb_size path_length, cb_bool with_hash)
+{
+    cb_u32 index = cbp_ib_file_state_index(bake, path, path_length);
+    cbp_ib_file_state* state = cb_darrT_ptr(&bake->file_states, index);
+    cb_bool was_hashed = state->hashed;
+    cb_stats* stats = &cb_current_context()->stats;
+
+    if (state->verified)
+    {
+        bake->ib->stat_file_state_hits += 1;
+    }
+    else
+    {
+        bake->ib->stat_file_state_misses += 1;
+        stats->files_stated += 1;
+    }
+
+    cbp_ib_query_file_state(bake, index, with_hash);
+
+    if (state->hashed && !was_hashed)
+    {
+        bake->ib->stat_file_hashes += 1;
+        stats->bytes_hashed += state->size;
+    }
+
+    return state;
+}
+
+typedef struct cbp_ib_query_task cbp_ib_query_task;
+struct cbp_ib_query_task
+{
+    cbp_ib_bake* bake;
+    const cb_u32* indices;
+    cb_bool with_hash;
+};
+
+CB_INTERNAL void cbp_ib_query_file_state_task(void* user_data, cb_size i)
+{
+    cbp_ib_query_task* task = (cbp_ib_query_task*)user_data;
+    cbp_ib_query_file_state(task->bake, task->indices[i], task->with_hash);
+}
+
+/* Query the states on several threads, each state must be present once. */
+CB_INTERNAL void cbp_ib_query_file_states(cbp_ib_bake* bake, const cb_u32* indices, cb_size count, cb_bool with_hash)
+{
+    cbp_ib_query_task task;
+    cb_size max_thread_count = (count + CBP_IB_MIN_FILES_PER_THREAD - 1) / CBP_IB_MIN_FILES_PER_THREAD;
+    int thread_count = bake->ib->check_threads > 0 ? bake->ib->check_threads : cb_get_jobs(bake->project);
+    cb_stats* stats = &cb_current_context()->stats;
+    const cbp_ib_file_state* state = NULL;
+    cb_size i = 0;
+
+    if ((cb_size)thread_count > max_thread_count)
+    {
+        thread_count = (int)max_thread_count;
+    }
+
+    /* Statistics are counted here, the threads don't write them. */
+    for (i = 0; i < count; i += 1)
+    {
+        stats->files_stated += cb_darrT_ptr(&bake->file_states, indices[i])->verified ? 0 : 1;
+    }
+
+    task.bake = bake;
+    task.indices = indices;
+    task.with_hash = with_hash;
+
+    cb_parallel_for(count, thread_count, cbp_ib_query_file_state_task, &task);
+
+    if (with_hash)
+    {
+        for (i = 0; i < count; i += 1)
+        {
+            state = cb_darrT_ptr(&bake->file_states, indices[i]);
+            if (state->hashed)
+            {
+                bake->ib->stat_file_hashes += 1;
+                stats->bytes_hashed += state->size;
+            }
+        }
+    }
+}
+
+/* Check all the files before they are compiled. The file system is queried on several threads,
+   then can_process_file only returns the status of each file. */
+CB_INTERNAL void cbp_ib_check_files(cb_plugin* plugin, cb_project_t* project, const char** files, cb_size count)
+{
+    cbp_incremental_build* ib = (cbp_incremental_build*)plugin;
+    cbp_ib_bake* bake = cbp_ib_get_bake(ib, project);
+
+    cb_darrT(cb_u32) units;         /* Units to check. */
+    cb_darrT(cb_u32) record_states; /* State index of each record of the units to check. */
+    cb_darrT(cb_u32) pending;       /* States to query. */
+    cb_u8* pending_hash = NULL;     /* 1 if a state is already in the list of states to hash. */
+    const cbp_ib_db_unit* unit = NULL;
+    const cbp_ib_db_record* record = NULL;
+    const cbp_ib_db_path* path = NULL;
+    const cbp_ib_file_state* state = NULL;
+    cb_size state_count = 0;
+    cb_size record_index = 0;
+    cb_size i = 0;
+    cb_u32 j = 0;
+    cb_u32 state_index = 0;
+    int unit_index = 0;
+    cb_u8 status = 0;
+
+    if (bake->needs_full_rebuild || !bake->db_header)
+    {
+        return;
+    }
+
+    cb_darrT_init(&units);
+    cb_darrT_init(&record_states);
+    cb_darrT_init(&pending);
+
+    /* Find the files to query, each file is queried once. */
+    for (i = 0; i < count; i += 1)
+    {
+        unit_index = cbp_ib_db_find_unit(&bake->db, files[i]);
+        if (unit_index < 0 || bake->db_unit_status[unit_index] != CBP_IB_UNIT_UNCHECKED)
+        {
+            continue;
+        }
+
+        /* Outdated until all the records have been checked. */
+        bake->db_unit_status[unit_index] = CBP_IB_UNIT_OUTDATED;
+        cb_darrT_push_back(&units, (cb_u32)unit_index);
+
+        unit = &bake->db.units[unit_index];
+        for (j = 0; j < unit->record_count; j += 1)
+        {
+            path = &bake->db.paths[bake->db.records[unit->first_record + j].path_index];
+
+            state_count = cb_darrT_size(&bake->file_states);
+            state_index = cbp_ib_file_state_index(bake, bake->db.strings + path->offset, path->length);
+            if (cb_darrT_size(&bake->file_states) != state_count)
+            {
+                ib->stat_file_state_misses += 1;
+                cb_darrT_push_back(&pending, state_index);
+            }
+            else
+            {
+                ib->stat_file_state_hits += 1;
+            }
+            cb_darrT_push_back(&record_states, state_index);
+        }
+    }
+
+    cbp_ib_query_file_states(bake, pending.darr.data, cb_darrT_size(&pending), ib->check_policy == cbp_ib_check_HASH);
+
+    /* Hash the files that need it, this only happens with the tiered policy. */
+    if (ib->check_policy == cbp_ib_check_TIERED)
+    {
+        cb_darrT_destroy(&pending);
+        cb_darrT_init(&pending);
+
+        pending_hash = (cb_u8*)CB_MALLOC(cb_darrT_size(&bake->file_states) + 1);
+        CB_ASSERT(pending_hash);
+        memset(pending_hash, 0, cb_darrT_size(&bake->file_states) + 1);
+
+        record_index = 0;
+        for (i = 0; i < cb_darrT_size(&units); i += 1)
+        {
+            unit = &bake->db.units[cb_darrT_at(&units, i)];
+            for (j = 0; j < unit->record_count; j += 1, record_index += 1)
             {
-                cb_size anchor = cb_tmp_save();
-                
-                int buffer_size = 4096;
-                char* buffer = cb_tmp_alloc(buffer_size);
-                while (1)
+                record = &bake->db.records[unit->first_record + j];
+                state_index = cb_darrT_at(&record_states, record_index);
+                state = cb_darrT_ptr(&bake->file_states, state_index);
+
+                if (!state->hashed && !pending_hash[state_index] && cbp_ib_needs_hash(ib, state, record))
                 {
-                    cb_file_info file_info = { 0 };
-                    if (cbp_ib_dep_store_read_info(dep_store_file, buffer, buffer_size, &file_info))
-                    {
-                        /* Check size, modification time and hash.
-                           Don't check volume id and file id because we don't retrieve them in
-                           cbp_ib_dep_store_read_info (because we don't need them since we are using the full path)
-                        */
-                        file_info_flags = cb_file_info_SIZE | cb_file_info_MODIFICATION_TIME | cb_file_info_HASH;
-                        if (!cb_file_info_matches(buffer, file_info_flags, &file_info))
-                        {
-                            file_need_to_be_compiled = cb_true;
-                            break;
-                        }
-                    }
-                    else
+                    pending_hash[state_index] = 1;
+                    cb_darrT_push_back(&pending, state_index);
+                }
+            }
+        }
+
+        cbp_ib_query_file_states(bake, pending.darr.data, cb_darrT_size(&pending), cb_true);
+
+        CB_FREE(pending_hash);
+    }
+
+    /* All the states are known, compare them with the records. */
+    record_index = 0;
+    for (i = 0; i < cb_darrT_size(&units); i += 1)
+    {
+        unit = &bake->db.units[cb_darrT_at(&units, i)];
+        status = CBP_IB_UNIT_UP_TO_DATE;
+
+        for (j = 0; j < unit->record_count; j += 1, record_index += 1)
+        {
+            record = &bake->db.records[unit->first_record + j];
+            state = cb_darrT_ptr(&bake->file_states, cb_darrT_at(&record_states, record_index));
+
+            if (!cbp_ib_state_matches(ib, state, record))
+            {
+                status = CBP_IB_UNIT_OUTDATED;
+            }
+        }
+
+        bake->db_unit_status[cb_darrT_at(&units, i)] = status;
+    }
+
+    cb_darrT_destroy(&units);
+    cb_darrT_destroy(&record_states);
+    cb_darrT_destroy(&pending);
+}
+
+CB_INTERNAL cb_bool cbp_ib_can_process_file(cb_plugin* plugin, cb_project_t* project, const char* file)
+{
+    cbp_incremental_build* ib = (cbp_incremental_build*)plugin;
+    cbp_ib_bake* bake = cbp_ib_get_bake(ib, project);
+
+    cb_bool file_need_to_be_compiled = cb_true;
+    int unit_index = -1;
+    const cbp_ib_db_unit* unit = NULL;
+    cb_u32 i = 0;
+    
+    if (!bake->needs_full_rebuild && bake->db_header)
+    {
+        unit_index = cbp_ib_db_find_unit(&bake->db, file);
+
+        /* If the file has never been compiled it needs to be processed. */
+        if (unit_index >= 0)
+        {
+            /* The unit has not been checked by cbp_ib_check_files. */
+            if (bake->db_unit_status[unit_index] == CBP_IB_UNIT_UNCHECKED)
+            {
+                bake->db_unit_status[unit_index] = CBP_IB_UNIT_UP_TO_DATE;
+
+                unit = &bake->db.units[unit_index];
+                for (i = 0; i < unit->record_count; i += 1)
+                {
+                    if (!cbp_ib_record_matches(bake, &bake->db, &bake->db.records[unit->first_record + i]))
                     {
-                        if (!feof(dep_store_file))
-                        {
-                            /*/ Something went wrong via the deserializing, assume the file to be changed. */
-                            file_need_to_be_compiled = cb_true;
-                            break;
-                        }
-                       
+                        bake->db_unit_status[unit_index] = CBP_IB_UNIT_OUTDATED;
                         break;
                     }
                 }
-                
-                cb_tmp_restore(anchor);
-                
-                /* Close dep_file */
-                fclose(dep_store_file);
             }
+
+            /* The records of up to date units are kept for the next bake. */
+            file_need_to_be_compiled = bake->db_unit_status[unit_index] != CBP_IB_UNIT_UP_TO_DATE;
         }
-        
-        cb_tmp_restore(handle.anchor);
     }
     
     if (!file_need_to_be_compiled)
@@ -262,10 +814,12 @@ CB_INTERNAL cb_bool cbp_ib_can_process_file(cb_plugin* plugin, const char* file)
     if (file_need_to_be_compiled)
     {
         ib->stat_compilable += 1;
+        cb_current_context()->stats.cache_misses += 1;
     }
     else
     {
         ib->stat_ignored += 1;
+        cb_current_context()->stats.cache_hits += 1;
     }
     
     return file_need_to_be_compiled;
@@ -284,212 +838,135 @@ CB_INTERNAL cb_tmp_strv_handle cbp_ib_format_dep_folder(const cb_toolchain_t* to
     return str_handle;
 }
 
-CB_INTERNAL cb_tmp_strv_handle cbp_ib_format_dep_store_filepath(cbp_incremental_build* ib, const char* filepath)
+CB_INTERNAL cb_tmp_strv_handle cbp_ib_format_db_path(const cb_toolchain_t* toolchain, const cb_project_t* project)
 {
-    cb_tmp_strv_handle str_handle;
-    const char* output_dir = "";
-
-    cb_file_info file_info = {0};
-    int flags = cb_file_info_FILE_ID;
-    cb_bool ok = cb_file_info_query(filepath, flags, &file_info);
-    
-    CB_ASSERT(ok);
-    
-    str_handle.anchor = cb_tmp_save();
-    output_dir = cb_get_output_directory(ib->project, &ib->toolchain);
-    str_handle.strv = cb_tmp_strv_printf("%s/cbp_ib_cache/%zu-%zu-" CB_STRV_FMT ".cache",
-        output_dir, file_info.volume_id, file_info.file_id, CB_STRV_ARG(cb_path_filename_str(filepath)));
-
-    return str_handle;
-}
-
-
-CB_INTERNAL cb_tmp_strv_handle cbp_ib_format_file_in_dep_directory(cbp_incremental_build* ib, const char* filename)
-{
-    cb_tmp_strv_handle flag_dep_file_handle = {0};
+    cb_tmp_strv_handle db_handle = {0};
     cb_tmp_strv_handle dir_handle = {0};
     
-    flag_dep_file_handle.anchor = cb_tmp_save();
+    db_handle.anchor = cb_tmp_save();
  
-    dir_handle = cbp_ib_format_dep_folder(&ib->toolchain, ib->project);
+    dir_handle = cbp_ib_format_dep_folder(toolchain, project);
 
-    flag_dep_file_handle.strv = cb_tmp_strv_printf(CB_STRV_FMT  "%s", CB_STRV_ARG(dir_handle.strv), filename);
+    db_handle.strv = cb_tmp_strv_printf(CB_STRV_FMT  "%s.db", CB_STRV_ARG(dir_handle.strv), project->name.data);
         
-    return flag_dep_file_handle;
+    return db_handle;
 }
 
 
 #ifdef _WIN32
 
 
-CB_INTERNAL void cbp_ib_file_processed(cb_plugin* plugin, const char* file, const char* std_out, const char* std_err)
+CB_INTERNAL void cbp_ib_file_processed(cb_plugin* plugin, cb_project_t* project, const char* file, const char* std_out, const char* std_err)
 {
-    cbp_incremental_build* ib = (cbp_incremental_build*)plugin;
+    cbp_ib_bake* bake = cbp_ib_get_bake((cbp_incremental_build*)plugin, project);
 
     cb_size anchor = 0;
     cb_strv value = { 0 };
     cb_dep_parser parser = { 0 };
     const char* filepath_str = NULL;
-  
-    cb_tmp_strv_handle handle = cbp_ib_format_dep_store_filepath(ib, file);
-
-    FILE* dep_store_to_write = cb_file_open_write(handle.strv.data);
       
     (void)std_err;
     
-    if (dep_store_to_write)
-    {
-         /* Record current file, it is part of the dependency */
-        cbp_ib_dep_store_write_info(dep_store_to_write, file);
+    /* Create new unit, replace the previous one if any. */
+    cbp_ib_db_builder_begin_unit(&bake->compiled, file, strlen(file));
+
+    /* Record current file, it is part of the dependency */
+    cbp_ib_record_dependency(bake, file);
+    
+    cb_msvc_dep_parser_init(&parser);
         
-        cb_msvc_dep_parser_init(&parser);
-            
-        cb_msvc_dep_parser_reset(&parser, std_out);
+    cb_msvc_dep_parser_reset(&parser, std_out);
+    
+    while(cb_msvc_dep_parser_get_next(&parser, std_out, &value))
+    {
+        anchor = cb_tmp_save();
         
-        while(cb_msvc_dep_parser_get_next(&parser, std_out, &value))
-        {
-            anchor = cb_tmp_save();
-            
-            filepath_str = cb_tmp_sprintf(CB_STRV_FMT, CB_STRV_ARG(value));
-            cbp_ib_dep_store_write_info(dep_store_to_write, filepath_str);
-            
-            cb_tmp_restore(anchor);
-        }
+        filepath_str = cb_tmp_sprintf(CB_STRV_FMT, CB_STRV_ARG(value));
+        cbp_ib_record_dependency(bake, filepath_str);
         
-        fclose(dep_store_to_write);
+        cb_tmp_restore(anchor);
     }
-    
-    cb_tmp_restore(handle.anchor);
 }
 
 #else
 
-CB_INTERNAL void cbp_ib_file_processed(cb_plugin* plugin, const char* filepath, const char* gcc_dep_filepath, const char* unused)
+CB_INTERNAL void cbp_ib_file_processed(cb_plugin* plugin, cb_project_t* project, const char* filepath, const char* gcc_dep_filepath, const char* unused)
 {
-    cbp_incremental_build* ib = (cbp_incremental_build*)plugin;
-    cb_tmp_strv_handle handle = cbp_ib_format_dep_store_filepath(ib, filepath);
+    cbp_ib_bake* bake = cbp_ib_get_bake((cbp_incremental_build*)plugin, project);
     
-    cb_size anchor = 0;
+    cb_size anchor = cb_tmp_save();
+    cb_size dep_anchor = 0;
     cb_strv value = { 0 };
     cb_dep_parser parser = { 0 };
+    cb_file_view gcc_dep_file_view;
     
     const char* filepath_str = NULL;
     int buffer_size = 4096;
-    char* buffer_read = cb_tmp_calloc(buffer_size);
     char* dep_read = cb_tmp_calloc(buffer_size);
-    FILE* gcc_dep_file_to_read = NULL;
-
-    /* Create new file, overwrite if already exists. */
-    FILE* dep_store_to_write = cb_file_open_write(handle.strv.data);
 
     (void)unused;
 
-    if (dep_store_to_write)
+    /* Create new unit, replace the previous one if any. */
+    cbp_ib_db_builder_begin_unit(&bake->compiled, filepath, strlen(filepath));
+
+    /* Read all dependencies from the dependency .d file */
+    if (cb_file_view_open(gcc_dep_filepath, &gcc_dep_file_view))
     {
-        gcc_dep_file_to_read = cb_file_open_readonly(gcc_dep_filepath);
-       
-        /* Read all dependencies from the dependency .d file */
-        if (gcc_dep_file_to_read)
+        cb_gcc_dep_parser_init_from_memory(&parser, gcc_dep_file_view.data, gcc_dep_file_view.size, dep_read, buffer_size);
+        
+        cb_gcc_dep_parser_reset(&parser, NULL);
+        
+        while(cb_gcc_dep_parser_get_next(&parser, NULL, &value))
         {
-            cb_gcc_dep_parser_init(&parser, buffer_read, buffer_size, dep_read, buffer_size);
+            dep_anchor = cb_tmp_save();
             
-            cb_gcc_dep_parser_reset(&parser, gcc_dep_file_to_read);
-            
-            while(cb_gcc_dep_parser_get_next(&parser, gcc_dep_file_to_read, &value))
-            {
-                anchor = cb_tmp_save();
-                
-                filepath_str = cb_tmp_sprintf(CB_STRV_FMT, CB_STRV_ARG(value));
-                cbp_ib_dep_store_write_info(dep_store_to_write, filepath_str);
-                
-                cb_tmp_restore(anchor);
-            }
+            filepath_str = cb_tmp_sprintf(CB_STRV_FMT, CB_STRV_ARG(value));
+            cbp_ib_record_dependency(bake, filepath_str);
             
-            fclose(gcc_dep_file_to_read);
+            cb_tmp_restore(dep_anchor);
         }
         
-        fclose(dep_store_to_write);
+        cb_file_view_close(&gcc_dep_file_view);
+    }
+    else
+    {
+        cb_log_error("incremental build: could not read dependency file: %s", gcc_dep_filepath);
     }
     
-    cb_tmp_restore(handle.anchor);
+    cb_tmp_restore(anchor);
 }
 
 #endif
 
-CB_INTERNAL void cbp_ib_dep_store_write_info(FILE* dep_store_file, const char* file_to_record)
+CB_INTERNAL void cbp_ib_record_dependency(cbp_ib_bake* bake, const char* file_to_record)
 {
-    cb_size anchor = cb_tmp_save();
+    cbp_ib_db_record record = { 0 };
+    /* Always record the hash so that the check policy can be changed between two bakes. */
+    const cbp_ib_file_state* state = cbp_ib_get_file_state(bake, file_to_record, strlen(file_to_record), cb_true);
 
-    cb_file_info file_info = {0};
-    int flags = cb_file_info_ALL;
-    if(!cb_file_info_query(file_to_record, flags, &file_info))
+    if (!state->exists)
     {
         cb_log_error("could not get file info");
         return;
     }
     
-    fprintf(dep_store_file, "%s" ";", file_to_record);
-    fprintf(dep_store_file, CB_U64_FMT  ";", file_info.size);
-    fprintf(dep_store_file, CB_U64_FMT  ";", file_info.last_modification);
-    fprintf(dep_store_file, CB_U64_FMT  "\r\n", file_info.hash);
+    record.size = state->size;
+    record.last_modification = state->last_modification;
+    record.hash_algorithm = cb_hash_algorithm_WIDE_128;
+    record.hash = state->hash;
 
-    cb_tmp_restore(anchor);
+    cbp_ib_db_builder_add_record(&bake->compiled, file_to_record, strlen(file_to_record), &record);
 }
 
-CB_INTERNAL cb_bool cbp_ib_dep_store_read_info(FILE* file, char* buffer, int buffer_size, cb_file_info* file_info)
-{
-    size_t scanned_count = 0;
-    char* cursor = buffer;
-    CB_ASSERT(buffer_size >= 4096);
-    
-    if (fgets(buffer, (size_t)buffer_size, file))
-    {
-        cursor = memchr(cursor, ';', (size_t)buffer_size);
-
-        if (!cursor)
-        {
-            cb_log_info("could not deserialize file.");
-            return cb_false;
-        }
-
-        /* First token was found, set null-terminating char */
-        *cursor = '\0';
-
-        /* Skip '\0'. */
-        cursor += 1;
-
-        scanned_count = CB_SSCANF(cursor,
-                CB_U64_FMT ";"  CB_U64_FMT ";" CB_U64_FMT "\r\n",
-                &file_info->size, &file_info->last_modification, &file_info->hash);
-
-        if (scanned_count == 3)
-        {
-            return cb_true;
-        }
-    }
-
-    return cb_false;
-}
-
-CB_INTERNAL cb_bool cbp_ib_check_full_rebuild_needed(cbp_incremental_build* ib)
+CB_INTERNAL cb_bool cbp_ib_check_full_rebuild_needed(cbp_ib_bake* bake)
 {
     size_t i = 0;
     size_t prop_count = 0;
-    cb_bool needs_full_rebuild = cb_true;
-    
-    /* If it exists to read file containing the flags. */
-    cb_tmp_strv_handle handle = cbp_ib_format_file_in_dep_directory(ib, "flags.cache");
-
-    FILE* flag_dep_file_read = cb_file_open_readonly(handle.strv.data);
 
     /* Character in flag strings. */
     cb_u64 flag_len = 0;
     /* hash sum of all the flag strings. */
     cb_u64 flag_hash = cb_hash_64_init();
-        
-    cb_bool cached_value_retrieved = cb_false;
-    cb_u64 cached_flag_len = 0;
-    cb_u64 cached_flag_hash = 0;
 
     static const char* properties[] = {
         cb_DEFINES,
@@ -498,32 +975,6 @@ CB_INTERNAL cb_bool cbp_ib_check_full_rebuild_needed(cbp_incremental_build* ib)
         "cxxflags", /* @TODO use cb_CXXLAGS? */
         cb_INCLUDE_DIRECTORIES
     };
-    
-    if (flag_dep_file_read)
-    {
-        /* Create tmp buffer to read the content of the file. 
-           Must be a singel line with the length of the file and the hash of the file.
-        */
-        int buffer_size = 512;
-        char* buffer = (char*)cb_tmp_calloc(buffer_size);
-
-        if (fgets(buffer, buffer_size, flag_dep_file_read))
-        {
-            /* Read the two integers in the file. */
-            size_t n = CB_SSCANF(buffer, CB_U64_FMT ";" CB_U64_FMT, &cached_flag_len, &cached_flag_hash);
-
-            /* Ensure we scanned two values. */
-            if (n == 2)
-            {
-                cached_value_retrieved = cb_true;
-            }
-        }
-        
-        /* Close the file */
-        fclose(flag_dep_file_read);
-    }
-
-    flag_hash = cb_hash_64_init();
 
     prop_count = sizeof(properties) / sizeof(properties[0]);
 
@@ -532,7 +983,7 @@ CB_INTERNAL cb_bool cbp_ib_check_full_rebuild_needed(cbp_incremental_build* ib)
     {
         const char* prop = properties[i];
 
-        cb_kv_range range = cb_mmap_get_range_str(&ib->project->mmap, prop);
+        cb_kv_range range = cb_mmap_get_range_str(&bake->project->mmap, prop);
         cb_kv current = { 0 };
         while (cb_mmap_range_get_next(&range, &current))
         {
@@ -542,36 +993,491 @@ CB_INTERNAL cb_bool cbp_ib_check_full_rebuild_needed(cbp_incremental_build* ib)
         }
     }
 
-    if (cached_value_retrieved)
+    /* Flags are written in the database at the end of the bake. */
+    bake->flags_len = flag_len;
+    bake->flags_hash = flag_hash;
+
+    return !bake->db_header
+        || bake->db_header->flags_hash != flag_hash
+        || bake->db_header->flags_len != flag_len;
+}
+
+/*-----------------------------------------------------------------------*/
+/* database */
+/*-----------------------------------------------------------------------*/
+
+/* Returns the header if the content of the file is a valid database. */
+CB_INTERNAL const cbp_ib_db_header* cbp_ib_db_validate(const cb_file_mapping* mapping)
+{
+    const cbp_ib_db_header* header = (const cbp_ib_db_header*)mapping->data;
+    const cbp_ib_db_unit* units = NULL;
+    const cbp_ib_db_record* records = NULL;
+    const cbp_ib_db_path* paths = NULL;
+    const char* strings = NULL;
+    cb_u64 expected_size = 0;
+    cb_u32 i = 0;
+
+    if (mapping->size < sizeof(cbp_ib_db_header)
+        || memcmp(header->magic, CBP_IB_DB_MAGIC, sizeof(header->magic)) != 0
+        || header->version != CBP_IB_DB_VERSION)
+    {
+        return NULL;
+    }
+
+    expected_size = sizeof(cbp_ib_db_header)
+        + (cb_u64)header->unit_count * sizeof(cbp_ib_db_unit)
+        + (cb_u64)header->record_count * sizeof(cbp_ib_db_record)
+        + (cb_u64)header->path_count * sizeof(cbp_ib_db_path)
+        + header->strings_size;
+
+    if (expected_size != (cb_u64)mapping->size)
+    {
+        return NULL;
+    }
+
+    units = (const cbp_ib_db_unit*)(header + 1);
+    records = (const cbp_ib_db_record*)(units + header->unit_count);
+    paths = (const cbp_ib_db_path*)(records + header->record_count);
+    strings = (const char*)(paths + header->path_count);
+
+    for (i = 0; i < header->path_count; i += 1)
     {
-        if (flag_hash == cached_flag_hash
-           && flag_len == cached_flag_len)
+        if ((cb_u64)paths[i].offset + paths[i].length >= header->strings_size
+            || strings[paths[i].offset + paths[i].length] != '\0')
         {
-            needs_full_rebuild = cb_false;
+            return NULL;
         }
     }
 
-    /* Write current file len and file hash.*/
+    for (i = 0; i < header->unit_count; i += 1)
     {
-        FILE* flag_dep_file_write = cb_file_open_write(handle.strv.data);
-        
-        if (flag_dep_file_write)
+        if (units[i].path_index >= header->path_count
+            || (cb_u64)units[i].first_record + units[i].record_count > header->record_count)
         {
-            fprintf(flag_dep_file_write, CB_U64_FMT ";" CB_U64_FMT, flag_len, flag_hash);
-            fclose(flag_dep_file_write);
+            return NULL;
         }
-        else
+    }
+
+    for (i = 0; i < header->record_count; i += 1)
+    {
+        if (records[i].path_index >= header->path_count)
         {
-            /* Something was wrong, try to delete the cache file anyway. */
-            cb_delete_file(handle.strv.data);
+            return NULL;
         }
     }
-    
+
+    return header;
+}
+
+CB_INTERNAL void cbp_ib_db_load(cbp_ib_bake* bake)
+{
+    cb_tmp_strv_handle handle = cbp_ib_format_db_path(&bake->toolchain, bake->project);
+    const cbp_ib_db_header* header = NULL;
+
+    if (cb_path_exists(handle.strv.data)
+        && cb_file_map_readonly(handle.strv.data, &bake->db_mapping))
+    {
+        header = cbp_ib_db_validate(&bake->db_mapping);
+        if (!header)
+        {
+            cb_log_debug("incremental build: invalid database: %s", handle.strv.data);
+            cb_file_unmap(&bake->db_mapping);
+        }
+    }
+
+    if (header)
+    {
+        bake->db_header = header;
+        bake->db.units = (const cbp_ib_db_unit*)(header + 1);
+        bake->db.unit_count = header->unit_count;
+        bake->db.records = (const cbp_ib_db_record*)(bake->db.units + header->unit_count);
+        bake->db.paths = (const cbp_ib_db_path*)(bake->db.records + header->record_count);
+        bake->db.strings = (const char*)(bake->db.paths + header->path_count);
+
+        if (header->unit_count > 0)
+        {
+            bake->db_unit_status = (cb_u8*)CB_MALLOC(header->unit_count);
+            CB_ASSERT(bake->db_unit_status);
+            memset(bake->db_unit_status, CBP_IB_UNIT_UNCHECKED, header->unit_count);
+        }
+    }
+
     cb_tmp_restore(handle.anchor);
-    
-    return needs_full_rebuild;
+}
+
+/* Unmap the database. */
+CB_INTERNAL void cbp_ib_db_unload(cbp_ib_bake* bake)
+{
+    cb_file_unmap(&bake->db_mapping);
+    bake->db_header = NULL;
+    memset(&bake->db, 0, sizeof(bake->db));
+
+    if (bake->db_unit_status)
+    {
+        CB_FREE(bake->db_unit_status);
+        bake->db_unit_status = NULL;
+    }
+}
+
+CB_INTERNAL void cbp_ib_db_release(cbp_ib_bake* bake)
+{
+    cbp_ib_db_unload(bake);
+    cbp_ib_db_builder_destroy(&bake->compiled);
+
+    cbp_ib_path_table_destroy(&bake->file_state_paths);
+    cb_darrT_destroy(&bake->file_states);
+}
+
+/* Used to sort the units by path. */
+static CB_THREAD const cbp_ib_db_builder* cbp_ib_sorted_builder = NULL;
+
+CB_INTERNAL int cbp_ib_db_unit_compare(const void* left, const void* right)
+{
+    const cbp_ib_db_builder* b = cbp_ib_sorted_builder;
+    const cbp_ib_db_unit* l = (const cbp_ib_db_unit*)left;
+    const cbp_ib_db_unit* r = (const cbp_ib_db_unit*)right;
+
+    return strcmp(b->paths.strings.data + b->paths.paths.darr.data[l->path_index].offset,
+        b->paths.strings.data + b->paths.paths.darr.data[r->path_index].offset);
+}
+
+/* Files with the same content but a different modification time are recorded with their new modification time,
+   this way their content does not need to be read again during the next bake. */
+CB_INTERNAL void cbp_ib_refresh_records(cbp_ib_bake* bake, cbp_ib_db_builder* b, cb_u32 first_record)
+{
+    cbp_ib_db_record* record = NULL;
+    const cbp_ib_db_path* path = NULL;
+    const cbp_ib_file_state* state = NULL;
+    int state_index = 0;
+    cb_u32 slot_index = 0;
+    cb_u32 i = 0;
+
+    for (i = first_record; i < (cb_u32)cb_darrT_size(&b->records); i += 1)
+    {
+        record = cb_darrT_ptr(&b->records, i);
+        path = &b->paths.paths.darr.data[record->path_index];
+        state_index = cbp_ib_path_table_find(&bake->file_state_paths, b->paths.strings.data + path->offset, path->length, &slot_index);
+
+        if (state_index >= 0)
+        {
+            state = cb_darrT_ptr(&bake->file_states, state_index);
+            if (state->hashed && state->exists && state->size == record->size && cbp_ib_hash_matches(state, record))
+            {
+                record->last_modification = state->last_modification;
+            }
+        }
+    }
+}
+
+/* Write the units compiled during this bake and the units that are still up to date. */
+CB_INTERNAL cb_bool cbp_ib_db_write(cbp_ib_bake* bake)
+{
+    cbp_ib_db_builder out;
+    cbp_ib_db_view compiled = cbp_ib_db_builder_view(&bake->compiled);
+    cbp_ib_db_header header;
+    const cbp_ib_db_path* path = NULL;
+    int path_index = 0;
+    cb_u32 i = 0;
+    cb_u32 slot_index = 0;
+    cb_u32 first_record = 0;
+    cb_bool result = cb_true;
+    FILE* file = NULL;
+    cb_tmp_strv_handle db_handle = cbp_ib_format_db_path(&bake->toolchain, bake->project);
+    const char* tmp_path = cb_tmp_sprintf("%s.tmp", db_handle.strv.data);
+
+    cbp_ib_db_builder_init(&out);
+
+    /* Units compiled during this bake. If a file was compiled twice the last one is used. */
+    for (i = 0; i < compiled.unit_count; i += 1)
+    {
+        if (cb_darrT_at(&bake->compiled.path_units, compiled.units[i].path_index) == i + 1)
+        {
+            cbp_ib_db_builder_copy_unit(&out, &compiled, i);
+        }
+    }
+
+    /* Units that are still up to date. */
+    for (i = 0; i < bake->db.unit_count; i += 1)
+    {
+        if (bake->db_unit_status[i] == CBP_IB_UNIT_UP_TO_DATE)
+        {
+            path = &bake->db.paths[bake->db.units[i].path_index];
+            path_index = cbp_ib_path_table_find(&bake->compiled.paths, bake->db.strings + path->offset, path->length, &slot_index);
+
+            if (path_index < 0 || cb_darrT_at(&bake->compiled.path_units, path_index) == 0)
+            {
+                first_record = (cb_u32)cb_darrT_size(&out.records);
+                cbp_ib_db_builder_copy_unit(&out, &bake->db, i);
+                cbp_ib_refresh_records(bake, &out, first_record);
+            }
+        }
+    }
+
+    /* Sort units to find them with a binary search. */
+    if (cb_darrT_size(&out.units) > 1)
+    {
+        cbp_ib_sorted_builder = &out;
+        qsort(out.units.darr.data, cb_darrT_size(&out.units), sizeof(cbp_ib_db_unit), cbp_ib_db_unit_compare);
+        cbp_ib_sorted_builder = NULL;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CBP_IB_DB_MAGIC, sizeof(CBP_IB_DB_MAGIC));
+    header.version = CBP_IB_DB_VERSION;
+    header.unit_count = (cb_u32)cb_darrT_size(&out.units);
+    header.record_count = (cb_u32)cb_darrT_size(&out.records);
+    header.path_count = (cb_u32)cb_darrT_size(&out.paths.paths);
+    header.strings_size = (cb_u64)out.paths.strings.size;
+    header.flags_len = bake->flags_len;
+    header.flags_hash = bake->flags_hash;
+
+    /* Write to a temporary file first so that the database is never partially written. */
+    file = cb_file_open_write(tmp_path);
+    if (!file)
+    {
+        cb_set_and_goto(result, cb_false, exit);
+    }
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1
+        || (header.unit_count && fwrite(out.units.darr.data, sizeof(cbp_ib_db_unit), header.unit_count, file) != header.unit_count)
+        || (header.record_count && fwrite(out.records.darr.data, sizeof(cbp_ib_db_record), header.record_count, file) != header.record_count)
+        || (header.path_count && fwrite(out.paths.paths.darr.data, sizeof(cbp_ib_db_path), header.path_count, file) != header.path_count)
+        || (out.paths.strings.size && fwrite(out.paths.strings.data, 1, out.paths.strings.size, file) != out.paths.strings.size))
+    {
+        cb_log_error("incremental build: could not write database: %s", tmp_path);
+        result = cb_false;
+    }
+
+    if (fclose(file) != 0)
+    {
+        result = cb_false;
+    }
+
+    /* The previous database could not be replaced while it's mapped. */
+    cbp_ib_db_unload(bake);
+
+    if (!result || !cb_file_replace(tmp_path, db_handle.strv.data))
+    {
+        cb_delete_file(tmp_path);
+        result = cb_false;
+    }
+
+exit:
+    cbp_ib_db_builder_destroy(&out);
+    cb_tmp_restore(db_handle.anchor);
+    return result;
+}
+
+/*-----------------------------------------------------------------------*/
+/* path table */
+/*-----------------------------------------------------------------------*/
+
+CB_INTERNAL void cbp_ib_path_table_init(cbp_ib_path_table* t)
+{
+    memset(t, 0, sizeof(cbp_ib_path_table));
+    cb_dstr_init(&t->strings);
+    cb_darrT_init(&t->paths);
+}
+
+CB_INTERNAL void cbp_ib_path_table_destroy(cbp_ib_path_table* t)
+{
+    /* Table that has never been initialized. */
+    if (!t->strings.data)
+    {
+        return;
+    }
+
+    cb_dstr_destroy(&t->strings);
+    cb_darrT_destroy(&t->paths);
+    if (t->slots)
+    {
+        CB_FREE(t->slots);
+    }
+    memset(t, 0, sizeof(cbp_ib_path_table));
+}
+
+CB_INTERNAL cb_u64 cbp_ib_hash_path(const char* path, cb_size path_length)
+{
+    return cb_hash_64((char*)path, (int)path_length);
+}
+
+CB_INTERNAL int cbp_ib_path_table_find(const cbp_ib_path_table* t, const char* path, cb_size path_length, cb_u32* slot_index)
+{
+    cb_u32 mask = t->slot_capacity - 1;
+    cb_u32 i = 0;
+    cb_u32 slot = 0;
+    const cbp_ib_db_path* current = NULL;
+
+    if (t->slot_capacity == 0)
+    {
+        return -1;
+    }
+
+    i = (cb_u32)cbp_ib_hash_path(path, path_length) & mask;
+    while ((slot = t->slots[i]) != 0)
+    {
+        current = &t->paths.darr.data[slot - 1];
+        if (current->length == path_length
+            && memcmp(t->strings.data + current->offset, path, path_length) == 0)
+        {
+            *slot_index = i;
+            return (int)(slot - 1);
+        }
+        i = (i + 1) & mask;
+    }
+
+    /* Free slot where the path can be inserted. */
+    *slot_index = i;
+    return -1;
+}
+
+CB_INTERNAL void cbp_ib_path_table_grow_slots(cbp_ib_path_table* t)
+{
+    cb_u32 new_capacity = t->slot_capacity ? t->slot_capacity * 2 : 64;
+    cb_u32 i = 0;
+    cb_u32 slot_index = 0;
+    const cbp_ib_db_path* path = NULL;
+
+    if (t->slots)
+    {
+        CB_FREE(t->slots);
+    }
+
+    t->slots = (cb_u32*)CB_MALLOC(new_capacity * sizeof(cb_u32));
+    CB_ASSERT(t->slots);
+    memset(t->slots, 0, new_capacity * sizeof(cb_u32));
+    t->slot_capacity = new_capacity;
+
+    for (i = 0; i < (cb_u32)cb_darrT_size(&t->paths); i += 1)
+    {
+        path = &t->paths.darr.data[i];
+        cbp_ib_path_table_find(t, t->strings.data + path->offset, path->length, &slot_index);
+        t->slots[slot_index] = i + 1;
+    }
+}
+
+CB_INTERNAL cb_u32 cbp_ib_path_table_intern(cbp_ib_path_table* t, const char* path, cb_size path_length)
+{
+    cbp_ib_db_path new_path;
+    cb_u32 slot_index = 0;
+    int index = 0;
+
+    /* Keep the load factor under 50%. */
+    if ((cb_darrT_size(&t->paths) + 1) * 2 > t->slot_capacity)
+    {
+        cbp_ib_path_table_grow_slots(t);
+    }
+
+    index = cbp_ib_path_table_find(t, path, path_length, &slot_index);
+    if (index >= 0)
+    {
+        return (cb_u32)index;
+    }
+
+    new_path.offset = (cb_u32)t->strings.size;
+    new_path.length = (cb_u32)path_length;
+
+    /* Keep the null-terminating char in the string table. */
+    cb_dstr_append_from(&t->strings, t->strings.size, path, path_length);
+    cb_dstr_append_from(&t->strings, t->strings.size, "", 1);
+
+    cb_darrT_push_back(&t->paths, new_path);
+
+    t->slots[slot_index] = (cb_u32)cb_darrT_size(&t->paths);
+
+    return (cb_u32)cb_darrT_size(&t->paths) - 1;
+}
+
+/*-----------------------------------------------------------------------*/
+/* database builder */
+/*-----------------------------------------------------------------------*/
+
+CB_INTERNAL void cbp_ib_db_builder_init(cbp_ib_db_builder* b)
+{
+    memset(b, 0, sizeof(cbp_ib_db_builder));
+    cbp_ib_path_table_init(&b->paths);
+    cb_darrT_init(&b->units);
+    cb_darrT_init(&b->records);
+    cb_darrT_init(&b->path_units);
+}
+
+CB_INTERNAL void cbp_ib_db_builder_destroy(cbp_ib_db_builder* b)
+{
+    cbp_ib_path_table_destroy(&b->paths);
+    cb_darrT_destroy(&b->units);
+    cb_darrT_destroy(&b->records);
+    cb_darrT_destroy(&b->path_units);
+    memset(b, 0, sizeof(cbp_ib_db_builder));
+}
+
+CB_INTERNAL cbp_ib_db_view cbp_ib_db_builder_view(const cbp_ib_db_builder* b)
+{
+    cbp_ib_db_view view;
+    view.units = b->units.darr.data;
+    view.unit_count = (cb_u32)cb_darrT_size(&b->units);
+    view.records = b->records.darr.data;
+    view.paths = b->paths.paths.darr.data;
+    view.strings = b->paths.strings.data;
+    return view;
+}
+
+/* Returns the index of the path, add it if it does not exist yet. */
+CB_INTERNAL cb_u32 cbp_ib_db_builder_intern(cbp_ib_db_builder* b, const char* path, cb_size path_length)
+{
+    cb_u32 no_unit = 0;
+    cb_u32 index = cbp_ib_path_table_intern(&b->paths, path, path_length);
+
+    if (index == cb_darrT_size(&b->path_units))
+    {
+        cb_darrT_push_back(&b->path_units, no_unit);
+    }
+    return index;
+}
+
+CB_INTERNAL void cbp_ib_db_builder_begin_unit(cbp_ib_db_builder* b, const char* path, cb_size path_length)
+{
+    cbp_ib_db_unit unit;
+
+    memset(&unit, 0, sizeof(unit));
+    unit.path_index = cbp_ib_db_builder_intern(b, path, path_length);
+    unit.first_record = (cb_u32)cb_darrT_size(&b->records);
+    unit.record_count = 0;
+
+    cb_darrT_push_back(&b->units, unit);
+
+    /* The last unit of a path replaces the previous ones. */
+    cb_darrT_set(&b->path_units, unit.path_index, (cb_u32)cb_darrT_size(&b->units));
+}
+
+CB_INTERNAL void cbp_ib_db_builder_add_record(cbp_ib_db_builder* b, const char* path, cb_size path_length, const cbp_ib_db_record* record)
+{
+    cbp_ib_db_record new_record = *record;
+
+    CB_ASSERT(cb_darrT_size(&b->units) > 0);
+
+    new_record.path_index = cbp_ib_db_builder_intern(b, path, path_length);
+    cb_darrT_push_back(&b->records, new_record);
+
+    cb_darrT_ptr(&b->units, cb_darrT_size(&b->units) - 1)->record_count += 1;
+}
+
+CB_INTERNAL void cbp_ib_db_builder_copy_unit(cbp_ib_db_builder* b, const cbp_ib_db_view* view, cb_u32 unit_index)
+{
+    const cbp_ib_db_unit* unit = &view->units[unit_index];
+    const cbp_ib_db_path* path = &view->paths[unit->path_index];
+    const cbp_ib_db_record* record = NULL;
+    cb_u32 i = 0;
+
+    cbp_ib_db_builder_begin_unit(b, view->strings + path->offset, path->length);
+
+    for (i = 0; i < unit->record_count; i += 1)
+    {
+        record = &view->records[unit->first_record + i];
+        path = &view->paths[record->path_index];
+        cbp_ib_db_builder_add_record(b, view->strings + path->offset, path->length, record);
+    }
 }
 
 #endif /* CB_PLUGIN_INCREMENTAL_BUILD_IMPL */
 
-#endif /* CB_IMPLEMENTATION */
\ No newline at end of file
+#endif /* CB_IMPLEMENTATION */
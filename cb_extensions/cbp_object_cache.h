@@ -0,0 +1,911 @@
+/*
+
+This plugin depends on:
+
+  cb_hash.h
+  cb_file_io.h
+  cb_file_info.h
+  cb_file_it.h
+
+Local cache of object files shared by all the projects and all the source trees of the machine (ccache-like).
+The key of a compiled file is the hash of the compiler identity (output of "<compiler> --version"),
+the compile options and the preprocessed source. On a hit the .o and .d files are restored from the cache
+instead of compiling the file, on a miss they are stored in the cache once the file is compiled.
+
+The cache is a plain directory so it can be shared through a network file system:
+
+  <directory>/<2 first hex digits of the key>/<key>.o
+  <directory>/<2 first hex digits of the key>/<key>.d
+
+Entries are written atomically (temporary file + rename). The modification time of an entry is updated when it is used,
+the least recently used entries are removed when the size of the cache exceeds 'max_size'.
+
+The current directory is replaced by a marker in the options, the preprocessed source and the stored .d files,
+so that the same source tree at a different location hits the cache. Paths in debug information are the paths
+of the tree that compiled the file first.
+
+Only the gcc family of toolchains is supported. The plugin disables itself with other toolchains.
+
+*/
+
+#ifndef CB_PLUGIN_OBJECT_CACHE_H
+#define CB_PLUGIN_OBJECT_CACHE_H
+
+#include "cb_hash.h"
+#include "cb_file_io.h"
+#include "cb_file_info.h"
+#include "cb_file_it.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CBP_OC_VERSION "cbp_object_cache 1"
+
+/* Replaces the current directory in the cached files. */
+#define CBP_OC_BASE_MARKER "@CBP_OBJECT_CACHE_BASE@"
+
+/* Once the cache is too big, entries are removed until the size goes below this percentage of the maximum size. */
+#ifndef CBP_OC_EVICTION_TARGET_PERCENT
+#define CBP_OC_EVICTION_TARGET_PERCENT 90
+#endif
+
+/* Source file of the project being baked. */
+typedef struct cbp_oc_entry cbp_oc_entry;
+struct cbp_oc_entry
+{
+    char* file;         /* Absolute path of the source file. */
+    cb_hash_128_t key;
+    cb_bool has_key;    /* The file has been preprocessed. */
+    cb_bool failed;     /* The file could not be preprocessed, it's not cached. */
+    cb_bool needs_store;/* Missed, the result of the compilation is stored in the cache. */
+};
+
+typedef struct cbp_object_cache cbp_object_cache;
+
+/* State of the bake of one project, several projects can be baked at the same time. */
+typedef struct cbp_oc_bake cbp_oc_bake;
+struct cbp_oc_bake
+{
+    cbp_object_cache* oc;
+
+    /* Toolchain and project being baked */
+    cb_toolchain_t toolchain;
+    cb_project_t* project;
+
+    /* False if the toolchain is not supported or the cache directory is not known. */
+    cb_bool active;
+
+    char* output_dir;
+    char* base_dir;         /* Current directory. */
+    cb_cmd* preprocess_options;
+
+    /* Hash of the identity and the options, combined with the preprocessed source to create the keys. */
+    cb_hash_128_t options_hash;
+
+    /* Source files sorted by path. */
+    cb_darrT(cbp_oc_entry) entries;
+};
+
+struct cbp_object_cache
+{
+    /* Plugin base, must stay at the top */
+    cb_plugin plugin;
+
+    /* Directory of the cache. By default the CB_OBJECT_CACHE_DIR environment variable
+       or $HOME/.cache/cb_object_cache (%LOCALAPPDATA%\cb_object_cache on Windows). */
+    const char* directory;
+    char* default_directory;
+
+    /* Maximum size of the cache in bytes, 0 for an unlimited size. */
+    cb_u64 max_size;
+
+    /* Some statistics of all the projects being baked. Reset each run. */
+    int stat_hits;
+    int stat_misses;
+    int stat_stores;
+    int stat_evictions;
+
+    /* Files restored from the cache are notified to the plugins, they must not be stored again. */
+    cb_bool restoring;
+
+    /* Name of the machine, part of the names of the temporary files so that hosts sharing the cache
+       through a network file system never write the same file. */
+    char host_name[64];
+    /* Number of temporary files created by the program. */
+    cb_u64 tmp_count;
+
+    /* Identity of the compiler, computed once per program. */
+    char* identity_program;
+    cb_hash_128_t identity;
+
+    /* Projects being baked. */
+    cb_darrT(cbp_oc_bake*) bakes;
+};
+
+CB_API void cbp_object_cache_init(cbp_object_cache* oc);
+
+/* Release the memory of the plugin. */
+CB_API void cbp_object_cache_destroy(cbp_object_cache* oc);
+
+/* Percentage of the files found in the cache during the last bake. */
+CB_API int cbp_object_cache_hit_rate(const cbp_object_cache* oc);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* CB_PLUGIN_OBJECT_CACHE_H */
+
+#ifdef CB_IMPLEMENTATION
+
+#ifndef CB_PLUGIN_OBJECT_CACHE_IMPL
+#define CB_PLUGIN_OBJECT_CACHE_IMPL
+
+#ifdef _WIN32
+#include <sys/utime.h> /* _wutime */
+#else
+#include <utime.h> /* utime */
+#endif
+
+CB_INTERNAL void cbp_oc_bake_starting(cb_plugin* plugin, cb_project_t* project);
+CB_INTERNAL void cbp_oc_check_files(cb_plugin* plugin, cb_project_t* project, const char** files, cb_size count);
+CB_INTERNAL cb_bool cbp_oc_can_process_file(cb_plugin* plugin, cb_project_t* project, const char* file);
+CB_INTERNAL void cbp_oc_file_processed(cb_plugin* plugin, cb_project_t* project, const char* file, const char* std_out, const char* std_err);
+CB_INTERNAL void cbp_oc_bake_finished(cb_plugin* plugin, cb_project_t* project);
+
+/* Returns the bake of a project, the bake must have been started. */
+CB_INTERNAL cbp_oc_bake* cbp_oc_get_bake(cbp_object_cache* oc, const cb_project_t* project);
+/* Remove the bake from the plugin and release it. */
+CB_INTERNAL void cbp_oc_release_bake(cbp_oc_bake* bake);
+/* Returns NULL if there is no default directory. The directory is allocated with CB_MALLOC. */
+CB_INTERNAL char* cbp_oc_default_directory(void);
+CB_INTERNAL void cbp_oc_get_host_name(char* buffer, cb_size size);
+CB_INTERNAL int cbp_oc_compare_entries(const void* left, const void* right);
+CB_INTERNAL cbp_oc_entry* cbp_oc_find_entry(cbp_oc_bake* bake, const char* file);
+CB_INTERNAL cb_bool cbp_oc_has_extension(const char* file, const char* extension);
+
+CB_INTERNAL void cbp_oc_append(cb_dstr* out, const char* data, cb_size size);
+/* Append 'data' to 'out' replacing all the occurences of 'from' by 'to'. */
+CB_INTERNAL void cbp_oc_append_replaced(cb_dstr* out, const char* data, cb_size size, cb_strv from, cb_strv to);
+
+/* Returns the path of the .o or .d file of an entry of the cache. The path is allocated with the tmp allocator. */
+CB_INTERNAL const char* cbp_oc_format_entry_path(cbp_object_cache* oc, cb_hash_128_t key, const char* extension);
+
+/* Start the preprocessing of a file, the process writes the result to its stdout. */
+CB_INTERNAL cb_process_handle* cbp_oc_start_preprocess(cbp_oc_bake* bake, cbp_oc_entry* entry, cb_cmd* cmd);
+/* Compute the key of an entry from the output of the preprocessor and release the process. */
+CB_INTERNAL void cbp_oc_end_preprocess(cbp_oc_bake* bake, cbp_oc_entry* entry, cb_process_handle* handle);
+
+CB_INTERNAL cb_bool cbp_oc_restore(cbp_oc_bake* bake, cbp_oc_entry* entry);
+CB_INTERNAL void cbp_oc_store(cbp_oc_bake* bake, cbp_oc_entry* entry, const char* dep_file);
+CB_INTERNAL void cbp_oc_evict(cbp_object_cache* oc);
+
+/*-----------------------------------------------------------------------*/
+/* API implementation */
+/*-----------------------------------------------------------------------*/
+
+CB_API void cbp_object_cache_init(cbp_object_cache* oc)
+{
+    memset(oc, 0, sizeof(cbp_object_cache));
+    oc->plugin.name = "cbp_object_cache";
+    oc->default_directory = cbp_oc_default_directory();
+    oc->directory = oc->default_directory;
+    cbp_oc_get_host_name(oc->host_name, sizeof(oc->host_name));
+
+    oc->plugin.bake_starting = cbp_oc_bake_starting;
+    oc->plugin.check_files = cbp_oc_check_files;
+    oc->plugin.can_process_file = cbp_oc_can_process_file;
+    oc->plugin.file_processed = cbp_oc_file_processed;
+    oc->plugin.bake_finished = cbp_oc_bake_finished;
+
+    cb_darrT_init(&oc->bakes);
+}
+
+CB_API void cbp_object_cache_destroy(cbp_object_cache* oc)
+{
+    while (cb_darrT_size(&oc->bakes) > 0)
+    {
+        cbp_oc_release_bake(cb_darrT_at(&oc->bakes, 0));
+    }
+    cb_darrT_destroy(&oc->bakes);
+
+    CB_FREE(oc->identity_program);
+    CB_FREE(oc->default_directory);
+    oc->identity_program = NULL;
+    oc->default_directory = NULL;
+}
+
+CB_API int cbp_object_cache_hit_rate(const cbp_object_cache* oc)
+{
+    int total = oc->stat_hits + oc->stat_misses;
+    return total > 0 ? (oc->stat_hits * 100) / total : 0;
+}
+
+/*-----------------------------------------------------------------------*/
+/* plugin */
+/*-----------------------------------------------------------------------*/
+
+CB_INTERNAL void cbp_oc_bake_starting(cb_plugin* plugin, cb_project_t* project)
+{
+    cbp_object_cache* oc = (cbp_object_cache*)plugin;
+    cbp_oc_bake* bake = NULL;
+    cb_process_handle* handle = NULL;
+    cb_hash_128_state state;
+    cb_dstr relocated;
+    cb_strv base = { 0 };
+    cb_strv marker = cb_strv_make_str(CBP_OC_BASE_MARKER);
+    cb_size tmp_index = 0;
+    cb_size i = 0;
+
+    /* Statistics are shared by the projects baked at the same time. */
+    if (cb_darrT_size(&oc->bakes) == 0)
+    {
+        oc->stat_hits = 0;
+        oc->stat_misses = 0;
+        oc->stat_stores = 0;
+        oc->stat_evictions = 0;
+    }
+
+    bake = (cbp_oc_bake*)CB_MALLOC(sizeof(cbp_oc_bake));
+    CB_ASSERT(bake);
+    memset(bake, 0, sizeof(cbp_oc_bake));
+    cb_darrT_init(&bake->entries);
+    cb_darrT_push_back(&oc->bakes, bake);
+
+    /* Reference current toolchain and project. */
+    bake->oc = oc;
+    bake->toolchain = cb_toolchain_get();
+    bake->project = project;
+
+    if (!cb_str_equals(bake->toolchain.family, "gcc"))
+    {
+        cb_log_warning("object cache: toolchain '%s' is not supported, the cache is not used.", bake->toolchain.name);
+        return;
+    }
+
+    if (!oc->directory || !oc->directory[0])
+    {
+        cb_log_warning("object cache: no cache directory, the cache is not used.");
+        return;
+    }
+
+    bake->active = cb_true;
+
+    tmp_index = cb_tmp_save();
+    bake->output_dir = cb_str_dup(cb_get_output_directory(bake->project, &bake->toolchain));
+    bake->base_dir = cb_str_dup(cb_tmp_sprintf(CB_STRV_FMT, CB_STRV_ARG(cb_get_current_directory())));
+    base = cb_strv_make_str(bake->base_dir);
+    cb_tmp_restore(tmp_index);
+
+    /* Identity of the compiler. */
+    if (!oc->identity_program || !cb_str_equals(oc->identity_program, bake->toolchain.program))
+    {
+        CB_FREE(oc->identity_program);
+        oc->identity_program = cb_str_dup(bake->toolchain.program);
+
+        tmp_index = cb_tmp_save();
+        handle = cb_process_to_string(cb_tmp_sprintf("%s --version", bake->toolchain.program), NULL, cb_false);
+        cb_hash_128_init(&state);
+        cb_hash_128_update(&state, bake->toolchain.program, strlen(bake->toolchain.program));
+        cb_hash_128_update(&state, cb_process_stdout_string(handle), strlen(cb_process_stdout_string(handle)));
+        oc->identity = cb_hash_128_final(&state);
+        cb_process_end(handle);
+        cb_tmp_restore(tmp_index);
+    }
+
+    /* Same options as the compile command, including the arguments of the plugins,
+       except the ones producing the outputs. */
+    bake->preprocess_options = cb_cmd_create();
+#ifndef _WIN32 /* The gcc toolchain is not available on Windows. */
+    cb_gcc_push_compile_options(bake->preprocess_options, &bake->toolchain, bake->project);
+#endif
+
+    /* The .d file is written by the compile command, the preprocessor must not create one. */
+    for (i = 0; i < cb_cmd_count(bake->preprocess_options); i += 1)
+    {
+        const char* arg = cb_cmd_at(bake->preprocess_options, i);
+        if (cb_str_equals(arg, "-MD") || cb_str_equals(arg, "-MMD"))
+        {
+            cb_cmd_push(bake->preprocess_options, "-MF");
+            cb_cmd_push(bake->preprocess_options, "/dev/null");
+            break;
+        }
+    }
+
+    /* Hash the options without the location of the source tree. */
+    cb_dstr_init(&relocated);
+    for (i = 0; i < cb_cmd_count(bake->preprocess_options); i += 1)
+    {
+        const char* arg = cb_cmd_at(bake->preprocess_options, i);
+        cbp_oc_append_replaced(&relocated, arg, strlen(arg), base, marker);
+        /* Include the null-terminating char to separate the arguments. */
+        cbp_oc_append(&relocated, "", 1);
+    }
+
+    cb_hash_128_init(&state);
+    cb_hash_128_update(&state, CBP_OC_VERSION, sizeof(CBP_OC_VERSION));
+    cb_hash_128_update(&state, &oc->identity, sizeof(oc->identity));
+    cb_hash_128_update(&state, relocated.data, relocated.size);
+    bake->options_hash = cb_hash_128_final(&state);
+    cb_dstr_destroy(&relocated);
+}
+
+/* Preprocess in parallel the files to compile, the previous plugins have already skipped the other ones.
+   The number of processes is limited by the jobs left by the projects baked at the same time. */
+CB_INTERNAL void cbp_oc_check_files(cb_plugin* plugin, cb_project_t* project, const char** files, cb_size count)
+{
+    cbp_oc_bake* bake = cbp_oc_get_bake((cbp_object_cache*)plugin, project);
+    cbp_oc_entry entry;
+    cb_process_handle** handles = NULL;
+    cb_cmd** commands = NULL;
+    cbp_oc_entry** slot_entries = NULL;
+    int slot_count = 0;
+    int running = 0;
+    int slot = 0;
+    cb_size next = 0;
+    cb_size i = 0;
+
+    if (!bake->active)
+    {
+        return;
+    }
+
+    for (i = 0; i < count; i += 1)
+    {
+        memset(&entry, 0, sizeof(cbp_oc_entry));
+        entry.file = cb_str_dup(files[i]);
+        cb_darrT_push_back(&bake->entries, entry);
+    }
+
+    qsort(bake->entries.darr.data, cb_darrT_size(&bake->entries), sizeof(cbp_oc_entry), cbp_oc_compare_entries);
+
+    slot_count = cb_get_free_jobs(bake->project);
+    handles = (cb_process_handle**)CB_MALLOC(sizeof(cb_process_handle*) * slot_count);
+    commands = (cb_cmd**)CB_MALLOC(sizeof(cb_cmd*) * slot_count);
+    slot_entries = (cbp_oc_entry**)CB_MALLOC(sizeof(cbp_oc_entry*) * slot_count);
+    CB_ASSERT(handles && commands && slot_entries);
+    for (slot = 0; slot < slot_count; slot += 1)
+    {
+        handles[slot] = NULL;
+        commands[slot] = cb_cmd_create();
+        slot_entries[slot] = NULL;
+    }
+
+    while (next < cb_darrT_size(&bake->entries) || running > 0)
+    {
+        /* Fill the free slots. */
+        for (slot = 0; slot < slot_count && next < cb_darrT_size(&bake->entries); slot += 1)
+        {
+            if (!handles[slot])
+            {
+                slot_entries[slot] = cb_darrT_ptr(&bake->entries, next);
+                handles[slot] = cbp_oc_start_preprocess(bake, slot_entries[slot], commands[slot]);
+                running += 1;
+                next += 1;
+            }
+        }
+
+        slot = cb_process_wait_any(handles, slot_count);
+        CB_ASSERT(slot >= 0);
+
+        cbp_oc_end_preprocess(bake, slot_entries[slot], handles[slot]);
+        handles[slot] = NULL;
+        slot_entries[slot] = NULL;
+        running -= 1;
+    }
+
+    for (slot = 0; slot < slot_count; slot += 1)
+    {
+        cb_cmd_destroy(commands[slot]);
+    }
+    CB_FREE(slot_entries);
+    CB_FREE(commands);
+    CB_FREE(handles);
+}
+
+CB_INTERNAL cb_bool cbp_oc_can_process_file(cb_plugin* plugin, cb_project_t* project, const char* file)
+{
+    cbp_object_cache* oc = (cbp_object_cache*)plugin;
+    cbp_oc_bake* bake = cbp_oc_get_bake(oc, project);
+    cbp_oc_entry* entry = NULL;
+
+    if (!bake->active)
+    {
+        return cb_true;
+    }
+
+    /* All the files have been preprocessed by cbp_oc_check_files. */
+    entry = cbp_oc_find_entry(bake, file);
+    CB_ASSERT(entry);
+
+    /* Let the compiler report the error. */
+    if (entry->failed)
+    {
+        return cb_true;
+    }
+
+    if (cbp_oc_restore(bake, entry))
+    {
+        oc->stat_hits += 1;
+        cb_current_context()->stats.cache_hits += 1;
+        cb_log_debug("object cache: hit: %s", file);
+        return cb_false;
+    }
+
+    oc->stat_misses += 1;
+    cb_current_context()->stats.cache_misses += 1;
+    entry->needs_store = cb_true;
+    cb_log_debug("object cache: miss: %s", file);
+    return cb_true;
+}
+
+CB_INTERNAL void cbp_oc_file_processed(cb_plugin* plugin, cb_project_t* project, const char* file, const char* std_out, const char* std_err)
+{
+    cbp_object_cache* oc = (cbp_object_cache*)plugin;
+    cbp_oc_bake* bake = cbp_oc_get_bake(oc, project);
+    cbp_oc_entry* entry = NULL;
+    (void)std_err;
+
+    if (!bake->active || oc->restoring)
+    {
+        return;
+    }
+
+    entry = cbp_oc_find_entry(bake, file);
+    if (entry && entry->needs_store)
+    {
+        /* With gcc 'std_out' is the .d file. */
+        cbp_oc_store(bake, entry, std_out);
+        entry->needs_store = cb_false;
+    }
+}
+
+CB_INTERNAL void cbp_oc_bake_finished(cb_plugin* plugin, cb_project_t* project)
+{
+    cbp_object_cache* oc = (cbp_object_cache*)plugin;
+
+    cbp_oc_release_bake(cbp_oc_get_bake(oc, project));
+
+    /* The cache is evicted once all the projects baked at the same time are done. */
+    if (cb_darrT_size(&oc->bakes) > 0)
+    {
+        return;
+    }
+
+    if (oc->stat_stores > 0 && oc->max_size > 0)
+    {
+        cbp_oc_evict(oc);
+    }
+
+    if (oc->stat_hits + oc->stat_misses > 0)
+    {
+        cb_log_debug("object cache: %d hits, %d misses (%d%% hit rate), %d stored, %d evicted.",
+            oc->stat_hits, oc->stat_misses, cbp_object_cache_hit_rate(oc), oc->stat_stores, oc->stat_evictions);
+    }
+}
+
+/*-----------------------------------------------------------------------*/
+/* internal */
+/*-----------------------------------------------------------------------*/
+
+CB_INTERNAL cbp_oc_bake* cbp_oc_get_bake(cbp_object_cache* oc, const cb_project_t* project)
+{
+    cb_size i = 0;
+
+    for (i = 0; i < cb_darrT_size(&oc->bakes); i += 1)
+    {
+        if (cb_darrT_at(&oc->bakes, i)->project == project)
+        {
+            return cb_darrT_at(&oc->bakes, i);
+        }
+    }
+
+    CB_ASSERT(0 && "The bake of the project has not been started.");
+    return NULL;
+}
+
+CB_INTERNAL void cbp_oc_release_bake(cbp_oc_bake* bake)
+{
+    cbp_object_cache* oc = bake->oc;
+    cb_size i = 0;
+
+    for (i = 0; i < cb_darrT_size(&oc->bakes); i += 1)
+    {
+        if (cb_darrT_at(&oc->bakes, i) == bake)
+        {
+            cb_darrT_remove(&oc->bakes, i);
+            break;
+        }
+    }
+
+    for (i = 0; i < cb_darrT_size(&bake->entries); i += 1)
+    {
+        CB_FREE(cb_darrT_ptr(&bake->entries, i)->file);
+    }
+    cb_darrT_destroy(&bake->entries);
+
+    cb_cmd_destroy(bake->preprocess_options);
+    CB_FREE(bake->output_dir);
+    CB_FREE(bake->base_dir);
+    CB_FREE(bake);
+}
+
+CB_INTERNAL char* cbp_oc_default_directory(void)
+{
+    const char* env = getenv("CB_OBJECT_CACHE_DIR");
+    const char* sub_directory = "";
+    cb_dstr directory;
+
+    if (!env || !env[0])
+    {
+#ifdef _WIN32
+        env = getenv("LOCALAPPDATA");
+        sub_directory = "/cb_object_cache";
+#else
+        env = getenv("HOME");
+        sub_directory = "/.cache/cb_object_cache";
+#endif
+    }
+
+    if (!env || !env[0])
+    {
+        return NULL;
+    }
+
+    /* Not allocated with the tmp allocator, the context might not exist yet. */
+    cb_dstr_init(&directory);
+    cb_dstr_append_f(&directory, "%s%s", env, sub_directory);
+    return directory.data;
+}
+
+/* Name of the machine with only the characters allowed in a file name, "unknown" if it's not known. */
+CB_INTERNAL void cbp_oc_get_host_name(char* buffer, cb_size size)
+{
+    cb_bool found = cb_false;
+    cb_size i = 0;
+#ifdef _WIN32
+    DWORD length = (DWORD)size;
+    found = GetComputerNameA(buffer, &length) != 0;
+#else
+    found = gethostname(buffer, size) == 0;
+#endif
+
+    if (!found || !buffer[0])
+    {
+        strncpy(buffer, "unknown", size);
+    }
+    buffer[size - 1] = '\0';
+
+    for (i = 0; buffer[i]; i += 1)
+    {
+        if (!isalnum((unsigned char)buffer[i]) && buffer[i] != '-' && buffer[i] != '_')
+        {
+            buffer[i] = '_';
+        }
+    }
+}
+
+CB_INTERNAL int cbp_oc_compare_entries(const void* left, const void* right)
+{
+    return strcmp(((const cbp_oc_entry*)left)->file, ((const cbp_oc_entry*)right)->file);
+}
+
+CB_INTERNAL cbp_oc_entry* cbp_oc_find_entry(cbp_oc_bake* bake, const char* file)
+{
+    cbp_oc_entry key;
+    key.file = (char*)file;
+
+    if (cb_darrT_size(&bake->entries) == 0)
+    {
+        return NULL;
+    }
+
+    return (cbp_oc_entry*)bsearch(&key, bake->entries.darr.data, cb_darrT_size(&bake->entries), sizeof(cbp_oc_entry), cbp_oc_compare_entries);
+}
+
+CB_INTERNAL cb_bool cbp_oc_has_extension(const char* file, const char* extension)
+{
+    return cb_strv_ends_with(cb_strv_make_str(file), cb_strv_make_str(extension));
+}
+
+/* Empty strings are not appended, an empty cb_dstr refers to a static string that must not be written. */
+CB_INTERNAL void cbp_oc_append(cb_dstr* out, const char* data, cb_size size)
+{
+    if (size > 0)
+    {
+        cb_dstr_append_strv(out, cb_strv_make(data, size));
+    }
+}
+
+CB_INTERNAL void cbp_oc_append_replaced(cb_dstr* out, const char* data, cb_size size, cb_strv from, cb_strv to)
+{
+    const char* end = data + size;
+    const char* cur = data;
+    const char* found = NULL;
+
+    if (from.size == 0)
+    {
+        cbp_oc_append(out, data, size);
+        return;
+    }
+
+    while ((cb_size)(end - cur) >= from.size)
+    {
+        found = (const char*)memchr(cur, from.data[0], (end - cur) - from.size + 1);
+        if (!found)
+        {
+            break;
+        }
+
+        if (memcmp(found, from.data, from.size) == 0)
+        {
+            cbp_oc_append(out, cur, found - cur);
+            cbp_oc_append(out, to.data, to.size);
+            cur = found + from.size;
+        }
+        else
+        {
+            cbp_oc_append(out, cur, found - cur + 1);
+            cur = found + 1;
+        }
+    }
+
+    cbp_oc_append(out, cur, end - cur);
+}
+
+CB_INTERNAL const char* cbp_oc_format_entry_path(cbp_object_cache* oc, cb_hash_128_t key, const char* extension)
+{
+    static const char digits[] = "0123456789abcdef";
+    char hex[33];
+    int i = 0;
+
+    for (i = 0; i < 16; i += 1)
+    {
+        hex[i] = digits[(key.high >> (60 - i * 4)) & 0xF];
+        hex[16 + i] = digits[(key.low >> (60 - i * 4)) & 0xF];
+    }
+    hex[32] = '\0';
+
+    return cb_tmp_sprintf("%s%c%.2s%c%s%s", oc->directory, CB_PREFERRED_DIR_SEPARATOR_CHAR, hex, CB_PREFERRED_DIR_SEPARATOR_CHAR, hex, extension);
+}
+
+CB_INTERNAL cb_process_handle* cbp_oc_start_preprocess(cbp_oc_bake* bake, cbp_oc_entry* entry, cb_cmd* cmd)
+{
+    /* Example: gcc <options> -E <c source file> */
+    cb_cmd_clear(cmd);
+    cb_cmd_append(cmd, bake->preprocess_options);
+    cb_cmd_push(cmd, "-E");
+    cb_cmd_push(cmd, entry->file);
+
+    /* Started from the output directory, like the compile command. */
+    return cb_cmd_spawn_to_string(cmd, bake->output_dir, cb_false);
+}
+
+CB_INTERNAL void cbp_oc_end_preprocess(cbp_oc_bake* bake, cbp_oc_entry* entry, cb_process_handle* handle)
+{
+    cb_hash_128_state state;
+    cb_dstr relocated;
+    const char* output = NULL;
+
+    if (cb_process_wait(handle) != 0)
+    {
+        entry->failed = cb_true;
+        cb_process_end(handle);
+        return;
+    }
+
+    output = cb_process_stdout_string(handle);
+
+    /* The preprocessor writes the path of the files in line markers. */
+    cb_dstr_init(&relocated);
+    cbp_oc_append_replaced(&relocated, output, strlen(output), cb_strv_make_str(bake->base_dir), cb_strv_make_str(CBP_OC_BASE_MARKER));
+
+    cb_hash_128_init(&state);
+    cb_hash_128_update(&state, &bake->options_hash, sizeof(bake->options_hash));
+    cb_hash_128_update(&state, relocated.data, relocated.size);
+    entry->key = cb_hash_128_final(&state);
+    cb_current_context()->stats.bytes_hashed += relocated.size;
+    entry->has_key = cb_true;
+
+    cb_dstr_destroy(&relocated);
+    cb_process_end(handle);
+}
+
+CB_INTERNAL void cbp_oc_touch(const char* path)
+{
+#ifdef _WIN32
+    _wutime(cb_utf8_to_utf16(path), NULL);
+#else
+    utime(path, NULL);
+#endif
+}
+
+CB_INTERNAL cb_bool cbp_oc_restore(cbp_oc_bake* bake, cbp_oc_entry* entry)
+{
+    cb_size tmp_index = cb_tmp_save();
+    const char* cached_obj = cbp_oc_format_entry_path(bake->oc, entry->key, ".o");
+    const char* cached_dep = cbp_oc_format_entry_path(bake->oc, entry->key, ".d");
+    cb_strv obj_file = cb_path_get_object_path(bake->output_dir, entry->file, ".o");
+    cb_strv dep_file = cb_path_change_extension(obj_file, cb_strv_make_str(".d"));
+    cb_file_view view = { 0 };
+    cb_dstr dep_content;
+    cb_bool restored = cb_false;
+
+    cb_dstr_init(&dep_content);
+
+    if (cb_path_exists(cached_obj)
+        && cb_file_view_open(cached_dep, &view))
+    {
+        cbp_oc_append_replaced(&dep_content, view.data, view.size, cb_strv_make_str(CBP_OC_BASE_MARKER), cb_strv_make_str(bake->base_dir));
+        cb_file_view_close(&view);
+
+        restored = cb_copy_file(cached_obj, obj_file.data)
+            && cb_write_file(dep_file.data, dep_content.data, dep_content.size);
+    }
+
+    if (restored)
+    {
+        /* Most recently used. */
+        cbp_oc_touch(cached_obj);
+
+        /* Let the other plugins know about the file, as if it had been compiled. */
+        bake->oc->restoring = cb_true;
+        cb_plugins_file_processed(bake->project, entry->file, dep_file.data, NULL);
+        bake->oc->restoring = cb_false;
+    }
+
+    cb_dstr_destroy(&dep_content);
+    cb_tmp_restore(tmp_index);
+    return restored;
+}
+
+/* Write a file of the cache atomically, other processes sharing the cache never see a partial file.
+   The temporary file is unique to the host, the process, the time and the file written by the process,
+   process ids of different hosts can be the same and process ids are reused. */
+CB_INTERNAL cb_bool cbp_oc_write_entry_file(cbp_object_cache* oc, const char* path, const char* source_file, const cb_dstr* content)
+{
+    const char* tmp_path = NULL;
+    cb_bool written = cb_false;
+
+    oc->tmp_count += 1;
+    tmp_path = cb_tmp_sprintf("%s.%s.%lu.%llx.%llx.tmp", path, oc->host_name, cb_current_process_id(),
+        (unsigned long long)cb_time_now(), (unsigned long long)oc->tmp_count);
+
+    if (source_file)
+    {
+        written = cb_copy_file(source_file, tmp_path);
+    }
+    else
+    {
+        cb_create_directories(tmp_path, strlen(tmp_path));
+        written = cb_write_file(tmp_path, content->data, content->size);
+    }
+
+    if (written && cb_file_replace(tmp_path, path))
+    {
+        return cb_true;
+    }
+
+    cb_delete_file(tmp_path);
+    return cb_false;
+}
+
+CB_INTERNAL void cbp_oc_store(cbp_oc_bake* bake, cbp_oc_entry* entry, const char* dep_file)
+{
+    cb_size tmp_index = cb_tmp_save();
+    cb_strv obj_file = cb_path_get_object_path(bake->output_dir, entry->file, ".o");
+    cb_file_view view = { 0 };
+    cb_dstr dep_content;
+
+    cb_dstr_init(&dep_content);
+
+    if (dep_file && cb_file_view_open(dep_file, &view))
+    {
+        cbp_oc_append_replaced(&dep_content, view.data, view.size, cb_strv_make_str(bake->base_dir), cb_strv_make_str(CBP_OC_BASE_MARKER));
+        cb_file_view_close(&view);
+
+        /* The .d file is written first, an entry is only valid once the .o file exists. */
+        if (cbp_oc_write_entry_file(bake->oc, cbp_oc_format_entry_path(bake->oc, entry->key, ".d"), NULL, &dep_content)
+            && cbp_oc_write_entry_file(bake->oc, cbp_oc_format_entry_path(bake->oc, entry->key, ".o"), obj_file.data, NULL))
+        {
+            bake->oc->stat_stores += 1;
+        }
+    }
+
+    cb_dstr_destroy(&dep_content);
+    cb_tmp_restore(tmp_index);
+}
+
+/* Object file stored in the cache. */
+typedef struct cbp_oc_cached_file cbp_oc_cached_file;
+struct cbp_oc_cached_file
+{
+    char* path;
+    cb_u64 size;              /* Size of the .o file. */
+    cb_u64 last_modification; /* Last time the entry has been used. */
+};
+
+CB_INTERNAL int cbp_oc_compare_cached_files(const void* left, const void* right)
+{
+    cb_u64 l = ((const cbp_oc_cached_file*)left)->last_modification;
+    cb_u64 r = ((const cbp_oc_cached_file*)right)->last_modification;
+    return l < r ? -1 : (l > r ? 1 : 0);
+}
+
+/* Remove the least recently used entries until the size of the cache is below the target size. */
+CB_INTERNAL void cbp_oc_evict(cbp_object_cache* oc)
+{
+    cb_darrT(cbp_oc_cached_file) files;
+    cbp_oc_cached_file cached;
+    cbp_oc_cached_file* current = NULL;
+    cb_file_info info;
+    cb_file_it it = { 0 };
+    const char* file = NULL;
+    cb_u64 total_size = 0;
+    cb_u64 target_size = (oc->max_size / 100) * CBP_OC_EVICTION_TARGET_PERCENT;
+    cb_size i = 0;
+    cb_size tmp_index = 0;
+
+    cb_darrT_init(&files);
+
+    cb_file_it_init_recursive(&it, oc->directory);
+    while (cb_file_it_get_next(&it))
+    {
+        file = cb_file_it_current_file(&it);
+
+        if (!cbp_oc_has_extension(file, ".o") && !cbp_oc_has_extension(file, ".d"))
+        {
+            continue;
+        }
+
+        if (!cb_file_info_query(file, cb_file_info_SIZE | cb_file_info_MODIFICATION_TIME, &info))
+        {
+            continue;
+        }
+
+        total_size += info.size;
+
+        /* The size of a .d file is counted, the .d file is removed along with its .o file. */
+        if (cbp_oc_has_extension(file, ".o"))
+        {
+            cached.path = cb_str_dup(file);
+            cached.size = info.size;
+            cached.last_modification = info.last_modification;
+            cb_darrT_push_back(&files, cached);
+        }
+    }
+    cb_file_it_destroy(&it);
+
+    if (total_size > oc->max_size)
+    {
+        qsort(files.darr.data, cb_darrT_size(&files), sizeof(cbp_oc_cached_file), cbp_oc_compare_cached_files);
+
+        for (i = 0; i < cb_darrT_size(&files) && total_size > target_size; i += 1)
+        {
+            current = cb_darrT_ptr(&files, i);
+
+            tmp_index = cb_tmp_save();
+            if (cb_file_info_query(cb_tmp_sprintf("%.*s.d", (int)(strlen(current->path) - 2), current->path), cb_file_info_SIZE, &info))
+            {
+                total_size -= info.size;
+            }
+            cb_delete_file(current->path);
+            cb_delete_file(cb_tmp_sprintf("%.*s.d", (int)(strlen(current->path) - 2), current->path));
+            cb_tmp_restore(tmp_index);
+
+            total_size -= current->size;
+            oc->stat_evictions += 1;
+        }
+    }
+
+    for (i = 0; i < cb_darrT_size(&files); i += 1)
+    {
+        CB_FREE(cb_darrT_ptr(&files, i)->path);
+    }
+    cb_darrT_destroy(&files);
+}
+
+#endif /* CB_PLUGIN_OBJECT_CACHE_IMPL */
+
+#endif /* CB_IMPLEMENTATION */
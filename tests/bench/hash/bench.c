@@ -0,0 +1,72 @@
+/* Compare the throughput of the 64-bit FNV-1a hash and the implementations of the 128-bit hash.
+   Usage: bench.bin [buffer MiB] [iterations] */
+
+#include <stdlib.h>
+#include <time.h>
+
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cb_hash.h>
+
+static double
+now_s(void)
+{
+    return (double)clock() / (double)CLOCKS_PER_SEC;
+}
+
+static void
+print_result(const char* name, double elapsed, cb_size size, int iterations, cb_u64 check)
+{
+    double mib = (double)size * iterations / (1024.0 * 1024.0);
+    printf("hash: %-12s %10.1f MiB/s (check: %016llx)\n", name, mib / elapsed, (unsigned long long)check);
+}
+
+int main(int argc, char** argv)
+{
+    const char* implementations[] = { "scalar", "sse2", "avx2" };
+    cb_size size = (cb_size)(argc > 1 ? atoi(argv[1]) : 64) * 1024 * 1024;
+    int iterations = argc > 2 ? atoi(argv[2]) : 4;
+    unsigned char* buffer = (unsigned char*)malloc(size);
+    cb_hash_128_t hash = { 0 };
+    cb_u64 hash_64 = 0;
+    cb_size i = 0;
+    int n = 0;
+    double start = 0;
+
+    if (!buffer)
+    {
+        cb_log_error("Could not allocate buffer");
+        return 1;
+    }
+
+    for (i = 0; i < size; i += 1)
+    {
+        buffer[i] = (unsigned char)(i * 31 + (i >> 7));
+    }
+
+    start = now_s();
+    for (n = 0; n < iterations; n += 1)
+    {
+        hash_64 += cb_hash_64((char*)buffer, (int)size);
+    }
+    print_result("fnv1a_64", now_s() - start, size, iterations, hash_64);
+
+    for (i = 0; i < sizeof(implementations) / sizeof(implementations[0]); i += 1)
+    {
+        if (!cb_hash_128_set_implementation(implementations[i]))
+        {
+            printf("hash: %-12s not supported\n", implementations[i]);
+            continue;
+        }
+
+        start = now_s();
+        for (n = 0; n < iterations; n += 1)
+        {
+            hash = cb_hash_128(buffer, size);
+        }
+        print_result(implementations[i], now_s() - start, size, iterations, hash.low);
+    }
+
+    free(buffer);
+    return 0;
+}
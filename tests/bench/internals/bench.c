@@ -0,0 +1,324 @@
+/* Micro-benchmarks of the data structures and functions cb uses the most.
+   Each benchmark is run several times and the fastest run is reported in nanoseconds per operation,
+   along with the number of allocations (CB_MALLOC) per operation.
+   Usage: bench.bin [repetitions] [max mmap size] */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Count the allocations made by cb. */
+static size_t bench_allocation_count = 0;
+static void* bench_malloc(size_t size);
+#define CB_MALLOC bench_malloc
+
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cb_hash.h>
+#include <cb_extensions/cb_dep_parser.h>
+#include <cb_extensions/cb_add_files.h>
+
+static void*
+bench_malloc(size_t size)
+{
+    bench_allocation_count += 1;
+    return malloc(size);
+}
+
+/* Run 'operation_count' operations, returns a value depending on the result so that the work is not optimized out. */
+typedef cb_u64 (*bench_fn)(cb_size operation_count);
+/* Release what has been created by the run, not measured. */
+typedef void (*bench_cleanup_fn)(void);
+
+static int repetitions = 5;
+
+static void
+bench_run(const char* name, bench_fn run, bench_cleanup_fn cleanup, cb_size operation_count)
+{
+    cb_u64 best = (cb_u64)-1;
+    cb_u64 start = 0;
+    cb_u64 elapsed = 0;
+    cb_u64 check = 0;
+    size_t allocations = 0;
+    int i = 0;
+
+    for (i = 0; i < repetitions; i += 1)
+    {
+        allocations = bench_allocation_count;
+        start = cb_time_now();
+        check = run(operation_count);
+        elapsed = cb_time_now() - start;
+        allocations = bench_allocation_count - allocations;
+
+        best = elapsed < best ? elapsed : best;
+
+        if (cleanup)
+        {
+            cleanup();
+        }
+    }
+
+    printf("internals: %-36s %10.1f ns/op %8.3f allocs/op (check: %llx)\n", name,
+        (double)best * 1000.0 / (double)operation_count, (double)allocations / (double)operation_count, (unsigned long long)check);
+    fflush(stdout);
+}
+
+/*-----------------------------------------------------------------------*/
+/* cb_mmap */
+/*-----------------------------------------------------------------------*/
+
+/* Keys look like property names, each key is inserted 4 times. */
+static cb_strv* keys = NULL;
+static char* key_storage = NULL;
+static cb_mmap map;
+
+static void
+create_keys(cb_size count)
+{
+    cb_size i = 0;
+    char* cur = NULL;
+
+    keys = (cb_strv*)malloc(count * sizeof(cb_strv));
+    key_storage = (char*)malloc(count * 32);
+    CB_ASSERT(keys && key_storage);
+
+    cur = key_storage;
+    for (i = 0; i < count; i += 1)
+    {
+        keys[i].data = cur;
+        keys[i].size = (cb_size)sprintf(cur, "property_key_%lu", (unsigned long)(i / 4));
+        cur += keys[i].size + 1;
+    }
+}
+
+static void
+destroy_keys(void)
+{
+    free(keys);
+    free(key_storage);
+}
+
+static cb_u64
+bench_mmap_insert(cb_size count)
+{
+    cb_size i = 0;
+
+    cb_mmap_init(&map);
+    for (i = 0; i < count; i += 1)
+    {
+        cb_mmap_insert(&map, cb_kv_make_with_strv(keys[i], keys[i]));
+    }
+    return (cb_u64)cb_mmap_size(&map);
+}
+
+static void
+destroy_map(void)
+{
+    cb_mmap_destroy(&map);
+}
+
+static cb_u64
+bench_mmap_get_range(cb_size count)
+{
+    cb_u64 found = 0;
+    cb_size i = 0;
+
+    for (i = 0; i < count; i += 1)
+    {
+        found += cb_mmap_get_range(&map, keys[i]).count;
+    }
+    return found;
+}
+
+/*-----------------------------------------------------------------------*/
+/* tmp allocator and cb_dstr */
+/*-----------------------------------------------------------------------*/
+
+/* Allocations of various sizes released by batches of 16, like the paths created while baking. */
+static cb_u64
+bench_tmp_alloc_restore(cb_size count)
+{
+    cb_u64 check = 0;
+    cb_size index = 0;
+    cb_size i = 0;
+
+    index = cb_tmp_save();
+    for (i = 0; i < count; i += 1)
+    {
+        check += (cb_u64)(cb_size)cb_tmp_alloc(16 + (i % 16) * 8) & 0xff;
+        if (i % 16 == 15)
+        {
+            cb_tmp_restore(index);
+        }
+    }
+    cb_tmp_restore(index);
+    return check;
+}
+
+static cb_dstr dstr;
+
+static cb_u64
+bench_dstr_append_f(cb_size count)
+{
+    cb_size i = 0;
+
+    cb_dstr_init(&dstr);
+    for (i = 0; i < count; i += 1)
+    {
+        cb_dstr_append_f(&dstr, "-D%s=%d ", "DEFINE", (int)i);
+    }
+    return (cb_u64)dstr.size;
+}
+
+static void
+destroy_dstr(void)
+{
+    cb_dstr_destroy(&dstr);
+}
+
+/*-----------------------------------------------------------------------*/
+/* hash */
+/*-----------------------------------------------------------------------*/
+
+static char hashed_string[] = "/home/user/project/src/module/file.c";
+
+static cb_u64
+bench_djb2(cb_size count)
+{
+    cb_u64 check = 0;
+    cb_size i = 0;
+
+    for (i = 0; i < count; i += 1)
+    {
+        hashed_string[0] = (char)('/' + (i & 1));
+        check += djb2_strv(hashed_string, sizeof(hashed_string) - 1);
+    }
+    return check;
+}
+
+static cb_u64
+bench_fnv1a_64(cb_size count)
+{
+    cb_u64 check = 0;
+    cb_size i = 0;
+
+    for (i = 0; i < count; i += 1)
+    {
+        hashed_string[0] = (char)('/' + (i & 1));
+        check += cb_fnv1a_64_update(cb_fnv1a_64_make(), hashed_string, (int)(sizeof(hashed_string) - 1));
+    }
+    return check;
+}
+
+/*-----------------------------------------------------------------------*/
+/* dependency parser */
+/*-----------------------------------------------------------------------*/
+
+static cb_dstr dep_file;
+
+/* .d file of a source file including 'count' headers, some of them with escaped spaces. */
+static void
+create_dep_file(cb_size count)
+{
+    cb_size i = 0;
+
+    cb_dstr_init(&dep_file);
+    cb_dstr_append_str(&dep_file, "/home/user/project/.build/gcc/app/main.o: /home/user/project/src/main.c");
+    for (i = 0; i < count; i += 1)
+    {
+        cb_dstr_append_f(&dep_file, " \\\n /usr/include/module_%lu/%sheader_%lu.h", (unsigned long)(i / 16), i % 8 ? "" : "my\\ ", (unsigned long)i);
+    }
+    cb_dstr_append_str(&dep_file, "\n");
+}
+
+static cb_u64
+bench_dep_parser(cb_size count)
+{
+    char dep_buffer[CB_MAX_PATH];
+    cb_dep_parser parser;
+    cb_strv dep = { 0 };
+    cb_u64 check = 0;
+    cb_size found = 0;
+
+    cb_gcc_dep_parser_init_from_memory(&parser, dep_file.data, dep_file.size, dep_buffer, sizeof(dep_buffer));
+    cb_gcc_dep_parser_reset(&parser, NULL);
+    while (cb_gcc_dep_parser_get_next(&parser, NULL, &dep))
+    {
+        check += dep.size;
+        found += 1;
+    }
+
+    /* The source file is one of the dependencies. */
+    CB_ASSERT(found == count + 1);
+    return check;
+}
+
+/*-----------------------------------------------------------------------*/
+/* wildmatch */
+/*-----------------------------------------------------------------------*/
+
+static char wildmatch_paths[1024][48];
+
+static void
+create_wildmatch_paths(void)
+{
+    int i = 0;
+    for (i = 0; i < 1024; i += 1)
+    {
+        sprintf(wildmatch_paths[i], "src/dir_%d/module_%d.%s", i % 10, i, i % 3 ? "c" : "h");
+    }
+}
+
+static cb_u64
+bench_wildmatch(cb_size count)
+{
+    cb_u64 check = 0;
+    cb_size i = 0;
+
+    for (i = 0; i < count; i += 1)
+    {
+        check += cb_wildmatch("src/*/module_*.c", wildmatch_paths[i % 1024]) ? 1 : 0;
+    }
+    return check;
+}
+
+int main(int argc, char** argv)
+{
+    cb_size max_map_size = 1000000;
+    cb_size size = 0;
+
+    repetitions = argc > 1 ? atoi(argv[1]) : 5;
+    max_map_size = argc > 2 ? (cb_size)atol(argv[2]) : max_map_size;
+    if (repetitions < 1)
+    {
+        repetitions = 1;
+    }
+
+    cb_init();
+
+    create_keys(max_map_size);
+    for (size = 1000; size <= max_map_size; size *= 10)
+    {
+        bench_run(cb_tmp_sprintf("cb_mmap_insert (%lu entries)", (unsigned long)size), bench_mmap_insert, destroy_map, size);
+
+        /* The map is kept for the lookups. */
+        bench_mmap_insert(size);
+        bench_run(cb_tmp_sprintf("cb_mmap_get_range (%lu entries)", (unsigned long)size), bench_mmap_get_range, NULL, size);
+        destroy_map();
+    }
+    destroy_keys();
+
+    bench_run("cb_tmp_alloc/cb_tmp_restore", bench_tmp_alloc_restore, NULL, 1000000);
+    bench_run("cb_dstr_append_f", bench_dstr_append_f, destroy_dstr, 1000000);
+    bench_run("djb2_strv (36 bytes)", bench_djb2, NULL, 10000000);
+    bench_run("cb_fnv1a_64_update (36 bytes)", bench_fnv1a_64, NULL, 10000000);
+
+    create_dep_file(100000);
+    bench_run("cb_gcc_dep_parser_get_next", bench_dep_parser, NULL, 100000);
+    cb_dstr_destroy(&dep_file);
+
+    create_wildmatch_paths();
+    bench_run("cb_wildmatch", bench_wildmatch, NULL, 1000000);
+
+    cb_destroy();
+    return 0;
+}
@@ -0,0 +1,263 @@
+/* Generate a large project and time the bakes a developer does the most: cold build, no-op build,
+   build after a change of one header and build after a change of one source file.
+   Each scenario is run without plugin and with cbp_incremental_build.
+   The sources are generated in .build/large_project/, headers are organized in 'depth' levels
+   and each source file or header includes 'fan-out' headers of the next level.
+   Results are printed one per line as key=value pairs, times are in milliseconds.
+   Usage: bench.bin [source file count] [header count] [fan-out] [depth] [jobs] */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cbp_incremental_build.h>
+
+typedef struct bench_params bench_params;
+struct bench_params {
+    int file_count;
+    int header_count;
+    int fan_out;
+    int depth;
+    int jobs;
+};
+
+static const char* root_dir = ".build/large_project/";
+
+static cbp_incremental_build incremental_build_plugin;
+
+/* Number of headers of a level, the last level gets the remaining headers. */
+static int
+level_size(const bench_params* params, int level)
+{
+    int size = params->header_count / params->depth;
+    if (level == params->depth - 1)
+    {
+        size = params->header_count - size * (params->depth - 1);
+    }
+    return size;
+}
+
+/* Header included by the k-th include of a file of the previous level. */
+static int
+included_header(const bench_params* params, int level, int file_index, int k)
+{
+    return level * (params->header_count / params->depth) + (file_index * params->fan_out + k) % level_size(params, level);
+}
+
+static void
+write_file(const char* path, cb_dstr* content)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file || fwrite(content->data, 1, content->size, file) != content->size || fclose(file) != 0)
+    {
+        cb_log_error("Could not write '%s'", path);
+        exit(1);
+    }
+    cb_dstr_destroy(content);
+    cb_dstr_init(content);
+}
+
+static void
+append_comment(const char* path)
+{
+    FILE* file = fopen(path, "ab");
+    if (!file || fputs("/* changed */\n", file) < 0 || fclose(file) != 0)
+    {
+        cb_log_error("Could not change '%s'", path);
+        exit(1);
+    }
+}
+
+static void
+generate(const bench_params* params)
+{
+    cb_dstr content;
+    char directory[256];
+    int level = 0;
+    int i = 0;
+    int k = 0;
+
+    sprintf(directory, "%sinclude/", root_dir);
+    cb_create_directories(directory, strlen(directory));
+    sprintf(directory, "%ssrc/", root_dir);
+    cb_create_directories(directory, strlen(directory));
+
+    cb_dstr_init(&content);
+
+    for (i = 0; i < params->header_count; i += 1)
+    {
+        level = i / (params->header_count / params->depth);
+        level = level < params->depth ? level : params->depth - 1;
+
+        cb_dstr_append_f(&content, "#ifndef BENCH_H_%d\n#define BENCH_H_%d\n\n", i, i);
+        for (k = 0; level + 1 < params->depth && k < params->fan_out; k += 1)
+        {
+            cb_dstr_append_f(&content, "#include \"h_%d.h\"\n", included_header(params, level + 1, i, k));
+        }
+        cb_dstr_append_f(&content, "\n#define BENCH_H_%d_VALUE %d\n\n", i, i);
+        cb_dstr_append_f(&content, "typedef struct bench_h_%d { int values[%d]; } bench_h_%d;\n\n", i, i % 8 + 1, i);
+        cb_dstr_append_f(&content, "#endif\n");
+        write_file(cb_tmp_sprintf("%sinclude/h_%d.h", root_dir, i), &content);
+    }
+
+    for (i = 0; i < params->file_count; i += 1)
+    {
+        for (k = 0; k < params->fan_out; k += 1)
+        {
+            cb_dstr_append_f(&content, "#include \"h_%d.h\"\n", included_header(params, 0, i, k));
+        }
+        cb_dstr_append_f(&content, "\nint tu_%d(void)\n{\n    return %d", i, i);
+        for (k = 0; k < params->fan_out; k += 1)
+        {
+            cb_dstr_append_f(&content, " + BENCH_H_%d_VALUE", included_header(params, 0, i, k));
+        }
+        cb_dstr_append_f(&content, ";\n}\n");
+        write_file(cb_tmp_sprintf("%ssrc/tu_%d.c", root_dir, i), &content);
+    }
+
+    for (i = 0; i < params->file_count; i += 1)
+    {
+        cb_dstr_append_f(&content, "int tu_%d(void);\n", i);
+    }
+    cb_dstr_append_f(&content, "\nint main(void)\n{\n    long sum = 0;\n");
+    for (i = 0; i < params->file_count; i += 1)
+    {
+        cb_dstr_append_f(&content, "    sum += tu_%d();\n", i);
+    }
+    cb_dstr_append_f(&content, "    return sum > 0 ? 0 : 1;\n}\n");
+    write_file(cb_tmp_sprintf("%ssrc/main.c", root_dir), &content);
+
+    cb_dstr_destroy(&content);
+}
+
+static void
+define_project(const bench_params* params, const char* output_dir)
+{
+    int i = 0;
+
+    cb_project("large_project");
+    cb_set(cb_BINARY_TYPE, cb_EXE);
+    cb_set(cb_OUTPUT_DIR, output_dir);
+    cb_add_f(cb_INCLUDE_DIRECTORIES, "%sinclude", root_dir);
+    cb_add_f(cb_FILES, "%ssrc/main.c", root_dir);
+    for (i = 0; i < params->file_count; i += 1)
+    {
+        cb_add_f(cb_FILES, "%ssrc/tu_%d.c", root_dir, i);
+    }
+}
+
+static void
+delete_files(const char* directory)
+{
+    cb_file_it it = { 0 };
+
+    if (!cb_path_exists(directory))
+    {
+        return;
+    }
+
+    cb_file_it_init_recursive(&it, directory);
+    while (cb_file_it_get_next(&it))
+    {
+        cb_delete_file(cb_file_it_current_file(&it));
+    }
+    cb_file_it_destroy(&it);
+}
+
+static void
+run_scenario(const char* plugin, const char* scenario)
+{
+    cb_u64 start = 0;
+    cb_u64 elapsed = 0;
+    cb_stats stats;
+    const char* artefact = NULL;
+
+    cb_stats_reset();
+
+    start = cb_time_now();
+    artefact = cb_bake();
+    elapsed = cb_time_now() - start;
+
+    if (!artefact)
+    {
+        cb_log_error("Could not bake the project (plugin=%s scenario=%s)", plugin, scenario);
+        exit(1);
+    }
+
+    stats = cb_stats_get();
+    printf("large_project: plugin=%s scenario=%s total_ms=%.1f processes=" CB_U64_FMT " check_ms=%.1f compile_ms=%.1f link_ms=%.1f plugin_ms=%.1f files_stated=" CB_U64_FMT " bytes_hashed=" CB_U64_FMT " cache_hits=" CB_U64_FMT " cache_misses=" CB_U64_FMT "\n",
+        plugin, scenario, elapsed / 1000.0, stats.process_count,
+        stats.check_time / 1000.0, stats.compile_time / 1000.0, stats.link_time / 1000.0, stats.plugin_time / 1000.0,
+        stats.files_stated, stats.bytes_hashed, stats.cache_hits, stats.cache_misses);
+    fflush(stdout);
+}
+
+static void
+run_scenarios(const bench_params* params, cb_bool with_plugin)
+{
+    cb_plugin* plugins[] = {
+        &incremental_build_plugin.plugin
+    };
+    const char* plugin = with_plugin ? "incremental_build" : "none";
+    const char* output_dir = NULL;
+
+    if (with_plugin)
+    {
+        cbp_incremental_build_init(&incremental_build_plugin);
+        cb_init_with_plugins(plugins, 1);
+    }
+    else
+    {
+        cb_init();
+    }
+
+    output_dir = cb_tmp_sprintf("%sout_%s/", root_dir, plugin);
+    cb_set_jobs(params->jobs);
+    define_project(params, output_dir);
+
+    if (with_plugin)
+    {
+        cbp_incremental_build_delete_cache(&incremental_build_plugin);
+    }
+    delete_files(output_dir);
+
+    run_scenario(plugin, "cold");
+    run_scenario(plugin, "no_op");
+
+    /* Header of the first level, included by the source files. */
+    append_comment(cb_tmp_sprintf("%sinclude/h_0.h", root_dir));
+    run_scenario(plugin, "change_header");
+
+    append_comment(cb_tmp_sprintf("%ssrc/tu_0.c", root_dir));
+    run_scenario(plugin, "change_source");
+
+    cb_destroy();
+}
+
+int main(int argc, char** argv)
+{
+    bench_params params;
+
+    params.file_count = argc > 1 ? atoi(argv[1]) : 500;
+    params.header_count = argc > 2 ? atoi(argv[2]) : 200;
+    params.fan_out = argc > 3 ? atoi(argv[3]) : 4;
+    params.depth = argc > 4 ? atoi(argv[4]) : 4;
+    params.jobs = argc > 5 ? atoi(argv[5]) : 0;
+
+    if (params.file_count < 1 || params.fan_out < 1 || params.depth < 1 || params.header_count < params.depth)
+    {
+        cb_log_error("Expected at least 1 source file, a fan-out of 1, a depth of 1 and one header per level.");
+        return 1;
+    }
+
+    printf("large_project: files=%d headers=%d fan_out=%d depth=%d jobs=%d\n",
+        params.file_count, params.header_count, params.fan_out, params.depth, params.jobs);
+
+    generate(&params);
+
+    run_scenarios(&params, cb_false);
+    run_scenarios(&params, cb_true);
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+/* Compare the time needed to create a child process with fork and with posix_spawn.
+   The parent process allocates a large amount of memory to behave like a cb.bin with big projects.
+   Usage: bench.bin [process count] [allocated MiB] */
+
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+
+#ifdef _WIN32
+
+int main(void)
+{
+    printf("process_spawn: fork and posix_spawn are not available on Windows.\n");
+    return 0;
+}
+
+#else
+
+#include <sys/time.h> /* gettimeofday */
+
+typedef pid_t (*launcher_t)(char* args[], cb_process_handle* handle, int stdout_pfd[2], int stderr_pfd[2]);
+
+static double
+now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec * 1000000.0 + (double)tv.tv_usec;
+}
+
+static void
+bench_launcher(const char* name, launcher_t launcher, const char* directory, int process_count)
+{
+    char* args[] = { "true", NULL };
+    int no_pipe[2] = { -1, -1 };
+    int wstatus = 0;
+    int i = 0;
+    pid_t pid = 0;
+    double start = 0;
+    double elapsed = 0;
+    cb_process_handle* handle = cb_create_process_handle("true", directory);
+
+    start = now_us();
+    for (i = 0; i < process_count; i += 1)
+    {
+        pid = launcher(args, handle, no_pipe, no_pipe);
+        if (pid == CB_INVALID_PROCESS || waitpid(pid, &wstatus, 0) < 0)
+        {
+            cb_log_error("Could not run process with %s", name);
+            exit(1);
+        }
+    }
+    elapsed = now_us() - start;
+
+    printf("process_spawn: %-24s %6d processes %10.1f us/process\n", name, process_count, elapsed / process_count);
+
+    cb_process_end(handle);
+}
+
+int main(int argc, char** argv)
+{
+    int process_count = argc > 1 ? atoi(argv[1]) : 500;
+    size_t allocated_size = (size_t)(argc > 2 ? atoi(argv[2]) : 256) * 1024 * 1024;
+    char* memory = NULL;
+
+    /* Touch the memory so that the pages are mapped and need to be copied by fork. */
+    memory = (char*)malloc(allocated_size);
+    CB_ASSERT(memory);
+    memset(memory, 1, allocated_size);
+
+    printf("process_spawn: parent process with %d MiB allocated\n", (int)(allocated_size / (1024 * 1024)));
+
+    bench_launcher("fork", cb_fork_process, NULL, process_count);
+    bench_launcher("fork (chdir)", cb_fork_process, "/", process_count);
+#ifdef CB_USE_POSIX_SPAWN
+    bench_launcher("posix_spawn", cb_posix_spawn_process, NULL, process_count);
+#ifdef CB_USE_POSIX_SPAWN_CHDIR
+    bench_launcher("posix_spawn (chdir)", cb_posix_spawn_process, "/", process_count);
+#endif
+#endif
+    /* Launcher used by cb_process_start. */
+    bench_launcher("cb_spawn_process", cb_spawn_process, NULL, process_count);
+
+    free(memory);
+    return 0;
+}
+
+#endif
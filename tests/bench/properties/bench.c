@@ -0,0 +1,50 @@
+/* Time the setup of a project with many files and defines.
+   Usage: bench.bin [file count] */
+
+#include <stdlib.h>
+#include <time.h>
+
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+
+static double
+now_s(void)
+{
+    return (double)clock() / (double)CLOCKS_PER_SEC;
+}
+
+int main(int argc, char** argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 40000;
+    int i = 0;
+    cb_size found = 0;
+    double start = 0;
+    cb_kv_range range;
+    cb_kv current;
+
+    cb_init();
+    cb_project("bench");
+
+    start = now_s();
+    for (i = 0; i < count; i += 1)
+    {
+        cb_add_f(cb_FILES, "src/module_%d/file_%d.c", i / 100, i);
+        cb_add_f(cb_DEFINES, "DEFINE_%d=%d", i, i);
+    }
+    printf("properties: add %d files and defines   %8.3f s\n", count, now_s() - start);
+
+    start = now_s();
+    for (i = 0; i < count; i += 1)
+    {
+        found += cb_mmap_get_range_str(&cb_current_project()->mmap, i % 2 ? cb_FILES : cb_DEFINES).count;
+    }
+    range = cb_mmap_get_range_str(&cb_current_project()->mmap, cb_FILES);
+    while (cb_mmap_range_get_next(&range, &current))
+    {
+        found += 1;
+    }
+    printf("properties: query %d ranges            %8.3f s (check: %lu)\n", count, now_s() - start, (unsigned long)found);
+
+    cb_destroy();
+    return 0;
+}
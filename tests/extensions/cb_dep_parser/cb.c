@@ -10,6 +10,7 @@
 
 static void msvc_parser_tests();
 static void gcc_parser_tests();
+static void gcc_parser_from_memory_tests();
 
 static const char* read_file_content(const char* filepath);
 static void free_file_content(const char* content);
@@ -20,6 +21,7 @@ int main(void)
 {
     msvc_parser_tests();
     gcc_parser_tests();
+    gcc_parser_from_memory_tests();
     return 0;
 }
 
@@ -278,6 +280,63 @@ static void gcc_parser_tests()
     }
 }
 
+/* Parsing a file from memory must give the same result as parsing it with the FILE API. */
+static void gcc_parser_from_memory_tests()
+{
+    const char* files[] = {
+        "gcc/empty.d",
+        "gcc/whitespaces.d",
+        "gcc/target_without_colon.d",
+        "gcc/target_without_deps.d",
+        "gcc/target_without_deps_ws.d",
+        "gcc/target_with_single_dep.d",
+        "gcc/target_with_single_dep_ws.d",
+        "gcc/target_with_multiple_deps_01.d",
+        "gcc/target_with_multiple_deps_02.d",
+        "gcc/target_with_multiple_deps_03.d",
+        "gcc/target_with_multiple_deps_04.d",
+        "gcc/target_with_multiple_deps_05.d",
+        "gcc/unusual_case_01.d",
+        "gcc/real_example.d",
+        "gcc/real_example_lf.d"
+    };
+    FILE* f = NULL;
+    cb_file_view view;
+    cb_strv value = { 0 };
+    cb_strv memory_value = { 0 };
+    cb_bool found = cb_false;
+    cb_dep_parser p = { 0 };
+    cb_dep_parser memory_p = { 0 };
+    size_t i = 0;
+
+    char read_buffer[4096] = { 0 };
+    char dep_buffer[4096] = { 0 };
+    char memory_dep_buffer[4096] = { 0 };
+
+    cb_gcc_dep_parser_init(&p, read_buffer, sizeof(read_buffer), dep_buffer, sizeof(dep_buffer));
+
+    for (i = 0; i < sizeof(files) / sizeof(files[0]); i += 1)
+    {
+        f = cb_file_open_readonly(files[i]);
+        cb_assert_true(cb_file_view_open(files[i], &view));
+
+        cb_gcc_dep_parser_reset(&p, f);
+
+        cb_gcc_dep_parser_init_from_memory(&memory_p, view.data, view.size, memory_dep_buffer, sizeof(memory_dep_buffer));
+        cb_gcc_dep_parser_reset(&memory_p, NULL);
+
+        do
+        {
+            found = cb_gcc_dep_parser_get_next(&p, f, &value);
+            CB_ASSERT(cb_gcc_dep_parser_get_next(&memory_p, NULL, &memory_value) == found);
+            CB_ASSERT(cb_strv_equals_strv(value, memory_value));
+        } while (found);
+
+        cb_file_view_close(&view);
+        fclose(f);
+    }
+}
+
 static const char* read_file_content(const char* filepath)
 {
     FILE* fp = cb_file_open_readonly(filepath);
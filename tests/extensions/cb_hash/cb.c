@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cb_assert.h>
+#include <cb_extensions/cb_file_io.h>
+#include <cb_extensions/cb_hash.h>
+
+#define DATA_SIZE 5000
+
+static unsigned char data[DATA_SIZE];
+
+/* Sizes around the stripe (64 bytes) and block (1024 bytes) boundaries. */
+static const cb_size sizes[] = { 0, 1, 7, 63, 64, 65, 127, 128, 1000, 1023, 1024, 1025, 2048, 3000, 4096, DATA_SIZE };
+
+#define SIZE_COUNT (sizeof(sizes) / sizeof(sizes[0]))
+
+static cb_hash_128_t hash_by_chunks(const unsigned char* bytes, cb_size size, cb_size chunk_size)
+{
+    cb_hash_128_state state;
+    cb_size offset = 0;
+    cb_size count = 0;
+
+    cb_hash_128_init(&state);
+    for (offset = 0; offset < size; offset += count)
+    {
+        count = size - offset < chunk_size ? size - offset : chunk_size;
+        cb_hash_128_update(&state, bytes + offset, count);
+    }
+    return cb_hash_128_final(&state);
+}
+
+int main(void)
+{
+    const char* implementations[] = { "sse2", "avx2" };
+    const char* filename = "hash_test.bin";
+    cb_hash_128_t expected[SIZE_COUNT];
+    cb_hash_128_t hash;
+    cb_u32 seed = 12345;
+    cb_size i = 0;
+    cb_size j = 0;
+
+    for (i = 0; i < DATA_SIZE; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (unsigned char)(seed >> 16);
+    }
+
+    /* Reference values. */
+    cb_assert_true(cb_hash_128_set_implementation("scalar"));
+    for (i = 0; i < SIZE_COUNT; i += 1)
+    {
+        expected[i] = cb_hash_128(data, sizes[i]);
+    }
+
+    /* All hashes must be different. */
+    for (i = 0; i < SIZE_COUNT; i += 1)
+    {
+        for (j = i + 1; j < SIZE_COUNT; j += 1)
+        {
+            cb_assert_false(cb_hash_128_equals(expected[i], expected[j]));
+        }
+    }
+
+    /* A single bit change must change the hash. */
+    data[DATA_SIZE / 2] ^= 1;
+    cb_assert_false(cb_hash_128_equals(expected[SIZE_COUNT - 1], cb_hash_128(data, DATA_SIZE)));
+    data[DATA_SIZE / 2] ^= 1;
+
+    /* Zero padding of the last stripe must not collide with actual zeros. */
+    {
+        unsigned char zeros[2] = { 0, 0 };
+        cb_assert_false(cb_hash_128_equals(cb_hash_128(zeros, 1), cb_hash_128(zeros, 2)));
+    }
+
+    /* Streaming must give the same result whatever the size of the chunks. */
+    for (i = 0; i < SIZE_COUNT; i += 1)
+    {
+        cb_assert_true(cb_hash_128_equals(expected[i], hash_by_chunks(data, sizes[i], 1)));
+        cb_assert_true(cb_hash_128_equals(expected[i], hash_by_chunks(data, sizes[i], 7)));
+        cb_assert_true(cb_hash_128_equals(expected[i], hash_by_chunks(data, sizes[i], 1000)));
+    }
+
+    /* SIMD implementations must give the same result as the scalar one. */
+    for (j = 0; j < sizeof(implementations) / sizeof(implementations[0]); j += 1)
+    {
+        if (!cb_hash_128_set_implementation(implementations[j]))
+        {
+            cb_log_info("cb_hash_128: '%s' is not supported", implementations[j]);
+            continue;
+        }
+
+        for (i = 0; i < SIZE_COUNT; i += 1)
+        {
+            cb_assert_true(cb_hash_128_equals(expected[i], cb_hash_128(data, sizes[i])));
+            cb_assert_true(cb_hash_128_equals(expected[i], hash_by_chunks(data, sizes[i], 7)));
+        }
+    }
+
+    /* Hash of a file. */
+    cb_assert_true(cb_file_write_strv(filename, cb_strv_make((const char*)data, DATA_SIZE)));
+    cb_assert_true(cb_hash_128_from_filename(filename, &hash));
+    cb_assert_true(cb_hash_128_equals(expected[SIZE_COUNT - 1], hash));
+    cb_assert_true(cb_delete_file(filename));
+
+    /* Hash of a file large enough to be mapped in memory. */
+    {
+        cb_size large_size = CB_FILE_VIEW_MAP_THRESHOLD + 1;
+        unsigned char* large_data = (unsigned char*)malloc(large_size);
+        cb_u64 hash_64 = 0;
+
+        CB_ASSERT(large_data);
+        for (i = 0; i < large_size; i += 1)
+        {
+            large_data[i] = data[i % DATA_SIZE];
+        }
+
+        cb_assert_true(cb_file_write_strv(filename, cb_strv_make((const char*)large_data, large_size)));
+        cb_assert_true(cb_hash_128_from_filename(filename, &hash));
+        cb_assert_true(cb_hash_128_equals(cb_hash_128(large_data, large_size), hash));
+        cb_assert_true(cb_hash_64_from_filename(filename, &hash_64));
+        CB_ASSERT(cb_hash_64((char*)large_data, (int)large_size) == hash_64);
+        cb_assert_true(cb_delete_file(filename));
+
+        free(large_data);
+    }
+
+    return 0;
+}
@@ -1,197 +1,313 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
-
-#if defined(_WIN32) || defined(_WIN64)
-    #include <sys/utime.h>
-    #include <io.h>
-    #define utime _utime
-    #define utimbuf _utimbuf
-#else
-    #include <utime.h>
-    #include <unistd.h>
-#endif
-
-#define CB_IMPLEMENTATION
-#include <cb/cb.h>
-#include <cb_extensions/cbp_incremental_build.h>
-#include <cb_extensions/cb_assert.h>
-
-static cbp_incremental_build incremental_build_plugin;
-
-static int fake_time = 0;
-
-static int change_time(const char *filename, time_t time)
-{
-    /* Set current time */
-    struct utimbuf new_times;
-    new_times.actime = time;  /* access time  */
-    new_times.modtime = time; /* modification time */
-
-    if (utime(filename, &new_times) != 0)
-    {
-        perror("Failed to update timestamp");
-        return -1;
-    }
-
-    return 0;
-}
-
-static void set_to_zero_time(const char *filename)
-{
-    time_t zero = (time_t)(0);
-    change_time(filename, zero);
-}
-
-static void set_to_next_fake_time(const char *filename)
-{
-    /* Increment by 2 in case the platform resolution is a single second */
-    fake_time += 1;
-    change_time(filename, (time_t)(fake_time));
-}
-
-/* The incremental database is saved in the output directory of a specific project.
-   Sharing the same output directory is likely something you will not want in this situation. */ 
-int main(void)
-{
-    const char* bar_c = "src/bar.c";
-    const char* bar_h = "src/bar.h";
-    const char* foo_c = "src/foo.c";
-    const char* foo_h = "src/foo.h";
-    const char* common_h = "src/common.h";
-    
-    cb_plugin* plugins[] = {
-        &incremental_build_plugin.plugin
-    };
-    
-    cbp_incremental_build_init(&incremental_build_plugin);
-    
-    cb_init_with_plugins(plugins, 1);
-
-    cb_project("lib");
-    cb_set(cb_BINARY_TYPE, cb_STATIC_LIBRARY);
-
-    cb_add(cb_FILES, bar_c);
-    cb_add(cb_FILES, foo_c);
-
-    cbp_incremental_build_delete_cache(&incremental_build_plugin);
-    
-    set_to_zero_time(bar_c);
-    set_to_zero_time(bar_h);
-    set_to_zero_time(foo_c);
-    set_to_zero_time(foo_h);
-    set_to_zero_time(common_h);
-
-    cb_bake();
-    
-    /* First build after all files were changed. All compilation unit must be rebuilt. */
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 2);
- 
-    set_to_next_fake_time(bar_c);
-    
-    /* Only one file must be rebuild after change bar.c */
-    cb_bake();
-
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 1);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 1);
-    
-    /* No file must be rebuild if we don't change any file. */
-    cb_bake();
-    
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
-
-    set_to_next_fake_time(foo_c);
-    
-    /* Only one file must be rebuild after change foo.c */
-    cb_bake();
-    
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 1);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 1);
-    
-    set_to_next_fake_time(foo_h);
-    
-    /* Only one file must be rebuild after change foo.h */
-    cb_bake();
-    
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 1);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 1);
-    
-    /* Only one file must be rebuild after change bar.h */
-    set_to_next_fake_time(bar_h);
-    
-    cb_bake();
-    
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 1);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 1);
-    
-    set_to_next_fake_time(common_h);
-    
-    /* bar.c and foo.c must be rebuild after change common.h */
-    cb_bake();
-    
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 2);
-    
-    set_to_next_fake_time(foo_h);
-    set_to_next_fake_time(bar_h);
-    
-    /* bar.c and foo.c must be rebuild after change bar.h and foo.h */
-    cb_bake();  
-
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 2);
-    
-    /* No file must be rebuild if we don't change any file. */
-    cb_bake();
-    
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
-    
-    /* Changing any flag must invalide all compilation unit. */
-    #ifdef _WIN32
-    cb_add(cb_CXFLAGS, "/O2");
-    #else
-       cb_add(cb_CXFLAGS, "-O2");
-    #endif
-    cb_bake();
-    
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 2);
-    
-    /* No file must be rebuild if we don't change any file. */
-    cb_bake();
-    
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
-    
-    /* Changing the defines must invalide all compilation unit. */
-    cb_add(cb_DEFINES, "UNICODE");
-    cb_bake();
-    
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 2);
-    
-    /* No file must be rebuild if we don't change any file. */
-    cb_bake();
-    
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
-    
-    /* Changing the include search directories must invalide all compilation unit. */
-    cb_add(cb_INCLUDE_DIRECTORIES, "./");
-    cb_bake();
-    
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 2);
-    
-    /* Make sure nothing get recompiled after 0 change. */
-    cb_bake();
-    
-    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
-    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
-    
-    return 0;
-}
-
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+    #include <sys/utime.h>
+    #include <io.h>
+    #define utime _utime
+    #define utimbuf _utimbuf
+#else
+    #include <utime.h>
+    #include <unistd.h>
+    #include <sys/stat.h>
+#endif
+
+#define CB_IMPLEMENTATION
+/* Check the files on several threads even if there are only a few of them. */
+#define CBP_IB_MIN_FILES_PER_THREAD 1
+#include <cb/cb.h>
+#include <cb_extensions/cbp_incremental_build.h>
+#include <cb_extensions/cb_assert.h>
+
+static cbp_incremental_build incremental_build_plugin;
+
+static int fake_time = 0;
+
+static int change_time(const char *filename, time_t time)
+{
+    /* Set current time */
+    struct utimbuf new_times;
+    new_times.actime = time;  /* access time  */
+    new_times.modtime = time; /* modification time */
+
+    if (utime(filename, &new_times) != 0)
+    {
+        perror("Failed to update timestamp");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void set_to_zero_time(const char *filename)
+{
+    time_t zero = (time_t)(0);
+    change_time(filename, zero);
+}
+
+static void set_to_next_fake_time(const char *filename)
+{
+    /* Increment by 2 in case the platform resolution is a single second */
+    fake_time += 1;
+    change_time(filename, (time_t)(fake_time));
+}
+
+/* The incremental database is saved in the output directory of a specific project.
+   Sharing the same output directory is likely something you will not want in this situation. */ 
+int main(void)
+{
+    const char* bar_c = "src/bar.c";
+    const char* bar_h = "src/bar.h";
+    const char* foo_c = "src/foo.c";
+    const char* foo_h = "src/foo.h";
+    const char* common_h = "src/common.h";
+    
+    cb_plugin* plugins[] = {
+        &incremental_build_plugin.plugin
+    };
+    
+    cbp_incremental_build_init(&incremental_build_plugin);
+    
+    /* Files are changed by updating their modification time only. */
+    incremental_build_plugin.check_policy = cbp_ib_check_METADATA;
+    incremental_build_plugin.check_threads = 4;
+    
+    cb_init_with_plugins(plugins, 1);
+
+    cb_project("lib");
+    cb_set(cb_BINARY_TYPE, cb_STATIC_LIBRARY);
+
+    cb_add(cb_FILES, bar_c);
+    cb_add(cb_FILES, foo_c);
+
+    cbp_incremental_build_delete_cache(&incremental_build_plugin);
+    
+    set_to_zero_time(bar_c);
+    set_to_zero_time(bar_h);
+    set_to_zero_time(foo_c);
+    set_to_zero_time(foo_h);
+    set_to_zero_time(common_h);
+
+    cb_bake();
+    
+    /* First build after all files were changed. All compilation unit must be rebuilt. */
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 2);
+ 
+    set_to_next_fake_time(bar_c);
+    
+    /* Only one file must be rebuild after change bar.c */
+    cb_bake();
+
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 1);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 1);
+    
+    /* No file must be rebuild if we don't change any file. */
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
+    
+    /* common.h is a dependency of both units but must be queried only once. */
+    CB_ASSERT(incremental_build_plugin.stat_file_state_misses == 5);
+    CB_ASSERT(incremental_build_plugin.stat_file_state_hits == 1);
+
+    set_to_next_fake_time(foo_c);
+    
+    /* Only one file must be rebuild after change foo.c */
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 1);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 1);
+    
+    set_to_next_fake_time(foo_h);
+    
+    /* Only one file must be rebuild after change foo.h */
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 1);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 1);
+    
+    /* Only one file must be rebuild after change bar.h */
+    set_to_next_fake_time(bar_h);
+    
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 1);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 1);
+    
+    set_to_next_fake_time(common_h);
+    
+    /* bar.c and foo.c must be rebuild after change common.h */
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 2);
+    
+    set_to_next_fake_time(foo_h);
+    set_to_next_fake_time(bar_h);
+    
+    /* bar.c and foo.c must be rebuild after change bar.h and foo.h */
+    cb_bake();  
+
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 2);
+    
+    /* No file must be rebuild if we don't change any file. */
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
+    
+    /* Changing any flag must invalide all compilation unit. */
+    #ifdef _WIN32
+    cb_add(cb_CXFLAGS, "/O2");
+    #else
+       cb_add(cb_CXFLAGS, "-O2");
+    #endif
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 2);
+    
+    /* No file must be rebuild if we don't change any file. */
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
+    
+    /* Changing the defines must invalide all compilation unit. */
+    cb_add(cb_DEFINES, "UNICODE");
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 2);
+    
+    /* No file must be rebuild if we don't change any file. */
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
+    
+    /* Changing the include search directories must invalide all compilation unit. */
+    cb_add(cb_INCLUDE_DIRECTORIES, "./");
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 2);
+    
+    /* Make sure nothing get recompiled after 0 change. */
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
+    
+#ifndef _WIN32
+    /* The library is not archived again when no object changed. */
+    {
+        const char* lib_path = cb_str_dup(cb_bake());
+        struct stat lib_stat;
+
+        set_to_zero_time(lib_path);
+        cb_bake();
+
+        CB_ASSERT(stat(lib_path, &lib_stat) == 0 && lib_stat.st_mtime == 0);
+
+        set_to_next_fake_time(bar_c);
+        cb_bake();
+
+        CB_ASSERT(incremental_build_plugin.stat_compilable == 1);
+        CB_ASSERT(stat(lib_path, &lib_stat) == 0 && lib_stat.st_mtime != 0);
+
+        CB_FREE((void*)lib_path);
+    }
+#endif
+
+    /* With the tiered policy a file that is touched without being modified is not compiled again. */
+    incremental_build_plugin.check_policy = cbp_ib_check_TIERED;
+    
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
+    CB_ASSERT(incremental_build_plugin.stat_file_hashes == 0);
+    
+    set_to_next_fake_time(common_h);
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
+    CB_ASSERT(incremental_build_plugin.stat_file_hashes == 1);
+    
+    /* The new modification time has been recorded, common.h must not be read again. */
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
+    CB_ASSERT(incremental_build_plugin.stat_file_hashes == 0);
+    
+    /* With the hash policy the content of all files is read. */
+    incremental_build_plugin.check_policy = cbp_ib_check_HASH;
+    set_to_next_fake_time(bar_c);
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
+    CB_ASSERT(incremental_build_plugin.stat_file_hashes == 5);
+    
+    incremental_build_plugin.check_policy = cbp_ib_check_METADATA;
+    
+    /* A corrupted database must invalidate all compilation units. */
+    {
+        cb_toolchain_t toolchain = cb_toolchain_get();
+        const char* db_path = cb_tmp_sprintf("%s/cbp_ib_cache/lib.db", cb_get_output_directory(cb_current_project(), &toolchain));
+        
+        cb_assert_file_exists(db_path);
+        cb_assert_true(cb_file_write_strv(db_path, cb_strv_make_str("not a database")));
+    }
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 2);
+    
+    /* Make sure nothing get recompiled after 0 change. */
+    cb_bake();
+    
+    CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
+    CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
+    
+    /* Projects sharing the same output directory must not erase the database of each other. */
+    {
+        cb_toolchain_t toolchain = cb_toolchain_get();
+        char* output_dir = cb_str_dup(cb_get_output_directory(cb_current_project(), &toolchain));
+        
+        cb_project("lib_bar");
+        cb_set(cb_BINARY_TYPE, cb_STATIC_LIBRARY);
+        cb_set(cb_OUTPUT_DIR, output_dir);
+        cb_add(cb_FILES, "src/bar/bar.c");
+        
+        cbp_incremental_build_delete_cache(&incremental_build_plugin);
+        cb_bake();
+        
+        CB_ASSERT(incremental_build_plugin.stat_ignored == 0);
+        CB_ASSERT(incremental_build_plugin.stat_compilable == 1);
+        
+        cb_project("lib");
+        cb_bake();
+        
+        CB_ASSERT(incremental_build_plugin.stat_ignored == 2);
+        CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
+        
+        cb_project("lib_bar");
+        cb_bake();
+        
+        CB_ASSERT(incremental_build_plugin.stat_ignored == 1);
+        CB_ASSERT(incremental_build_plugin.stat_compilable == 0);
+        
+        CB_FREE(output_dir);
+    }
+    
+    return 0;
+}
+
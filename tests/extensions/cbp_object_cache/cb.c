@@ -0,0 +1,179 @@
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cbp_object_cache.h>
+#include <cb_extensions/cbp_incremental_build.h>
+#include <cb_extensions/cb_assert.h>
+
+static cbp_object_cache object_cache_plugin;
+static cbp_incremental_build incremental_build_plugin;
+
+/* Plugin adding a code generation flag to the compile command. */
+static cb_plugin codegen_plugin;
+static const char* codegen_argument = "";
+
+static const char* codegen_extra_argument(cb_plugin* plugin, cb_project_t* project)
+{
+    (void)plugin;
+    (void)project;
+    return codegen_argument;
+}
+
+static void delete_files(const char* directory)
+{
+    cb_file_it it = { 0 };
+
+    if (!cb_path_exists(directory))
+    {
+        return;
+    }
+
+    cb_file_it_init_recursive(&it, directory);
+    while (cb_file_it_get_next(&it))
+    {
+        cb_delete_file(cb_file_it_current_file(&it));
+    }
+    cb_file_it_destroy(&it);
+}
+
+/* Bake the project in an output directory. */
+static void bake_again_in(const char* output_dir)
+{
+    const char* path = NULL;
+
+    cb_set(cb_OUTPUT_DIR, output_dir);
+
+    path = cb_bake();
+    cb_assert_file_exists(path);
+    cb_assert_run(path);
+}
+
+/* Bake the project in a new output directory, as if it was a fresh copy of the source tree. */
+static void bake_in(const char* output_dir)
+{
+    delete_files(output_dir);
+    bake_again_in(output_dir);
+}
+
+static void define_project(void)
+{
+    cb_project("app");
+    cb_set(cb_BINARY_TYPE, cb_EXE);
+    cb_add(cb_FILES, "src/main.c");
+    cb_add(cb_FILES, "src/util.c");
+}
+
+int main(void)
+{
+    cb_plugin* plugins[] = {
+        &object_cache_plugin.plugin,
+        &codegen_plugin
+    };
+    /* The incremental build decides first, only the files it compiles are looked up in the cache. */
+    cb_plugin* combined_plugins[] = {
+        &incremental_build_plugin.plugin,
+        &object_cache_plugin.plugin
+    };
+
+    cbp_object_cache_init(&object_cache_plugin);
+    object_cache_plugin.directory = ".build/object_cache/";
+    codegen_plugin.name = "codegen";
+    codegen_plugin.extra_argument = codegen_extra_argument;
+
+    cb_init_with_plugins(plugins, 2);
+
+    delete_files(object_cache_plugin.directory);
+
+    define_project();
+
+    /* Empty cache, all the files are compiled and stored. */
+    bake_in(".build/a/");
+
+    cb_assert_int_equals(0, object_cache_plugin.stat_hits);
+    cb_assert_int_equals(2, object_cache_plugin.stat_misses);
+    cb_assert_int_equals(2, object_cache_plugin.stat_stores);
+
+    /* Nothing is compiled. */
+    bake_in(".build/b/");
+
+    cb_assert_int_equals(2, object_cache_plugin.stat_hits);
+    cb_assert_int_equals(0, object_cache_plugin.stat_misses);
+    cb_assert_int_equals(0, object_cache_plugin.stat_stores);
+    cb_assert_int_equals(100, cbp_object_cache_hit_rate(&object_cache_plugin));
+
+    /* Options are part of the key, even if the preprocessed source is the same. */
+    cb_add(cb_DEFINES, "UTIL_OFFSET=0");
+    bake_in(".build/c/");
+
+    cb_assert_int_equals(0, object_cache_plugin.stat_hits);
+    cb_assert_int_equals(2, object_cache_plugin.stat_misses);
+    cb_assert_int_equals(2, object_cache_plugin.stat_stores);
+
+    /* So are the arguments of the plugins. */
+    codegen_argument = "-fno-inline";
+    bake_in(".build/c_codegen/");
+
+    cb_assert_int_equals(0, object_cache_plugin.stat_hits);
+    cb_assert_int_equals(2, object_cache_plugin.stat_misses);
+    cb_assert_int_equals(2, object_cache_plugin.stat_stores);
+
+    /* The cache is too small to keep anything, all the entries are evicted. */
+    object_cache_plugin.max_size = 1;
+    cb_add(cb_DEFINES, "UNUSED_DEFINE");
+    bake_in(".build/d/");
+
+    cb_assert_int_equals(2, object_cache_plugin.stat_misses);
+    cb_assert_int_equals(8, object_cache_plugin.stat_evictions);
+
+    bake_in(".build/e/");
+
+    cb_assert_int_equals(0, object_cache_plugin.stat_hits);
+    cb_assert_int_equals(2, object_cache_plugin.stat_misses);
+
+    cb_destroy();
+
+    /* With cbp_incremental_build. */
+    object_cache_plugin.max_size = 0;
+    cbp_incremental_build_init(&incremental_build_plugin);
+    cb_init_with_plugins(combined_plugins, 2);
+
+    delete_files(object_cache_plugin.directory);
+    define_project();
+
+    /* Empty cache and new tree, all the files are compiled and stored. */
+    bake_in(".build/f/");
+
+    cb_assert_int_equals(0, object_cache_plugin.stat_hits);
+    cb_assert_int_equals(2, object_cache_plugin.stat_misses);
+    cb_assert_int_equals(2, object_cache_plugin.stat_stores);
+
+    /* Up to date, the cache is not used and nothing is preprocessed. */
+    cb_stats_reset();
+    bake_again_in(".build/f/");
+
+    cb_assert_int_equals(0, object_cache_plugin.stat_hits);
+    cb_assert_int_equals(0, object_cache_plugin.stat_misses);
+    /* Only the program has been run. */
+    cb_assert_true(cb_stats_get().process_count == 1);
+
+    /* New tree, the files are restored from the cache. */
+    cb_stats_reset();
+    bake_in(".build/g/");
+
+    cb_assert_int_equals(2, object_cache_plugin.stat_hits);
+    cb_assert_int_equals(0, object_cache_plugin.stat_misses);
+    /* Missed by cbp_incremental_build, found by cbp_object_cache. */
+    cb_assert_true(cb_stats_get().cache_hits == 2);
+    cb_assert_true(cb_stats_get().cache_misses == 2);
+
+    /* The restored files have been recorded by cbp_incremental_build, the tree is up to date. */
+    bake_again_in(".build/g/");
+
+    cb_assert_int_equals(0, object_cache_plugin.stat_hits);
+    cb_assert_int_equals(0, object_cache_plugin.stat_misses);
+    cb_assert_int_equals(2, incremental_build_plugin.stat_ignored);
+
+    cb_destroy();
+    cbp_object_cache_destroy(&object_cache_plugin);
+
+    return 0;
+}
@@ -0,0 +1,6 @@
+#include "util.h"
+
+int main(void)
+{
+    return util_value() == 42 ? 0 : 1;
+}
@@ -0,0 +1,10 @@
+#include "util.h"
+
+#ifndef UTIL_OFFSET
+#define UTIL_OFFSET 0
+#endif
+
+int util_value(void)
+{
+    return 42 + UTIL_OFFSET;
+}
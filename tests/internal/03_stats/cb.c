@@ -5,7 +5,7 @@
 #define assert_property_values_count(count) \
     do { \
         cb_project_t* p = cb_current_project(); \
-        cb_assert_int_equals((int)count, (int)cb_darrT_size(&p->mmap)); \
+        cb_assert_int_equals((int)count, (int)cb_mmap_size(&p->mmap)); \
     } while(0)
 
 int main(void)
@@ -40,6 +40,110 @@ int main(void)
 
     cb_set("key", "value6");
 
+    assert_property_values_count(1);
+
+    /* Values of a key are iterated from the most recently added one. */
+    cb_add("key", "value7");
+    cb_add("key", "value8");
+    cb_add("key", "value7");
+    cb_assert_true(cb_remove_one("key", "value7"));
+    {
+        const char* expected[] = { "value8", "value7", "value6" };
+        cb_project_t* p = cb_current_project();
+        cb_kv_range range = cb_mmap_get_range_str(&p->mmap, "key");
+        cb_kv current;
+        int i = 0;
+        cb_assert_int_equals(3, (int)range.count);
+        while (cb_mmap_range_get_next(&range, &current))
+        {
+            cb_assert_true(cb_strv_equals_str(current.u.strv, expected[i]));
+            i += 1;
+        }
+        cb_assert_int_equals(3, i);
+    }
+
+    /* Values added within a batch are stored in cb_batch_end, in the same order. */
+    {
+        const char* values[] = { "batch_value2", "batch_value3" };
+        const char* expected[] = { "batch_value4", "batch_value3", "batch_value2", "batch_value1" };
+        cb_project_t* p = cb_current_project();
+        cb_kv_range range;
+        cb_kv current;
+        int i = 0;
+
+        cb_batch_begin();
+        cb_add("batch_key", "batch_value1");
+        cb_add("batch_other_key", "batch_other_value");
+        cb_add_many("batch_key", values, 2);
+        cb_batch_begin();
+        cb_add("batch_key", "batch_value4");
+        cb_batch_end();
+        assert_property_values_count(3);
+        cb_batch_end();
+
+        assert_property_values_count(8);
+        cb_assert_true(cb_contains("batch_other_key", "batch_other_value"));
+
+        range = cb_mmap_get_range_str(&p->mmap, "batch_key");
+        while (cb_mmap_range_get_next(&range, &current))
+        {
+            cb_assert_true(cb_strv_equals_str(current.u.strv, expected[i]));
+            i += 1;
+        }
+        cb_assert_int_equals(4, i);
+
+        cb_remove_all("batch_key");
+        cb_remove_all("batch_other_key");
+        assert_property_values_count(3);
+    }
+
+    /* The batch stays on the project which was current in cb_batch_begin,
+       values added to another project within the batch are stored right away. */
+    {
+        cb_batch_begin();
+        cb_add("batch_key", "batch_value1");
+        cb_project("bar");
+        cb_add("bar_key", "bar_value");
+        cb_assert_true(cb_contains("bar_key", "bar_value"));
+        cb_remove_all("bar_key");
+        cb_batch_end();
+
+        assert_property_values_count(0);
+        cb_project("foo");
+        assert_property_values_count(4);
+        cb_assert_true(cb_contains("batch_key", "batch_value1"));
+
+        cb_remove_all("batch_key");
+        assert_property_values_count(3);
+    }
+
+    /* Enough keys to grow the index several times. */
+    {
+        int i = 0;
+        cb_kv_range range;
+        cb_kv current;
+        cb_project_t* p = cb_current_project();
+        for (i = 0; i < 500; ++i)
+        {
+            cb_add_f(cb_tmp_sprintf("many_key_%d", i % 100), "value_%d", i);
+        }
+        assert_property_values_count(503);
+        for (i = 0; i < 100; ++i)
+        {
+            cb_assert_int_equals(5, (int)cb_mmap_get_range_str(&p->mmap, cb_tmp_sprintf("many_key_%d", i)).count);
+        }
+        cb_assert_int_equals(5, (int)cb_remove_all("many_key_42"));
+        assert_property_values_count(498);
+
+        i = 0;
+        range = cb_mmap_get_range_all(&p->mmap);
+        while (cb_mmap_range_get_next(&range, &current))
+        {
+            i += 1;
+        }
+        cb_assert_int_equals(498, i);
+    }
+
     cb_destroy();
 
     return 0;
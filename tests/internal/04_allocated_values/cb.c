@@ -43,6 +43,29 @@ int main(void)
 
     assert_strings_are_within_tmp_buffer();
 
+    /* Equal keys and values are stored once. */
+    {
+        cb_kv first;
+        cb_kv second;
+        cb_size tmp_size = 0;
+
+        cb_add(cb_INCLUDE_DIRECTORIES, "include");
+        cb_mmap_try_get_first(&cb_current_project()->mmap, cb_strv_make_str(cb_INCLUDE_DIRECTORIES), &first);
+
+        cb_project("bar");
+        cb_add(cb_INCLUDE_DIRECTORIES, "include");
+        cb_mmap_try_get_first(&cb_current_project()->mmap, cb_strv_make_str(cb_INCLUDE_DIRECTORIES), &second);
+
+        cb_assert_true(first.key.data == second.key.data);
+        cb_assert_true(first.u.strv.data == second.u.strv.data);
+
+        tmp_size = cb_tmp_save();
+        cb_add_f(cb_INCLUDE_DIRECTORIES, "%s", "include");
+        cb_assert_int_equals((int)tmp_size, (int)cb_tmp_save());
+
+        assert_strings_are_within_tmp_buffer();
+    }
+
     cb_destroy();
 
     return 0;
@@ -0,0 +1,58 @@
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cb_assert.h>
+
+int main(void)
+{
+    cb_size anchor = 0;
+    cb_size peak = 0;
+    char* small = NULL;
+    char* big = NULL;
+    char* reused = NULL;
+    int i = 0;
+
+    cb_init();
+
+    small = (char*)cb_tmp_alloc(16);
+    cb_assert_true(cb_tmp_contains(small));
+    cb_assert_true(((size_t)small % CB_TMP_ALIGNMENT) == 0);
+
+    /* The allocator grows past the size of its first block. */
+    anchor = cb_tmp_save();
+    for (i = 0; i < 64; ++i)
+    {
+        big = (char*)cb_tmp_alloc(256 * 1024);
+        cb_assert_true(big != NULL);
+        memset(big, i, 256 * 1024);
+        cb_assert_true(cb_tmp_contains(big));
+        cb_assert_true(cb_tmp_contains(big + 256 * 1024 - 1));
+    }
+    peak = cb_tmp_peak_usage();
+    cb_assert_true(peak >= 64 * 256 * 1024);
+
+    /* Restoring releases the allocations made after the anchor, blocks are reused. */
+    cb_tmp_restore(anchor);
+    cb_assert_int_equals((int)anchor, (int)cb_tmp_save());
+    reused = (char*)cb_tmp_alloc(256 * 1024);
+    cb_assert_true(cb_tmp_contains(reused));
+    cb_assert_int_equals((int)peak, (int)cb_tmp_peak_usage());
+
+    /* Allocations made before the anchor are untouched. */
+    small[0] = 'a';
+    cb_assert_true(cb_tmp_contains(small));
+
+    /* Interned strings released by a restore are copied again. */
+    anchor = cb_tmp_save();
+    cb_project("foo");
+    cb_add("key", "value");
+    cb_tmp_restore(anchor);
+    cb_assert_true(cb_tmp_intern_str("value").data != NULL);
+    cb_assert_true(cb_strv_equals_str(cb_tmp_intern_str("value"), "value"));
+
+    cb_destroy();
+
+    cb_assert_false(cb_tmp_contains(small));
+    cb_assert_int_equals(0, (int)cb_tmp_save());
+
+    return 0;
+}
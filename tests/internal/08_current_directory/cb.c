@@ -0,0 +1,50 @@
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cb_assert.h>
+
+int main(void)
+{
+    cb_strv cwd;
+    cb_strv parent;
+    const char* abs_file = NULL;
+    const char* abs_dir = NULL;
+    const char* expected = NULL;
+
+    cb_init();
+
+    /* Copied since the cached directory is released by cb_set_current_directory. */
+    cwd = cb_get_current_directory();
+    cb_assert_true(cwd.size > 0);
+    cb_assert_true(cb_path_is_absolute(cwd));
+    cwd.data = cb_str_dup(cwd.data);
+
+    abs_file = cb_path_get_absolute_file("src/main.c");
+    expected = cb_tmp_sprintf(CB_STRV_FMT "/src/main.c", CB_STRV_ARG(cwd));
+    cb_assert_true(cb_str_equals(abs_file, expected));
+    cb_assert_true(cb_str_equals(cb_path_get_absolute_file("./src/main.c"), expected));
+
+    /* Results are cached and survive a reset of the tmp allocator. */
+    cb_clear();
+    cb_assert_true(abs_file == cb_path_get_absolute_file("src/main.c"));
+    expected = cb_tmp_sprintf(CB_STRV_FMT "/src/main.c", CB_STRV_ARG(cwd));
+
+    abs_dir = cb_path_get_absolute_dir("src");
+    cb_assert_true(cb_str_equals(abs_dir, cb_tmp_sprintf(CB_STRV_FMT "/src/", CB_STRV_ARG(cwd))));
+
+    /* Changing directory invalidates the cache. */
+    cb_assert_true(cb_set_current_directory(".."));
+    parent = cb_get_current_directory();
+    cb_assert_true(parent.size < cwd.size);
+    cb_assert_true(cb_strv_starts_with(cwd, parent));
+    cb_assert_true(cb_str_equals(cb_path_get_absolute_file("src/main.c"), cb_tmp_sprintf(CB_STRV_FMT "/src/main.c", CB_STRV_ARG(parent))));
+
+    cb_assert_true(cb_set_current_directory(cb_tmp_strv_to_str(cwd)));
+    cb_assert_true(cb_str_equals(cb_path_get_absolute_file("src/main.c"), expected));
+
+    cb_assert_false(cb_set_current_directory("this/directory/does/not/exist"));
+
+    cb_destroy();
+    CB_FREE(cwd.data);
+
+    return 0;
+}
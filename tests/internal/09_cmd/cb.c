@@ -0,0 +1,61 @@
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cb_assert.h>
+
+int main(void)
+{
+    cb_cmd* options = NULL;
+    cb_cmd* cmd = NULL;
+
+    cb_init();
+
+    options = cb_cmd_create();
+    cb_assert_int_equals(0, (int)cb_cmd_count(options));
+    cb_assert_true(cb_str_equals(cb_cmd_to_string(options), ""));
+
+    cb_cmd_push_command_line(options, "gcc -Wall \"-I my dir\"");
+    cb_cmd_push_f(options, "-D%s=%d", "VALUE", 42);
+    cb_cmd_push(options, "");
+    cb_assert_int_equals(5, (int)cb_cmd_count(options));
+    cb_assert_true(cb_str_equals(cb_cmd_at(options, 0), "gcc"));
+    cb_assert_true(cb_str_equals(cb_cmd_at(options, 1), "-Wall"));
+    cb_assert_true(cb_str_equals(cb_cmd_at(options, 2), "-I my dir"));
+    cb_assert_true(cb_str_equals(cb_cmd_at(options, 3), "-DVALUE=42"));
+    cb_assert_true(cb_str_equals(cb_cmd_at(options, 4), ""));
+
+    /* Arguments are quoted when displayed. */
+    cb_assert_true(cb_str_equals(cb_cmd_to_string(options), "gcc -Wall \"-I my dir\" -DVALUE=42 \"\""));
+
+    /* The shared arguments are copied into each command. */
+    cmd = cb_cmd_create();
+    cb_cmd_append(cmd, options);
+    cb_cmd_push(cmd, "a \"quoted\" \\path\\");
+    cb_assert_int_equals(6, (int)cb_cmd_count(cmd));
+    cb_assert_true(cb_str_equals(cb_cmd_at(cmd, 2), "-I my dir"));
+    cb_assert_true(cb_str_equals(cb_cmd_at(cmd, 5), "a \"quoted\" \\path\\"));
+    cb_assert_true(cb_str_equals(cb_cmd_to_string(cmd), "gcc -Wall \"-I my dir\" -DVALUE=42 \"\" \"a \\\"quoted\\\" \\path\\\\\""));
+
+    cb_cmd_clear(cmd);
+    cb_assert_int_equals(0, (int)cb_cmd_count(cmd));
+
+#ifndef _WIN32
+    /* Arguments reach the process as they are. */
+    cb_cmd_push(cmd, "sh");
+    cb_cmd_push(cmd, "-c");
+    cb_cmd_push(cmd, "test \"$0\" = \"a b\" && test \"$1\" = \"'c' \\\"d\\\"\" && test -z \"$2\"");
+    cb_cmd_push(cmd, "a b");
+    cb_cmd_push(cmd, "'c' \"d\"");
+    cb_cmd_push(cmd, "");
+    cb_assert_int_equals(0, cb_cmd_run(cmd, NULL));
+
+    cb_cmd_clear(cmd);
+    cb_cmd_push_command_line(cmd, "sh -c \"exit 3\"");
+    cb_assert_int_equals(3, cb_process_end(cb_cmd_spawn(cmd, NULL)));
+#endif
+
+    cb_cmd_destroy(cmd);
+    cb_cmd_destroy(options);
+    cb_destroy();
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cb_assert.h>
+
+int main(void)
+{
+    const char* path = NULL;
+
+    cb_init();
+
+    /* Compile several files at the same time. */
+    cb_project("exe");
+    cb_set(cb_BINARY_TYPE, cb_EXE);
+    cb_set(cb_JOBS, "4");
+
+    cb_add(cb_FILES, "src/main.c");
+    cb_add(cb_FILES, "src/value_1.c");
+    cb_add(cb_FILES, "src/value_2.c");
+    cb_add(cb_FILES, "src/value_3.c");
+    cb_add(cb_FILES, "src/value_4.c");
+    cb_add(cb_FILES, "src/value_5.c");
+    cb_add(cb_FILES, "src/value_6.c");
+
+    path = cb_bake();
+
+    cb_assert_file_exists(path);
+    
+    cb_assert_run(path);
+
+    /* Use as many jobs as there are logical processors. */
+    cb_set_jobs(0);
+
+    /* Compilation of one of the files fails, the other compilations must be waited on. */
+    cb_project("broken");
+    cb_set(cb_BINARY_TYPE, cb_STATIC_LIBRARY);
+
+    cb_add(cb_FILES, "src/value_1.c");
+    cb_add(cb_FILES, "src/broken.c");
+    cb_add(cb_FILES, "src/value_2.c");
+    cb_add(cb_FILES, "src/value_3.c");
+
+    cb_assert_true(cb_bake() == NULL);
+
+    cb_destroy();
+
+    return 0;
+}
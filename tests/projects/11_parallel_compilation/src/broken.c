@@ -0,0 +1,4 @@
+int broken_value()
+{
+    return undeclared_value;
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#include <stdio.h>
+
+#include "values.h"
+
+int main()
+{
+    int sum = value_1() + value_2() + value_3() + value_4() + value_5() + value_6();
+
+    printf("Hello Exe - %d\n", sum);
+
+    return sum == 21 ? 0 : 1;
+}
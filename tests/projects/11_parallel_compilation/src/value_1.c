@@ -0,0 +1,4 @@
+int value_1()
+{
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,4 @@
+int value_2()
+{
+    return 2;
+}
\ No newline at end of file
@@ -0,0 +1,4 @@
+int value_3()
+{
+    return 3;
+}
\ No newline at end of file
@@ -0,0 +1,4 @@
+int value_4()
+{
+    return 4;
+}
\ No newline at end of file
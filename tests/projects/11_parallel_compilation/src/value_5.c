@@ -0,0 +1,4 @@
+int value_5()
+{
+    return 5;
+}
\ No newline at end of file
@@ -0,0 +1,4 @@
+int value_6()
+{
+    return 6;
+}
\ No newline at end of file
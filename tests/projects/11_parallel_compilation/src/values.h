@@ -0,0 +1,6 @@
+int value_1();
+int value_2();
+int value_3();
+int value_4();
+int value_5();
+int value_6();
@@ -0,0 +1,138 @@
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cb_assert.h>
+
+#define PROCESS_COUNT 3
+
+typedef struct line_stats line_stats;
+struct line_stats {
+    int line_count;
+    cb_bool last_line_ok;
+};
+
+static void
+count_lines(void* user_data, const char* line, cb_size size, cb_bool is_stderr)
+{
+    line_stats* stats = (line_stats*)user_data;
+    const char* expected = "Hello Async - 99999";
+
+    cb_assert_false(is_stderr);
+
+    stats->line_count += 1;
+    stats->last_line_ok = size == strlen(expected) && memcmp(line, expected, size) == 0;
+}
+
+int main(void)
+{
+    const char* path = NULL;
+    cb_process_handle* handles[PROCESS_COUNT];
+    cb_process_handle* handle = NULL;
+    int ended_count = 0;
+    int index = 0;
+    line_stats stats = { 0 };
+
+    cb_init();
+
+    cb_project("exe");
+    cb_set(cb_BINARY_TYPE, cb_EXE);
+
+    cb_add(cb_FILES, "src/main.c");
+
+    path = cb_bake();
+
+    cb_assert_file_exists(path);
+
+    /* Run several processes at the same time, one of them writes more than the pipe can hold. */
+    handles[0] = cb_process_spawn_to_string(cb_tmp_sprintf("\"%s\" 1", path), NULL, cb_false);
+    handles[1] = cb_process_spawn_to_string(cb_tmp_sprintf("\"%s\" 100000", path), NULL, cb_false);
+    handles[2] = cb_process_spawn(cb_tmp_sprintf("\"%s\" 0", path), NULL);
+
+    while ((index = cb_process_wait_any(handles, PROCESS_COUNT)) >= 0)
+    {
+        cb_assert_true(cb_process_poll(handles[index]));
+        cb_assert_int_equals(0, cb_process_wait(handles[index]));
+        ended_count += 1;
+
+        if (index == 0)
+        {
+#ifdef _WIN32
+            cb_assert_true(cb_str_equals(cb_process_stdout_string(handles[index]), "Hello Async - 0\r\n"));
+#else
+            cb_assert_true(cb_str_equals(cb_process_stdout_string(handles[index]), "Hello Async - 0\n"));
+#endif
+        }
+
+        if (index == 1)
+        {
+            cb_assert_true(strlen(cb_process_stdout_string(handles[index])) > 100000);
+        }
+
+        cb_process_end(handles[index]);
+        handles[index] = NULL;
+    }
+
+    cb_assert_int_equals(PROCESS_COUNT, ended_count);
+
+#ifndef _WIN32
+    /* A child process created by the user exits and stays waitable while waiting for ours. */
+    {
+        pid_t user_child = 0;
+        int user_child_status = 0;
+
+        handles[0] = cb_process_spawn("sleep 0.2", NULL);
+        handles[1] = NULL;
+        handles[2] = NULL;
+
+        user_child = fork();
+        if (user_child == 0)
+        {
+            _exit(3);
+        }
+        cb_assert_true(user_child > 0);
+
+        cb_assert_int_equals(0, cb_process_wait_any(handles, PROCESS_COUNT));
+        cb_assert_int_equals(0, cb_process_end(handles[0]));
+        handles[0] = NULL;
+        cb_assert_int_equals(-1, cb_process_wait_any(handles, PROCESS_COUNT));
+
+        cb_assert_int_equals((int)user_child, (int)waitpid(user_child, &user_child_status, 0));
+        cb_assert_int_equals(3, WEXITSTATUS(user_child_status));
+    }
+
+    /* The handler installed by cb is replaced by the user, the exit of the process is still noticed. */
+    {
+        void (*previous_handler)(int) = signal(SIGCHLD, SIG_DFL);
+
+        handles[0] = cb_process_spawn("sleep 0.2", NULL);
+        cb_assert_int_equals(0, cb_process_wait_any(handles, PROCESS_COUNT));
+        cb_assert_int_equals(0, cb_process_end(handles[0]));
+        handles[0] = NULL;
+
+        signal(SIGCHLD, previous_handler);
+    }
+#endif
+
+    /* Get the lines while the process is running. */
+    handle = cb_process_spawn_with_callback(cb_tmp_sprintf("\"%s\" 100000", path), NULL, cb_false, count_lines, &stats);
+    cb_assert_int_equals(0, cb_process_end(handle));
+    cb_assert_int_equals(100000, stats.line_count);
+    cb_assert_true(stats.last_line_ok);
+
+    /* A process that cannot be started still gives a handle. */
+    handle = cb_process_spawn("cb_non_existing_program_", NULL);
+    cb_assert_int_not_equals(0, cb_process_wait(handle));
+    cb_assert_int_not_equals(0, cb_process_end(handle));
+
+    cb_destroy();
+
+#ifndef _WIN32
+    /* The SIGCHLD disposition replaced by the first process is restored. */
+    {
+        struct sigaction action;
+        cb_assert_true(sigaction(SIGCHLD, NULL, &action) == 0);
+        cb_assert_true(!(action.sa_flags & SA_SIGINFO) && action.sa_handler == SIG_DFL);
+    }
+#endif
+
+    return 0;
+}
@@ -0,0 +1,16 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char** argv)
+{
+    int i = 0;
+    int line_count = argc > 1 ? atoi(argv[1]) : 1;
+
+    /* Print enough lines to fill the pipe of the parent process. */
+    for (i = 0; i < line_count; i += 1)
+    {
+        printf("Hello Async - %d\n", i);
+    }
+
+    return 0;
+}
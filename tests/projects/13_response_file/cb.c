@@ -0,0 +1,77 @@
+/* Give all the object files through response files, even for small projects.
+   Same projects as 05_exe_with_deps, built from its source files. */
+#define CB_RESPONSE_FILE_THRESHOLD 1
+
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cb_assert.h>
+
+static void
+assert_response_file_exists(const char* project_name)
+{
+    cb_toolchain_t tc = cb_toolchain_default_c();
+    const char* output_dir = cb_get_output_directory(cb_find_project_by_name_str(project_name), &tc);
+
+    cb_assert_file_exists(cb_tmp_sprintf("%s%s.rsp", output_dir, project_name));
+}
+
+int main(void)
+{
+    const char* path = NULL;
+
+    cb_init();
+
+    /* Static library, some object files contain spaces. */
+    {
+        cb_project("foo");
+        cb_set(cb_BINARY_TYPE, cb_STATIC_LIBRARY);
+
+        cb_add(cb_FILES, "../05_exe_with_deps/src/foo.c");
+        cb_add(cb_FILES, "../05_exe_with_deps/src/foo/foo.c");
+        cb_add(cb_FILES, "../05_exe_with_deps/src/foo/f oo.c");
+
+        path = cb_bake();
+
+        cb_assert_file_exists(path);
+        assert_response_file_exists("foo");
+    }
+
+    /* Shared library */
+    {
+        cb_project("bar");
+        cb_set(cb_BINARY_TYPE, cb_SHARED_LIBRARY);
+
+        cb_add(cb_FILES, "../05_exe_with_deps/src/bar.c");
+        cb_add(cb_FILES, "../05_exe_with_deps/src/bar/bar.c");
+        cb_add(cb_FILES, "../05_exe_with_deps/src/bar/b ar.c");
+
+        cb_add(cb_DEFINES, "BAR_LIB_EXPORT");
+
+        path = cb_bake();
+
+        cb_assert_file_exists(path);
+        assert_response_file_exists("bar");
+    }
+
+    /* exe */
+    {
+        cb_project("exe");
+        cb_set(cb_BINARY_TYPE, cb_EXE);
+
+        cb_add(cb_FILES, "../05_exe_with_deps/src/main.c");
+
+        cb_add(cb_LINK_PROJECTS, "foo");
+        cb_add(cb_LINK_PROJECTS, "bar");
+
+        path = cb_bake();
+
+        cb_assert_file_exists(path);
+        assert_response_file_exists("exe");
+
+        cb_assert_run(path);
+    }
+
+    cb_destroy();
+
+    return 0;
+}
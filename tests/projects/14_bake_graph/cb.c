@@ -0,0 +1,97 @@
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cb_assert.h>
+
+/* Bake an executable and the libraries it links without baking them by hand.
+   Same projects as 05_exe_with_deps, built from its source files. */
+
+static void
+define_projects(void)
+{
+    /* The executable is defined first, the libraries are baked before it anyway. */
+    cb_project("exe");
+    cb_set(cb_BINARY_TYPE, cb_EXE);
+    cb_add(cb_FILES, "../05_exe_with_deps/src/main.c");
+    cb_add(cb_LINK_PROJECTS, "foo");
+    cb_add(cb_LINK_PROJECTS, "bar");
+
+    /* Static library */
+    cb_project("foo");
+    cb_set(cb_BINARY_TYPE, cb_STATIC_LIBRARY);
+    cb_add(cb_FILES, "../05_exe_with_deps/src/foo.c");
+    cb_add(cb_FILES, "../05_exe_with_deps/src/foo/foo.c");
+    cb_add(cb_FILES, "../05_exe_with_deps/src/foo/f oo.c");
+
+    /* Shared library, compiled one file at a time while the other projects use the remaining jobs. */
+    cb_project("bar");
+    cb_set(cb_BINARY_TYPE, cb_SHARED_LIBRARY);
+    cb_set(cb_JOBS, "1");
+    cb_add(cb_FILES, "../05_exe_with_deps/src/bar.c");
+    cb_add(cb_FILES, "../05_exe_with_deps/src/bar/bar.c");
+    cb_add(cb_FILES, "../05_exe_with_deps/src/bar/b ar.c");
+    cb_add(cb_DEFINES, "BAR_LIB_EXPORT");
+
+    /* Another executable linking the same libraries. */
+    cb_project("exe2");
+    cb_set(cb_BINARY_TYPE, cb_EXE);
+    cb_add(cb_FILES, "../05_exe_with_deps/src/main.c");
+    cb_add(cb_LINK_PROJECTS, "bar");
+    cb_add(cb_LINK_PROJECTS, "foo");
+}
+
+int main(void)
+{
+    const char* path = NULL;
+    char* exe_path = NULL;
+
+    cb_init();
+
+    cb_set_jobs(4);
+
+    define_projects();
+
+    path = cb_bake_graph("exe");
+    cb_assert_file_exists(path);
+    cb_assert_run(path);
+    exe_path = cb_str_dup(path);
+
+    cb_assert_true(cb_bake_all());
+
+    /* Unknown linked project. */
+    cb_project("missing_link");
+    cb_set(cb_BINARY_TYPE, cb_EXE);
+    cb_add(cb_FILES, "../05_exe_with_deps/src/main.c");
+    cb_add(cb_LINK_PROJECTS, "does_not_exist");
+    cb_assert_true(cb_bake_graph("missing_link") == NULL);
+    cb_assert_true(!cb_bake_all());
+
+    cb_clear();
+
+    /* Projects linking each other can't be baked. */
+    cb_project("a");
+    cb_set(cb_BINARY_TYPE, cb_STATIC_LIBRARY);
+    cb_add(cb_FILES, "../05_exe_with_deps/src/foo.c");
+    cb_add(cb_LINK_PROJECTS, "b");
+
+    cb_project("b");
+    cb_set(cb_BINARY_TYPE, cb_STATIC_LIBRARY);
+    cb_add(cb_FILES, "../05_exe_with_deps/src/foo.c");
+    cb_add(cb_LINK_PROJECTS, "a");
+
+    cb_assert_true(cb_bake_graph("a") == NULL);
+
+    /* A file of a library does not compile while the other projects are compiled,
+       the bake fails and the executable is not linked. */
+    cb_clear();
+    define_projects();
+    cb_project("foo");
+    cb_add(cb_FILES, "src/broken.c");
+    cb_assert_true(cb_delete_file(exe_path));
+    cb_assert_true(cb_bake_graph("exe") == NULL);
+    cb_assert_true(!cb_path_exists(exe_path));
+
+    CB_FREE(exe_path);
+    cb_destroy();
+
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+    #include <utime.h>
+    #include <sys/stat.h>
+#endif
+
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cbp_incremental_build.h>
+#include <cb_extensions/cb_assert.h>
+
+/* Export the compilation database of the projects and check that it matches what is baked. */
+
+static const char* database = ".build/compile_commands.json";
+
+static cbp_incremental_build incremental_build_plugin;
+
+static void
+define_projects(void)
+{
+    cb_project("foo");
+    cb_set(cb_BINARY_TYPE, cb_STATIC_LIBRARY);
+    cb_add(cb_FILES, "src/foo/f oo.c");
+    cb_add(cb_INCLUDE_DIRECTORIES, "src/include");
+
+    cb_project("exe");
+    cb_set(cb_BINARY_TYPE, cb_EXE);
+    cb_add(cb_FILES, "src/main.c");
+    cb_add(cb_INCLUDE_DIRECTORIES, "src/include");
+    cb_add(cb_DEFINES, "GREETING=\"Hello \\\"compile commands\\\"\"");
+    cb_add(cb_LINK_PROJECTS, "foo");
+}
+
+#ifndef _WIN32
+
+/* Returns the content of the file, allocated with the tmp allocator. */
+static const char*
+read_file(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    char* content = NULL;
+    long size = 0;
+
+    cb_assert_true(file != NULL);
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    content = (char*)cb_tmp_alloc(size + 1);
+    cb_assert_true(fread(content, 1, size, file) == (size_t)size);
+    content[size] = '\0';
+
+    fclose(file);
+    return content;
+}
+
+static int
+count_occurrences(const char* str, const char* value)
+{
+    int count = 0;
+    while ((str = strstr(str, value)) != NULL)
+    {
+        count += 1;
+        str += strlen(value);
+    }
+    return count;
+}
+
+/* Every "output" of the database must have been created by the bake. */
+static void
+assert_outputs_exist(const char* content)
+{
+    const char* key = "\"output\": \"";
+    const char* begin = NULL;
+    const char* end = NULL;
+
+    while ((begin = strstr(content, key)) != NULL)
+    {
+        begin += strlen(key);
+        end = strchr(begin, '"');
+        cb_assert_true(end != NULL);
+
+        cb_assert_file_exists(cb_tmp_sprintf("%.*s", (int)(end - begin), begin));
+        content = end;
+    }
+}
+
+/* Compiler writing its arguments to 'argv_path', one per line, before running the actual compiler. */
+static const char*
+create_recording_compiler(const char* compiler, const char* argv_path)
+{
+    const char* path = cb_tmp_sprintf("%s", cb_path_get_absolute_file(".build/recording_cc.sh"));
+    FILE* file = fopen(path, "wb");
+
+    cb_assert_true(file != NULL);
+    fprintf(file, "#!/bin/sh\nprintf '%%s\\n' \"$@\" > '%s'\nexec %s \"$@\"\n", argv_path, compiler);
+    fclose(file);
+    cb_assert_true(chmod(path, 0755) == 0);
+
+    return path;
+}
+
+static void
+append_json_string(cb_dstr* out, const char* str, cb_size size)
+{
+    cb_size i = 0;
+
+    cb_dstr_append_str(out, "\"");
+    for (i = 0; i < size; i += 1)
+    {
+        cb_dstr_append_f(out, (str[i] == '"' || str[i] == '\\') ? "\\%c" : "%c", str[i]);
+    }
+    cb_dstr_append_str(out, "\"");
+}
+
+/* "arguments" of the database expected for the arguments recorded by the compiler. */
+static const char*
+format_recorded_arguments(const char* program, const char* recorded)
+{
+    cb_dstr arguments;
+    const char* end = NULL;
+    const char* result = NULL;
+
+    cb_dstr_init(&arguments);
+    cb_dstr_append_str(&arguments, "\"arguments\": [");
+    append_json_string(&arguments, program, strlen(program));
+    while ((end = strchr(recorded, '\n')) != NULL)
+    {
+        cb_dstr_append_str(&arguments, ", ");
+        append_json_string(&arguments, recorded, (cb_size)(end - recorded));
+        recorded = end + 1;
+    }
+    cb_dstr_append_str(&arguments, "]");
+
+    result = cb_tmp_sprintf("%s", arguments.data);
+    cb_dstr_destroy(&arguments);
+    return result;
+}
+
+static time_t
+last_modification(const char* path)
+{
+    struct stat st;
+    cb_assert_true(stat(path, &st) == 0);
+    return st.st_mtime;
+}
+
+static void
+set_last_modification(const char* path, time_t time)
+{
+    struct utimbuf times;
+    times.actime = time;
+    times.modtime = time;
+    cb_assert_true(utime(path, &times) == 0);
+}
+
+int main(void)
+{
+    cb_plugin* plugins[] = {
+        &incremental_build_plugin.plugin
+    };
+    cb_toolchain_t toolchain;
+    const char* argv_path = NULL;
+    const char* content = NULL;
+    /* Modified while the directories are created. */
+    char directory[] = ".build/";
+
+    cb_init();
+
+    define_projects();
+
+    cb_create_directories(directory, strlen(directory));
+    cb_assert_true(cb_export_compile_commands(database));
+
+    content = read_file(database);
+    cb_assert_int_equals(2, count_occurrences(content, "\"directory\": "));
+    cb_assert_int_equals(1, count_occurrences(content, "\"-DGREETING=\\\"Hello \\\\\\\"compile commands\\\\\\\"\\\"\""));
+    cb_assert_int_equals(2, count_occurrences(content, "\"-MMD\", \"-MF\""));
+    cb_assert_true(strstr(content, "f oo.c\"") != NULL);
+
+    /* The objects are created where the database says they are. */
+    cb_assert_true(cb_bake_all());
+    assert_outputs_exist(content);
+    cb_assert_run(cb_bake_project("exe"));
+
+    /* Nothing changed, the file is not written again. */
+    set_last_modification(database, 0);
+    cb_assert_true(cb_export_compile_commands(database));
+    cb_assert_true(last_modification(database) == 0);
+
+    /* A new define changes the commands. */
+    cb_project("foo");
+    cb_add(cb_DEFINES, "FOO_DEFINE");
+    cb_assert_true(cb_export_compile_commands(database));
+    cb_assert_true(last_modification(database) != 0);
+    cb_assert_int_equals(1, count_occurrences(read_file(database), "\"-DFOO_DEFINE\""));
+
+    /* Linked project that does not exist. */
+    cb_project("missing_link");
+    cb_add(cb_LINK_PROJECTS, "unknown");
+    cb_assert_false(cb_export_compile_commands(database));
+
+    cb_destroy();
+
+    /* The arguments of the plugins are exported, the database contains the arguments of the bake. */
+    cbp_incremental_build_init(&incremental_build_plugin);
+    cb_init_with_plugins(plugins, 1);
+
+    define_projects();
+
+    toolchain = cb_toolchain_get();
+    argv_path = cb_tmp_sprintf("%s", cb_path_get_absolute_file(".build/recorded_argv.txt"));
+    toolchain.program = create_recording_compiler(toolchain.program, argv_path);
+
+    cb_project("foo");
+    cbp_incremental_build_delete_cache(&incremental_build_plugin);
+    cb_assert_true(cb_bake_project_with("foo", toolchain) != NULL);
+    cb_assert_true(cb_export_compile_commands_with(database, toolchain));
+
+    content = read_file(database);
+    cb_assert_true(strstr(content, format_recorded_arguments(toolchain.program, read_file(argv_path))) != NULL);
+    /* Added by the plugin and by the compile command of each file. */
+    cb_assert_int_equals(4, count_occurrences(content, "\"-MMD\""));
+
+    cb_destroy();
+
+    return 0;
+}
+
+#else
+
+int main(void)
+{
+    cb_init();
+
+    define_projects();
+
+    /* Only the gcc toolchain is supported. */
+    cb_assert_false(cb_export_compile_commands(database));
+
+    cb_destroy();
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,6 @@
+#include "greeting.h"
+
+int foo_value(void)
+{
+    return 42;
+}
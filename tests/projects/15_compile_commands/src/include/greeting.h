@@ -0,0 +1,6 @@
+#ifndef GREETING_H
+#define GREETING_H
+
+int foo_value(void);
+
+#endif /* GREETING_H */
@@ -0,0 +1,11 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "greeting.h"
+
+int main(void)
+{
+    printf("%s - %d\n", GREETING, foo_value());
+
+    return strcmp(GREETING, "Hello \"compile commands\"") == 0 && foo_value() == 42 ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <string.h>
+
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cb_assert.h>
+
+/* Record the steps of a bake and check that they are in the trace. */
+
+static const char* trace_path = ".build/trace.json";
+
+static int bake_starting_count = 0;
+
+static void
+bake_starting(cb_plugin* plugin, cb_project_t* project)
+{
+    (void)plugin;
+    (void)project;
+    bake_starting_count += 1;
+}
+
+/* Returns the content of the file, allocated with the tmp allocator. */
+static const char*
+read_file(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    char* content = NULL;
+    long size = 0;
+
+    cb_assert_true(file != NULL);
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    content = (char*)cb_tmp_alloc(size + 1);
+    cb_assert_true(fread(content, 1, size, file) == (size_t)size);
+    content[size] = '\0';
+
+    fclose(file);
+    return content;
+}
+
+static int
+count_occurrences(const char* str, const char* value)
+{
+    int count = 0;
+    while ((str = strstr(str, value)) != NULL)
+    {
+        count += 1;
+        str += strlen(value);
+    }
+    return count;
+}
+
+int main(void)
+{
+    cb_plugin plugin = { 0 };
+    cb_plugin* plugins[1];
+    const char* content = NULL;
+    const char* path = NULL;
+    /* Modified while the directories are created. */
+    char directory[] = ".build/";
+
+    plugin.name = "test_plugin";
+    plugin.bake_starting = bake_starting;
+    plugins[0] = &plugin;
+
+    cb_init_with_plugins(plugins, 1);
+
+    cb_create_directories(directory, strlen(directory));
+    cb_assert_true(cb_trace_begin(trace_path));
+
+    cb_project("foo");
+    cb_set(cb_BINARY_TYPE, cb_STATIC_LIBRARY);
+    cb_add(cb_FILES, "src/foo.c");
+
+    cb_project("exe");
+    cb_set(cb_BINARY_TYPE, cb_EXE);
+    cb_add(cb_FILES, "src/main.c");
+    cb_add(cb_LINK_PROJECTS, "foo");
+
+    path = cb_bake_graph("exe");
+    cb_assert_file_exists(path);
+    cb_assert_true(cb_copy_file(path, cb_tmp_sprintf("%s.copy", path)));
+
+    cb_trace_end();
+
+    /* Not recorded anymore. */
+    cb_assert_true(cb_copy_file(path, cb_tmp_sprintf("%s.copy", path)));
+
+    content = read_file(trace_path);
+    cb_assert_true(content[0] == '[');
+    cb_assert_true(strstr(content, "\n]\n") != NULL);
+
+    cb_assert_int_equals(2, count_occurrences(content, "\"cat\":\"compile\""));
+    cb_assert_int_equals(1, count_occurrences(content, "\"cat\":\"archive\""));
+    cb_assert_int_equals(1, count_occurrences(content, "\"cat\":\"link\""));
+    cb_assert_int_equals(1, count_occurrences(content, "\"cat\":\"copy\""));
+    cb_assert_int_equals(4, count_occurrences(content, "\"exit_code\":0"));
+    cb_assert_int_equals(bake_starting_count, count_occurrences(content, "\"name\":\"test_plugin.bake_starting\""));
+    cb_assert_true(strstr(content, "\"project\":\"exe\"") != NULL);
+    cb_assert_true(strstr(content, "\"name\":\"foo.c\"") != NULL);
+
+    cb_destroy();
+
+    return 0;
+}
@@ -0,0 +1,6 @@
+#include "foo.h"
+
+int foo_value()
+{
+    return 42;
+}
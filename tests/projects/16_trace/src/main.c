@@ -0,0 +1,10 @@
+#include <stdio.h>
+
+#include "foo.h"
+
+int main()
+{
+    printf("Hello trace - %d\n", foo_value());
+
+    return foo_value() == 42 ? 0 : 1;
+}
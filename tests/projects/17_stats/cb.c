@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+
+#define CB_IMPLEMENTATION
+#include <cb/cb.h>
+#include <cb_extensions/cbp_incremental_build.h>
+#include <cb_extensions/cb_assert.h>
+
+/* Check the statistics of a full bake and of a bake where everything is up to date.
+   Same projects as 16_trace, built from its source files. */
+
+static cbp_incremental_build incremental_build_plugin;
+
+int main(void)
+{
+    cb_plugin* plugins[] = {
+        &incremental_build_plugin.plugin
+    };
+    cb_stats stats;
+    const char* path = NULL;
+
+    cbp_incremental_build_init(&incremental_build_plugin);
+    /* Content of the dependencies is hashed when they are checked. */
+    incremental_build_plugin.check_policy = cbp_ib_check_HASH;
+
+    cb_init_with_plugins(plugins, 1);
+
+    cb_project("foo");
+    cb_set(cb_BINARY_TYPE, cb_STATIC_LIBRARY);
+    cb_add(cb_FILES, "../16_trace/src/foo.c");
+
+    cb_project("exe");
+    cb_set(cb_BINARY_TYPE, cb_EXE);
+    cb_add(cb_FILES, "../16_trace/src/main.c");
+    cb_add(cb_LINK_PROJECTS, "foo");
+
+    cbp_incremental_build_delete_cache(&incremental_build_plugin);
+    cb_project("foo");
+    cbp_incremental_build_delete_cache(&incremental_build_plugin);
+
+    /* Everything is compiled and linked. */
+    path = cb_bake_graph("exe");
+    cb_assert_file_exists(path);
+    cb_assert_run(path);
+
+    stats = cb_stats_get();
+    printf("%s\n", cb_stats_summary());
+
+    cb_assert_true(stats.process_count >= 4);
+    cb_assert_true(stats.compile_time > 0);
+    cb_assert_true(stats.link_time > 0);
+    cb_assert_true(stats.plugin_time > 0);
+    cb_assert_true(stats.bake_time >= stats.compile_time + stats.link_time);
+    cb_assert_true(stats.files_stated > 0);
+    cb_assert_true(stats.tmp_peak > 0);
+    cb_assert_true(stats.cache_hits == 0);
+    cb_assert_true(stats.cache_misses == 2);
+    /* Both projects are baked at the same time, the statistics of the plugin cover both of them. */
+    cb_assert_true(incremental_build_plugin.stat_compilable == 2);
+
+    cb_stats_reset();
+    stats = cb_stats_get();
+    cb_assert_true(stats.process_count == 0);
+    cb_assert_true(stats.bake_time == 0);
+
+    /* Nothing to compile or to link, the dependencies are checked. */
+    path = cb_bake_graph("exe");
+    cb_assert_file_exists(path);
+
+    stats = cb_stats_get();
+    printf("%s\n", cb_stats_summary());
+
+    cb_assert_true(stats.process_count == 0);
+    cb_assert_true(stats.compile_time == 0);
+    cb_assert_true(stats.link_time == 0);
+    cb_assert_true(stats.check_time > 0);
+    cb_assert_true(stats.bytes_hashed > 0);
+    cb_assert_true(stats.files_stated > 0);
+    cb_assert_true(stats.cache_hits == 2);
+    cb_assert_true(stats.cache_misses == 0);
+    cb_assert_true(strstr(cb_stats_summary(), " 2 cache hits, 0 cache misses") != NULL);
+    cb_assert_true(strstr(cb_stats_summary(), " 0 processes") != NULL);
+
+    cb_destroy();
+
+    return 0;
+}